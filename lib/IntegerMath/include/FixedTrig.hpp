@@ -56,6 +56,25 @@
 
 // Portable constexpr count trailing zeros (fallback for non-GCC compilers)
 namespace detail {
+    // pi/2 in Q30
+    constexpr int64_t HALF_PI_Q30 = 1686629713LL;
+
+    // sin(x), x in Q30 radians (|x| <= pi/2), Taylor series to x^19 - table generation only
+    constexpr int64_t sin_q30(int64_t x) {
+        int64_t x2 = (x * x) >> 30;
+        int64_t term = x;
+        int64_t s = x;
+        for (int64_t n = 2; n < 20; n += 2) {
+            term = -((term * x2) >> 30) / (n * (n + 1));
+            s += term;
+        }
+        return s;
+    }
+
+    constexpr int64_t cos_q30(int64_t x) {
+        return sin_q30(HALF_PI_Q30 - x);
+    }
+
     constexpr int constexpr_ctz(size_t n) {
         if (n == 0) return 0;
         int count = 0;
@@ -104,80 +123,59 @@ private:
 
     // Precompute reciprocal for multiplication instead of division
     // For converting to table index: multiply by this instead of dividing
-    static constexpr uint32_t RECIPROCAL_QUADRANT = (static_cast<uint32_t>(SinCosTableSize) << 16) / 4096;
+    // The table has SinCosTableSize points from 0 to 90 degrees: SinCosTableSize - 1 steps
+    static constexpr uint32_t RECIPROCAL_QUADRANT = (static_cast<uint32_t>(SinCosTableSize - 1) << 16) / 4096;
 
     // ========================================================================
     // Table generation helper functions - MUST be defined before table init
     // ========================================================================
 
-    static constexpr int16_t sin_internal(uint32_t angle) {
-        uint32_t x = angle;
-        uint32_t term = (x * (16384 - x)) >> 14;
-        int32_t numerator = term << 2;
-        int32_t denominator = 16487 - term;
-        return static_cast<int16_t>((numerator * OUTPUT_SCALE * 2) / denominator);
+    // OUTPUT_SCALE * sin(x), x in Q30 radians (0..pi/2), rounded
+    static constexpr int16_t sin_internal(int64_t x) {
+        return static_cast<int16_t>((detail::sin_q30(x) * OUTPUT_SCALE + (1LL << 29)) >> 30);
+    }
+
+    // Angle in Q30 radians (0..pi/2) where num * cos = den * sin, by bisection
+    static constexpr int64_t angle_for_ratio(int64_t num, int64_t den, bool useSin) {
+        int64_t low = 0;
+        int64_t high = detail::HALF_PI_Q30;
+        for (int k = 0; k < 32; ++k) {
+            int64_t mid = (low + high) / 2;
+            // atan: sin/cos < num/den, asin: sin < num/den
+            int64_t lhs = detail::sin_q30(mid) * den;
+            int64_t rhs = useSin ? (num << 30) : detail::cos_q30(mid) * num;
+            if (lhs < rhs) low = mid; else high = mid;
+        }
+        return (low + high) / 2;
+    }
+
+    // Q30 radians -> fixed angle (4096 per quarter)
+    static constexpr uint16_t to_fixed_angle(int64_t x) {
+        return static_cast<uint16_t>((x * 4096 + detail::HALF_PI_Q30 / 2) / detail::HALF_PI_Q30);
     }
 
     static constexpr std::array<int16_t, SinCosTableSize> generate_sine_quarter_table() {
         std::array<int16_t, SinCosTableSize> table{};
         for (size_t i = 0; i < SinCosTableSize; ++i) {
-            uint32_t angle = (i * 16384) / (SinCosTableSize - 1);
-            table[i] = sin_internal(angle);
+            table[i] = sin_internal(detail::HALF_PI_Q30 * static_cast<int64_t>(i) / (SinCosTableSize - 1));
         }
         return table;
     }
 
-    static constexpr std::array<uint16_t, AtanTableSize> generate_atan_quarter_table() {
-        std::array<uint16_t, AtanTableSize> table{};
-        for (size_t i = 0; i < AtanTableSize; ++i) {
-            // CORDIC implementation
-            int32_t x = 16384;
-            int32_t y = 0;
-            int32_t target_y = (i * 16384) / AtanTableSize;
-            uint32_t angle = 0;
-
-            for (int k = 0; k < 16; ++k) {
-                int32_t x_new = 0;
-                int32_t y_new = 0;
-                uint32_t angle_step = (2048 >> k);
-
-                if (y < target_y) {
-                    x_new = x - (y >> k);
-                    y_new = y + (x >> k);
-                    angle += angle_step;
-                } else {
-                    x_new = x + (y >> k);
-                    y_new = y - (x >> k);
-                    angle -= angle_step;
-                }
-                x = x_new;
-                y = y_new;
-            }
-
-            table[i] = static_cast<uint16_t>(angle);
+    // atan(i / AtanTableSize), i = 0..AtanTableSize (0..45 degrees)
+    static constexpr std::array<uint16_t, AtanTableSize + 1> generate_atan_quarter_table() {
+        std::array<uint16_t, AtanTableSize + 1> table{};
+        for (size_t i = 0; i <= AtanTableSize; ++i) {
+            table[i] = to_fixed_angle(angle_for_ratio(static_cast<int64_t>(i), AtanTableSize, false));
         }
         return table;
     }
 
-    static constexpr std::array<uint16_t, AsinTableSize> generate_asin_quarter_table() {
-        std::array<uint16_t, AsinTableSize> table{};
-        for (size_t i = 0; i < AsinTableSize; ++i) {
-            int32_t target = (i * OUTPUT_SCALE * 2) / AsinTableSize;
-            uint32_t low = 0;
-            uint32_t high = ANGLE_MAX / 2;
-
-            while (high - low > 1) {
-                uint32_t mid = (low + high) / 2;
-                int32_t sin_mid = sin_internal(mid);
-
-                if (sin_mid < target) {
-                    low = mid;
-                } else {
-                    high = mid;
-                }
-            }
-
-            table[i] = static_cast<uint16_t>((low + high) / 2);
+    // asin(i / AsinTableSize), i = 0..AsinTableSize (0..90 degrees)
+    static constexpr std::array<uint16_t, AsinTableSize + 1> generate_asin_quarter_table() {
+        std::array<uint16_t, AsinTableSize + 1> table{};
+        for (size_t i = 0; i <= AsinTableSize; ++i) {
+            table[i] = to_fixed_angle(angle_for_ratio(static_cast<int64_t>(i), AsinTableSize, true));
         }
         return table;
     }
@@ -252,7 +250,7 @@ public:
     // ============================================================
     [[nodiscard, gnu::always_inline, gnu::hot]]
     static int16_t cos(uint16_t angle) noexcept {
-        return sin(angle + (ANGLE_MAX >> 2));  // Add π/2 using shift
+        return sin(angle + (ANGLE_MAX >> 1));  // Add π/2 (ANGLE_MAX is π)
     }
 
     // ============================================================
@@ -278,23 +276,23 @@ public:
         if (abs_x >= abs_y) {
             // Single division, reuse result for both index and fraction
             uint32_t ratio_full = (abs_y << (ATAN_TABLE_BITS + 8)) / abs_x;
-            uint32_t index = (ratio_full >> 8) & ATAN_TABLE_MASK;
+            uint32_t index = ratio_full >> 8;              // 0..AtanTableSize
             uint32_t fraction = ratio_full & 0xFF;
 
             // Table lookup with interpolation using PROGMEM reads
             int32_t y0 = read_atan_table(index);
-            int32_t y1 = read_atan_table((index + 1) & ATAN_TABLE_MASK);
+            int32_t y1 = read_atan_table(index < AtanTableSize ? index + 1 : index);
 
             angle = static_cast<uint16_t>(y0 + (((y1 - y0) * fraction) >> 8));
         } else {
             // Single division, reuse result for both index and fraction
             uint32_t ratio_full = (abs_x << (ATAN_TABLE_BITS + 8)) / abs_y;
-            uint32_t index = (ratio_full >> 8) & ATAN_TABLE_MASK;
+            uint32_t index = ratio_full >> 8;
             uint32_t fraction = ratio_full & 0xFF;
 
             // Table lookup with interpolation using PROGMEM reads
             int32_t y0 = read_atan_table(index);
-            int32_t y1 = read_atan_table((index + 1) & ATAN_TABLE_MASK);
+            int32_t y1 = read_atan_table(index < AtanTableSize ? index + 1 : index);
 
             uint16_t base = static_cast<uint16_t>(y0 + (((y1 - y0) * fraction) >> 8));
             angle = (ANGLE_MAX >> 1) - base;
@@ -318,7 +316,7 @@ public:
         uint16_t offset = quadrant_offset[quadrant_adjust];
         int16_t sign = angle_sign[quadrant_adjust];
 
-        return offset + (angle * sign);
+        return (offset + (angle * sign)) & 0x3FFF;
     }
 
     // ============================================================
@@ -329,25 +327,22 @@ public:
         // Get absolute value and track sign
         uint32_t abs_val = (value < 0) ? -value : value;
 
-        // Clamp using bit operations
-        abs_val = (abs_val > OUTPUT_SCALE * 2) ? OUTPUT_SCALE * 2 : abs_val;
+        // Clamp to 1.0 (OUTPUT_SCALE, as returned by sin())
+        abs_val = (abs_val > OUTPUT_SCALE) ? OUTPUT_SCALE : abs_val;
 
         // Map to table index using multiplication by reciprocal
-        // Instead of: index = (abs_val * (AsinTableSize-1)) / (OUTPUT_SCALE * 2)
+        // Instead of: index = (abs_val * AsinTableSize) / OUTPUT_SCALE
         // We use: (abs_val * RECIPROCAL) >> SHIFT
 
-        constexpr uint32_t ASIN_RECIPROCAL = (static_cast<uint32_t>(AsinTableSize) << 16) / (OUTPUT_SCALE * 2);
+        constexpr uint32_t ASIN_RECIPROCAL = (static_cast<uint32_t>(AsinTableSize) << 16) / OUTPUT_SCALE;
 
         uint32_t index_scaled = abs_val * ASIN_RECIPROCAL;
         uint32_t index = index_scaled >> 16;
         uint8_t fraction = (index_scaled >> 8) & 0xFF;
 
-        // Bounds check
-        index = (index < AsinTableSize - 1) ? index : (AsinTableSize - 1);
-
-        // Interpolation with PROGMEM read
+        // Interpolation with PROGMEM read (table has AsinTableSize + 1 points)
         int32_t y0 = read_asin_table(index);
-        int32_t y1 = read_asin_table((index + 1) & ASIN_TABLE_MASK);
+        int32_t y1 = read_asin_table(index < AsinTableSize ? index + 1 : index);
 
         uint16_t angle = static_cast<uint16_t>(y0 + (((y1 - y0) * fraction) >> 8));
 
@@ -391,6 +386,7 @@ public:
         // Binary search for the square root
         uint32_t start = 1;
         uint32_t end = (x >> 1) + 1;  // sqrt(x) <= x/2 + 1
+        if (end > 65535) end = 65535; // ... and < 2^16, so mid * mid can't wrap
         uint32_t result = 0;
 
         while (start <= end) {
@@ -44,7 +44,7 @@ struct IntegerTrigWrapper {
     static inline uint16_t mowerToFixedAngle(angle_t angle) {
         angle = normalizeAngle(angle);
         // Approximate multiplier using multiply+shift to avoid division
-        return static_cast<uint16_t>((static_cast<int32_t>(angle) * 4663) >> 10);
+        return static_cast<uint16_t>((static_cast<int32_t>(angle) * 4661) >> 10);   // 16384 / 3600 * 1024
     }
 
     static inline angle_t fixedToMowerAngle(uint16_t fixedAngle) {
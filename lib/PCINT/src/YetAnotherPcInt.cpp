@@ -33,22 +33,15 @@
 #define IMPLEMENT_ISR(port, isr_vect, pcmsk, input) \
   ISR(isr_vect) \
   { \
+    PcInt::timestamp_t when = PCINT_TIMESTAMP(); \
     uint8_t new_state = input; \
     uint8_t trigger_pins = pcmsk & (port.state ^ new_state) & ( (port.rising & new_state) | (port.falling & ~new_state) ); \
-    PcIntCallback* callbacks = port.callbacks; \
     port.state = new_state; \
-    if (trigger_pins & _BV(0)) port.callbacks[0].func(port.callbacks[0].arg, bool(new_state & _BV(0))); \
-    if (trigger_pins & _BV(1)) port.callbacks[1].func(port.callbacks[1].arg, bool(new_state & _BV(1))); \
-    if (trigger_pins & _BV(2)) port.callbacks[2].func(port.callbacks[2].arg, bool(new_state & _BV(2))); \
-    if (trigger_pins & _BV(3)) port.callbacks[3].func(port.callbacks[3].arg, bool(new_state & _BV(3))); \
-    if (trigger_pins & _BV(4)) port.callbacks[4].func(port.callbacks[4].arg, bool(new_state & _BV(4))); \
-    if (trigger_pins & _BV(5)) port.callbacks[5].func(port.callbacks[5].arg, bool(new_state & _BV(5))); \
-    if (trigger_pins & _BV(6)) port.callbacks[6].func(port.callbacks[6].arg, bool(new_state & _BV(6))); \
-    if (trigger_pins & _BV(7)) port.callbacks[7].func(port.callbacks[7].arg, bool(new_state & _BV(7))); \
+    dispatch(port, trigger_pins, new_state, when); \
   }
 
 struct PcIntCallback {
-  PcInt::callback func;
+  PcInt::handler func;
   void* arg;
 };
   
@@ -57,8 +50,36 @@ struct PcIntPort {
   uint8_t state;
   uint8_t rising;
   uint8_t falling;
+  uint8_t with_state;  // Pins whose callback takes the pin state
+  uint8_t with_time;   // ... and the timestamp
 };
 
+// Index of the lowest set bit of a nibble (entry 0 unused)
+static const uint8_t lowest_bit_nibble[16] = { 0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0 };
+
+// Call a callback with the arguments it was attached with
+static inline __attribute__((always_inline)) void call(PcIntPort& port, uint8_t bit, uint8_t mask, bool pinstate, PcInt::timestamp_t when) {
+  PcIntCallback& cb = port.callbacks[bit];
+  if (port.with_time & mask) {
+    cb.func.stamped(cb.arg, pinstate, when);
+  } else if (port.with_state & mask) {
+    cb.func.state(cb.arg, pinstate);
+  } else {
+    cb.func.plain(cb.arg);
+  }
+}
+
+// Call the callbacks of the triggered pins only, lowest pin first
+static inline __attribute__((always_inline)) void dispatch(PcIntPort& port, uint8_t trigger_pins, uint8_t new_state, PcInt::timestamp_t when) {
+  while (trigger_pins) {
+    uint8_t low = trigger_pins & 0x0F;
+    uint8_t bit = low ? lowest_bit_nibble[low] : 4 + lowest_bit_nibble[trigger_pins >> 4];
+    uint8_t mask = trigger_pins & (uint8_t)-trigger_pins;   // No variable shifts on AVR
+    trigger_pins ^= mask;
+    call(port, bit, mask, bool(new_state & mask), when);
+  }
+}
+
 #if defined(PCINT_INPUT_PORT0)
 PcIntPort port0;
 IMPLEMENT_ISR(port0, PCINT0_vect, PCMSK0, PCINT_INPUT_PORT0)
@@ -113,7 +134,19 @@ static inline uint8_t get_port_value(uint8_t port) {
     }
 }
 
+void PcInt::attachInterrupt(uint8_t pin, callback_ts func, void* arg, uint8_t mode, bool trigger_now) {
+  handler h;
+  h.stamped = func;
+  attach(pin, h, 3, arg, mode, trigger_now);
+}
+
 void PcInt::attachInterrupt(uint8_t pin, callback func, void* arg, uint8_t mode, bool trigger_now) {
+  handler h;
+  h.state = func;
+  attach(pin, h, 2, arg, mode, trigger_now);
+}
+
+void PcInt::attach(uint8_t pin, handler func, uint8_t args, void* arg, uint8_t mode, bool trigger_now) {
   volatile uint8_t * pcicr = digitalPinToPCICR(pin);
   volatile uint8_t * pcmsk = digitalPinToPCMSK(pin);
   uint8_t portGroup = digitalPinToPCICRbit(pin);
@@ -121,10 +154,12 @@ void PcInt::attachInterrupt(uint8_t pin, callback func, void* arg, uint8_t mode,
   uint8_t portBitMask = _BV(portBit);
   PcIntPort* port = get_port(portGroup);
   
-  if (pcicr && pcmsk && port && func) {
+  if (pcicr && pcmsk && port && func.plain) {
     WITHOUT_INTERRUPTION({
       port->callbacks[portBit].func = func;
       port->callbacks[portBit].arg  = arg;
+      port->with_state = (args >= 2)  ?  (port->with_state | portBitMask)  :  (port->with_state & ~portBitMask);
+      port->with_time  = (args >= 3)  ?  (port->with_time  | portBitMask)  :  (port->with_time  & ~portBitMask);
       port->rising  = (mode == RISING || mode == CHANGE)  ?  (port->rising  | portBitMask)  :  (port->rising  & ~portBitMask);
       port->falling = (mode == FALLING|| mode == CHANGE)  ?  (port->falling | portBitMask)  :  (port->falling & ~portBitMask);
       *pcmsk |= portBitMask;
@@ -135,7 +170,7 @@ void PcInt::attachInterrupt(uint8_t pin, callback func, void* arg, uint8_t mode,
       
       if (trigger_now) {
         if ( portBitMask & ( (port->rising & port->state) | (port->falling & ~port->state) ) ) {
-           port->callbacks[portBit].func(port->callbacks[portBit].arg, bool(port->state & portBitMask));
+           call(*port, portBit, portBitMask, bool(port->state & portBitMask), PCINT_TIMESTAMP());
         }
       }
     })
@@ -152,7 +187,7 @@ void PcInt::detachInterrupt(uint8_t pin) {
   
   if (pcicr && pcmsk && port) {
     WITHOUT_INTERRUPTION({
-      port->callbacks[portBit].func = nullptr;
+      port->callbacks[portBit].func.plain = nullptr;
       port->callbacks[portBit].arg  = nullptr;
       port->rising &= ~portBitMask;
       port->falling &= ~portBitMask; 
@@ -165,3 +200,52 @@ void PcInt::detachInterrupt(uint8_t pin) {
     })
   }
 }
+
+
+// === Deferred event log ===
+// Single producer (the PCINT ISRs, which don't nest) / single consumer (readEvent).
+// The producer only writes head, the consumer only writes tail; 8 bit indices are atomic on AVR.
+
+static_assert((PCINT_EVENT_LOG_SIZE & (PCINT_EVENT_LOG_SIZE - 1)) == 0 && PCINT_EVENT_LOG_SIZE <= 128,
+              "PCINT_EVENT_LOG_SIZE must be a power of two <= 128");
+
+static PcInt::Event event_log[PCINT_EVENT_LOG_SIZE];
+static volatile uint8_t event_head = 0;
+static volatile uint8_t event_tail = 0;
+static volatile uint8_t event_dropped = 0;
+
+static void log_event(void* arg, bool pinstate, PcInt::timestamp_t when) {
+  uint8_t head = event_head;
+  if ((uint8_t)(head - event_tail) >= PCINT_EVENT_LOG_SIZE) {
+    if (event_dropped != 0xFF) event_dropped++;
+    return;
+  }
+  PcInt::Event& e = event_log[head & (PCINT_EVENT_LOG_SIZE - 1)];
+  e.pin = (uint8_t)(uintptr_t)arg;
+  e.pinstate = pinstate;
+  e.when = when;
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+  event_head = head + 1;
+}
+
+void PcInt::attachLogged(uint8_t pin, uint8_t mode) {
+  attachInterrupt(pin, log_event, (void*)(uintptr_t)pin, mode, false);
+}
+
+bool PcInt::readEvent(Event &event) {
+  uint8_t tail = event_tail;
+  if (tail == event_head) return false;
+  event = event_log[tail & (PCINT_EVENT_LOG_SIZE - 1)];
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+  event_tail = tail + 1;
+  return true;
+}
+
+uint8_t PcInt::eventsDropped() {
+  uint8_t dropped;
+  WITHOUT_INTERRUPTION({
+    dropped = event_dropped;
+    event_dropped = 0;
+  })
+  return dropped;
+}
@@ -27,32 +27,71 @@
 
 #include <Arduino.h>
 
+// Timestamp taken once at ISR entry and passed to every callback of that interrupt.
+// Override with a build flag, e.g. -D'PCINT_TIMESTAMP()=TCNT1' for a free-running
+// Timer1, or -D'PCINT_TIMESTAMP()=0' to skip it.
+#ifndef PCINT_TIMESTAMP
+#define PCINT_TIMESTAMP() micros()
+#endif
+
+// Size of the deferred event log (power of two, <= 128)
+#ifndef PCINT_EVENT_LOG_SIZE
+#define PCINT_EVENT_LOG_SIZE 16
+#endif
+
 class PcInt {
 public:
+  typedef uint32_t timestamp_t;
   typedef void (*callback)(void *userdata, bool pinstate);
+  typedef void (*callback_ts)(void *userdata, bool pinstate, timestamp_t when);
+  typedef void (*callback_plain)(void *userdata);
+
+  // What a pin calls; the pin's argument count tells the dispatcher which member is set.
+  union handler {
+    callback_plain plain;
+    callback state;
+    callback_ts stamped;
+  };
+
+  // One logged pin change, see attachLogged()
+  struct Event {
+    uint8_t pin;
+    bool pinstate;
+    timestamp_t when;
+  };
   
+  static void attachInterrupt(uint8_t pin, callback_ts func, void *userdata, uint8_t mode=CHANGE, bool trigger_now=false);
   static void attachInterrupt(uint8_t pin, callback func, void *userdata, uint8_t mode=CHANGE, bool trigger_now=false);
   static void detachInterrupt(uint8_t pin);
 
+  // Record changes on `pin` as Events into a lock-free ring instead of calling back.
+  // Drain them outside the ISR with readEvent().
+  static void attachLogged(uint8_t pin, uint8_t mode=CHANGE);
+  static bool readEvent(Event &event);
+  // Events lost because the log was full (reset on read)
+  static uint8_t eventsDropped();
+
 
   // === Syntax sugar for `attachInterrupt()` with different callback signatures ===
-  
+
+  // Callbacks are called with exactly the arguments they declare: each pin
+  // remembers which of the handler types below it holds.
+
   // Ataches an interrupt callback without arguments.
   static inline void attachInterrupt(uint8_t pin, void(*func)(), uint8_t mode=CHANGE, bool trigger_now=false) {
-    //On AVR's calling convention, if we call a funcion with extra arguments, they are silently ignored
-    attachInterrupt(pin, (callback)func, nullptr, mode, trigger_now);
+    attachInterrupt(pin, _wrap_callback_void, func, mode, trigger_now);
   };
 
   // Ataches an interrupt callback with user data.
   template<typename T>
   static inline void attachInterrupt(uint8_t pin, void(*func)(T *arg), T *userdata, uint8_t mode=CHANGE, bool trigger_now=false) {
-    //On AVR's calling convention, if we call a funcion with extra arguments, they are silently ignored
-    attachInterrupt(pin, (PcInt::callback)func, (void*)userdata, mode, trigger_now);
+    handler h;
+    h.plain = (callback_plain)func;
+    attach(pin, h, 1, (void*)userdata, mode, trigger_now);
   };
 
   // Ataches an interrupt callback with pin state.
   static inline void attachInterrupt(uint8_t pin, void(*func)(bool pinstate), uint8_t mode=CHANGE, bool trigger_now=false) {
-    //On AVR's calling convention, if we call a funcion with extra arguments, they are silently ignored
     attachInterrupt(pin, _wrap_callback_pinvalue, func, mode, trigger_now);
   };
   
@@ -61,11 +100,24 @@ public:
   static inline void attachInterrupt(uint8_t pin, void(*func)(T *arg, bool pinstate), T *userdata, uint8_t mode=CHANGE, bool trigger_now=false) {
     attachInterrupt(pin, (PcInt::callback)func, (void*)userdata, mode, trigger_now);
   };
+
+  // Ataches an interrupt callback with user data, pin state and the ISR entry timestamp.
+  template<typename T>
+  static inline void attachInterrupt(uint8_t pin, void(*func)(T *arg, bool pinstate, timestamp_t when), T *userdata, uint8_t mode=CHANGE, bool trigger_now=false) {
+    attachInterrupt(pin, (PcInt::callback_ts)func, (void*)userdata, mode, trigger_now);
+  };
   
   
 private:
+  static void attach(uint8_t pin, handler func, uint8_t args, void *userdata, uint8_t mode, bool trigger_now);
+
   //This tiny wrapper is necessary for callback with pin_state but without userdata
   static void _wrap_callback_pinvalue(void (*func)(bool pinstate), bool pinstate) {
     func(pinstate);
   };
+
+  //Same for callbacks without any argument
+  static void _wrap_callback_void(void (*func)()) {
+    func();
+  };
 };
@@ -3,15 +3,79 @@
 
 #include "globals.hpp"
 #include <TaskSchedulerDeclarations.h>
+#include "Queue.h"
+#include "MoveProgram.h"
+#include "movePatterns.h"
 
+// Answers MoveProgram BRANCH sensor queries (true = sensor active)
+typedef bool (*patternSensorCallback)(uint8_t sensor);
+
+// Pattern priorities - a pattern can only be preempted by a higher priority
+enum PatternPriority : uint8_t {
+   PRIORITY_ROUTINE = 0,      // Mowing / continuous driving
+   PRIORITY_NAVIGATION,       // Turns, manoeuvres
+   PRIORITY_OBSTACLE,         // Sonar obstacle avoidance
+   PRIORITY_BOUNDARY,         // Boundary wire reaction
+   PRIORITY_EMERGENCY         // Emergency stop
+};
+
+// AllMovements - runs flash-resident motion patterns
+// Callback() is a small interpreter over the MoveProgram bytecode.
+// Higher-priority patterns preempt the running one from the current wheel
+// speeds (no stop); the interrupted pattern resumes when they end.
+// Stop patterns end in HALT: interrupted and chained patterns are dropped and
+// the wheels stay at zero until setCurrentPattern() (or a higher priority
+// preempt).
 class AllMovements : public Task {
 private:
-#include <movePatterns.h>
+   // Execution state of one running pattern
+   struct PatternContext {
+      const uint8_t* pc;                 // Next bytecode to execute (PROGMEM)
+      const uint8_t* callStack[MoveProgram::MaxCallDepth];
+      uint8_t callDepth;
+      struct LoopFrame {
+         const uint8_t* start;           // First byte of loop body
+         uint8_t remaining;              // Iterations left including current
+      } loopStack[MoveProgram::MaxLoopDepth];
+      uint8_t loopDepth;
+      CurrentMotion motion;
+      uint8_t priority;
+      int8_t left, right;                // Quantized speeds of the current step
+      time_ms_t stepStart;               // When the current step began
+      uint16_t stepMs;                   // Duration of the current step
+   };
+
+   // Pattern queued to run next, with the priority it runs at
+   struct ChainEntry {
+      uint8_t motion;
+      uint8_t priority;
+   };
+
+   static constexpr uint8_t MaxPreemptDepth = 2;   // Interrupted patterns kept for resume
+   static constexpr uint8_t ChainDepth = 4;        // Patterns queued to run next
+   // Ramp time used when blending into a preempting or resumed pattern
+   static constexpr uint16_t BlendMs = 2 * WheelUpdateRate;
+
+   PatternContext ctx;
+   PatternContext saved[MaxPreemptDepth];
+   uint8_t savedCount = 0;
+   Queue<ChainEntry, ChainDepth, 0> chained;
+   bool blendNext = false;
+
+   // Reaction latency: preempt() -> first motor command (microseconds)
+   bool latencyPending = false;
+   unsigned long preemptStartMicros = 0;
+   unsigned long lastLatencyMicros = 0;
+   unsigned long maxLatencyMicros = 0;
 
-    /* data */
-   inline static movement *currMove = nullptr;
    inline static motorSpeedCallback AdjustSpeedCallback = nullptr;
-   CurrentMotion CurrMotion = CONTINUOUS;
+   inline static patternSensorCallback SensorCallback = nullptr;
+
+   void waitFor(uint16_t mSec);
+   void start(CurrentMotion _CM, uint8_t priority);
+   void emitSpeed(int8_t left, int8_t right, uint16_t mSec);
+   bool resume();
+   void dropPending();
 
 public:
    AllMovements(Scheduler* aS, motorSpeedCallback f);
@@ -20,71 +84,270 @@ public:
    bool Callback() override;
    void setCurrentPattern(CurrentMotion _CM);
    void setCallback(motorSpeedCallback f);
-   inline CurrentMotion CurrentPattern() { return CurrMotion; };
+   void setSensorCallback(patternSensorCallback f) { SensorCallback = f; };
+   inline CurrentMotion CurrentPattern() { return ctx.motion; };
+   inline uint8_t CurrentPriority() { return ctx.priority; };
+
+   // Interrupt the running pattern with a higher priority one (call from task context).
+   // The first motor command is issued before returning.
+   // Returns false if the running pattern has equal or higher priority.
+   bool preempt(CurrentMotion _CM, uint8_t priority);
+
+   // Run a pattern after the current one ends (instead of going continous)
+   bool chainPattern(CurrentMotion _CM, uint8_t priority = PRIORITY_ROUTINE) {
+      return chained.push(ChainEntry{(uint8_t)_CM, priority});
+   };
+
+   // Reaction latency of the last / worst preemption in microseconds
+   unsigned long lastPreemptLatency() const { return lastLatencyMicros; };
+   unsigned long maxPreemptLatency() const { return maxLatencyMicros; };
+
+   // Bytecode for a pattern (PROGMEM address)
+   static const uint8_t* program(uint8_t pattern);
 };
 
 inline AllMovements::AllMovements(Scheduler* aS, motorSpeedCallback f)
           : Task(1, TASK_FOREVER, aS, false) {
    setIterations(1);
    AdjustSpeedCallback = f;
+   start(CONTINUOUS, PRIORITY_ROUTINE);
 }
 
 inline AllMovements::~AllMovements() {
 }
 
+inline void AllMovements::setCallback(motorSpeedCallback f) {
+   AdjustSpeedCallback = f;
+}
+
+inline void AllMovements::waitFor(uint16_t mSec) {
+   ctx.stepStart = millis();
+   ctx.stepMs = mSec;
+   setInterval(mSec);
+   restartDelayed();
+}
+
+inline void AllMovements::start(CurrentMotion _CM, uint8_t priority) {
+   ctx.pc = program(_CM);
+   ctx.callDepth = 0;
+   ctx.loopDepth = 0;
+   ctx.motion = _CM;
+   ctx.priority = priority;
+   ctx.stepStart = millis();
+   ctx.stepMs = 0;
+}
+
+// Issue a motor command; right after a preempt/resume the ramp is shortened to BlendMs
+inline void AllMovements::emitSpeed(int8_t left, int8_t right, uint16_t mSec) {
+   using MoveProgram::SpeedQuantum;
+
+   uint16_t ramp = mSec;
+   if (blendNext && ramp > BlendMs) ramp = BlendMs;
+   blendNext = false;
+
+   ctx.left = left;
+   ctx.right = right;
+   movement m = { (wheelSpeed)(left * SpeedQuantum), (wheelSpeed)(right * SpeedQuantum), ramp };
+   AdjustSpeedCallback(m);
+
+   if (latencyPending) {
+      lastLatencyMicros = micros() - preemptStartMicros;
+      if (lastLatencyMicros > maxLatencyMicros) maxLatencyMicros = lastLatencyMicros;
+      latencyPending = false;
+   }
+}
+
+inline bool AllMovements::preempt(CurrentMotion _CM, uint8_t priority) {
+   if (priority <= ctx.priority) return false;
+
+   preemptStartMicros = micros();
+   latencyPending = true;
+   DEBUG_PRINT("Preempt with:  ");
+   DEBUG_PRINTLN(_CM);
+
+   if (savedCount == MaxPreemptDepth) {
+      // Stack full: drop the lowest priority (oldest) interrupted pattern,
+      // the running one is kept for resume
+      DEBUG_PRINT("Preempt stack full, dropped: ");
+      DEBUG_PRINTLN(saved[0].motion);
+      for (uint8_t i = 1; i < savedCount; i++) saved[i - 1] = saved[i];
+      savedCount--;
+   }
+   saved[savedCount++] = ctx;
+
+   start(_CM, priority);
+   blendNext = true;
+   Callback();          // First motor command now, not on the next scheduler pass
+   return true;
+}
+
+// Continue the most recently interrupted pattern.
+// Returns true if the interrupted step was re-issued (task is now waiting).
+inline bool AllMovements::resume() {
+   ctx = saved[--savedCount];
+   DEBUG_PRINT("Resume:  ");
+   DEBUG_PRINTLN(ctx.motion);
+
+   // Time left of the step that was interrupted
+   time_ms_t elapsed = millis() - ctx.stepStart;
+   if (elapsed < ctx.stepMs) {
+      uint16_t remaining = ctx.stepMs - elapsed;
+      blendNext = true;
+      emitSpeed(ctx.left, ctx.right, remaining);
+      waitFor(remaining);
+      return true;
+   }
+   blendNext = true;   // Step already over - blend into the next one instead
+   return false;
+}
+
+// Forget interrupted and chained patterns
+inline void AllMovements::dropPending() {
+   ChainEntry dropped;
+   while (chained.pull(dropped)) {}
+   savedCount = 0;
+}
+
 inline bool AllMovements::Callback() {
-   DEBUG_PRINT("Moves task CB  ");
-   DEBUG_PRINTLN(currMove->mSec);
-   if (currMove->mSec == 0) {
-       currMove = Continous; //When at last action, run straight.
-       DEBUG_PRINTLN("EOF current move, going continous");
+   using namespace MoveProgram;
+
+   for (uint8_t ops = 0; ops < MaxOpsPerTick; ops++) {
+      uint8_t op = pgm_read_byte(ctx.pc++);
+
+      switch (op) {
+      case OP_SPEED: {
+         int8_t left = (int8_t)pgm_read_byte(ctx.pc++);
+         int8_t right = (int8_t)pgm_read_byte(ctx.pc++);
+         uint16_t mSec = readVarint(ctx.pc);
+         DEBUG_PRINT("Moves task CB  ");
+         DEBUG_PRINTLN(mSec);
+         emitSpeed(left, right, mSec);
+         waitFor(mSec);
+         return true;
+      }
+      case OP_HOLD:
+         waitFor(readVarint(ctx.pc));
+         return true;
+
+      case OP_LOOP:
+         if (ctx.loopDepth < MaxLoopDepth) {
+            ctx.loopStack[ctx.loopDepth].remaining = pgm_read_byte(ctx.pc++);
+            ctx.loopStack[ctx.loopDepth].start = ctx.pc;
+            ctx.loopDepth++;
+         } else {
+            // A CALL nested the loops too deep: the body cannot be matched
+            // with its NEXT, so the pattern is abandoned like a bad opcode
+            DEBUG_PRINTLN("Pattern loop too deep");
+            start(CONTINUOUS, PRIORITY_ROUTINE);
+         }
+         break;
+
+      case OP_NEXT:
+         if (ctx.loopDepth > 0) {
+            PatternContext::LoopFrame& frame = ctx.loopStack[ctx.loopDepth - 1];
+            if (frame.remaining > 1) {
+               frame.remaining--;
+               ctx.pc = frame.start;
+            } else {
+               ctx.loopDepth--;
+            }
+         }
+         break;
+
+      case OP_BRANCH: {
+         uint8_t sensor = pgm_read_byte(ctx.pc++);
+         uint8_t skip = pgm_read_byte(ctx.pc++);
+         if (SensorCallback && SensorCallback(sensor)) ctx.pc += skip;
+         break;
+      }
+      case OP_CALL: {
+         uint8_t pattern = pgm_read_byte(ctx.pc++);
+         if (ctx.callDepth < MaxCallDepth) {
+            ctx.callStack[ctx.callDepth++] = ctx.pc;
+            ctx.pc = program(pattern);
+         } else {
+            DEBUG_PRINTLN("Pattern call too deep");
+         }
+         break;
+      }
+      case OP_HALT:
+         // Stay on HALT: a preempting pattern that ends resumes into it again
+         dropPending();
+         ctx.pc--;
+         emitSpeed(0, 0, BlendMs);        // The wheels may be on a resumed pattern's speeds
+         DEBUG_PRINTLN("Pattern halted");
+         disable();
+         return false;
+
+      case OP_END: {
+         ChainEntry next;
+         if (ctx.callDepth > 0) {
+            ctx.pc = ctx.callStack[--ctx.callDepth];
+         } else if (savedCount > 0) {
+            if (resume()) return true;
+         } else if (chained.pull(next)) {
+            start((CurrentMotion)next.motion, next.priority);
+            DEBUG_PRINT("Chained move:  ");
+            DEBUG_PRINTLN(next.motion);
+         } else {
+            start(CONTINUOUS, PRIORITY_ROUTINE); //When at last action, run straight.
+            DEBUG_PRINTLN("EOF current move, going continous");
+         }
+         break;
+      }
+      default:
+         DEBUG_PRINT("Bad pattern opcode: ");
+         DEBUG_PRINTLN(op);
+         start(CONTINUOUS, PRIORITY_ROUTINE);
+         break;
+      }
    }
-   AdjustSpeedCallback(*currMove);
-   setInterval(currMove->mSec);
-   DEBUG_PRINT("currMove->mSec  :");
-   DEBUG_PRINTLN(currMove->mSec);
-   currMove++;
-   DEBUG_PRINT("Next move ->mSec  :");
-   DEBUG_PRINTLN(currMove->mSec);
-   restartDelayed();
+
+   // Only non-waiting ops this tick (e.g. empty loop) - yield and continue later
+   waitFor(1);
    return true;
 };
 
-inline void AllMovements::setCurrentPattern(CurrentMotion _CM) {
-   AllMovements::CurrMotion = _CM;
-   DEBUG_PRINT("SetCurMotion:  ");
-   DEBUG_PRINTLN(_CM);
+inline const uint8_t* AllMovements::program(uint8_t pattern) {
+   using namespace MovePatterns;
 
-   switch (_CM) {
-   case CONTINUOUS:
-      currMove = Continous;
-      break;
-   case CHARGER_BACKOUT:
-      currMove = ChargerBackout;
-      break;
-   case BWF_LEFT:
-      currMove = BWFLeft;
-      break;
-   case BWF_RIGHT:
-      currMove = BWFRight;
-      break;
-   case CIRCLE:
-      currMove = Circle;
-      break;
-   case TURN_LEFT:
-      currMove = TurnLeft;
-      break;
-   case SLOW_DOWN:
-      currMove = SlowDown;
-      break;
-   case AVOID_OBSTACLE:
-      currMove = AvoidObstacle;
-      break;
+   switch (pattern) {
+   case CONTINUOUS:              return Continous.bytes;
+   case CHARGER_BACKOUT:         return ChargerBackout.bytes;
+   case BWF_LEFT:                return BWFLeft.bytes;
+   case BWF_RIGHT:               return BWFRight.bytes;
+   case CIRCLE:                  return Circle.bytes;
+   case TURN_LEFT:               return TurnLeft.bytes;
+   case SLOW_DOWN:               return SlowDown.bytes;
+   case AVOID_OBSTACLE:          return AvoidObstacle.bytes;
+   case EMERGENCY_STOP:          return EmergencyStop.bytes;
+   case GENTLE_STOP:             return GentleStop.bytes;
+   case SPOT_TURN_LEFT_90:       return SpotTurnLeft90.bytes;
+   case SPOT_TURN_RIGHT_90:      return SpotTurnRight90.bytes;
+   case SPOT_TURN_180:           return SpotTurn180.bytes;
+   case REVERSE_AND_TURN:        return ReverseAndTurn.bytes;
+   case GENTLE_ARC_LEFT:         return GentleArcLeft.bytes;
+   case GENTLE_ARC_RIGHT:        return GentleArcRight.bytes;
+   case PERIMETER_SEARCH_SPIRAL: return PerimeterSearchSpiral.bytes;
+   case GPS_DRIFT_CORRECTION:    return GPSDriftCorrection.bytes;
+   case OBSTACLE_NUDGE_LEFT:     return ObstacleNudgeLeft.bytes;
+   case OBSTACLE_NUDGE_RIGHT:    return ObstacleNudgeRight.bytes;
+   case TEARDROP_TURN_180:       return TeardropTurn180.bytes;
+   case TEARDROP_TURN_180_LEFT:  return TeardropTurn180Left.bytes;
    default:
       DEBUG_PRINTLN("Default move!");
-      currMove = Continous;
+      return Continous.bytes;
    };
+}
+
+// Replace whatever is running (including interrupted and chained patterns)
+inline void AllMovements::setCurrentPattern(CurrentMotion _CM) {
+   DEBUG_PRINT("SetCurMotion:  ");
+   DEBUG_PRINTLN(_CM);
+
+   dropPending();
+   start(_CM, PRIORITY_ROUTINE);
    restart();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,552 @@
+#ifndef COVERAGECLEANUP_H
+#define COVERAGECLEANUP_H
+
+#include "globals.hpp"
+#include "Arduino.h"
+#include "MowerTypes.h"
+#include "IntegerMathDefault.h"
+#include "CoverageMap.h"
+
+// CoverageCleanup - plans short stripes over the gaps a CoverageMap still has
+// INTEGER ONLY - cells for planning, mm for the fragments
+//
+// Incremental: step() does a bounded amount of work and returns; call it
+// until takeFragment() has a stripe or isDone(). Per round:
+//   scan       uncovered runs row by row (all-covered words skipped), joined
+//              with the runs of the row before into regions (8-connected,
+//              union-find), WordsPerStep words per step
+//   order      nearest neighbour tour over the region centers from the
+//              mower's position, one tour position per step
+//   improve    2-opt on the open tour, PairsPerStep pairs per step, until a
+//              pass finds nothing (at most MaxPasses)
+//   fragments  per region, bands one blade wide from the side nearer the
+//              mower, walked from the end nearer the mower; every run of
+//              uncovered rows in a band gives a stripe. A covered row ends the
+//              run: excludeOutside() marks off-lawn cells covered, so a stripe
+//              never crosses a bay of a concave lawn or an exclusion zone
+// After the last fragment of a round the map is scanned again (what the
+// fragments mowed is then covered). Regions beyond MaxRegions and runs beyond
+// MaxRuns per row wait for the next round. Planning ends when a scan finds no
+// region of minCells, when a round did not shrink the gaps, or after maxRounds.
+//
+// RAM: ~400 bytes.
+class CoverageCleanup {
+public:
+   static constexpr uint8_t MaxRegions = 16;
+   static constexpr uint8_t MaxRuns = 16;                // Uncovered runs per row
+   static constexpr uint8_t NoRegion = 0xFF;
+   static constexpr uint16_t DefaultWordsPerStep = 64;
+   static constexpr uint8_t DefaultPairsPerStep = 16;
+   static constexpr uint8_t MaxPasses = 4;
+   static constexpr uint8_t DefaultMaxRounds = 32;
+   static constexpr uint16_t DefaultMinCells = 4;        // Smaller regions are ignored
+
+   enum Phase : uint8_t {
+      IDLE,
+      SCANNING,
+      ORDERING,
+      IMPROVING,
+      FRAGMENTS,
+      DONE
+   };
+
+private:
+   struct Run {
+      uint16_t c0, c1;
+      uint8_t region;
+   };
+
+   struct Region {
+      uint16_t minCol, maxCol;
+      uint16_t minRow, maxRow;
+      uint16_t cells;              // Saturates at 65535
+      uint8_t parent;              // Union-find; == own index for a root, NoRegion if free
+   };
+
+   CoverageMap *_map;
+   Phase _phase;
+   uint16_t _wordsPerStep;
+   uint8_t _pairsPerStep;
+   uint16_t _minCells;
+   uint8_t _maxRounds;
+   uint8_t _round;
+   uint16_t _bandCells;             // Fragment spacing (blade width) in cells
+   Point2D_int _position;           // Mower, then the end of the last fragment
+
+   // Scan
+   Region _regions[MaxRegions];
+   uint8_t _regionCount;
+   Run _prev[MaxRuns];
+   Run _cur[MaxRuns];
+   uint8_t _prevCount;
+   uint8_t _curCount;
+   uint16_t _row;
+   uint16_t _droppedRuns;           // Runs the tables had no room for, this round
+   uint16_t _lastDroppedRuns;
+   uint32_t _gapCells;              // Cells in the regions of the last scan
+
+   // Tour
+   uint8_t _order[MaxRegions];
+   uint8_t _orderCount;
+   uint8_t _built;
+   uint8_t _i, _j;
+   uint8_t _pass;
+   bool _improved;
+
+   // Fragments
+   uint8_t _tourIndex;
+   uint16_t _band;
+   uint16_t _bandCount;
+   bool _bandsDescending;
+   int32_t _bandRow;                // Next row, walking towards _bandEnd
+   int32_t _bandEnd;
+   int8_t _rowStep;
+   int32_t _firstRow;               // Uncovered run so far, -1 = none
+   int32_t _lastRow;
+   uint16_t _runCol0;               // Uncovered columns of the run
+   uint16_t _runCol1;
+   bool _hasFragment;
+   Point2D_int _fragmentStart;
+   Point2D_int _fragmentEnd;
+   uint16_t _fragments;
+
+   uint8_t find(uint8_t r) const {
+      while (_regions[r].parent != r) r = _regions[r].parent;
+      return r;
+   }
+
+   void addCells(Region &g, uint32_t n) {
+      uint32_t c = (uint32_t)g.cells + n;
+      g.cells = c > 0xFFFF ? 0xFFFF : c;
+   }
+
+   void extend(uint8_t r, uint16_t row, uint16_t c0, uint16_t c1) {
+      Region &g = _regions[r];
+      if (c0 < g.minCol) g.minCol = c0;
+      if (c1 > g.maxCol) g.maxCol = c1;
+      if (row < g.minRow) g.minRow = row;
+      if (row > g.maxRow) g.maxRow = row;
+      addCells(g, c1 - c0 + 1);
+   }
+
+   void merge(uint8_t from, uint8_t into) {
+      Region &a = _regions[from];
+      Region &b = _regions[into];
+      a.parent = into;
+      if (a.minCol < b.minCol) b.minCol = a.minCol;
+      if (a.maxCol > b.maxCol) b.maxCol = a.maxCol;
+      if (a.minRow < b.minRow) b.minRow = a.minRow;
+      if (a.maxRow > b.maxRow) b.maxRow = a.maxRow;
+      addCells(b, a.cells);
+   }
+
+   void pushRun(uint16_t c0, uint16_t c1) {
+      if (_curCount >= MaxRuns) {
+         _droppedRuns++;
+         return;
+      }
+      _cur[_curCount].c0 = c0;
+      _cur[_curCount].c1 = c1;
+      _cur[_curCount].region = NoRegion;
+      _curCount++;
+   }
+
+   void scanRow(uint16_t row) {
+      // Uncovered runs, a word at a time
+      _curCount = 0;
+      int32_t start = -1;
+      uint16_t stride = _map->getStride();
+      for (uint16_t w = 0; w < stride; w++) {
+         uint32_t v = _map->getRowWord(row, w);
+         uint16_t base = w << 5;
+         if (v == 0xFFFFFFFFUL) {
+            if (start >= 0) pushRun(start, base - 1);
+            start = -1;
+            continue;
+         }
+         if (v == 0 && start >= 0) continue;
+         for (uint8_t b = 0; b < 32; b++) {
+            bool covered = (v >> b) & 1;
+            if (!covered && start < 0) start = base + b;
+            if (covered && start >= 0) {
+               pushRun(start, base + b - 1);
+               start = -1;
+            }
+         }
+      }
+      if (start >= 0) pushRun(start, _map->getCols() - 1);
+
+      // Join with the runs of the row before (8-connected)
+      for (uint8_t k = 0; k < _curCount; k++) {
+         Run &r = _cur[k];
+         uint8_t id = NoRegion;
+         for (uint8_t p = 0; p < _prevCount; p++) {
+            const Run &q = _prev[p];
+            if (q.region == NoRegion || q.c0 > r.c1 + 1 || q.c1 + 1 < r.c0) continue;
+            uint8_t root = find(q.region);
+            if (id == NoRegion) id = root;
+            else if (root != id) merge(root, id);
+         }
+         if (id == NoRegion) {
+            id = allocRegion();
+            if (id == NoRegion) {
+               _droppedRuns++;
+               continue;
+            }
+            Region &g = _regions[id];
+            g.minCol = r.c0;
+            g.maxCol = r.c1;
+            g.minRow = row;
+            g.maxRow = row;
+            g.cells = 0;
+            g.parent = id;
+         }
+         extend(id, row, r.c0, r.c1);
+         r.region = id;
+      }
+
+      for (uint8_t k = 0; k < _curCount; k++) {
+         _prev[k] = _cur[k];
+         if (_prev[k].region != NoRegion) _prev[k].region = find(_prev[k].region);
+      }
+      _prevCount = _curCount;
+      releaseClosed();
+   }
+
+   uint8_t allocRegion() {
+      for (uint8_t r = 0; r < _regionCount; r++) {
+         if (_regions[r].parent == NoRegion) return r;
+      }
+      return _regionCount < MaxRegions ? _regionCount++ : NoRegion;
+   }
+
+   // Runs now point at roots only, so merged regions are garbage; a root no
+   // run continues is finished and dropped if it is too small to bother
+   void releaseClosed() {
+      bool open[MaxRegions];
+      for (uint8_t r = 0; r < _regionCount; r++) open[r] = false;
+      for (uint8_t k = 0; k < _prevCount; k++) {
+         if (_prev[k].region != NoRegion) open[_prev[k].region] = true;
+      }
+      for (uint8_t r = 0; r < _regionCount; r++) {
+         Region &g = _regions[r];
+         if (g.parent == NoRegion || open[r]) continue;
+         if (g.parent != r || g.cells < _minCells) g.parent = NoRegion;
+      }
+   }
+
+   void startScan() {
+      _phase = SCANNING;
+      _droppedRuns = 0;
+      _regionCount = 0;
+      _prevCount = 0;
+      _curCount = 0;
+      _row = 0;
+      _orderCount = 0;
+   }
+
+   void finishScan() {
+      _orderCount = 0;
+      uint32_t cells = 0;
+      for (uint8_t r = 0; r < _regionCount; r++) {
+         if (_regions[r].parent == r && _regions[r].cells >= _minCells) {
+            _order[_orderCount++] = r;
+            cells += _regions[r].cells;
+         }
+      }
+      // Done when nothing is left, or the last round's stripes did not shrink
+      // the gaps (unreachable, or the blade misses them every time)
+      bool stuck = _round > 0 && cells >= _gapCells && _droppedRuns == _lastDroppedRuns;
+      _gapCells = cells;
+      _lastDroppedRuns = _droppedRuns;
+      if (_orderCount == 0 || stuck) {
+         _phase = DONE;
+         return;
+      }
+      _built = 0;
+      _phase = ORDERING;
+   }
+
+   // Cell of _position, (0, 0) on an invalid map; outside the grid is fine,
+   // only the distances are used
+   void positionCell(int32_t &col, int32_t &row) const {
+      col = 0;
+      row = 0;
+      _map->cellOf(_position, col, row);
+   }
+
+   // Region center, mower position for index -1 (cells)
+   void tourPoint(int8_t index, int32_t &col, int32_t &row) const {
+      if (index < 0) {
+         positionCell(col, row);
+         return;
+      }
+      const Region &g = _regions[_order[index]];
+      col = ((int32_t)g.minCol + g.maxCol) / 2;
+      row = ((int32_t)g.minRow + g.maxRow) / 2;
+   }
+
+   uint32_t distance(int8_t a, int8_t b) const {
+      int32_t ac, ar, bc, br;
+      tourPoint(a, ac, ar);
+      tourPoint(b, bc, br);
+      int32_t dc = ac - bc;
+      int32_t dr = ar - br;
+      return fast_sqrt((uint32_t)(dc * dc + dr * dr));
+   }
+
+   void orderStep() {
+      // Nearest of the rest to the last placed one
+      uint8_t best = _built;
+      uint32_t bestD = 0xFFFFFFFFUL;
+      for (uint8_t k = _built; k < _orderCount; k++) {
+         uint32_t d = distance((int8_t)_built - 1, k);
+         if (d < bestD) {
+            bestD = d;
+            best = k;
+         }
+      }
+      uint8_t t = _order[_built];
+      _order[_built] = _order[best];
+      _order[best] = t;
+
+      if (++_built >= _orderCount) {
+         _i = 0;
+         _j = 1;
+         _pass = 0;
+         _improved = false;
+         _phase = IMPROVING;
+      }
+   }
+
+   void improveStep() {
+      for (uint8_t k = 0; k < _pairsPerStep; k++) {
+         if (_j >= _orderCount) {
+            _i++;
+            _j = _i + 1;
+         }
+         if (_i + 1 >= _orderCount) {
+            if (!_improved || ++_pass >= MaxPasses) {
+               startFragments();
+               return;
+            }
+            _i = 0;
+            _j = 1;
+            _improved = false;
+         }
+
+         // Reverse order[i..j]: edges (i-1, i) and (j, j+1) become (i-1, j) and (i, j+1)
+         bool last = _j + 1 >= _orderCount;
+         uint32_t before = distance(_i - 1, _i) + (last ? 0 : distance(_j, _j + 1));
+         uint32_t after = distance(_i - 1, _j) + (last ? 0 : distance(_i, _j + 1));
+         if (after < before) {
+            for (uint8_t a = _i, b = _j; a < b; a++, b--) {
+               uint8_t t = _order[a];
+               _order[a] = _order[b];
+               _order[b] = t;
+            }
+            _improved = true;
+         }
+         _j++;
+      }
+   }
+
+   void startFragments() {
+      _phase = FRAGMENTS;
+      _tourIndex = 0;
+      startRegion();
+   }
+
+   void startRegion() {
+      const Region &g = _regions[_order[_tourIndex]];
+      int32_t col, row;
+      positionCell(col, row);
+      _bandCount = (g.maxCol - g.minCol) / _bandCells + 1;
+      _bandsDescending = (col - (int32_t)g.minCol) > ((int32_t)g.maxCol - col);
+      _band = 0;
+      startBand();
+   }
+
+   void startBand() {
+      const Region &g = _regions[_order[_tourIndex]];
+      int32_t col, row;
+      positionCell(col, row);
+      bool down = (row - (int32_t)g.minRow) > ((int32_t)g.maxRow - row);
+      _bandRow = down ? g.maxRow : g.minRow;
+      _bandEnd = down ? (int32_t)g.minRow - 1 : (int32_t)g.maxRow + 1;
+      _rowStep = down ? -1 : 1;
+      _firstRow = -1;
+      _lastRow = -1;
+   }
+
+   // Stripe over the run _firstRow.._lastRow of the band, from the run's first row
+   void emitFragment() {
+      // Blade centered on the run's columns, half a cell past its first and
+      // last row
+      int32_t cell = _map->getCellMM();
+      Point2D_int a = _map->cellCenter(_runCol0, _firstRow);
+      Point2D_int b = _map->cellCenter(_runCol1, _lastRow);
+      int32_t x = (a.x + b.x) / 2;
+      int32_t half = _rowStep > 0 ? cell / 2 : -cell / 2;
+      _fragmentStart = Point2D_int(x, a.y - half);
+      _fragmentEnd = Point2D_int(x, b.y + half);
+      _position = _fragmentEnd;
+      _hasFragment = true;
+      _fragments++;
+      _firstRow = -1;
+      _lastRow = -1;
+   }
+
+   void bandColumns(uint16_t &c0, uint16_t &c1) const {
+      const Region &g = _regions[_order[_tourIndex]];
+      uint16_t k = _bandsDescending ? _bandCount - 1 - _band : _band;
+      c0 = g.minCol + k * _bandCells;
+      c1 = c0 + _bandCells - 1;
+      if (c1 > g.maxCol) c1 = g.maxCol;
+   }
+
+   void fragmentStep() {
+      uint16_t c0, c1;
+      bandColumns(c0, c1);
+
+      uint16_t rows = 0;
+      while (_bandRow != _bandEnd && rows < _wordsPerStep) {
+         rows++;
+         uint16_t r0 = c1 + 1, r1 = c0;         // Uncovered columns of the row
+         for (uint16_t c = c0; c <= c1; c++) {
+            if (_map->isCellCovered(c, (uint16_t)_bandRow)) continue;
+            if (c < r0) r0 = c;
+            if (c > r1) r1 = c;
+         }
+         if (r0 > r1) {
+            _bandRow += _rowStep;
+            if (_firstRow < 0) continue;
+            emitFragment();                       // The rest of the band on the next step
+            return;
+         }
+         if (_firstRow < 0) {
+            _firstRow = _bandRow;
+            _runCol0 = r0;
+            _runCol1 = r1;
+         } else {
+            // The run keeps the columns open in all its rows: beside a bed
+            // the gap bends round the corner, its average can be the edge
+            if (r0 < _runCol0) r0 = _runCol0;
+            if (r1 > _runCol1) r1 = _runCol1;
+            if (r0 > r1) {
+               emitFragment();                    // This row starts the next run
+               return;
+            }
+            _runCol0 = r0;
+            _runCol1 = r1;
+         }
+         _lastRow = _bandRow;
+         _bandRow += _rowStep;
+      }
+      if (_bandRow != _bandEnd) return;
+
+      if (_firstRow >= 0) emitFragment();
+
+      if (++_band < _bandCount) {
+         startBand();
+      } else if (++_tourIndex < _orderCount) {
+         startRegion();
+      } else if (++_round < _maxRounds) {
+         startScan();
+      } else {
+         _phase = DONE;
+      }
+   }
+
+public:
+   CoverageCleanup(CoverageMap *map = nullptr)
+      : _map(map), _phase(IDLE), _wordsPerStep(DefaultWordsPerStep), _pairsPerStep(DefaultPairsPerStep),
+        _minCells(DefaultMinCells), _maxRounds(DefaultMaxRounds), _round(0), _bandCells(1),
+        _position(0, 0), _regionCount(0), _prevCount(0), _curCount(0), _row(0), _droppedRuns(0),
+        _lastDroppedRuns(0), _gapCells(0),
+        _orderCount(0), _built(0), _i(0), _j(0), _pass(0), _improved(false),
+        _tourIndex(0), _band(0), _bandCount(0), _bandsDescending(false), _bandRow(0),
+        _bandEnd(0), _rowStep(1), _firstRow(-1), _lastRow(-1), _runCol0(0), _runCol1(0),
+        _hasFragment(false), _fragmentStart(0, 0), _fragmentEnd(0, 0),
+        _fragments(0) {}
+
+   void setMap(CoverageMap *map) {
+      _map = map;
+      _phase = IDLE;
+   }
+
+   // Work per step(): words (scan) or rows (fragments), and 2-opt pairs
+   void setStepBudget(uint16_t words, uint8_t pairs) {
+      _wordsPerStep = words > 0 ? words : 1;
+      _pairsPerStep = pairs > 0 ? pairs : 1;
+   }
+
+   void setMinRegionCells(uint16_t cells) { _minCells = cells; }
+   void setMaxRounds(uint8_t rounds) { _maxRounds = rounds; }
+
+   // Start planning from the mower's position; fragments one stripe width apart
+   void begin(Point2D_int position, uint16_t stripeMM) {
+      if (_map == nullptr || !_map->isValid()) {
+         _phase = DONE;
+         return;
+      }
+      _position = position;
+      _bandCells = stripeMM / _map->getCellMM();
+      if (_bandCells == 0) _bandCells = 1;
+      _round = 0;
+      _gapCells = 0;
+      _fragments = 0;
+      _hasFragment = false;                    // A scan keeps the round's last fragment
+      startScan();
+   }
+
+   // One bounded piece of work. False once there is nothing left to plan.
+   bool step() {
+      if (_hasFragment) return true;           // Waiting for takeFragment()
+
+      switch (_phase) {
+         case SCANNING: {
+            uint16_t stride = _map->getStride();
+            uint16_t words = 0;
+            while (_row < _map->getRows() && (words == 0 || words + stride <= _wordsPerStep)) {
+               scanRow(_row++);
+               words += stride;
+            }
+            if (_row >= _map->getRows()) finishScan();
+            break;
+         }
+         case ORDERING:
+            orderStep();
+            break;
+         case IMPROVING:
+            improveStep();
+            break;
+         case FRAGMENTS:
+            fragmentStep();
+            break;
+         case IDLE:
+         case DONE:
+         default:
+            return false;
+      }
+      return _phase != DONE || _hasFragment;
+   }
+
+   // Next stripe to mow; false if none is ready yet (keep calling step())
+   bool takeFragment(Point2D_int &start, Point2D_int &end) {
+      if (!_hasFragment) return false;
+      start = _fragmentStart;
+      end = _fragmentEnd;
+      _hasFragment = false;
+      return true;
+   }
+
+   bool isDone() const { return _phase == DONE && !_hasFragment; }
+   Phase getPhase() const { return _phase; }
+   uint8_t getRegionCount() const { return _orderCount; }
+   uint8_t getRound() const { return _round; }
+   uint16_t getFragmentCount() const { return _fragments; }
+   uint16_t getDroppedRuns() const { return _droppedRuns; }
+};
+
+#endif
@@ -0,0 +1,517 @@
+#ifndef COVERAGEMAP_H
+#define COVERAGEMAP_H
+
+#include "globals.hpp"
+#include "Arduino.h"
+#include "MowerTypes.h"
+#include "IntegerMathDefault.h"
+#include "PerimeterStorage.h"
+
+// Backing store of a CoverageMap: rows of 32 bit words. Bits are only ever
+// set between clear()s, so a NOR flash store can keep the words inverted and
+// program 1 -> 0 without erasing; an SD card store can seek to index * 4.
+// CoverageQuadtree stores the same bits compressed.
+class CoverageStore {
+protected:
+   uint16_t _stride;            // Words per row
+   uint16_t _rows;
+
+public:
+   CoverageStore() : _stride(0), _rows(0) {}
+   virtual ~CoverageStore() {}
+
+   virtual uint32_t capacity() const = 0;                      // Words
+   virtual uint32_t read(uint32_t index) = 0;
+   virtual void set(uint32_t index, uint32_t bits) = 0;        // word |= bits
+   virtual void clear(uint32_t words) = 0;                     // First words -> 0
+
+   // Grid layout, before the first clear(). False if it does not fit.
+   virtual bool begin(uint16_t stride, uint16_t rows) {
+      _stride = stride;
+      _rows = rows;
+      return (uint32_t)stride * rows <= capacity();
+   }
+
+   virtual uint32_t countSet() {
+      uint32_t n = 0;
+      uint32_t words = (uint32_t)_stride * _rows;
+      for (uint32_t i = 0; i < words; i++) n += popcount32(read(i));
+      return n;
+   }
+
+   virtual bool test(uint16_t col, uint16_t row) {
+      return (read((uint32_t)row * _stride + (col >> 5)) >> (col & 31)) & 1;
+   }
+
+   // Clear cell nearest to (col, row) within cols x rows; false if all are set.
+   // Square rings outwards until no closer cell can follow, O(distance^2) reads.
+   virtual bool findNearestClear(uint16_t col, uint16_t row, uint16_t cols, uint16_t rows,
+                                 uint16_t &outCol, uint16_t &outRow) {
+      uint32_t best = 0xFFFFFFFFUL;
+      int32_t maxRing = cols > rows ? cols : rows;
+      for (int32_t r = 0; r < maxRing && (uint32_t)(r * r) < best; r++) {
+         for (int32_t dy = -r; dy <= r; dy++) {
+            int32_t y = row + dy;
+            if (y < 0 || y >= rows) continue;
+            int32_t step = (dy == -r || dy == r) ? 1 : 2 * r;
+            for (int32_t dx = -r; dx <= r; dx += step) {
+               int32_t x = col + dx;
+               if (x < 0 || x >= cols || test(x, y)) continue;
+               uint32_t d = (uint32_t)(dx * dx + dy * dy);
+               if (d < best) {
+                  best = d;
+                  outCol = x;
+                  outRow = y;
+               }
+            }
+         }
+      }
+      return best != 0xFFFFFFFFUL;
+   }
+
+   static uint8_t popcount32(uint32_t v) {
+      v = v - ((v >> 1) & 0x55555555UL);
+      v = (v & 0x33333333UL) + ((v >> 2) & 0x33333333UL);
+      v = (v + (v >> 4)) & 0x0F0F0F0FUL;
+      return (uint8_t)((v * 0x01010101UL) >> 24);
+   }
+};
+
+// Store in a RAM array owned by the caller
+class CoverageRamStore : public CoverageStore {
+private:
+   uint32_t *_words;
+   uint32_t _capacity;
+
+public:
+   CoverageRamStore(uint32_t *words, uint32_t capacity) : _words(words), _capacity(capacity) {}
+
+   uint32_t capacity() const override { return _capacity; }
+   uint32_t read(uint32_t index) override { return _words[index]; }
+   void set(uint32_t index, uint32_t bits) override { _words[index] |= bits; }
+   void clear(uint32_t words) override {
+      for (uint32_t i = 0; i < words && i < _capacity; i++) _words[i] = 0;
+   }
+};
+
+// CoverageMap - 1 bit per cell record of where the blade has been
+// INTEGER ONLY - positions in mm, cells of cellMM (default 100mm)
+//
+// The grid covers the perimeter bounding box. A cell counts as mowed when its
+// center was under the blade. Rows are padded to whole 32 bit words:
+//   cell (col, row) = bit (col & 31) of word row * stride + col / 32
+//
+// track() is called with the pose every tick. The blade is a disc, so the area
+// swept between two poses is the rectangle from -> to, blade width wide, plus
+// the disc at the new end (the disc at the old end was the previous call). The
+// rectangle is rasterized as two triangles with a DDA per edge (one division
+// per edge, then one add per row); each row span is set with a masked first
+// and last word and whole words in between.
+//
+// countCovered() / coveragePercent() count bits 32 at a time (SWAR popcount).
+//
+// RAM: 10m x 10m at 100mm = 100 x 100 cells = 1.3KB. Larger lawns need an
+// external store (1000m^2 at 100mm = 13KB).
+class CoverageMap {
+public:
+   static constexpr uint16_t DefaultCellMM = 100;
+   static constexpr uint16_t MaxCells = 32767;         // Per axis
+   static constexpr uint16_t MaxCrossings = MAX_BOUNDARY_CROSSINGS;   // Per row (zones included)
+   static constexpr int32_t DefaultMaxJumpMM = 1000;   // Larger pose steps are not swept
+   static constexpr uint16_t DefaultMaxSigmaMM = 200;
+   static constexpr int32_t MaxSegmentMM = 30000;      // Longer markSwath() segments are split
+
+private:
+   CoverageStore *_store;
+   int32_t _minX;
+   int32_t _minY;
+   uint16_t _cellMM;
+   uint16_t _cols;
+   uint16_t _rows;
+   uint16_t _stride;                // Words per row
+   uint32_t _insideCells;           // Cells with their center inside the perimeter
+   uint16_t _bladeMM;
+   int32_t _maxJumpMM;
+   uint16_t _maxSigmaMM;
+   Point2D_int _last;
+   bool _hasLast;
+   bool _valid;
+
+   static int32_t floorDiv(int32_t a, int32_t b) {
+      int32_t q = a / b;
+      return (a % b != 0 && a < 0) ? q - 1 : q;
+   }
+
+   // Columns whose centers lie in [xl, xr] (Q8 mm, grid relative)
+   void setSpanQ8(uint16_t row, int32_t xl, int32_t xr) {
+      int32_t cellQ8 = (int32_t)_cellMM << 8;
+      int32_t half = cellQ8 >> 1;
+      int32_t c0 = floorDiv(xl - half + cellQ8 - 1, cellQ8);
+      int32_t c1 = floorDiv(xr - half, cellQ8);
+      setSpan(row, c0, c1);
+   }
+
+   void setSpan(uint16_t row, int32_t c0, int32_t c1) {
+      if (c0 < 0) c0 = 0;
+      if (c1 >= _cols) c1 = _cols - 1;
+      if (c0 > c1) return;
+
+      uint32_t base = (uint32_t)row * _stride;
+      uint16_t w0 = c0 >> 5;
+      uint16_t w1 = c1 >> 5;
+      uint32_t first = 0xFFFFFFFFUL << (c0 & 31);
+      uint32_t last = 0xFFFFFFFFUL >> (31 - (c1 & 31));
+      if (w0 == w1) {
+         _store->set(base + w0, first & last);
+         return;
+      }
+      _store->set(base + w0, first);
+      for (uint16_t w = w0 + 1; w < w1; w++) _store->set(base + w, 0xFFFFFFFFUL);
+      _store->set(base + w1, last);
+   }
+
+   uint32_t countSpan(uint16_t row, int32_t c0, int32_t c1) const {
+      if (c0 < 0) c0 = 0;
+      if (c1 >= _cols) c1 = _cols - 1;
+      if (c0 > c1) return 0;
+
+      uint32_t base = (uint32_t)row * _stride;
+      uint16_t w0 = c0 >> 5;
+      uint16_t w1 = c1 >> 5;
+      uint32_t first = 0xFFFFFFFFUL << (c0 & 31);
+      uint32_t last = 0xFFFFFFFFUL >> (31 - (c1 & 31));
+      if (w0 == w1) return CoverageStore::popcount32(_store->read(base + w0) & first & last);
+
+      uint32_t n = CoverageStore::popcount32(_store->read(base + w0) & first);
+      for (uint16_t w = w0 + 1; w < w1; w++) n += CoverageStore::popcount32(_store->read(base + w));
+      return n + CoverageStore::popcount32(_store->read(base + w1) & last);
+   }
+
+   // Row of the first cell center at or above y (mm, grid relative)
+   int32_t firstRowFrom(int32_t y) const {
+      return floorDiv(y - _cellMM / 2 + _cellMM - 1, _cellMM);
+   }
+
+   // Triangle in grid relative mm: every cell whose center is inside
+   void fillTriangle(Point2D_int a, Point2D_int b, Point2D_int c) {
+      Point2D_int t;
+      if (b.y < a.y) { t = a; a = b; b = t; }
+      if (c.y < a.y) { t = a; a = c; c = t; }
+      if (c.y < b.y) { t = b; b = c; c = t; }
+      if (c.y == a.y) return;
+
+      int32_t r0 = firstRowFrom(a.y);
+      int32_t r1 = firstRowFrom(c.y);       // Exclusive
+      if (r0 < 0) r0 = 0;
+      if (r1 > _rows) r1 = _rows;
+      if (r0 >= r1) return;
+
+      // Long edge a -> c: x at the first row center, then + step per row
+      int32_t y0 = r0 * (int32_t)_cellMM + _cellMM / 2;
+      int32_t xLong = (a.x << 8) + (int32_t)(((int64_t)(y0 - a.y) * (c.x - a.x) << 8) / (c.y - a.y));
+      int32_t stepLong = (int32_t)(((int64_t)_cellMM * (c.x - a.x) << 8) / (c.y - a.y));
+
+      // Short side: a -> b below b.y, b -> c from there on
+      int32_t xShort = 0;
+      int32_t stepShort = 0;
+      int8_t edge = -1;
+      for (int32_t row = r0; row < r1; row++) {
+         int32_t y = row * (int32_t)_cellMM + _cellMM / 2;
+         int8_t e = (y < b.y) ? 0 : 1;
+         if (e != edge) {
+            Point2D_int p = e ? b : a;
+            Point2D_int q = e ? c : b;
+            xShort = (p.x << 8) + (int32_t)(((int64_t)(y - p.y) * (q.x - p.x) << 8) / (q.y - p.y));
+            stepShort = (int32_t)(((int64_t)_cellMM * (q.x - p.x) << 8) / (q.y - p.y));
+            edge = e;
+         }
+
+         if (xLong < xShort) setSpanQ8(row, xLong, xShort);
+         else setSpanQ8(row, xShort, xLong);
+         xLong += stepLong;
+         xShort += stepShort;
+      }
+   }
+
+   // Disc in grid relative mm
+   void fillDisc(Point2D_int center, int32_t radius) {
+      int32_t r0 = firstRowFrom(center.y - radius);
+      int32_t r1 = firstRowFrom(center.y + radius + 1);
+      if (r0 < 0) r0 = 0;
+      if (r1 > _rows) r1 = _rows;
+      for (int32_t row = r0; row < r1; row++) {
+         int32_t dy = row * (int32_t)_cellMM + _cellMM / 2 - center.y;
+         int32_t half = (int32_t)fast_sqrt((uint32_t)(radius * radius - dy * dy));
+         setSpanQ8(row, (center.x - half) << 8, (center.x + half) << 8);
+      }
+   }
+
+public:
+   CoverageMap(CoverageStore *store)
+      : _store(store), _minX(0), _minY(0), _cellMM(DefaultCellMM), _cols(0), _rows(0), _stride(0),
+        _insideCells(0), _bladeMM(250), _maxJumpMM(DefaultMaxJumpMM),
+        _maxSigmaMM(DefaultMaxSigmaMM), _last(0, 0), _hasLast(false), _valid(false) {}
+
+   // Grid over a rectangle (mm). False if the store is too small.
+   bool begin(int32_t minX, int32_t minY, int32_t maxX, int32_t maxY, uint16_t cellMM = DefaultCellMM) {
+      _valid = false;
+      _hasLast = false;
+      if (_store == nullptr || cellMM == 0 || maxX < minX || maxY < minY) return false;
+
+      int32_t cols = (maxX - minX) / cellMM + 1;
+      int32_t rows = (maxY - minY) / cellMM + 1;
+      if (cols > MaxCells || rows > MaxCells) return false;
+
+      _minX = minX;
+      _minY = minY;
+      _cellMM = cellMM;
+      _cols = cols;
+      _rows = rows;
+      _stride = (_cols + 31) >> 5;
+      if (!_store->begin(_stride, _rows)) {
+         DEBUG_PRINTLN("CoverageMap: store too small");
+         return false;
+      }
+      _insideCells = (uint32_t)_cols * _rows;
+      _store->clear(getWords());
+      _valid = true;
+      return true;
+   }
+
+   // Grid over the perimeter bounding box; coveragePercent() counts inside cells only
+   bool begin(const PerimeterStorage &perimeter, uint16_t cellMM = DefaultCellMM) {
+      int32_t minX, maxX, minY, maxY;
+      perimeter.getBounds(minX, maxX, minY, maxY);
+      if (!begin(minX, minY, maxX, maxY, cellMM)) return false;
+
+      _insideCells = 0;
+      int32_t xs[MaxCrossings];
+      for (uint16_t row = 0; row < _rows; row++) {
+         int n = rowCrossings(perimeter, row, xs);
+         for (int i = 0; i + 1 < n; i += 2) {
+            int32_t c0, c1;
+            crossingCells(xs[i], xs[i + 1], c0, c1);
+            if (c1 >= c0) _insideCells += c1 - c0 + 1;
+         }
+      }
+      return true;
+   }
+
+   void clear() {
+      if (_valid) _store->clear(getWords());
+      _hasLast = false;
+   }
+
+   // Blade (cut) width in mm
+   void setBladeWidth(uint16_t widthMM) { _bladeMM = widthMM; }
+
+   // track() does not sweep steps longer than maxJump (GPS jump, relocation)
+   // and ignores poses with a larger sigma
+   void setTrackingLimits(int32_t maxJumpMM, uint16_t maxSigmaMM) {
+      _maxJumpMM = maxJumpMM;
+      _maxSigmaMM = maxSigmaMM;
+   }
+
+   // Mark the area the blade swept from -> to; the disc at 'from' is not included
+   void markSwath(Point2D_int from, Point2D_int to, uint16_t widthMM) {
+      if (!_valid) return;
+      if (to.x - from.x > MaxSegmentMM || from.x - to.x > MaxSegmentMM ||
+          to.y - from.y > MaxSegmentMM || from.y - to.y > MaxSegmentMM) {
+         Point2D_int mid((from.x + to.x) / 2, (from.y + to.y) / 2);    // Keeps dx^2 + dy^2 in 32 bits
+         markSwath(from, mid, widthMM);
+         markSwath(mid, to, widthMM);
+         return;
+      }
+      from.x -= _minX;
+      from.y -= _minY;
+      to.x -= _minX;
+      to.y -= _minY;
+      int32_t half = widthMM / 2;
+
+      int32_t dx = to.x - from.x;
+      int32_t dy = to.y - from.y;
+      int32_t len = (int32_t)fast_sqrt((uint32_t)(dx * dx + dy * dy));
+      if (len > 0) {
+         // Normal to the motion, half a blade long
+         int32_t nx = -dy * half / len;
+         int32_t ny = dx * half / len;
+         Point2D_int a(from.x + nx, from.y + ny);
+         Point2D_int b(to.x + nx, to.y + ny);
+         Point2D_int c(to.x - nx, to.y - ny);
+         Point2D_int d(from.x - nx, from.y - ny);
+         fillTriangle(a, b, c);
+         fillTriangle(a, c, d);
+      }
+      fillDisc(to, half);
+   }
+
+   // Mark the blade disc at a point
+   void markPoint(Point2D_int p, uint16_t widthMM) {
+      if (!_valid) return;
+      fillDisc(Point2D_int(p.x - _minX, p.y - _minY), widthMM / 2);
+   }
+
+   // Feed the current pose (every tick while the blade runs)
+   void track(Point2D_int position, uint16_t sigmaMM = 0) {
+      if (!_valid) return;
+      if (sigmaMM > _maxSigmaMM) {
+         _hasLast = false;
+         return;
+      }
+      if (!_hasLast) {
+         markPoint(position, _bladeMM);
+      } else {
+         int32_t dx = position.x - _last.x;
+         int32_t dy = position.y - _last.y;
+         if (dx > _maxJumpMM || dx < -_maxJumpMM || dy > _maxJumpMM || dy < -_maxJumpMM) {
+            markPoint(position, _bladeMM);
+         } else if (dx * dx + dy * dy < (int32_t)_cellMM * _cellMM / 4) {
+            return;                        // Less than half a cell: wait, keep the start point
+         } else {
+            markSwath(_last, position, _bladeMM);
+         }
+      }
+      _last = position;
+      _hasLast = true;
+   }
+
+   // Stop sweeping from the last pose (blade off, transit)
+   void lift() { _hasLast = false; }
+
+   bool isCovered(Point2D_int p) const {
+      int32_t col, row;
+      if (!cellOf(p, col, row)) return false;
+      return isCellCovered(col, row);
+   }
+
+   bool isCellCovered(uint16_t col, uint16_t row) const {
+      if (!_valid || col >= _cols || row >= _rows) return false;
+      return _store->test(col, row);
+   }
+
+   // Cell of a point; false outside the grid
+   bool cellOf(Point2D_int p, int32_t &col, int32_t &row) const {
+      if (!_valid) return false;
+      col = floorDiv(p.x - _minX, _cellMM);
+      row = floorDiv(p.y - _minY, _cellMM);
+      return col >= 0 && col < _cols && row >= 0 && row < _rows;
+   }
+
+   Point2D_int cellCenter(uint16_t col, uint16_t row) const {
+      return Point2D_int(_minX + (int32_t)col * _cellMM + _cellMM / 2,
+                         _minY + (int32_t)row * _cellMM + _cellMM / 2);
+   }
+
+   // Word w of a row (cells w * 32 ..), cells past the last column read as covered
+   uint32_t getRowWord(uint16_t row, uint16_t w) const {
+      uint32_t v = _store->read((uint32_t)row * _stride + w);
+      uint16_t end = _cols - ((uint16_t)w << 5);
+      if (end < 32) v |= 0xFFFFFFFFUL << end;
+      return v;
+   }
+
+   // All cells c0..c1 of a row covered (clipped to the grid)
+   bool isSpanCovered(uint16_t row, int32_t c0, int32_t c1) const {
+      if (c0 < 0) c0 = 0;
+      if (c1 >= _cols) c1 = _cols - 1;
+      if (!_valid || row >= _rows || c0 > c1) return true;
+      return countSpan(row, c0, c1) == (uint32_t)(c1 - c0 + 1);
+   }
+
+   // Covered cells in the whole grid (incl. cells set by excludeOutside())
+   uint32_t countCovered() const {
+      if (!_valid) return 0;
+      return _store->countSet();
+   }
+
+   // Mark the cells outside the perimeter as done, so they never show up as
+   // gaps (findNearestUncovered()) and a quadtree store collapses them.
+   // coveragePercent() is not affected.
+   void excludeOutside(const PerimeterStorage &perimeter) {
+      if (!_valid) return;
+      int32_t xs[MaxCrossings];
+      for (uint16_t row = 0; row < _rows; row++) {
+         int n = rowCrossings(perimeter, row, xs);
+         int32_t next = 0;
+         for (int i = 0; i + 1 < n; i += 2) {
+            int32_t c0, c1;
+            crossingCells(xs[i], xs[i + 1], c0, c1);
+            if (c1 < c0) continue;
+            setSpan(row, next, c0 - 1);
+            next = c1 + 1;
+         }
+         setSpan(row, next, _cols - 1);
+      }
+   }
+
+   // Center of the uncovered cell nearest to p; false if everything is covered
+   bool findNearestUncovered(Point2D_int p, Point2D_int &cell) const {
+      if (!_valid) return false;
+      int32_t col = floorDiv(p.x - _minX, _cellMM);
+      int32_t row = floorDiv(p.y - _minY, _cellMM);
+      col = col < 0 ? 0 : (col >= _cols ? _cols - 1 : col);
+      row = row < 0 ? 0 : (row >= _rows ? _rows - 1 : row);
+
+      uint16_t c, r;
+      if (!_store->findNearestClear(col, row, _cols, _rows, c, r)) return false;
+      cell = cellCenter(c, r);
+      return true;
+   }
+
+   // Covered cells with their center inside the perimeter
+   uint32_t countCoveredInside(const PerimeterStorage &perimeter) const {
+      if (!_valid) return 0;
+      uint32_t n = 0;
+      int32_t xs[MaxCrossings];
+      for (uint16_t row = 0; row < _rows; row++) {
+         int count = rowCrossings(perimeter, row, xs);
+         for (int i = 0; i + 1 < count; i += 2) {
+            int32_t c0, c1;
+            crossingCells(xs[i], xs[i + 1], c0, c1);
+            n += countSpan(row, c0, c1);
+         }
+      }
+      return n;
+   }
+
+   // Mowed share of the lawn inside the perimeter, 0..100
+   uint8_t coveragePercent(const PerimeterStorage &perimeter) const {
+      if (_insideCells == 0) return 0;
+      return (uint8_t)(countCoveredInside(perimeter) * 100ULL / _insideCells);
+   }
+
+   bool isValid() const { return _valid; }
+   uint16_t getCols() const { return _cols; }
+   uint16_t getRows() const { return _rows; }
+   uint16_t getCellMM() const { return _cellMM; }
+   uint32_t getWords() const { return (uint32_t)_stride * _rows; }
+   uint16_t getStride() const { return _stride; }
+   uint32_t getInsideCells() const { return _insideCells; }
+   CoverageStore *getStore() const { return _store; }
+
+private:
+   // Sorted crossings of the row's center line with the perimeter
+   int rowCrossings(const PerimeterStorage &perimeter, uint16_t row, int32_t *xs) const {
+      int32_t y = _minY + (int32_t)row * _cellMM + _cellMM / 2;
+      int n = perimeter.getCrossings(y, xs, MaxCrossings);
+      if (n < 0) return 0;                  // Too many to pair up: the row counts as off the lawn
+      for (int i = 1; i < n; i++) {
+         int32_t v = xs[i];
+         int j = i;
+         for (; j > 0 && xs[j - 1] > v; j--) xs[j] = xs[j - 1];
+         xs[j] = v;
+      }
+      return n & ~1;
+   }
+
+   // Columns with their center in [x0, x1] (absolute mm)
+   void crossingCells(int32_t x0, int32_t x1, int32_t &c0, int32_t &c1) const {
+      int32_t half = _cellMM / 2;
+      c0 = floorDiv(x0 - _minX - half + _cellMM - 1, _cellMM);
+      c1 = floorDiv(x1 - _minX - half, _cellMM);
+      if (c0 < 0) c0 = 0;
+      if (c1 >= _cols) c1 = _cols - 1;
+   }
+};
+
+#endif
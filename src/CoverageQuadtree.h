@@ -0,0 +1,274 @@
+#ifndef COVERAGEQUADTREE_H
+#define COVERAGEQUADTREE_H
+
+#include "globals.hpp"
+#include "Arduino.h"
+#include "CoverageMap.h"
+
+// CoverageQuadtree - region quadtree store for a CoverageMap
+// Memory grows with the length of the mowed/unmowed boundary, not the area
+//
+// The grid is padded to a square of 8 * 2^levels cells. Every child slot holds
+// a 16 bit code:
+//   Empty (0)   nothing mowed in the quadrant
+//   Full (1)    all of it mowed
+//   n >= 2      pool entry n - 2: four child codes, or at the bottom level an
+//               8 x 8 cell tile (64 bits, row r in byte r)
+// Pool entries are 8 bytes either way and come from a caller supplied array
+// with a free list. When a tile or node becomes all set it is returned to the
+// pool and its slot becomes Full, up the tree as far as it goes.
+//
+// set()/read() of a CoverageMap word touch the 4 tiles under it; each is one
+// walk from the root, O(levels). test() is one walk. countSet() and
+// findNearestClear() skip Empty and Full quadrants whole.
+//
+// A full pool drops the write (getDroppedWrites()); the cells stay unmowed.
+class CoverageQuadtree : public CoverageStore {
+public:
+   static constexpr uint16_t Empty = 0;
+   static constexpr uint16_t Full = 1;
+   static constexpr uint8_t TileShift = 3;      // 8 x 8 cells
+   static constexpr uint8_t MaxLevels = 12;     // 32768 cells per side
+   static constexpr uint16_t MaxPool = 65533;
+
+private:
+   uint16_t (*_pool)[4];
+   uint16_t _poolSize;
+   uint16_t _next;              // First never used entry
+   uint16_t _freeHead;          // Code of the first released entry, Empty if none
+   uint16_t _used;
+   uint16_t _peak;
+   uint16_t _root;
+   uint8_t _levels;             // Node levels above the tiles
+   uint32_t _dropped;
+
+   struct Query {
+      uint16_t col, row;        // From
+      uint16_t cols, rows;      // Grid limits
+      uint32_t best;            // Squared distance, cells
+      uint16_t outCol, outRow;
+   };
+
+   uint16_t alloc() {
+      uint16_t code;
+      if (_freeHead != Empty) {
+         code = _freeHead;
+         _freeHead = _pool[code - 2][0];
+      } else if (_next < _poolSize) {
+         code = _next++ + 2;
+      } else {
+         return Empty;
+      }
+      for (uint8_t i = 0; i < 4; i++) _pool[code - 2][i] = 0;
+      _used++;
+      if (_used > _peak) _peak = _used;
+      return code;
+   }
+
+   void release(uint16_t code) {
+      _pool[code - 2][0] = _freeHead;
+      _freeHead = code;
+      _used--;
+   }
+
+   bool allFull(uint16_t code, uint16_t value) const {
+      const uint16_t *e = _pool[code - 2];
+      return e[0] == value && e[1] == value && e[2] == value && e[3] == value;
+   }
+
+   static uint8_t quadrant(uint16_t tx, uint16_t ty, int8_t level) {
+      return ((tx >> level) & 1) | (((ty >> level) & 1) << 1);
+   }
+
+   // Row r (0..7) of tile (tx, ty); bit i = column tx * 8 + i
+   uint8_t tileRow(uint16_t tx, uint16_t ty, uint8_t r) const {
+      uint16_t code = _root;
+      for (int8_t level = _levels - 1; level >= 0 && code >= 2; level--) {
+         code = _pool[code - 2][quadrant(tx, ty, level)];
+      }
+      if (code == Empty) return 0;
+      if (code == Full) return 0xFF;
+      return (_pool[code - 2][r >> 1] >> ((r & 1) << 3)) & 0xFF;
+   }
+
+   void orTileRow(uint16_t tx, uint16_t ty, uint8_t r, uint8_t bits) {
+      uint16_t *path[MaxLevels];
+      uint16_t *slot = &_root;
+      int8_t depth = 0;
+      for (int8_t level = _levels - 1; level >= 0; level--) {
+         if (*slot == Full) return;
+         if (*slot == Empty) {
+            uint16_t code = alloc();
+            if (code == Empty) {
+               _dropped++;
+               return;
+            }
+            *slot = code;
+         }
+         path[depth++] = slot;
+         slot = &_pool[*slot - 2][quadrant(tx, ty, level)];
+      }
+
+      if (*slot == Full) return;
+      if (*slot == Empty) {
+         uint16_t code = alloc();
+         if (code == Empty) {
+            _dropped++;
+            return;
+         }
+         *slot = code;
+      }
+      _pool[*slot - 2][r >> 1] |= (uint16_t)bits << ((r & 1) << 3);
+      if (!allFull(*slot, 0xFFFF)) return;
+
+      // Collapse: the tile, then every node whose four quadrants are Full
+      release(*slot);
+      *slot = Full;
+      while (depth > 0) {
+         slot = path[--depth];
+         if (!allFull(*slot, Full)) return;
+         release(*slot);
+         *slot = Full;
+      }
+   }
+
+   uint32_t countNode(uint16_t code, uint8_t level) const {
+      if (code == Empty) return 0;
+      if (code == Full) return (uint32_t)64 << (2 * level);
+      const uint16_t *e = _pool[code - 2];
+      uint32_t n = 0;
+      if (level == 0) {
+         for (uint8_t i = 0; i < 4; i++) n += popcount32(e[i]);
+         return n;
+      }
+      for (uint8_t i = 0; i < 4; i++) n += countNode(e[i], level - 1);
+      return n;
+   }
+
+   static uint16_t clampTo(uint16_t v, uint16_t lo, uint16_t hi) {
+      return v < lo ? lo : (v > hi ? hi : v);
+   }
+
+   static uint32_t squaredDistance(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1) {
+      int32_t dx = (int32_t)x1 - x0;
+      int32_t dy = (int32_t)y1 - y0;
+      return (uint32_t)(dx * dx + dy * dy);
+   }
+
+   // Branch and bound: nearest quadrant first, skip Full ones and any that
+   // cannot beat the best so far
+   void nearest(uint16_t code, uint8_t level, uint16_t x0, uint16_t y0, Query &q) const {
+      if (code == Full || x0 >= q.cols || y0 >= q.rows) return;
+
+      uint16_t size = (uint16_t)8 << level;
+      uint16_t x1 = (uint32_t)x0 + size > q.cols ? q.cols - 1 : x0 + size - 1;
+      uint16_t y1 = (uint32_t)y0 + size > q.rows ? q.rows - 1 : y0 + size - 1;
+      uint16_t cx = clampTo(q.col, x0, x1);
+      uint16_t cy = clampTo(q.row, y0, y1);
+      uint32_t d = squaredDistance(q.col, q.row, cx, cy);
+      if (d >= q.best) return;
+
+      if (code == Empty) {
+         q.best = d;
+         q.outCol = cx;
+         q.outRow = cy;
+         return;
+      }
+
+      const uint16_t *e = _pool[code - 2];
+      if (level == 0) {
+         for (uint8_t r = 0; r < 8 && y0 + r <= y1; r++) {
+            uint8_t bits = (e[r >> 1] >> ((r & 1) << 3)) & 0xFF;
+            for (uint8_t i = 0; i < 8 && x0 + i <= x1; i++) {
+               if (bits & (1 << i)) continue;
+               d = squaredDistance(q.col, q.row, x0 + i, y0 + r);
+               if (d < q.best) {
+                  q.best = d;
+                  q.outCol = x0 + i;
+                  q.outRow = y0 + r;
+               }
+            }
+         }
+         return;
+      }
+
+      uint16_t half = size >> 1;
+      uint8_t first = (cx >= x0 + half ? 1 : 0) | (cy >= y0 + half ? 2 : 0);
+      for (uint8_t k = 0; k < 4; k++) {
+         uint8_t child = first ^ k;
+         nearest(e[child], level - 1, x0 + ((child & 1) ? half : 0), y0 + ((child & 2) ? half : 0), q);
+      }
+   }
+
+public:
+   // pool: caller's array of poolSize entries (8 bytes each)
+   CoverageQuadtree(uint16_t (*pool)[4], uint16_t poolSize)
+      : _pool(pool), _poolSize(poolSize > MaxPool ? MaxPool : poolSize), _next(0), _freeHead(Empty),
+        _used(0), _peak(0), _root(Empty), _levels(0), _dropped(0) {}
+
+   bool begin(uint16_t stride, uint16_t rows) override {
+      _stride = stride;
+      _rows = rows;
+      uint32_t size = (uint32_t)stride * 32 > rows ? (uint32_t)stride * 32 : rows;
+      _levels = 0;
+      while (((uint32_t)8 << _levels) < size) _levels++;
+      return _levels <= MaxLevels;
+   }
+
+   // Storage in words (two per pool entry)
+   uint32_t capacity() const override { return (uint32_t)_poolSize * 2; }
+
+   uint32_t read(uint32_t index) override {
+      uint16_t row = index / _stride;
+      uint16_t tx = (index % _stride) << 2;
+      uint32_t v = 0;
+      for (uint8_t k = 0; k < 4; k++) {
+         v |= (uint32_t)tileRow(tx + k, row >> TileShift, row & 7) << (k << 3);
+      }
+      return v;
+   }
+
+   void set(uint32_t index, uint32_t bits) override {
+      uint16_t row = index / _stride;
+      uint16_t tx = (index % _stride) << 2;
+      for (uint8_t k = 0; k < 4; k++) {
+         uint8_t b = (bits >> (k << 3)) & 0xFF;
+         if (b) orTileRow(tx + k, row >> TileShift, row & 7, b);
+      }
+   }
+
+   void clear(uint32_t) override {                         // Drops the whole tree
+      _root = Empty;
+      _next = 0;
+      _freeHead = Empty;
+      _used = 0;
+      _peak = 0;
+      _dropped = 0;
+   }
+
+   bool test(uint16_t col, uint16_t row) override {
+      return (tileRow(col >> TileShift, row >> TileShift, row & 7) >> (col & 7)) & 1;
+   }
+
+   uint32_t countSet() override {
+      return countNode(_root, _levels);
+   }
+
+   bool findNearestClear(uint16_t col, uint16_t row, uint16_t cols, uint16_t rows,
+                         uint16_t &outCol, uint16_t &outRow) override {
+      Query q = {col, row, cols, rows, 0xFFFFFFFFUL, 0, 0};
+      nearest(_root, _levels, 0, 0, q);
+      if (q.best == 0xFFFFFFFFUL) return false;
+      outCol = q.outCol;
+      outRow = q.outRow;
+      return true;
+   }
+
+   uint16_t getUsed() const { return _used; }              // Pool entries in use
+   uint16_t getPeak() const { return _peak; }              // Most in use since clear()
+   uint32_t getBytesUsed() const { return (uint32_t)_used * 8; }
+   uint32_t getDroppedWrites() const { return _dropped; }
+   uint8_t getLevels() const { return _levels; }
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+#if defined(__AVR__)
+#include <util/crc16.h>
+#endif
+
+// CRC-16/CCITT (polynomial 0x1021, MSB first); start with 0xFFFF so an
+// all-zero or erased record does not check out
+inline uint16_t crc16Update(uint16_t crc, uint8_t data) {
+#if defined(__AVR__)
+   return _crc_xmodem_update(crc, data);
+#else
+   crc ^= (uint16_t)data << 8;
+   for (uint8_t i = 0; i < 8; i++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+   }
+   return crc;
+#endif
+}
+
+inline uint16_t crc16(const void *data, uint16_t length, uint16_t crc = 0xFFFF) {
+   const uint8_t *p = (const uint8_t *)data;
+   while (length--) crc = crc16Update(crc, *p++);
+   return crc;
+}
+
+#endif
@@ -7,46 +7,22 @@
 #include "VirtualMotor.h"
 #include <TaskSchedulerDeclarations.h>
 
-// DriveUnit - coordinates left and right wheel motors with smooth speed transitions
-class DriveUnit : public Task {
+// DriveUnitT - coordinates left and right wheel motors with smooth speed transitions
+// Wheels and motors are composed by value: no heap allocation, and the per-tick
+// EmitNewSpeed() -> move() path is resolved at compile time (no vtable lookups).
+//   DriveUnitT<L298Driver, L298Driver>  - production hardware, static dispatch
+//   DriveUnit                           - runtime Motor* (VirtualMotor testing etc.)
+template <class LeftMotor, class RightMotor>
+class DriveUnitT : public Task {
 private:
-   Motor* _leftMotor;     // Left motor driver (can be L298 or virtual)
-   Motor* _rightMotor;    // Right motor driver (can be L298 or virtual)
-   Wheel* _leftWheel;     // Left wheel (uses composition)
-   Wheel* _rightWheel;    // Right wheel (uses composition)
-   bool _ownsMotors;
+   WheelT<LeftMotor>  _leftWheel;    // Left wheel (uses composition)
+   WheelT<RightMotor> _rightWheel;   // Right wheel (uses composition)
 
 public:
-   // Default constructor: create hardware L298 drivers and own them
-   DriveUnit(Scheduler* aS, unsigned int mSec)
+   DriveUnitT(Scheduler* aS, unsigned int mSec, const LeftMotor& leftMotor, const RightMotor& rightMotor)
       : Task(mSec, TASK_FOREVER, aS, false),
-        _leftMotor(nullptr), _rightMotor(nullptr), _leftWheel(nullptr), _rightWheel(nullptr), _ownsMotors(true)
+        _leftWheel(leftMotor), _rightWheel(rightMotor)
    {
-      // allocate hardware drivers
-      _leftMotor = new L298(LEFTENABLE, LEFTIN1, LEFTIN2);
-      _rightMotor = new L298(RIGHTENABLE, RIGHTIN1, RIGHTIN2);
-      _leftWheel = new Wheel(_leftMotor);
-      _rightWheel = new Wheel(_rightMotor);
-   };
-
-   // Injection constructor: supply Motor implementations (virtual or hardware)
-   DriveUnit(Motor* leftMotor, Motor* rightMotor, Scheduler* aS, unsigned int mSec)
-      : Task(mSec, TASK_FOREVER, aS, false),
-        _leftMotor(leftMotor), _rightMotor(rightMotor), _leftWheel(nullptr), _rightWheel(nullptr), _ownsMotors(false)
-   {
-      _leftWheel = new Wheel(_leftMotor);
-      _rightWheel = new Wheel(_rightMotor);
-   };
-
-   ~DriveUnit() { 
-      // cleanup wheels
-      if (_leftWheel) { delete _leftWheel; _leftWheel = nullptr; }
-      if (_rightWheel) { delete _rightWheel; _rightWheel = nullptr; }
-      // cleanup motors if we own them
-      if (_ownsMotors) {
-         if (_leftMotor) { delete _leftMotor; _leftMotor = nullptr; }
-         if (_rightMotor) { delete _rightMotor; _rightMotor = nullptr; }
-      }
    };
 
    // Set target speeds with smooth transition over time
@@ -63,42 +39,97 @@ public:
       DEBUG_PRINT(" ");
       DEBUG_PRINTLN(iterations);
 
-      _leftWheel->setWheelSpeed(leftSpeed, iterations);
-      _rightWheel->setWheelSpeed(rightSpeed, iterations);
+      _leftWheel.setWheelSpeed(leftSpeed, iterations);
+      _rightWheel.setWheelSpeed(rightSpeed, iterations);
       setIterations(iterations);
       enable();
    };
 
    // Task callbacks
    bool Callback() override {
-      _leftWheel->EmitNewSpeed();
-      _rightWheel->EmitNewSpeed();
+      _leftWheel.EmitNewSpeed();
+      _rightWheel.EmitNewSpeed();
       return true;
    };
 
    bool OnEnable() override {
       DEBUG_PRINTLN("DriveUnit OnEnable:");
-      _leftWheel->EmitNewSpeed();
-      _rightWheel->EmitNewSpeed();
+      _leftWheel.EmitNewSpeed();
+      _rightWheel.EmitNewSpeed();
       return true;
    };
 
    void OnDisable() override {
       DEBUG_PRINTLN("EmitTargetSpeed:");
-      _leftWheel->EmitTargetSpeed();
-      _rightWheel->EmitTargetSpeed();
+      _leftWheel.EmitTargetSpeed();
+      _rightWheel.EmitTargetSpeed();
    };
 
    // Get current speeds
-   int getLeftSpeed() const { return _leftWheel ? _leftWheel->getCurrentSpeed() : 0; }
-   int getRightSpeed() const { return _rightWheel ? _rightWheel->getCurrentSpeed() : 0; }
+   int getLeftSpeed() const { return _leftWheel.getCurrentSpeed(); }
+   int getRightSpeed() const { return _rightWheel.getCurrentSpeed(); }
+
+   // Closed-loop wheel speed control (see SpeedControl.h)
+   void setClosedLoop(bool on) {
+      _leftWheel.setClosedLoop(on);
+      _rightWheel.setClosedLoop(on);
+   };
+
+   // One velocity loop step with measured wheel speeds in mm/s
+   void controlStep(int16_t leftMMs, int16_t rightMMs) {
+      _leftWheel.controlStep(leftMMs);
+      _rightWheel.controlStep(rightMMs);
+   };
+
+   void setSpeedGains(int16_t kp, int16_t ki, int16_t kd) {
+      _leftWheel.setSpeedGains(kp, ki, kd);
+      _rightWheel.setSpeedGains(kp, ki, kd);
+   };
 
    // Stop both wheels
    void stopWheels() {
-      if (_leftWheel) _leftWheel->stop();
-      if (_rightWheel) _rightWheel->stop();
+      _leftWheel.stop();
+      _rightWheel.stop();
       disable();
    };
+
+protected:
+   WheelT<LeftMotor>&  leftWheel()  { return _leftWheel; }
+   WheelT<RightMotor>& rightWheel() { return _rightWheel; }
+};
+
+// Production drive unit: L298 drivers by value, static dispatch
+typedef DriveUnitT<L298Driver, L298Driver> L298DriveUnit;
+
+// DriveUnit - runtime-polymorphic variant driving any Motor implementation
+class DriveUnit : public DriveUnitT<MotorRef, MotorRef> {
+private:
+   bool _ownsMotors;
+
+public:
+   // Default constructor: create hardware L298 drivers and own them
+   DriveUnit(Scheduler* aS, unsigned int mSec)
+      : DriveUnitT(aS, mSec,
+                   MotorRef(new L298(LEFTENABLE, LEFTIN1, LEFTIN2)),
+                   MotorRef(new L298(RIGHTENABLE, RIGHTIN1, RIGHTIN2))),
+        _ownsMotors(true)
+   {
+   };
+
+   // Injection constructor: supply Motor implementations (virtual or hardware)
+   DriveUnit(Motor* leftMotor, Motor* rightMotor, Scheduler* aS, unsigned int mSec)
+      : DriveUnitT(aS, mSec, MotorRef(leftMotor), MotorRef(rightMotor)),
+        _ownsMotors(false)
+   {
+   };
+
+   ~DriveUnit() {
+      // cleanup motors if we own them
+      if (_ownsMotors) {
+         delete leftWheel().motor().get();
+         delete rightWheel().motor().get();
+      }
+   };
 };
 
 #endif
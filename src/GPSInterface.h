@@ -6,36 +6,134 @@
 #include "MowerTypes.h"
 #include "MowerGeometry.h"
 #include "IntegerMathUtils.h"
+#include "GPSParser.h"
+#include "GeoProjection.h"
 
-// GPS Interface stub - to be replaced with actual GPS implementation
+// GPS Interface - receiver on a serial port, decoded by GPSParser
 // INTEGER ONLY - positions in millimeters!
+//
+// begin(&port) reads NMEA GGA/RMC or UBX NAV-PVT/NAV-RELPOSNED from the port;
+// begin() without a port keeps the simulated fix set by setPosition*().
+// Fixes are projected to the local frame (mm, x = east, y = north) around
+// the origin from setOrigin(), or around the first fix if none was set.
+// The UART receive interrupt fills the core's ring buffer, update() drains it:
+// call it every loop pass, not at the fix rate (64 byte buffer = 5.5ms at 115200).
 class GPSInterface {
+public:
+    static constexpr uint8_t MaxBytesPerUpdate = 64;    // Bounds one update() to ~0.3ms
+    static constexpr time_ms_t FixTimeoutMs = 1000;     // No fix message for this long = no fix
+
 private:
     Point2D_int _currentPosition;
     bool _hasFixSimulated;
 
+    Stream* _port;
+    GPSParser _parser;
+    GeoProjection _projection;
+    time_ms_t _lastFixMs;           // millis() when the last fix message arrived
+    time_ms_t _lastRelPosMs;
+    uint16_t _fixCount;             // Positions taken, wraps
+    time_ms_t _lastEpoch;           // Receiver time of the last counted fix
+    time_ms_t _fixArrivalMs;        // millis() when that epoch's first message arrived
+
 public:
-    GPSInterface() : _currentPosition(0, 0), _hasFixSimulated(false) {}
+    GPSInterface() : _currentPosition(0, 0), _hasFixSimulated(false),
+                     _port(nullptr), _lastFixMs(0), _lastRelPosMs(0), _fixCount(0), _lastEpoch(0xFFFFFFFF), _fixArrivalMs(0) {}
 
-    // Initialize GPS module
-    void begin() {
-        // TODO: Initialize actual GPS hardware
+    // Initialize GPS module. The port must already run at the receiver's baud rate.
+    void begin(Stream* port = nullptr) {
+        _port = port;
         _hasFixSimulated = false;
     }
 
-    // Update GPS reading (call periodically)
+    // Decode what arrived since the last call (call every loop pass)
     void update() {
-        // TODO: Read from actual GPS module
-        // Convert lat/lon to local coordinates in millimeters
-        _hasFixSimulated = true;
+        if (!_port) {
+            // No receiver: keep the simulated fix
+            _hasFixSimulated = true;
+            return;
+        }
+        for (uint8_t n = 0; n < MaxBytesPerUpdate && _port->available() > 0; n++) {
+            feed((uint8_t)_port->read());
+        }
     }
 
+    // Decode one received byte (also for feeding from a custom UART ISR ring)
+    GPSParser::Message feed(uint8_t c) {
+        GPSParser::Message m = _parser.feed(c);
+        if (m == GPSParser::Message::RelPosNed) {
+            _lastRelPosMs = millis();
+        } else if (m != GPSParser::Message::None) {
+            _lastFixMs = millis();
+            const GPSFix &f = _parser.getFix();
+            if (f.quality != GPSQuality::None) {
+                if (!_projection.valid()) {
+                    _projection.begin(f.lat, f.lon, f.heightMM + f.geoidSepMM, f.latHp, f.lonHp);
+                }
+                _currentPosition = _projection.toLocal(f.lat, f.lon, f.latHp, f.lonHp);
+                // GGA and RMC of one epoch are one measurement
+                if (f.timeMs != _lastEpoch) {
+                    _lastEpoch = f.timeMs;
+                    _fixArrivalMs = _lastFixMs;
+                    _fixCount++;
+                }
+            }
+        }
+        return m;
+    }
+
+    // Local frame origin: lat/lon in 1e-7 deg, height above the ellipsoid in mm.
+    // Use a fixed point (e.g. the charger) so stored perimeters stay valid.
+    void setOrigin(int32_t lat7, int32_t lon7, int32_t heightMM, int8_t latHp = 0, int8_t lonHp = 0) {
+        _projection.begin(lat7, lon7, heightMM, latHp, lonHp);
+    }
+
+    const GeoProjection& getProjection() const { return _projection; }
+
     // Check if GPS has valid fix
     bool hasFix() const {
-        return _hasFixSimulated;
+        if (!_port) return _hasFixSimulated;
+        return _parser.getFix().quality != GPSQuality::None && getFixAgeMs() < FixTimeoutMs;
     }
 
-    // Get current position (in millimeters)
+    // RTK fixed solution (cm level)
+    bool hasRtkFix() const {
+        return hasFix() && _parser.getFix().quality == GPSQuality::RtkFixed;
+    }
+
+    // Incremented with every new epoch (also by setPosition*()): a changed
+    // count means a new measurement, e.g. for PoseEKF
+    uint16_t getFixCount() const { return _fixCount; }
+    // millis() when the current epoch arrived; the epoch itself is the receiver latency earlier
+    time_ms_t getFixArrivalMs() const { return _fixArrivalMs; }
+
+    // Horizontal 1 sigma accuracy (mm): the receiver's estimate from NAV-PVT,
+    // else typical values for the fix quality
+    uint16_t getAccuracyMM() const {
+        if (!_port) return 20;
+        const GPSFix &f = _parser.getFix();
+        if (f.hAccMM > 0) return f.hAccMM;
+        switch (f.quality) {
+            case GPSQuality::RtkFixed: return 20;
+            case GPSQuality::RtkFloat: return 300;
+            case GPSQuality::Dgps:     return 700;
+            case GPSQuality::Gps:      return 2500;
+            default:                   return 0xFFFF;
+        }
+    }
+
+    // Time since the last fix message arrived
+    time_ms_t getFixAgeMs() const {
+        return millis() - _lastFixMs;
+    }
+
+    // Decoded receiver data: lat/lon, quality, speed, course, epoch
+    const GPSFix& getFix() const { return _parser.getFix(); }
+    const GPSRelPos& getRelPos() const { return _parser.getRelPos(); }
+    time_ms_t getRelPosAgeMs() const { return millis() - _lastRelPosMs; }
+    const GPSParser& getParser() const { return _parser; }
+
+    // Get current position (mm, local frame: x = east, y = north)
     Point2D_int getPosition() const {
         return _currentPosition;
     }
@@ -45,6 +143,8 @@ public:
         _currentPosition.x = x;
         _currentPosition.y = y;
         _hasFixSimulated = true;
+        _fixArrivalMs = millis();
+        _fixCount++;
     }
 
     // Stub: Set position in meters (for convenience)
@@ -52,6 +152,8 @@ public:
         _currentPosition.x = METERS_TO_MM(xMeters);
         _currentPosition.y = METERS_TO_MM(yMeters);
         _hasFixSimulated = true;
+        _fixArrivalMs = millis();
+        _fixCount++;
     }
 
     // Stub: Set position with fractional meters (for testing)
@@ -60,15 +162,19 @@ public:
         _currentPosition.x = xTenths * 100;  // tenths of meter to mm
         _currentPosition.y = yTenths * 100;
         _hasFixSimulated = true;
+        _fixArrivalMs = millis();
+        _fixCount++;
     }
 
-    // Get number of satellites (stub)
+    // Get number of satellites
     int getSatellites() const {
+        if (_port) return _parser.getFix().satellites;
         return _hasFixSimulated ? 8 : 0;
     }
 
-    // Get HDOP (horizontal dilution of precision) - stub
+    // Get HDOP (horizontal dilution of precision) in tenths
     int getHDOP() const {
+        if (_port) return hasFix() ? _parser.getFix().dop / 10 : 999;
         return _hasFixSimulated ? 12 : 999;  // 1.2 → 12 (tenths)
     }
 };
@@ -0,0 +1,445 @@
+#ifndef GPSPARSER_H
+#define GPSPARSER_H
+
+#include <stdint.h>
+#include <string.h>
+#include "MowerTypes.h"
+
+// GPSParser - streaming NMEA (GGA, RMC) and UBX (NAV-PVT, NAV-RELPOSNED) decoder
+// INTEGER ONLY - lat/lon in 1e-7 degrees, everything else in mm, mm/s, ms
+//
+// feed() takes one byte at a time and never buffers a line or a payload:
+// - NMEA: each field is converted digit by digit as it arrives (integer part,
+//   fraction part and its digit count); the XOR checksum runs along.
+// - UBX: payload bytes are shifted into a 32 bit accumulator and a field is
+//   stored when its last byte arrives; the Fletcher checksum runs along.
+// Values go to a staging copy and are only published once the checksum
+// matches, so a corrupted sentence never changes getFix().
+//
+// Both protocols can share one port; '$' and 0xB5 0x62 start a new message.
+// Cost is a few microseconds per byte, ~1ms of CPU per second at 115200 baud.
+
+enum class GPSQuality : uint8_t { None = 0, Gps, Dgps, RtkFloat, RtkFixed };
+
+struct GPSFix {
+   int32_t lat;                 // 1e-7 deg, north positive
+   int32_t lon;                 // 1e-7 deg, east positive
+   int8_t latHp;                // 1e-9 deg, add to lat (NMEA with >= 6 minute decimals)
+   int8_t lonHp;
+   int32_t heightMM;            // Above mean sea level
+   int32_t geoidSepMM;          // Ellipsoid to mean sea level (height above ellipsoid = heightMM + geoidSepMM)
+   int32_t speedMM;             // Ground speed, mm/s
+   angle_t course;              // Course over ground, tenths, clockwise from north (GPS convention)
+   uint32_t timeMs;             // Epoch: UTC ms of day (NMEA), GPS ms of week (UBX)
+   uint16_t hAccMM;             // Horizontal accuracy estimate (UBX), 0 = unknown
+   uint16_t dop;                // HDOP (NMEA) / PDOP (UBX), hundredths
+   uint8_t satellites;
+   GPSQuality quality;
+};
+
+struct GPSRelPos {
+   int32_t northMM;             // Rover relative to the base (moving base: antenna baseline)
+   int32_t eastMM;
+   int32_t downMM;
+   angle_t heading;             // Baseline heading, tenths, clockwise from north
+   uint32_t timeMs;             // GPS ms of week
+   uint16_t accNMM;             // Accuracy estimates
+   uint16_t accEMM;
+   GPSQuality quality;
+   bool headingValid;
+};
+
+class GPSParser {
+public:
+   enum class Message : uint8_t { None, GGA, RMC, NavPvt, RelPosNed };
+
+   static constexpr uint8_t NmeaMaxLength = 100;   // 82 by the standard, u-blox HP output is longer
+   static constexpr uint8_t UbxSync1 = 0xB5;
+   static constexpr uint8_t UbxSync2 = 0x62;
+   static constexpr uint8_t UbxClassNav = 0x01;
+   static constexpr uint8_t UbxIdPvt = 0x07;
+   static constexpr uint8_t UbxIdRelPosNed = 0x3C;
+   static constexpr uint16_t UbxLenPvt = 92;
+   static constexpr uint16_t UbxLenRelPosNed = 64;   // Version 1 (protocol 20.3+)
+   static constexpr uint16_t UbxMaxLength = 512;     // Longer is taken as a false sync
+
+private:
+   enum class State : uint8_t {
+      Idle,
+      NmeaAddress, NmeaField, NmeaCk1, NmeaCk2,
+      UbxSync, UbxClass, UbxId, UbxLen1, UbxLen2, UbxPayload, UbxCkA, UbxCkB
+   };
+
+   State _state;
+   Message _msg;                // Message being decoded, None = skip to the end
+   uint8_t _ck;                 // NMEA XOR / UBX CK_A
+   uint8_t _ckB;
+   uint8_t _length;             // NMEA characters so far
+
+   // NMEA: current field and its number
+   uint8_t _field;
+   uint8_t _addr[3];            // Last 3 address characters (GPGGA -> GGA)
+   int32_t _int;                // Digits before the '.'
+   int32_t _frac;               // Digits after the '.', at most FracDigits
+   uint8_t _fracDigits;
+   bool _dot;
+   bool _neg;
+   bool _empty;
+   char _char;                  // First character of the field (N/S, A/V, ...)
+
+   // UBX
+   uint8_t _class;
+   uint16_t _payloadLen;
+   uint16_t _offset;
+   uint32_t _acc;               // Last 4 payload bytes, little endian
+
+   GPSFix _stage;
+   GPSRelPos _stageRel;
+   GPSFix _fix;
+   GPSRelPos _rel;
+
+   uint16_t _messages;
+   uint16_t _checksumErrors;
+
+   static constexpr uint8_t FracDigits = 7;
+
+   static uint8_t hexValue(uint8_t c) {
+      if (c >= '0' && c <= '9') return c - '0';
+      if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+      if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+      return 0xFF;
+   }
+
+   static int32_t powerOf10(uint8_t n) {
+      int32_t p = 1;
+      while (n--) p *= 10;
+      return p;
+   }
+
+   // Fraction rescaled to exactly `digits` decimals
+   int32_t fracTo(uint8_t digits) const {
+      if (_fracDigits >= digits) return _frac / powerOf10(_fracDigits - digits);
+      return _frac * powerOf10(digits - _fracDigits);
+   }
+
+   // Value with `digits` decimals, e.g. "1.25" with 3 -> 1250
+   int32_t fixedPoint(uint8_t digits) const {
+      int32_t v = _int * powerOf10(digits) + fracTo(digits);
+      return _neg ? -v : v;
+   }
+
+   // "ddmm.mmmmmmm" / "dddmm.mmmmmmm" -> 1e-7 deg and the 1e-9 deg rest
+   void degreesMinutes(int32_t &deg7, int8_t &hp) const {
+      uint32_t minutes7 = (uint32_t)(_int % 100) * 10000000UL + fracTo(7);   // 1e-7 min
+      deg7 = (_int / 100) * 10000000L + minutes7 / 60;
+      hp = (int8_t)((minutes7 % 60) * 100 / 60);
+   }
+
+   // "hhmmss.ss" -> ms of day
+   uint32_t timeOfDay() const {
+      uint32_t hms = _int;
+      return (hms / 10000) * 3600000UL + (hms / 100 % 100) * 60000UL + (hms % 100) * 1000UL
+             + fracTo(3);
+   }
+
+   void startField() {
+      _int = 0;
+      _frac = 0;
+      _fracDigits = 0;
+      _dot = false;
+      _neg = false;
+      _empty = true;
+      _char = 0;
+   }
+
+   void nmeaChar(uint8_t c) {
+      if (_empty) _char = c;
+      _empty = false;
+      if (c >= '0' && c <= '9') {
+         if (!_dot) _int = _int * 10 + (c - '0');
+         else if (_fracDigits < FracDigits) { _frac = _frac * 10 + (c - '0'); _fracDigits++; }
+      } else if (c == '.') {
+         _dot = true;
+      } else if (c == '-') {
+         _neg = true;
+      }
+   }
+
+   // Field `_field` complete: store it into the staging fix
+   void nmeaField() {
+      if (_msg == Message::GGA) {
+         switch (_field) {
+            case 1: _stage.timeMs = timeOfDay(); break;
+            case 2: degreesMinutes(_stage.lat, _stage.latHp); break;
+            case 3: if (_char == 'S') { _stage.lat = -_stage.lat; _stage.latHp = -_stage.latHp; } break;
+            case 4: degreesMinutes(_stage.lon, _stage.lonHp); break;
+            case 5: if (_char == 'W') { _stage.lon = -_stage.lon; _stage.lonHp = -_stage.lonHp; } break;
+            case 6:
+               switch (_int) {
+                  case 1: _stage.quality = GPSQuality::Gps; break;
+                  case 2: _stage.quality = GPSQuality::Dgps; break;
+                  case 4: _stage.quality = GPSQuality::RtkFixed; break;
+                  case 5: _stage.quality = GPSQuality::RtkFloat; break;
+                  default: _stage.quality = GPSQuality::None; break;
+               }
+               break;
+            case 7: _stage.satellites = (uint8_t)_int; break;
+            case 8: _stage.dop = (uint16_t)fixedPoint(2); break;
+            case 9: _stage.heightMM = fixedPoint(3); break;
+            case 11: _stage.geoidSepMM = fixedPoint(3); break;
+         }
+      } else if (_msg == Message::RMC) {
+         switch (_field) {
+            case 1: _stage.timeMs = timeOfDay(); break;
+            case 2: _stage.quality = _char == 'A' ? GPSQuality::Gps : GPSQuality::None; break;
+            case 3: degreesMinutes(_stage.lat, _stage.latHp); break;
+            case 4: if (_char == 'S') { _stage.lat = -_stage.lat; _stage.latHp = -_stage.latHp; } break;
+            case 5: degreesMinutes(_stage.lon, _stage.lonHp); break;
+            case 6: if (_char == 'W') { _stage.lon = -_stage.lon; _stage.lonHp = -_stage.lonHp; } break;
+            case 7: _stage.speedMM = fixedPoint(3) * 463 / 900; break;   // 1e-3 knots -> mm/s
+            case 8: if (!_empty) _stage.course = (angle_t)fixedPoint(1); break;
+         }
+      }
+   }
+
+   // Sentence verified: publish what it carries
+   void nmeaCommit() {
+      if (_msg == Message::GGA) {
+         _fix.timeMs = _stage.timeMs;
+         _fix.quality = _stage.quality;
+         _fix.satellites = _stage.satellites;
+         _fix.dop = _stage.dop;
+         _fix.heightMM = _stage.heightMM;
+         _fix.geoidSepMM = _stage.geoidSepMM;
+         _fix.hAccMM = 0;
+      } else {
+         // RMC only knows valid / invalid; keep the GGA quality while valid
+         if (_stage.quality == GPSQuality::None) _fix.quality = GPSQuality::None;
+         else if (_fix.quality == GPSQuality::None) _fix.quality = GPSQuality::Gps;
+         _fix.timeMs = _stage.timeMs;
+         _fix.speedMM = _stage.speedMM;
+         _fix.course = _stage.course;
+      }
+      _fix.lat = _stage.lat;
+      _fix.lon = _stage.lon;
+      _fix.latHp = _stage.latHp;
+      _fix.lonHp = _stage.lonHp;
+   }
+
+   // UBX payload byte at _offset, already in _acc
+   void ubxByte(uint8_t b) {
+      int32_t v = (int32_t)_acc;
+      if (_msg == Message::NavPvt) {
+         switch (_offset) {
+            case 3:  _stage.timeMs = _acc; break;
+            case 20: _stage.quality = b >= 2 && b <= 4 ? GPSQuality::Gps : GPSQuality::None; break;
+            case 21:
+               // flags: gnssFixOK (bit 0), diffSoln (bit 1), carrSoln (bits 6..7)
+               if (!(b & 0x01)) _stage.quality = GPSQuality::None;
+               else if (_stage.quality != GPSQuality::None) {
+                  if ((b >> 6) == 2) _stage.quality = GPSQuality::RtkFixed;
+                  else if ((b >> 6) == 1) _stage.quality = GPSQuality::RtkFloat;
+                  else if (b & 0x02) _stage.quality = GPSQuality::Dgps;
+               }
+               break;
+            case 23: _stage.satellites = b; break;
+            case 27: _stage.lon = v; break;
+            case 31: _stage.lat = v; break;
+            case 35: _stage.geoidSepMM = v; break;                        // Height above ellipsoid ...
+            case 39: _stage.heightMM = v; _stage.geoidSepMM -= v; break;  // ... minus hMSL
+            case 43: _stage.hAccMM = _acc > 0xFFFF ? 0xFFFF : (uint16_t)_acc; break;
+            case 63: _stage.speedMM = v; break;
+            case 67: _stage.course = (angle_t)(v / 10000); break;        // 1e-5 deg -> tenths
+            case 77: _stage.dop = (uint16_t)(_acc >> 16); break;
+         }
+      } else if (_msg == Message::RelPosNed) {
+         switch (_offset) {
+            case 7:  _stageRel.timeMs = _acc; break;
+            case 11: _stageRel.northMM = v * 10; break;                  // cm
+            case 15: _stageRel.eastMM = v * 10; break;
+            case 19: _stageRel.downMM = v * 10; break;
+            case 27: _stageRel.heading = (angle_t)(v / 10000); break;
+            case 32: _stageRel.northMM += ((int8_t)b + ((int8_t)b < 0 ? -5 : 5)) / 10; break;   // 0.1mm
+            case 33: _stageRel.eastMM += ((int8_t)b + ((int8_t)b < 0 ? -5 : 5)) / 10; break;
+            case 34: _stageRel.downMM += ((int8_t)b + ((int8_t)b < 0 ? -5 : 5)) / 10; break;
+            case 39: _stageRel.accNMM = (uint16_t)((_acc > 655350 ? 655350 : _acc) / 10); break;
+            case 43: _stageRel.accEMM = (uint16_t)((_acc > 655350 ? 655350 : _acc) / 10); break;
+            case 63:
+               // flags: gnssFixOK (0), diffSoln (1), relPosValid (2), carrSoln (3..4), relPosHeadingValid (8)
+               if ((_acc & 0x05) != 0x05) _stageRel.quality = GPSQuality::None;
+               else if (((_acc >> 3) & 3) == 2) _stageRel.quality = GPSQuality::RtkFixed;
+               else if (((_acc >> 3) & 3) == 1) _stageRel.quality = GPSQuality::RtkFloat;
+               else _stageRel.quality = GPSQuality::Dgps;
+               _stageRel.headingValid = (_acc >> 8) & 1;
+               break;
+         }
+      }
+   }
+
+   Message ubxCommit() {
+      if (_msg == Message::NavPvt) _fix = _stage;
+      else if (_msg == Message::RelPosNed) _rel = _stageRel;
+      return _msg;
+   }
+
+   void restart(uint8_t c) {
+      _state = State::Idle;
+      if (c == '$') {
+         _state = State::NmeaAddress;
+         _ck = 0;
+         _length = 0;
+         _field = 0;
+      } else if (c == UbxSync1) {
+         _state = State::UbxSync;
+      }
+   }
+
+public:
+   GPSParser() : _state(State::Idle), _msg(Message::None), _messages(0), _checksumErrors(0) {
+      memset(&_fix, 0, sizeof(_fix));
+      memset(&_rel, 0, sizeof(_rel));
+      _stage = _fix;
+      _stageRel = _rel;
+   }
+
+   // Decode one byte. Returns the message that just completed with a good
+   // checksum, Message::None otherwise.
+   Message feed(uint8_t c) {
+      switch (_state) {
+         case State::Idle:
+            restart(c);
+            return Message::None;
+
+         // ---------------- NMEA ----------------
+         case State::NmeaAddress:
+         case State::NmeaField:
+            // '$' or a byte that can't be NMEA (UBX sync, line noise) starts over
+            if (c == '$' || c >= 0x80 || c < ' ' || ++_length > NmeaMaxLength) {
+               restart(c);
+               return Message::None;
+            }
+            if (c == '*') {
+               if (_state == State::NmeaField) nmeaField();
+               _state = State::NmeaCk1;
+               return Message::None;
+            }
+            _ck ^= c;
+            if (_state == State::NmeaAddress) {
+               if (c == ',') {
+                  _msg = Message::None;
+                  if (_addr[0] == 'G' && _addr[1] == 'G' && _addr[2] == 'A') _msg = Message::GGA;
+                  if (_addr[0] == 'R' && _addr[1] == 'M' && _addr[2] == 'C') _msg = Message::RMC;
+                  _field = 1;
+                  _state = State::NmeaField;
+                  startField();
+               } else {
+                  _addr[0] = _addr[1];
+                  _addr[1] = _addr[2];
+                  _addr[2] = c;
+               }
+            } else if (_msg != Message::None) {
+               if (c == ',') {
+                  nmeaField();
+                  _field++;
+                  startField();
+               } else {
+                  nmeaChar(c);
+               }
+            }
+            return Message::None;
+
+         case State::NmeaCk1:
+            _ckB = hexValue(c);
+            _state = _ckB == 0xFF ? State::Idle : State::NmeaCk2;
+            return Message::None;
+
+         case State::NmeaCk2: {
+            _state = State::Idle;
+            uint8_t lo = hexValue(c);
+            if (lo == 0xFF || (uint8_t)(_ckB << 4 | lo) != _ck) {
+               _checksumErrors++;
+               return Message::None;
+            }
+            if (_msg == Message::None) return Message::None;
+            nmeaCommit();
+            _messages++;
+            return _msg;
+         }
+
+         // ---------------- UBX ----------------
+         case State::UbxSync:
+            if (c == UbxSync2) _state = State::UbxClass;
+            else restart(c);
+            return Message::None;
+
+         case State::UbxClass:
+            _class = c;
+            _ck = c;
+            _ckB = c;
+            _state = State::UbxId;
+            return Message::None;
+
+         case State::UbxId:
+            _msg = Message::None;
+            if (_class == UbxClassNav && c == UbxIdPvt) _msg = Message::NavPvt;
+            if (_class == UbxClassNav && c == UbxIdRelPosNed) _msg = Message::RelPosNed;
+            break;
+
+         case State::UbxLen1:
+            _payloadLen = c;
+            break;
+
+         case State::UbxLen2:
+            _payloadLen |= (uint16_t)c << 8;
+            if (_payloadLen > UbxMaxLength) {
+               _state = State::Idle;
+               return Message::None;
+            }
+            // Unknown length (other protocol version): skip, don't misread
+            if ((_msg == Message::NavPvt && _payloadLen != UbxLenPvt) ||
+                (_msg == Message::RelPosNed && _payloadLen != UbxLenRelPosNed)) {
+               _msg = Message::None;
+            }
+            _offset = 0;
+            break;
+
+         case State::UbxPayload:
+            _acc = (_acc >> 8) | ((uint32_t)c << 24);
+            if (_msg != Message::None) ubxByte(c);
+            _offset++;
+            break;
+
+         case State::UbxCkA:
+            _state = c == _ck ? State::UbxCkB : State::Idle;
+            if (c != _ck) _checksumErrors++;
+            return Message::None;
+
+         case State::UbxCkB:
+            _state = State::Idle;
+            if (c != _ckB) {
+               _checksumErrors++;
+               return Message::None;
+            }
+            if (_msg == Message::None) return Message::None;
+            _messages++;
+            return ubxCommit();
+      }
+
+      // UBX header/payload byte: Fletcher checksum and next state
+      _ck += c;
+      _ckB += _ck;
+      if (_state == State::UbxPayload || _state == State::UbxLen2) {
+         _state = _offset < _payloadLen ? State::UbxPayload : State::UbxCkA;
+      } else {
+         _state = (State)((uint8_t)_state + 1);
+      }
+      return Message::None;
+   }
+
+   const GPSFix& getFix() const { return _fix; }
+   const GPSRelPos& getRelPos() const { return _rel; }
+   uint16_t getMessages() const { return _messages; }
+   uint16_t getChecksumErrors() const { return _checksumErrors; }
+};
+
+#endif
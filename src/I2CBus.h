@@ -0,0 +1,137 @@
+#ifndef I2CBUS_H
+#define I2CBUS_H
+
+#define _TASK_OO_CALLBACKS
+
+#include <TaskSchedulerDeclarations.h>
+#include <Arduino.h>
+#include <globals.hpp>
+
+enum class I2CStatus : uint8_t {
+   Idle,          // Never submitted
+   Queued,        // Waiting for the bus
+   Busy,          // On the bus
+   Done,
+   Nack,          // Address or data not acknowledged
+   BusError       // Arbitration lost, illegal state or timeout
+};
+
+struct I2CTransaction;
+typedef void (*I2CCallback)(I2CTransaction *t, void *context);
+
+// One register transfer: write reg, then
+//   read = false: write length bytes from data
+//   read = true:  repeated start, read length bytes into data
+// The caller owns the transaction and the buffer; both must stay untouched
+// until status leaves Queued/Busy.
+struct I2CTransaction {
+   uint8_t address;
+   uint8_t reg;
+   uint8_t *data;
+   uint8_t length;
+   bool read;
+   volatile I2CStatus status;
+   I2CCallback done;          // Called from I2CBus::Callback() (task context), may be nullptr
+   void *context;
+
+   bool pending() const { return status == I2CStatus::Queued || status == I2CStatus::Busy; }
+   bool ok() const { return status == I2CStatus::Done; }
+
+   void setRead(uint8_t addr, uint8_t r, uint8_t *buf, uint8_t len) {
+      address = addr; reg = r; data = buf; length = len; read = true;
+   }
+   void setWrite(uint8_t addr, uint8_t r, uint8_t *buf, uint8_t len) {
+      address = addr; reg = r; data = buf; length = len; read = false;
+   }
+};
+
+// I2CBus - queue of I2C transactions executed in the background
+//
+// submit() only queues; the backend (I2CBusTWI on AVR, MockI2CBus on the host)
+// runs the transfers one after the other from its interrupt, with no waiting
+// in task code. Finished transactions go through a second queue and their
+// callbacks run from this Task (1ms), so callbacks may touch anything and
+// submit follow-up transactions.
+//
+// Queues are RingBuffers: pending is filled by tasks and drained by the ISR,
+// finished is filled by the ISR and drained here. A transfer that takes longer
+// than TimeoutMs (stuck bus) is aborted with BusError.
+class I2CBus : public Task {
+public:
+   static constexpr uint8_t QueueSize = 8;
+   static constexpr time_ms_t TimeoutMs = 10;
+
+private:
+   RingBuffer<I2CTransaction*, QueueSize, false> _pending;
+   RingBuffer<I2CTransaction*, QueueSize * 2, false> _finished;
+   volatile uint16_t _errors;
+
+protected:
+   I2CTransaction * volatile _active;
+   volatile time_ms_t _activeSinceMs;
+
+   // Start t on the hardware. Called with interrupts off or from the ISR.
+   virtual void start(I2CTransaction *t) = 0;
+   // Reset the hardware after a timeout. Called with interrupts off.
+   virtual void abort() = 0;
+
+   // Backend: the active transaction has ended. Starts the next one.
+   // Returns the next transaction (nullptr = bus idle) so a backend can
+   // chain STOP and START.
+   I2CTransaction *finish(I2CStatus status) {
+      I2CTransaction *t = _active;
+      if (t) {
+         t->status = status;
+         if (status != I2CStatus::Done) _errors++;
+         _finished.push(t);       // Can't overflow: submit() keeps pending + finished <= QueueSize
+      }
+      return startNext();
+   }
+
+   I2CTransaction *startNext() {
+      I2CTransaction *next = nullptr;
+      if (_pending.pull(next)) {
+         next->status = I2CStatus::Busy;
+         _activeSinceMs = millis();
+      }
+      _active = next;
+      return next;
+   }
+
+public:
+   I2CBus(Scheduler* aS) : Task(1, TASK_FOREVER, aS, false),
+      _errors(0), _active(nullptr), _activeSinceMs(0) {}
+
+   // Queue t (task context). Returns false if the queue is full or t is still pending.
+   bool submit(I2CTransaction *t) {
+      if (t->pending()) return false;
+      if (_pending.count() + _finished.count() >= QueueSize) return false;
+      t->status = I2CStatus::Queued;
+      _pending.push(t);
+      noInterrupts();
+      if (!_active && startNext()) start(_active);
+      interrupts();
+      return true;
+   }
+
+   bool idle() const { return _active == nullptr; }
+   uint16_t getErrors() const { return _errors; }
+
+   bool Callback() override {
+      // Stuck transfer: reset the hardware and fail it
+      noInterrupts();
+      if (_active && (time_ms_t)(millis() - _activeSinceMs) > TimeoutMs) {
+         abort();
+         if (finish(I2CStatus::BusError)) start(_active);
+      }
+      interrupts();
+
+      I2CTransaction *t;
+      while (_finished.pull(t)) {
+         if (t->done) t->done(t, t->context);
+      }
+      return true;
+   }
+};
+
+#endif
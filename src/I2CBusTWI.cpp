@@ -0,0 +1,131 @@
+#include <Arduino.h>
+#include <I2CBusTWI.h>
+#include <TaskSchedulerDeclarations.h>
+#include <globals.hpp>
+
+// Only built with I2C_ASYNC: it owns the TWI vector, which Wire defines as well
+#if I2C_ASYNC && defined(__AVR__)
+
+#include <util/twi.h>
+
+I2CBusTWI *I2CBusTWI::_instance = nullptr;
+
+// TWCR values: every step acknowledges the interrupt (TWINT) and keeps it enabled
+#define TWCR_NEXT     (_BV(TWEN) | _BV(TWIE) | _BV(TWINT))
+#define TWCR_ACK      (TWCR_NEXT | _BV(TWEA))
+#define TWCR_START    (TWCR_NEXT | _BV(TWSTA))
+#define TWCR_STOP     (_BV(TWEN) | _BV(TWINT) | _BV(TWSTO))
+// STOP, then START for the next transaction, in one write
+#define TWCR_RESTART  (TWCR_NEXT | _BV(TWSTO) | _BV(TWSTA))
+
+I2CBusTWI::I2CBusTWI(Scheduler* aS) : I2CBus(aS) {
+   _index = 0;
+   _readPhase = false;
+   _instance = this;
+};
+
+I2CBusTWI::~I2CBusTWI() {
+   end();
+   _instance = nullptr;
+};
+
+void I2CBusTWI::begin(uint32_t clockHz) {
+   // Internal pull-ups as Wire does; external 4.7k are still recommended at 400kHz
+   digitalWrite(SDA, HIGH);
+   digitalWrite(SCL, HIGH);
+
+   TWSR = 0;                                      // Prescaler 1
+   TWBR = ((F_CPU / clockHz) - 16) / 2;           // SCL = F_CPU / (16 + 2 * TWBR)
+   TWCR = _BV(TWEN);
+   enable();
+};
+
+void I2CBusTWI::end() {
+   disable();
+   TWCR = 0;
+};
+
+void I2CBusTWI::start(I2CTransaction *t) {
+   _index = 0;
+   _readPhase = false;
+   TWCR = TWCR_START;
+};
+
+void I2CBusTWI::abort() {
+   TWCR = 0;                  // Releases SDA/SCL
+   TWCR = _BV(TWEN);
+};
+
+void I2CBusTWI::service() {
+   I2CBusTWI *bus = _instance;
+   I2CTransaction *t = bus ? bus->_active : nullptr;
+   if (!t) {
+      TWCR = TWCR_STOP;
+      return;
+   }
+
+   I2CStatus result;
+   switch (TW_STATUS) {
+      case TW_START:
+      case TW_REP_START:
+         TWDR = (t->address << 1) | (bus->_readPhase ? TW_READ : TW_WRITE);
+         TWCR = TWCR_NEXT;
+         return;
+
+      // Master transmitter: register, then data (write) or repeated start (read)
+      case TW_MT_SLA_ACK:
+         TWDR = t->reg;
+         TWCR = TWCR_NEXT;
+         return;
+      case TW_MT_DATA_ACK:
+         if (t->read && t->length > 0) {
+            bus->_readPhase = true;
+            TWCR = TWCR_START;
+            return;
+         }
+         if (!t->read && bus->_index < t->length) {
+            TWDR = t->data[bus->_index++];
+            TWCR = TWCR_NEXT;
+            return;
+         }
+         result = I2CStatus::Done;
+         break;
+
+      // Master receiver: ACK every byte but the last
+      case TW_MR_DATA_ACK:
+         t->data[bus->_index++] = TWDR;
+         // fall through
+      case TW_MR_SLA_ACK:
+         TWCR = (t->length - bus->_index > 1) ? TWCR_ACK : TWCR_NEXT;
+         return;
+      case TW_MR_DATA_NACK:
+         t->data[bus->_index++] = TWDR;
+         result = I2CStatus::Done;
+         break;
+
+      case TW_MT_SLA_NACK:
+      case TW_MT_DATA_NACK:
+      case TW_MR_SLA_NACK:
+         result = I2CStatus::Nack;
+         break;
+
+      default:                // Arbitration lost (TW_MT_ARB_LOST), bus error
+         bus->abort();
+         result = I2CStatus::BusError;
+         break;
+   }
+
+   if (bus->finish(result)) {
+      bus->_index = 0;
+      bus->_readPhase = false;
+      TWCR = TWCR_RESTART;
+   } else {
+      TWCR = TWCR_STOP;
+   }
+};
+
+ISR(TWI_vect) {
+   I2CBusTWI::service();
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef I2CBUSTWI_H
+#define I2CBUSTWI_H
+
+#define _TASK_OO_CALLBACKS
+
+#include <TaskSchedulerDeclarations.h>
+#include <Arduino.h>
+#include <globals.hpp>
+#include <I2CBus.h>
+
+// I2CBusTWI - I2CBus backend on the AVR TWI hardware (SDA A4, SCL A5)
+//
+// Every bus event (START sent, address/data ACK or NACK, byte received)
+// raises TWI_vect; the ISR advances the transaction one step and returns.
+// Between transactions it chains STOP and START without waiting.
+// Only one instance can exist and it owns TWI_vect: with I2C_ASYNC set,
+// nothing may use the Wire library.
+class I2CBusTWI : public I2CBus {
+private:
+   uint8_t _index;                  // Next data byte
+   bool _readPhase;                 // Register written, now reading
+
+   static I2CBusTWI *_instance;
+
+protected:
+   void start(I2CTransaction *t) override;
+   void abort() override;
+
+public:
+   I2CBusTWI(Scheduler* aS);
+   ~I2CBusTWI();
+
+   void begin(uint32_t clockHz = 400000);
+   void end();
+
+   // Called from TWI_vect
+   static void service();
+};
+#endif
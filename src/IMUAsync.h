@@ -0,0 +1,227 @@
+#ifndef IMUASYNC_H
+#define IMUASYNC_H
+
+#define _TASK_OO_CALLBACKS
+
+#include <TaskSchedulerDeclarations.h>
+#include "globals.hpp"
+#include "I2CBus.h"
+#include "IMUInterface.h"
+
+// IMUAsync - drives an IMUInterface over I2CBus, never blocking
+//
+// Same register traffic as IMUInterface::begin()/calibrate()/update()
+// (setup from ICM20948Setup), but as a state machine on a 1ms Task: each step queues one transaction and the
+// next step starts from its completion callback. The reset and wake-up waits
+// and the 10ms calibration spacing are task delays, so the scheduler (motor
+// ramps, sonar, odometry) keeps running during begin and calibration.
+//
+// Run phase, every pollMs:
+//   burst read 14/22 bytes (accel, gyro, temp, mag) -> FIFO_COUNT -> drain in 32 byte reads
+//   -> magnetometer fusion
+// IMUInterface does the integration, so getHeading() etc. work as before.
+class IMUAsync : public Task {
+public:
+   enum class State : uint8_t { Idle, Setup, Calibrate, Run };
+
+private:
+   enum class Phase : uint8_t { Burst, Count, Drain };
+
+   I2CBus *_bus;
+   IMUInterface *_imu;
+   I2CTransaction _t;
+   uint8_t _buf[ICM20948_FIFO_CHUNK];
+
+   State _state;
+   State _afterSetup;              // Where the current script run continues
+   Phase _phase;
+   uint8_t _step;                  // Next script step
+   uint8_t _stepEnd;
+   bool _useFifo;
+   bool _useMagnetometer;
+   bool _waiting;                  // Transaction queued, completion not yet handled
+
+   uint16_t _pollMs;
+   time_ms_t _wakeMs;              // Next step not before this
+   time_ms_t _lastPollMs;
+
+   int _calSamples;
+   int _calCount;
+   int32_t _sum[3];
+
+   uint16_t _fifoLeft;
+   uint16_t _errors;
+
+   void waitMs(time_ms_t ms) { _wakeMs = millis() + ms; }
+
+   void runScript(uint8_t from, uint8_t to, State after) {
+      _step = from;
+      _stepEnd = to;
+      _afterSetup = after;
+      _state = State::Setup;
+   }
+
+   void enter(State s) {
+      _state = s;
+      _phase = Phase::Burst;
+      if (s == State::Calibrate) {
+         _calCount = 0;
+         _sum[0] = _sum[1] = _sum[2] = 0;
+      } else if (s == State::Run) {
+         _lastPollMs = millis();
+      }
+   }
+
+   // Skip setup steps not needed for this configuration
+   void skipUnused() {
+      while (_step < _stepEnd && !ICM20948Setup::used(_step, _useMagnetometer, _useFifo)) _step++;
+   }
+
+   // Queue the transaction for the current state
+   void issue() {
+      if (_state == State::Setup) {
+         _buf[0] = ICM20948Setup::value(_step, _useMagnetometer, _useFifo);
+         _t.setWrite(ICM20948_ADDR, ICM20948Setup::reg(_step), _buf, 1);
+      } else if (_phase == Phase::Count) {
+         _t.setRead(ICM20948_ADDR, ICM20948_FIFO_COUNTH, _buf, 2);
+      } else if (_phase == Phase::Drain) {
+         uint8_t n = _fifoLeft > ICM20948_FIFO_CHUNK ? ICM20948_FIFO_CHUNK : _fifoLeft;
+         _t.setRead(ICM20948_ADDR, ICM20948_FIFO_R_W, _buf, n);
+      } else {
+         _t.setRead(ICM20948_ADDR, ICM20948_ACCEL_XOUT_H, _buf, _imu->burstLength());
+      }
+      _waiting = _bus->submit(&_t);   // Queue full: Callback() retries next tick
+   }
+
+   void completed() {
+      _waiting = false;
+      if (!_t.ok()) {
+         _errors++;
+         // Setup and calibration repeat the step, Run skips to the next poll
+         if (_state == State::Run) {
+            _phase = Phase::Burst;
+            waitMs(_pollMs);
+         } else {
+            waitMs(10);
+         }
+         return;
+      }
+
+      switch (_state) {
+         case State::Setup:
+            waitMs(ICM20948Setup::waitMs(_step));
+            _step++;
+            skipUnused();
+            if (_step >= _stepEnd) {
+               if (_afterSetup == State::Calibrate) _imu->attach(_useMagnetometer, _useFifo);
+               enter(_afterSetup);
+            }
+            break;
+
+         case State::Calibrate:
+            _imu->applyBurst(_buf);
+            _imu->addRawGyro(_sum);
+            waitMs(10);
+            if (++_calCount >= _calSamples) {
+               _imu->setGyroBias(_sum[0], _sum[1], _sum[2], _calSamples);
+               // Drop what queued up while calibrating
+               if (_useFifo) runScript(ICM20948Setup::FifoReset, ICM20948Setup::Count, State::Run);
+               else enter(State::Run);
+            }
+            break;
+
+         case State::Run:
+            completedRun();
+            break;
+
+         default:
+            break;
+      }
+   }
+
+   void completedRun() {
+      time_ms_t now = millis();
+      switch (_phase) {
+         case Phase::Burst:
+            _imu->applyBurst(_buf);
+            if (_useFifo) {
+               _phase = Phase::Count;
+               return;
+            }
+            _imu->integrateLastRate(now - _lastPollMs);
+            break;
+
+         case Phase::Count: {
+            uint16_t count = (uint16_t)(_buf[0] & 0x1F) << 8 | _buf[1];
+            if (_imu->fifoOverflowed(count)) {
+               // Lost samples: bridge this poll with the last rate, restart the FIFO
+               _imu->integrateLastRate(now - _lastPollMs);
+               _lastPollMs = now;
+               _imu->updateFromMagnetometer();
+               runScript(ICM20948Setup::FifoReset, ICM20948Setup::Count, State::Run);
+               return;
+            }
+            _fifoLeft = count & ~1;
+            if (_fifoLeft > 0) {
+               _phase = Phase::Drain;
+               return;
+            }
+            break;
+         }
+
+         case Phase::Drain:
+            _imu->integrateFifo(_buf, _t.length);
+            _fifoLeft -= _t.length;
+            if (_fifoLeft > 0) return;
+            break;
+      }
+
+      // Poll done
+      _imu->updateFromMagnetometer();
+      _phase = Phase::Burst;
+      _lastPollMs = now;
+      waitMs(_pollMs);
+   }
+
+   static void onDone(I2CTransaction *, void *context) {
+      static_cast<IMUAsync*>(context)->completed();
+   }
+
+public:
+   IMUAsync(Scheduler* aS, I2CBus *bus, IMUInterface *imu, uint16_t pollMs = 20)
+      : Task(1, TASK_FOREVER, aS, false), _bus(bus), _imu(imu),
+        _state(State::Idle), _afterSetup(State::Idle), _phase(Phase::Burst),
+        _step(0), _stepEnd(0), _useFifo(true), _useMagnetometer(false), _waiting(false),
+        _pollMs(pollMs), _wakeMs(0), _lastPollMs(0),
+        _calSamples(200), _calCount(0), _sum{0, 0, 0}, _fifoLeft(0), _errors(0)
+   {
+      _t.status = I2CStatus::Idle;
+      _t.done = onDone;
+      _t.context = this;
+   }
+
+   // Start setup and calibration (sensor must be stationary); runs in the background
+   void begin(bool useMagnetometer = true, bool useFifo = true, int calibrationSamples = 200) {
+      _useMagnetometer = useMagnetometer;
+      _useFifo = useFifo;
+      _calSamples = calibrationSamples > 0 ? calibrationSamples : 1;
+      runScript(0, ICM20948Setup::Count, State::Calibrate);
+      skipUnused();
+      waitMs(100);                 // Power up
+      enable();
+   }
+
+   bool Callback() override {
+      if (_state == State::Idle || _waiting) return false;
+      if ((int32_t)(millis() - _wakeMs) < 0) return false;
+      issue();
+      return true;
+   }
+
+   State getState() const { return _state; }
+   bool ready() const { return _state == State::Run; }
+   bool isCalibrating() const { return _state == State::Calibrate; }
+   uint16_t getErrors() const { return _errors; }
+};
+
+#endif
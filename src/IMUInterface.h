@@ -3,6 +3,8 @@
 
 #include "globals.hpp"
 #include "Arduino.h"
+#include "IntegerMathDefault.h"
+#include "MagCalibration.h"
 #include <Wire.h>
 
 // ICM-20948 I2C addresses
@@ -15,15 +17,53 @@
 
 // Bank 0 Registers
 #define ICM20948_WHO_AM_I       0x00
+#define ICM20948_USER_CTRL      0x03
 #define ICM20948_PWR_MGMT_1     0x06
 #define ICM20948_PWR_MGMT_2     0x07
 #define ICM20948_ACCEL_XOUT_H   0x2D
 #define ICM20948_GYRO_XOUT_H    0x33
+#define ICM20948_TEMP_OUT_H     0x39
+#define ICM20948_EXT_SLV_SENS_DATA_00 0x3B   // Magnetometer bytes (I2C master SLV0)
+
+#define ICM20948_FIFO_EN_2      0x67
+#define ICM20948_FIFO_RST       0x68
+#define ICM20948_FIFO_MODE      0x69
+#define ICM20948_FIFO_COUNTH    0x70
+#define ICM20948_FIFO_R_W       0x72
+
+// One burst from ACCEL_XOUT_H: accel XYZ, gyro XYZ, temp (big endian)
+#define ICM20948_SENSOR_BURST   14
+// ... followed by the magnetometer: HX, HY, HZ (little endian), TMPS, ST2
+#define ICM20948_SENSOR_BURST_MAG 22
+
+// USER_CTRL bits
+#define ICM20948_USER_CTRL_FIFO_EN  0x40
+#define ICM20948_USER_CTRL_I2C_MST_EN 0x20
+
+// FIFO bits
+#define ICM20948_FIFO_EN_GYRO_Z     0x08
+#define ICM20948_FIFO_SIZE      512   // Bytes
+#define ICM20948_FIFO_CHUNK     32    // Max bytes per read (Wire buffer), even
 
 // Bank 2 Registers
+#define ICM20948_GYRO_SMPLRT_DIV 0x00
 #define ICM20948_GYRO_CONFIG_1  0x01
 #define ICM20948_ACCEL_CONFIG   0x14
 
+// Bank 3 Registers (I2C master for the magnetometer)
+#define ICM20948_I2C_MST_ODR_CONFIG 0x00
+#define ICM20948_I2C_MST_CTRL   0x01
+#define ICM20948_I2C_SLV0_ADDR  0x03
+#define ICM20948_I2C_SLV0_REG   0x04
+#define ICM20948_I2C_SLV0_CTRL  0x05
+#define ICM20948_I2C_SLV4_ADDR  0x13
+#define ICM20948_I2C_SLV4_REG   0x14
+#define ICM20948_I2C_SLV4_CTRL  0x15
+#define ICM20948_I2C_SLV4_DO    0x16
+
+// Gyro ODR = 1125Hz / (1 + ICM20948_GYRO_RATE_DIV)
+#define ICM20948_GYRO_RATE_DIV  0
+
 // Magnetometer (AK09916) - accessed via I2C master interface
 #define AK09916_I2C_ADDR        0x0C
 #define AK09916_WHO_AM_I        0x01
@@ -31,13 +71,97 @@
 #define AK09916_MAG_XOUT_L      0x11
 #define AK09916_CONTROL_2       0x31
 #define AK09916_CONTROL_3       0x32
+#define AK09916_MODE_CONT_100HZ 0x08
+#define AK09916_ST2_HOFL        0x08  // Magnetic overflow
+
+// ICM-20948 setup as { register, value, wait ms after, used when }, one write per
+// step. Register 0x7F (REG_BANK_SEL) switches banks like any other write.
+// Shared by IMUInterface::begin() (Wire) and IMUAsync (I2CBus).
+namespace ICM20948Setup {
+   enum : uint8_t { Always = 0, Mag = 1, Fifo = 2 };
+
+   static constexpr uint8_t Steps[][4] PROGMEM = {
+      { ICM20948_REG_BANK_SEL, 0 << 4, 0, Always },
+      { ICM20948_PWR_MGMT_1, 0x80, 100, Always },            // Device reset (back in Bank 0)
+      { ICM20948_PWR_MGMT_1, 0x01, 10, Always },             // Wake, auto clock
+      { ICM20948_PWR_MGMT_2, 0x00, 10, Always },             // All axes on
+      { ICM20948_REG_BANK_SEL, 2 << 4, 0, Always },
+      { ICM20948_GYRO_SMPLRT_DIV, ICM20948_GYRO_RATE_DIV, 0, Always },
+      { ICM20948_GYRO_CONFIG_1, 0x01, 0, Always },           // 250 dps, 1.1 kHz ODR
+      { ICM20948_ACCEL_CONFIG, 0x01, 0, Always },            // ±2g, 1.125 kHz ODR
+      { ICM20948_REG_BANK_SEL, 0 << 4, 0, Always },
+      { ICM20948_USER_CTRL, 0x00, 0, Always },               // Value from userCtrl()
+      { ICM20948_FIFO_MODE, 0x00, 0, Fifo },                 // Stream: overwrite when full
+      { ICM20948_FIFO_EN_2, ICM20948_FIFO_EN_GYRO_Z, 0, Fifo },
+      // AK09916 through the I2C master: SLV4 writes CNTL2 once,
+      // SLV0 then copies HXL..ST2 to EXT_SLV_SENS_DATA_00 every cycle
+      { ICM20948_REG_BANK_SEL, 3 << 4, 0, Mag },
+      { ICM20948_I2C_MST_CTRL, 0x07, 0, Mag },               // 345.6kHz
+      { ICM20948_I2C_MST_ODR_CONFIG, 0x03, 0, Mag },         // 1.1kHz / 2^3 = 137Hz
+      { ICM20948_I2C_SLV4_ADDR, AK09916_I2C_ADDR, 0, Mag },
+      { ICM20948_I2C_SLV4_REG, AK09916_CONTROL_2, 0, Mag },
+      { ICM20948_I2C_SLV4_DO, AK09916_MODE_CONT_100HZ, 0, Mag },
+      { ICM20948_I2C_SLV4_CTRL, 0x80, 10, Mag },             // One shot
+      { ICM20948_I2C_SLV0_ADDR, 0x80 | AK09916_I2C_ADDR, 0, Mag },   // Read
+      { ICM20948_I2C_SLV0_REG, AK09916_MAG_XOUT_L, 0, Mag },
+      { ICM20948_I2C_SLV0_CTRL, 0x88, 0, Mag },              // Enable, 8 bytes
+      { ICM20948_REG_BANK_SEL, 0 << 4, 0, Mag },
+      // FIFO reset, also run after gyro calibration
+      { ICM20948_FIFO_RST, 0x1F, 0, Fifo },
+      { ICM20948_FIFO_RST, 0x00, 0, Fifo },
+   };
+   static constexpr uint8_t Count = sizeof(Steps) / sizeof(Steps[0]);
+   static constexpr uint8_t FifoReset = Count - 2;
+
+   inline uint8_t reg(uint8_t step) { return pgm_read_byte(&Steps[step][0]); }
+   inline uint8_t waitMs(uint8_t step) { return pgm_read_byte(&Steps[step][2]); }
+   inline bool used(uint8_t step, bool mag, bool fifo) {
+      uint8_t when = pgm_read_byte(&Steps[step][3]);
+      return when == Always || (when == Mag && mag) || (when == Fifo && fifo);
+   }
+   inline uint8_t value(uint8_t step, bool mag, bool fifo) {
+      if (reg(step) == ICM20948_USER_CTRL) {
+         return (fifo ? ICM20948_USER_CTRL_FIFO_EN : 0) | (mag ? ICM20948_USER_CTRL_I2C_MST_EN : 0);
+      }
+      return pgm_read_byte(&Steps[step][1]);
+   }
+}
 
 // IMU Interface for ICM-20948
 // INTEGER-ONLY MATH - No floats!
 // Angles in tenths of degrees (0-3599)
 // Time in milliseconds
+//
+// FIFO mode (default): the sensor queues every gyro Z sample at its 1125Hz
+// ODR, update() drains the FIFO and integrates each sample with the exact
+// sample period. Nothing between polls is lost and the poll jitter doesn't
+// matter. Without FIFO, update() integrates one sample over the millis() delta.
+//
+// Magnetometer (AK09916): read with the same burst, calibrated online
+// (MagCalibration) and tilt compensated with the accelerometer. The compass
+// heading corrects the gyro heading with a complementary filter; its integral
+// part trims the gyro Z bias (Mahony), so drift stays bounded. Readings with
+// a disturbed field or while accelerating are skipped. Cost per sample is
+// fixed: one atan2 and one square root per magnetometer reading.
 class IMUInterface {
+public:
+    static constexpr uint8_t GyroRateDiv = ICM20948_GYRO_RATE_DIV;
+    static constexpr uint16_t GyroOdrHz = 1125 / (1 + GyroRateDiv);
+
+    // Complementary filter defaults: per magnetometer update the heading moves
+    // err/KpDiv towards the compass, the Z bias err/KiDiv (1/16 LSB)
+    static constexpr int16_t DefaultKpDiv = 64;
+    static constexpr int16_t DefaultKiDiv = 32;
+    static constexpr int16_t BiasLearnWindow = 100;      // Only trim the bias within 10°
+    static constexpr int16_t BiasTrimLimit = 262 * 16;   // ±2°/s around the calibrated bias
+    static constexpr int16_t FieldRefDiv = 64;           // Field strength reference follows in ~3s at 20Hz
+
 private:
+    // Heading accumulator scale: bias corrected raw gyro (Q4) * 10 summed per
+    // sample. One tenth of a degree = 131 LSB/(°/s) * ODR * 16.
+    static constexpr int32_t BiasScale = 16;
+    static constexpr int32_t AccPerTenth = 131L * GyroOdrHz * BiasScale;
+
     angle_t _currentHeading;        // Heading in tenths of degrees (0-3599)
     angle_t _headingOffset;         // Calibration offset
     time_ms_t _lastUpdate;          // Last update time in milliseconds
@@ -49,69 +173,210 @@ private:
     int16_t _gyroBiasY;
     int16_t _gyroBiasZ;
 
-    // Magnetometer calibration (hard iron offset)
-    int16_t _magOffsetX;
-    int16_t _magOffsetY;
-    int16_t _magOffsetZ;
+    // Magnetometer: last reading in accelerometer axes (raw), online calibration
+    int16_t _magRaw[3];
+    bool _magNew;
+    MagCalibration _magCal;
+
+    // Heading fusion
+    angle_t _magHeading;            // Last tilt compensated compass heading
+    bool _magHeadingValid;
+    angle_t _declination;           // Magnetic to true north, tenths
+    int16_t _kpDiv;
+    int16_t _kiDiv;
+    int16_t _fuseAcc;               // Heading correction remainder (tenths * KpDiv)
+    int16_t _biasAcc;               // Bias correction remainder (1/16 LSB * KiDiv)
+    int16_t _gyroBiasZQ4Cal;        // Bias from calibrate(), centre of the trim range
+    int16_t _fieldRef;              // Usual calibrated field strength, 0 = not known yet
+
+    // Last burst read (raw sensor units)
+    int16_t _accelRaw[3];
+    int16_t _gyroRaw[3];
+    int16_t _tempRaw;
+
+    // FIFO integration
+    bool _fifoEnabled;
+    int16_t _gyroBiasZQ4;           // Z bias in 1/16 LSB (sub LSB resolution)
+    int32_t _headingAcc;            // Remainder below one tenth, AccPerTenth units
+    int32_t _gyroAngle;             // Gyro-only rotation since begin, tenths, not wrapped
+    uint32_t _fifoSamples;          // Samples integrated since begin()
+    uint16_t _fifoOverflows;
+
+    // Register bank currently selected in the sensor (BankUnknown = must write)
+    static constexpr uint8_t BankUnknown = 0xFF;
+    uint8_t _currentBank;
 
     // Select register bank (ICM-20948 uses bank switching)
+    // Cached: only costs an I2C transaction when the bank actually changes
     void selectBank(uint8_t bank) {
+        if (bank == _currentBank) return;
         Wire.beginTransmission(ICM20948_ADDR);
         Wire.write(ICM20948_REG_BANK_SEL);
         Wire.write(bank << 4);
+        if (Wire.endTransmission(true) == 0) {
+            _currentBank = bank;
+        } else {
+            _currentBank = BankUnknown;
+        }
+    }
+
+    // Read accel + gyro + temp (+ magnetometer) in one burst (Bank 0)
+    bool readSensors() {
+        selectBank(0);
+
+        uint8_t n = burstLength();
+        Wire.beginTransmission(ICM20948_ADDR);
+        Wire.write(ICM20948_ACCEL_XOUT_H);
+        Wire.endTransmission(false);
+        if (Wire.requestFrom((uint8_t)ICM20948_ADDR, n, (uint8_t)true) != n) {
+            return false;
+        }
+
+        uint8_t buf[ICM20948_SENSOR_BURST_MAG];
+        for (uint8_t i = 0; i < n; i++) buf[i] = Wire.read();
+        applyBurst(buf);
+        return true;
+    }
+
+    void writeRegister(uint8_t reg, uint8_t value) {
+        Wire.beginTransmission(ICM20948_ADDR);
+        Wire.write(reg);
+        Wire.write(value);
         Wire.endTransmission(true);
     }
 
+    // Bytes waiting in the FIFO (Bank 0)
+    uint16_t fifoCount() {
+        selectBank(0);
+        Wire.beginTransmission(ICM20948_ADDR);
+        Wire.write(ICM20948_FIFO_COUNTH);
+        Wire.endTransmission(false);
+        if (Wire.requestFrom((uint8_t)ICM20948_ADDR, (uint8_t)2, (uint8_t)true) != 2) return 0;
+        uint16_t count = (Wire.read() & 0x1F) << 8;
+        return count | Wire.read();
+    }
+
+    void resetFifo() {
+        selectBank(0);
+        writeRegister(ICM20948_FIFO_RST, 0x1F);
+        writeRegister(ICM20948_FIFO_RST, 0x00);
+    }
+
+
+    // Add one bias corrected gyro sample to the heading, carrying the remainder
+    void integrateSample(int16_t gyroZ) {
+        _headingAcc += ((int32_t)gyroZ * BiasScale - _gyroBiasZQ4) * 10;
+        int32_t tenths = _headingAcc / AccPerTenth;
+        if (tenths != 0) {
+            _headingAcc -= tenths * AccPerTenth;
+            _currentHeading += (angle_t)tenths;
+            _gyroAngle += tenths;
+        }
+    }
+
+    // Drain the FIFO in bursts, integrating every sample.
+    // Returns false if the FIFO had overflowed (samples were lost).
+    bool drainFifo() {
+        uint16_t count = fifoCount();
+        if (fifoOverflowed(count)) {
+            resetFifo();
+            return false;
+        }
+        count &= ~1;    // Whole samples only, the rest stays for the next poll
+
+        while (count > 0) {
+            uint8_t n = count > ICM20948_FIFO_CHUNK ? ICM20948_FIFO_CHUNK : count;
+            Wire.beginTransmission(ICM20948_ADDR);
+            Wire.write(ICM20948_FIFO_R_W);
+            Wire.endTransmission(false);
+            if (Wire.requestFrom((uint8_t)ICM20948_ADDR, n, (uint8_t)true) != n) {
+                // Misaligned from here on: start over
+                resetFifo();
+                return false;
+            }
+            uint8_t buf[ICM20948_FIFO_CHUNK];
+            for (uint8_t i = 0; i < n; i++) buf[i] = Wire.read();
+            integrateFifo(buf, n);
+            count -= n;
+        }
+        return true;
+    }
+
+    // Integrate one rate over deltaTimeMs (no FIFO, or after an overflow)
+    void integrateRate(int16_t gyroZ, time_ms_t deltaTimeMs) {
+        // ICM-20948 at ±250°/s: 131 LSB/(°/s)
+        // Convert to tenths of degrees per second: gyroZ / 131 * 10 = gyroZ / 13.1
+        // To avoid float: gyroZ * 10 / 131
+        int16_t gyroRateDeciDegPerSec = ((int32_t)(gyroZ - _gyroBiasZ) * 10) / 131;
+
+        // Integrate: heading += rate * (deltaTime / 1000)
+        // In tenths of degrees: heading += (rate_in_tenths/sec) * (ms / 1000)
+        //                              = (rate_in_tenths/sec * ms) / 1000
+        int32_t headingChange = ((int32_t)gyroRateDeciDegPerSec * deltaTimeMs) / 1000;
+        _currentHeading += (angle_t)headingChange;
+        _gyroAngle += headingChange;
+        normalizeHeading();
+    }
+
+    // Normalize to 0-3599 range (0.0° to 359.9°)
+    void normalizeHeading() {
+        while (_currentHeading >= ANGLE_360) _currentHeading -= ANGLE_360;
+        while (_currentHeading < 0) _currentHeading += ANGLE_360;
+    }
+
+    // Heading of the sensor x axis from a calibrated field m and the
+    // accelerometer a (milli-g, pointing up at rest). No angles needed:
+    //   East = m x a, North = a x East, heading = atan2(North.x, East.x * |a|)
+    // Same convention as the rest of the code: 0 = east, CCW positive.
+    angle_t tiltCompensatedHeading(const int16_t m[3], const int16_t a[3]) const {
+        int32_t ex = (int32_t)m[1] * a[2] - (int32_t)m[2] * a[1];
+        int32_t ey = ((int32_t)m[2] * a[0] - (int32_t)m[0] * a[2]) >> 8;
+        int32_t ez = ((int32_t)m[0] * a[1] - (int32_t)m[1] * a[0]) >> 8;
+        int32_t nx = (int32_t)a[1] * ez - (int32_t)a[2] * ey;
+        int32_t aNorm = fast_sqrt((uint32_t)((int32_t)a[0] * a[0] + (int32_t)a[1] * a[1] + (int32_t)a[2] * a[2]));
+        return atan2_int(nx, (ex >> 8) * aNorm);
+    }
+
 public:
     IMUInterface() : _currentHeading(0), _headingOffset(0),
                      _lastUpdate(0), _initialized(false),
                      _magnetometerEnabled(false),
                      _gyroBiasX(0), _gyroBiasY(0), _gyroBiasZ(0),
-                     _magOffsetX(0), _magOffsetY(0), _magOffsetZ(0) {}
+                     _magRaw{0, 0, 0}, _magNew(false),
+                     _magHeading(0), _magHeadingValid(false), _declination(0),
+                     _kpDiv(DefaultKpDiv), _kiDiv(DefaultKiDiv), _fuseAcc(0), _biasAcc(0),
+                     _gyroBiasZQ4Cal(0), _fieldRef(0),
+                     _accelRaw{0, 0, 0}, _gyroRaw{0, 0, 0}, _tempRaw(0),
+                     _fifoEnabled(false), _gyroBiasZQ4(0), _headingAcc(0),
+                     _gyroAngle(0), _fifoSamples(0), _fifoOverflows(0),
+                     _currentBank(BankUnknown) {}
 
     // Initialize ICM-20948
-    void begin(bool useMagnetometer = true) {
+    // useFifo: integrate every gyro sample from the FIFO (see class comment)
+    void begin(bool useMagnetometer = true, bool useFifo = true) {
         Wire.begin();
+        Wire.setClock(400000);  // Fast mode: ICM-20948 supports 400kHz
         delay(100);  // Allow sensor to power up
 
-        // Reset device (Bank 0, PWR_MGMT_1, bit 7)
-        selectBank(0);
-        Wire.beginTransmission(ICM20948_ADDR);
-        Wire.write(ICM20948_PWR_MGMT_1);
-        Wire.write(0x80);  // Device reset
-        Wire.endTransmission(true);
-        delay(100);
-
-        // Wake up sensor (clear sleep bit)
-        Wire.beginTransmission(ICM20948_ADDR);
-        Wire.write(ICM20948_PWR_MGMT_1);
-        Wire.write(0x01);  // Auto select best clock source
-        Wire.endTransmission(true);
-        delay(10);
-
-        // Enable accelerometer and gyroscope (Bank 0, PWR_MGMT_2)
-        Wire.beginTransmission(ICM20948_ADDR);
-        Wire.write(ICM20948_PWR_MGMT_2);
-        Wire.write(0x00);  // Enable all axes
-        Wire.endTransmission(true);
-        delay(10);
-
-        // Configure gyroscope (Bank 2, GYRO_CONFIG_1)
-        // ±250°/s range for precise heading tracking
-        selectBank(2);
-        Wire.beginTransmission(ICM20948_ADDR);
-        Wire.write(ICM20948_GYRO_CONFIG_1);
-        Wire.write(0x01);  // 250 dps, 1.1 kHz ODR
-        Wire.endTransmission(true);
-
-        // Configure accelerometer (Bank 2, ACCEL_CONFIG)
-        Wire.beginTransmission(ICM20948_ADDR);
-        Wire.write(ICM20948_ACCEL_CONFIG);
-        Wire.write(0x01);  // ±2g range, 1.125 kHz ODR
-        Wire.endTransmission(true);
+        // Reset, configure gyro/accel, FIFO and magnetometer (ICM20948Setup)
+        _currentBank = BankUnknown;
+        for (uint8_t i = 0; i < ICM20948Setup::Count; i++) {
+            if (!ICM20948Setup::used(i, useMagnetometer, useFifo)) continue;
+            uint8_t reg = ICM20948Setup::reg(i);
+            uint8_t value = ICM20948Setup::value(i, useMagnetometer, useFifo);
+            if (reg == ICM20948_REG_BANK_SEL) {
+                selectBank(value >> 4);
+            } else {
+                writeRegister(reg, value);
+            }
+            delay(ICM20948Setup::waitMs(i));
+            if (reg == ICM20948_PWR_MGMT_1 && (value & 0x80)) _currentBank = 0;  // Reset selects Bank 0
+        }
 
-        // Return to Bank 0
-        selectBank(0);
+        _fifoEnabled = useFifo;
+        _headingAcc = 0;
+        _fifoSamples = 0;
+        _fifoOverflows = 0;
 
         _magnetometerEnabled = useMagnetometer;
         _initialized = true;
@@ -128,45 +393,44 @@ public:
 
         int32_t sumX = 0, sumY = 0, sumZ = 0;
 
-        selectBank(0);
-
         for (int i = 0; i < samples; i++) {
-            Wire.beginTransmission(ICM20948_ADDR);
-            Wire.write(ICM20948_GYRO_XOUT_H);
-            Wire.endTransmission(false);
-            Wire.requestFrom((uint8_t)ICM20948_ADDR, (uint8_t)6, (uint8_t)true);
-
-            int16_t gyroX = Wire.read() << 8 | Wire.read();
-            int16_t gyroY = Wire.read() << 8 | Wire.read();
-            int16_t gyroZ = Wire.read() << 8 | Wire.read();
+            readSensors();
 
-            sumX += gyroX;
-            sumY += gyroY;
-            sumZ += gyroZ;
+            sumX += _gyroRaw[0];
+            sumY += _gyroRaw[1];
+            sumZ += _gyroRaw[2];
 
             delay(10);  // 10ms between samples
         }
 
-        _gyroBiasX = sumX / samples;
-        _gyroBiasY = sumY / samples;
-        _gyroBiasZ = sumZ / samples;
+        setGyroBias(sumX, sumY, sumZ, samples);
 
-        DEBUG_PRINT("Gyro bias: X=");
-        DEBUG_PRINT(_gyroBiasX);
-        DEBUG_PRINT(" Y=");
-        DEBUG_PRINT(_gyroBiasY);
-        DEBUG_PRINT(" Z=");
-        DEBUG_PRINTLN(_gyroBiasZ);
+        // Drop what queued up while calibrating
+        if (_fifoEnabled) resetFifo();
     }
 
     // Calibrate magnetometer (for accurate compass heading)
+    // Turn the mower through at least one full circle while this runs
+    // (samples * 20ms). Not required: update() keeps calibrating online.
     void calibrateMagnetometer(int samples = 100) {
         if (!_initialized || !_magnetometerEnabled) return;
 
-        // TODO: Implement magnetometer calibration
-        _magOffsetX = 0;
-        _magOffsetY = 0;
-        _magOffsetZ = 0;
+        DEBUG_PRINTLN("Calibrating magnetometer - turn a full circle!");
+
+        _magCal.reset();
+        _fieldRef = 0;
+        for (int i = 0; i < samples; i++) {
+            if (readSensors() && _magNew) _magCal.add(_magRaw);
+            _magNew = false;
+            delay(20);
+        }
+
+        DEBUG_PRINT("Mag offset: X=");
+        DEBUG_PRINT(_magCal.getOffset(0));
+        DEBUG_PRINT(" Y=");
+        DEBUG_PRINT(_magCal.getOffset(1));
+        DEBUG_PRINT(" Z=");
+        DEBUG_PRINTLN(_magCal.getOffset(2));
     }
 
     // Update heading from gyro (call frequently, e.g., 50-100Hz)
@@ -178,52 +442,153 @@ public:
         time_ms_t deltaTimeMs = currentTime - _lastUpdate;
         _lastUpdate = currentTime;
 
-        // Read gyroscope Z-axis (yaw rate)
-        selectBank(0);
+        // One burst: accel, gyro and temp (accel/gyro getters use this sample)
+        if (!readSensors()) return;
 
-        Wire.beginTransmission(ICM20948_ADDR);
-        Wire.write(ICM20948_GYRO_XOUT_H);
-        Wire.endTransmission(false);
-        Wire.requestFrom((uint8_t)ICM20948_ADDR, (uint8_t)6, (uint8_t)true);
+        // FIFO: every sample at the ODR. On overflow fall back to the
+        // current rate over the poll interval for this once.
+        if (!_fifoEnabled || !drainFifo()) {
+            integrateRate(_gyroRaw[2], deltaTimeMs);
+        }
 
-        int16_t gyroX __attribute__((unused)) = Wire.read() << 8 | Wire.read();
-        int16_t gyroY __attribute__((unused)) = Wire.read() << 8 | Wire.read();
-        int16_t gyroZ = Wire.read() << 8 | Wire.read();
+        updateFromMagnetometer();
+    }
 
-        // ICM-20948 at ±250°/s: 131 LSB/(°/s)
-        // Convert to tenths of degrees per second: gyroZ / 131 * 10 = gyroZ / 13.1
-        // To avoid float: gyroZ * 10 / 131
-        int16_t gyroRateDeciDegPerSec = ((int32_t)(gyroZ - _gyroBiasZ) * 10) / 131;
+    // Transport independent part, shared by the Wire path above and IMUAsync
+    // (which moves the same bytes over I2CBus without blocking)
 
-        // Integrate: heading += rate * (deltaTime / 1000)
-        // In tenths of degrees: heading += (rate_in_tenths/sec) * (ms / 1000)
-        //                              = (rate_in_tenths/sec * ms) / 1000
-        int32_t headingChange = ((int32_t)gyroRateDeciDegPerSec * deltaTimeMs) / 1000;
-        _currentHeading += (angle_t)headingChange;
+    // Mark the sensor as configured by an external transport
+    void attach(bool useMagnetometer, bool useFifo) {
+        _fifoEnabled = useFifo;
+        _magnetometerEnabled = useMagnetometer;
+        _headingAcc = 0;
+        _fifoSamples = 0;
+        _fifoOverflows = 0;
+        _initialized = true;
+        _lastUpdate = millis();
+    }
 
-        // Normalize to 0-3599 range (0.0° to 359.9°)
-        while (_currentHeading >= ANGLE_360) _currentHeading -= ANGLE_360;
-        while (_currentHeading < 0) _currentHeading += ANGLE_360;
+    // Bytes per burst from ACCEL_XOUT_H
+    uint8_t burstLength() const {
+        return _magnetometerEnabled ? ICM20948_SENSOR_BURST_MAG : ICM20948_SENSOR_BURST;
     }
 
-    // Update heading from magnetometer (compass - absolute heading)
-    // This corrects gyro drift and provides true north reference
-    void updateFromMagnetometer() {
-        if (!_initialized || !_magnetometerEnabled) return;
+    // Store a burst from ACCEL_XOUT_H (accel, gyro, temp, magnetometer)
+    void applyBurst(const uint8_t *buf) {
+        for (uint8_t i = 0; i < 3; i++) _accelRaw[i] = buf[2 * i] << 8 | buf[2 * i + 1];
+        for (uint8_t i = 0; i < 3; i++) _gyroRaw[i] = buf[6 + 2 * i] << 8 | buf[7 + 2 * i];
+        _tempRaw = buf[12] << 8 | buf[13];
+        if (!_magnetometerEnabled) return;
+
+        // AK09916 axes: X = accel X, Y = -accel Y, Z = -accel Z (little endian)
+        const uint8_t *m = buf + ICM20948_SENSOR_BURST;
+        if (m[7] & AK09916_ST2_HOFL) return;     // Saturated, e.g. next to a motor
+        _magRaw[0] = (int16_t)(m[1] << 8 | m[0]);
+        _magRaw[1] = -(int16_t)(m[3] << 8 | m[2]);
+        _magRaw[2] = -(int16_t)(m[5] << 8 | m[4]);
+        _magNew = true;
+    }
+
+    // Add the last burst's raw gyro X, Y, Z to sum (calibration)
+    void addRawGyro(int32_t *sum) const {
+        for (uint8_t i = 0; i < 3; i++) sum[i] += _gyroRaw[i];
+    }
 
-        // Note: AK09916 magnetometer requires I2C master interface setup
-        // This is a simplified direct read - full implementation would use
-        // the ICM-20948's I2C master to read from AK09916 at 0x0C
+    // Gyro bias from the sums of samples stationary readings
+    void setGyroBias(int32_t sumX, int32_t sumY, int32_t sumZ, int samples) {
+        _gyroBiasX = sumX / samples;
+        _gyroBiasY = sumY / samples;
+        _gyroBiasZ = sumZ / samples;
+        _gyroBiasZQ4 = sumZ * BiasScale / samples;
+        _gyroBiasZQ4Cal = _gyroBiasZQ4;
+        _biasAcc = 0;
+        _headingAcc = 0;
+        _lastUpdate = millis();
 
-        // For now, stub implementation - magnetometer requires additional setup
-        // Full implementation would:
-        // 1. Configure I2C master in ICM-20948
-        // 2. Set up slave 0 to read from AK09916
-        // 3. Read magnetometer data registers
-        // 4. Calculate heading with tilt compensation using accelerometer
+        DEBUG_PRINT("Gyro bias: X=");
+        DEBUG_PRINT(_gyroBiasX);
+        DEBUG_PRINT(" Y=");
+        DEBUG_PRINT(_gyroBiasY);
+        DEBUG_PRINT(" Z=");
+        DEBUG_PRINTLN(_gyroBiasZ);
+    }
 
-        // Placeholder: Use gyro-based heading
-        // In production, implement proper mag reading or use library like SparkFun ICM-20948
+    // Integrate FIFO bytes (big endian gyro Z samples, n even)
+    void integrateFifo(const uint8_t *buf, uint8_t n) {
+        for (uint8_t i = 0; i + 1 < n; i += 2) {
+            integrateSample(buf[i] << 8 | buf[i + 1]);
+        }
+        _fifoSamples += n / 2;
+        normalizeHeading();
+    }
+
+    // FIFO_COUNT at or near the FIFO size means samples were overwritten
+    bool fifoOverflowed(uint16_t count) {
+        if (count < ICM20948_FIFO_SIZE - 1) return false;
+        _fifoOverflows++;
+        return true;
+    }
+
+    // No FIFO data for this poll: integrate the last burst's rate instead
+    void integrateLastRate(time_ms_t deltaTimeMs) {
+        integrateRate(_gyroRaw[2], deltaTimeMs);
+    }
+
+    // Update heading from magnetometer (compass - absolute heading)
+    // This corrects gyro drift and provides true north reference.
+    // Uses the reading of the last burst; update() calls it.
+    void updateFromMagnetometer() {
+        if (!_initialized || !_magnetometerEnabled || !_magNew) return;
+        _magNew = false;
+
+        // Online calibration, ignoring spikes once calibrated
+        int16_t m[3];
+        if (_magCal.valid() && _fieldRef > 0) {
+            _magCal.apply(_magRaw, m);
+            if (fast_sqrt(fieldStrength2(m)) > (uint32_t)(2 * _fieldRef)) return;
+        }
+        if (!_magCal.add(_magRaw)) return;
+        _magCal.apply(_magRaw, m);
+
+        // Disturbed field (steel, wires): outside 75%..125% of the usual strength.
+        // The reference follows slowly, so a lasting change is accepted after a while.
+        int16_t strength = (int16_t)fast_sqrt(fieldStrength2(m));
+        if (_fieldRef == 0) _fieldRef = strength;
+        _fieldRef += (strength - _fieldRef) / FieldRefDiv;
+        if (4 * strength < 3 * _fieldRef || 4 * strength > 5 * _fieldRef) return;
+
+        // Accelerating or bumping: gravity is not "up", tilt compensation would be off
+        int16_t a[3];
+        getAcceleration(a[0], a[1], a[2]);
+        int32_t a2 = fieldStrength2(a);
+        if (a2 < 850L * 850 || a2 > 1150L * 1150) return;
+
+        _magHeading = normalizeAngle(tiltCompensatedHeading(m, a) + _declination + _headingOffset);
+        _magHeadingValid = true;
+
+        // Complementary filter: move err / KpDiv towards the compass
+        int16_t err = angleDifference(_magHeading, _currentHeading);
+        _fuseAcc += err;
+        int16_t step = _fuseAcc / _kpDiv;
+        _fuseAcc -= step * _kpDiv;
+        _currentHeading += step;
+        normalizeHeading();
+
+        // Integral part: a lasting error means a wrong gyro bias.
+        // Heading behind the compass (err > 0) = gyro reads low = bias too high.
+        if (err > -BiasLearnWindow && err < BiasLearnWindow) {
+            _biasAcc += err;
+            int16_t trim = _biasAcc / _kiDiv;
+            _biasAcc -= trim * _kiDiv;
+            int32_t bias = (int32_t)_gyroBiasZQ4 - trim;
+            _gyroBiasZQ4 = constrain(bias, (int32_t)_gyroBiasZQ4Cal - BiasTrimLimit,
+                                           (int32_t)_gyroBiasZQ4Cal + BiasTrimLimit);
+            _gyroBiasZ = _gyroBiasZQ4 / BiasScale;
+        }
+    }
+
+    static int32_t fieldStrength2(const int16_t v[3]) {
+        return (int32_t)v[0] * v[0] + (int32_t)v[1] * v[1] + (int32_t)v[2] * v[2];
     }
 
     // Get current heading in tenths of degrees (0-3599)
@@ -270,6 +635,11 @@ public:
         return _magnetometerEnabled;
     }
 
+    // FIFO statistics: samples integrated and overflows (poll too slow)
+    bool isFifoEnabled() const { return _fifoEnabled; }
+    uint32_t getFifoSamples() const { return _fifoSamples; }
+    uint16_t getFifoOverflows() const { return _fifoOverflows; }
+
     // Stub: Set heading manually for testing (in tenths of degrees)
     void setHeadingStub(angle_t heading) {
         setHeading(heading);
@@ -281,7 +651,7 @@ public:
     }
 
     // Get accelerometer data (useful for tilt compensation)
-    // Returns acceleration in milli-g's (1000 = 1g)
+    // Returns acceleration in milli-g's (1000 = 1g) from the last update() burst
     void getAcceleration(int16_t& x, int16_t& y, int16_t& z) {
         if (!_initialized) {
             x = y = 0;
@@ -289,45 +659,65 @@ public:
             return;
         }
 
-        selectBank(0);
-
-        Wire.beginTransmission(ICM20948_ADDR);
-        Wire.write(ICM20948_ACCEL_XOUT_H);
-        Wire.endTransmission(false);
-        Wire.requestFrom((uint8_t)ICM20948_ADDR, (uint8_t)6, (uint8_t)true);
-
-        int16_t accelX = Wire.read() << 8 | Wire.read();
-        int16_t accelY = Wire.read() << 8 | Wire.read();
-        int16_t accelZ = Wire.read() << 8 | Wire.read();
-
         // ICM-20948 at ±2g: 16384 LSB/g
         // Convert to milli-g's: (raw / 16384.0) * 1000 = raw * 1000 / 16384 ≈ raw / 16
-        x = accelX >> 4;  // Approximately /16 for milli-g
-        y = accelY >> 4;
-        z = accelZ >> 4;
+        x = _accelRaw[0] >> 4;  // Approximately /16 for milli-g
+        y = _accelRaw[1] >> 4;
+        z = _accelRaw[2] >> 4;
+    }
+
+    // Die temperature in tenths of °C from the last update() burst
+    // ICM-20948: T = raw / 333.87 + 21°C
+    int16_t getTemperature() const {
+        return (int16_t)((int32_t)_tempRaw * 100 / 3339 + 210);
     }
 
-    // Get magnetometer data (raw integer values)
+    // Get magnetometer data: calibrated, in accelerometer axes (0.15uT units)
     void getMagnetometer(int16_t& x, int16_t& y, int16_t& z) {
         if (!_magnetometerEnabled) {
             x = y = z = 0;
             return;
         }
 
-        // TODO: Read actual magnetometer
-        // Stub values (pointing north)
-        x = 0;
-        y = 500;  // Arbitrary units
-        z = 0;
+        int16_t m[3];
+        _magCal.apply(_magRaw, m);
+        x = m[0];
+        y = m[1];
+        z = m[2];
+    }
+
+    // Last tilt compensated compass heading, tenths (valid once calibrated)
+    angle_t getMagHeading() const { return _magHeading; }
+    bool hasMagHeading() const { return _magHeadingValid; }
+
+    // Magnetic declination (true = magnetic + declination), tenths, east positive
+    void setDeclination(angle_t declination) { _declination = declination; }
+
+    // Filter gains: larger divisors trust the gyro longer
+    void setFusionGains(int16_t kpDiv, int16_t kiDiv) {
+        _kpDiv = kpDiv > 0 ? kpDiv : 1;
+        _kiDiv = kiDiv > 0 ? kiDiv : 1;
+        _fuseAcc = 0;
+        _biasAcc = 0;
     }
 
-    // Get gyroscope data (raw angular rates in millidegrees/sec)
+    // Magnetometer calibration (e.g. to store and restore it)
+    MagCalibration& getMagCalibration() { return _magCal; }
+
+    // Rotation from the gyro alone (no compass steps, no setHeading), tenths,
+    // not wrapped: take differences, e.g. as the prediction input of PoseEKF
+    int32_t getGyroAngle() const { return _gyroAngle; }
+
+    // Gyro Z bias as trimmed by the filter, 1/16 LSB
+    int16_t getGyroBiasZQ4() const { return _gyroBiasZQ4; }
+
+    // Get gyroscope data: bias corrected rates in tenths of degrees/sec
+    // from the last update() burst (millidegrees would overflow int16 above 32°/s)
     void getGyroscope(int16_t& x, int16_t& y, int16_t& z) {
-        // TODO: Read actual gyroscope
-        // Stub values
-        x = 0;
-        y = 0;
-        z = 0;
+        // ±250°/s: 131 LSB/(°/s) -> tenths: raw * 10 / 131
+        x = ((int32_t)(_gyroRaw[0] - _gyroBiasX) * 10) / 131;
+        y = ((int32_t)(_gyroRaw[1] - _gyroBiasY) * 10) / 131;
+        z = ((int32_t)(_gyroRaw[2] - _gyroBiasZ) * 10) / 131;
     }
 };
 
@@ -1,6 +1,6 @@
 #include "L298.h"
 
-L298::L298() {
+L298Driver::L298Driver() {
    _pwmVal = 0;
    _speed = 0;
    _pinIN1 = 0;
@@ -8,13 +8,13 @@ L298::L298() {
    _pinPwmOut = 0;
 };
 
-L298::L298(byte pinPWM, byte pinIN1, byte pinIN2) {
+L298Driver::L298Driver(byte pinPWM, byte pinIN1, byte pinIN2) {
    _pwmVal = 0;
    _speed = 0;
    setPins(pinPWM, pinIN1, pinIN2);
 };
 
-void L298::setPins(byte pinPWM, byte pinIN1, byte pinIN2) {
+void L298Driver::setPins(byte pinPWM, byte pinIN1, byte pinIN2) {
    _pinPwmOut = pinPWM; 
    _pinIN1 = pinIN1;
    _pinIN2 = pinIN2;
@@ -26,13 +26,13 @@ void L298::setPins(byte pinPWM, byte pinIN1, byte pinIN2) {
    digitalWrite(_pinIN2, LOW);
 };
 
-int L298::getSpeed() {
+int L298Driver::getSpeed() {
    return _pwmVal;
 };
 
-void L298::move(int S) {
+void L298Driver::move(int S) {
    // Constrain to standardized range: -1023 to +1023
-   S = constrain(S, MOTOR_SPEED_MIN, MOTOR_SPEED_MAX);
+   S = constrain(S, SPEED_MIN, SPEED_MAX);
    _speed = S;
 
    if (S == 0 ) {
@@ -57,14 +57,14 @@ void L298::move(int S) {
    analogWrite(_pinPwmOut, _pwmVal);
 };
 
-void L298::stop() {
+void L298Driver::stop() {
    //Disable
    digitalWrite(_pinIN1, LOW);
    digitalWrite(_pinIN2, LOW);
    analogWrite(_pinPwmOut, 255);
 };
 
-void L298::reset() {
+void L298Driver::reset() {
    stop();
    _speed = 0;
    _pwmVal = 0;
@@ -4,25 +4,48 @@
 #include "Arduino.h"
 #include "motor.hpp"
 
-class L298 : public Motor  {
-//From motor interface
+// L298Driver - non-virtual L298 driver
+// Same speed contract as Motor (-1023..+1023) but without a vtable,
+// so it can be composed by value into DriveUnitT for static dispatch.
+class L298Driver {
 public:
-   // constructor
-   L298();
-   L298(byte pinEnable, byte pinIN1, byte pinIN2);
+   L298Driver();
+   L298Driver(byte pinEnable, byte pinIN1, byte pinIN2);
 
    void setPins(byte pinPWM, byte pinIN1, byte pinIN2);
 
-   void move(int Speed) override;
-   void stop()          override;
-   void reset()         override;
-   int  getSpeed()      override;
+   void move(int Speed);
+   void stop();
+   void reset();
+   int  getSpeed();
 
 private:
+   static const int SPEED_MAX = 1023;
+   static const int SPEED_MIN = -1023;
+
    byte _pinPwmOut;
    byte _pinIN1;
    byte _pinIN2;
    int   _speed;
    byte _pwmVal;
 };
-#endif
\ No newline at end of file
+
+// L298 - Motor interface adapter around L298Driver (runtime polymorphism)
+class L298 : public Motor  {
+//From motor interface
+public:
+   // constructor
+   L298() {};
+   L298(byte pinEnable, byte pinIN1, byte pinIN2) : _driver(pinEnable, pinIN1, pinIN2) {};
+
+   void setPins(byte pinPWM, byte pinIN1, byte pinIN2) { _driver.setPins(pinPWM, pinIN1, pinIN2); };
+
+   void move(int Speed) override { _driver.move(Speed); };
+   void stop()          override { _driver.stop(); };
+   void reset()         override { _driver.reset(); };
+   int  getSpeed()      override { return _driver.getSpeed(); };
+
+private:
+   L298Driver _driver;
+};
+#endif
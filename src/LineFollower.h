@@ -4,6 +4,7 @@
 #include "globals.hpp"
 #include "GPSInterface.h"
 #include "IMUInterface.h"
+#include "PoseEKF.h"
 #include "IntegerMathDefault.h"
 #include "DriveUnit.h"
 #include <TaskSchedulerDeclarations.h>
@@ -11,7 +12,12 @@
 // Line Following Controller - INTEGER ONLY VERSION
 // Smoothly guides mower along a line from point A to point B
 // All math in integers: distances in mm, angles in tenths of degrees
-class LineFollower : public Task {
+// With a PoseEKF attached the fused pose replaces the raw GPS position and IMU
+// heading, and the speed drops while its position uncertainty is high.
+// DriveT needs setTargetSpeed(left, right, mSec): L298DriveUnit in production
+// (static dispatch), DriveUnit for injected Motor implementations.
+template <class DriveT>
+class LineFollowerT : public Task {
 private:
     // Line definition (in millimeters)
     Point2D_int _startPoint;
@@ -21,11 +27,13 @@ private:
     // Sensor references
     GPSInterface* _gps;
     IMUInterface* _imu;
-    DriveUnit* _drive;
+    DriveT* _drive;
+    PoseEKF* _pose;                  // Optional fused pose
 
     // Current state
     Point2D_int _currentPosition;    // mm
     angle_t _currentHeading;         // tenths of degrees (0-3599)
+    uint16_t _positionSigma;         // mm, 0 without a PoseEKF
 
     // Controller parameters (tunable)
     int16_t _K_crossTrack;           // Cross-track gain (scaled by 1000)
@@ -36,6 +44,10 @@ private:
     // Completion detection
     distance_t _completionThreshold; // Distance to endpoint in mm
 
+    // Uncertainty limits (mm, 1 sigma): full speed up to slow, then base * slow / sigma, stop at stop
+    uint16_t _slowSigmaMM;
+    uint16_t _stopSigmaMM;
+
     bool _lineComplete;
 
     // Helper functions
@@ -45,11 +57,12 @@ private:
     Point2D_int calculateLookAheadPoint();
     distance_t calculateDistanceToEnd();
     angle_t calculateBearing(const Point2D_int& from, const Point2D_int& to);
+    wheelSpeed speedForUncertainty();
 
 public:
     // Constructor
-    LineFollower(Scheduler* aS, GPSInterface* gps, IMUInterface* imu, DriveUnit* drive);
-    ~LineFollower();
+    LineFollowerT(Scheduler* aS, GPSInterface* gps, IMUInterface* imu, DriveT* drive);
+    ~LineFollowerT();
 
     // Set the line to follow (coordinates in millimeters)
     void setLineMM(Point2D_int start, Point2D_int end);
@@ -69,6 +82,13 @@ public:
     void setBaseSpeed(wheelSpeed speed) { _baseSpeed = speed; }
     void setCompletionThresholdMM(distance_t threshold) { _completionThreshold = threshold; }
 
+    // Take position and heading from a PoseEKF instead of GPS and IMU directly
+    void setPoseEstimator(PoseEKF* pose) { _pose = pose; }
+    void setUncertaintyLimitsMM(uint16_t slowSigma, uint16_t stopSigma) {
+        _slowSigmaMM = slowSigma;
+        _stopSigmaMM = stopSigma;
+    }
+
     // Get controller parameters
     int16_t getCrossTrackGain() const { return _K_crossTrack; }
     int16_t getHeadingGain() const { return _K_heading; }
@@ -84,6 +104,9 @@ public:
     // Get current cross-track error in mm (for monitoring)
     distance_t getCrossTrackError() { return calculateCrossTrackError(); }
 
+    // Position uncertainty used for the speed limit (mm, 0 without a PoseEKF)
+    uint16_t getPositionSigmaMM() const { return _positionSigma; }
+
     // Reset state
     void reset();
 
@@ -93,4 +116,296 @@ public:
     void OnDisable() override;
 };
 
+// Constructor
+template <class DriveT>
+LineFollowerT<DriveT>::LineFollowerT(Scheduler* aS, GPSInterface* gps, IMUInterface* imu, DriveT* drive)
+    : Task(200, TASK_FOREVER, aS, false),  // 200ms update rate, disabled initially
+      _lineSet(false),
+      _gps(gps),
+      _imu(imu),
+      _drive(drive),
+      _pose(nullptr),
+      _positionSigma(0),
+      _K_crossTrack(1000),           // Default: 1.0 (scaled by 1000)
+      _K_heading(2000),              // Default: 2.0 (scaled by 1000)
+      _lookaheadDistance(1000),      // Default: 1000mm = 1 meter
+      _baseSpeed(Speed50),           // Default: 50% speed
+      _completionThreshold(300),     // Default: 300mm = 30cm
+      _slowSigmaMM(100),             // Default: slow down above 10cm
+      _stopSigmaMM(1000),            // Default: stop above 1m
+      _lineComplete(false)
+{
+}
+
+// Destructor
+template <class DriveT>
+LineFollowerT<DriveT>::~LineFollowerT() {
+}
+
+// Set the line to follow (in millimeters)
+template <class DriveT>
+void LineFollowerT<DriveT>::setLineMM(Point2D_int start, Point2D_int end) {
+    _startPoint = start;
+    _endPoint = end;
+    _lineSet = true;
+    _lineComplete = false;
+}
+
+// Set line in meters
+template <class DriveT>
+void LineFollowerT<DriveT>::setLineMeters(int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+    setLineMM(
+        Point2D_int(METERS_TO_MM(x1), METERS_TO_MM(y1)),
+        Point2D_int(METERS_TO_MM(x2), METERS_TO_MM(y2))
+    );
+}
+
+// Reset state
+template <class DriveT>
+void LineFollowerT<DriveT>::reset() {
+    _lineComplete = false;
+}
+
+// Update sensors (fused pose, or read GPS and IMU)
+template <class DriveT>
+void LineFollowerT<DriveT>::updateSensors() {
+    if (_pose && _pose->isValid()) {
+        PoseEstimate p = _pose->getPose();
+        _currentPosition = p.position;
+        _currentHeading = p.heading;
+        _positionSigma = p.sigmaMM;
+        return;
+    }
+
+    if (_gps && _gps->hasFix()) {
+        _currentPosition = _gps->getPosition();
+    }
+
+    if (_imu && _imu->isInitialized()) {
+        _currentHeading = _imu->getHeading();
+    }
+}
+
+// Calculate bearing from one point to another (returns tenths of degrees)
+template <class DriveT>
+angle_t LineFollowerT<DriveT>::calculateBearing(const Point2D_int& from, const Point2D_int& to) {
+    distance_t dx = to.x - from.x;
+    distance_t dy = to.y - from.y;
+
+    // atan2 gives the mathematical angle (0° = East, 90° = North), the same
+    // convention as the IMU, odometry and PoseEKF headings
+    return normalizeAngle(atan2_int(dy, dx));
+}
+
+// Base speed for the current position uncertainty
+template <class DriveT>
+wheelSpeed LineFollowerT<DriveT>::speedForUncertainty() {
+    if (_positionSigma <= _slowSigmaMM) return _baseSpeed;
+    if (_positionSigma >= _stopSigmaMM) return 0;
+    return (wheelSpeed)((int32_t)_baseSpeed * _slowSigmaMM / _positionSigma);
+}
+
+// Calculate nearest point on line segment
+template <class DriveT>
+Point2D_int LineFollowerT<DriveT>::calculateNearestPointOnLine() {
+    // Vector from start to end of line
+    Point2D_int lineVector = _endPoint - _startPoint;
+
+    // Vector from start to current position
+    Point2D_int posVector = _currentPosition - _startPoint;
+
+    // Project position onto line (parametric t)
+    int64_t lineLengthSquared = lineVector.dot(lineVector);
+
+    if (lineLengthSquared < 100) {  // Line too short (< 10mm)
+        return _startPoint;
+    }
+
+    // t = (posVector · lineVector) / |lineVector|²
+    // Scale t by 1000 for precision
+    int32_t t_scaled = (int32_t)((posVector.dot(lineVector) * 1000) / lineLengthSquared);
+
+    // Clamp to line segment [0, 1000]
+    if (t_scaled < 0) t_scaled = 0;
+    if (t_scaled > 1000) t_scaled = 1000;
+
+    // Calculate nearest point
+    Point2D_int nearestPoint(
+        _startPoint.x + (lineVector.x * t_scaled / 1000),
+        _startPoint.y + (lineVector.y * t_scaled / 1000)
+    );
+
+    return nearestPoint;
+}
+
+// Calculate cross-track error (perpendicular distance from line in mm)
+template <class DriveT>
+distance_t LineFollowerT<DriveT>::calculateCrossTrackError() {
+    if (!_lineSet) return 0;
+
+    // Vector from start to end
+    Point2D_int lineVector = _endPoint - _startPoint;
+
+    // Vector from start to current position
+    Point2D_int posVector = _currentPosition - _startPoint;
+
+    // Cross-track error = (posVector × lineVector) / |lineVector|
+    int64_t crossProduct = posVector.cross(lineVector);
+    distance_t lineMagnitude = lineVector.magnitude();
+
+    if (lineMagnitude < 10) return 0;  // Avoid division by near-zero
+
+    // Return signed distance in mm
+    return (distance_t)(crossProduct / lineMagnitude);
+}
+
+// Calculate look-ahead point on the line
+template <class DriveT>
+Point2D_int LineFollowerT<DriveT>::calculateLookAheadPoint() {
+    // Get nearest point on line
+    Point2D_int nearestPoint = calculateNearestPointOnLine();
+
+    // Direction vector along line (normalized to magnitude 1000)
+    Point2D_int lineDirection = (_endPoint - _startPoint).normalized();
+
+    // Move ahead by lookahead distance
+    // lookahead point = nearest + direction * distance / 1000
+    Point2D_int lookAheadPoint(
+        nearestPoint.x + (lineDirection.x * _lookaheadDistance / 1000),
+        nearestPoint.y + (lineDirection.y * _lookaheadDistance / 1000)
+    );
+
+    // Don't go past the end point
+    distance_t distToEnd = lookAheadPoint.distanceTo(_endPoint);
+    distance_t nearestToEnd = nearestPoint.distanceTo(_endPoint);
+
+    if (distToEnd > nearestToEnd) {
+        // Lookahead would overshoot, aim for endpoint instead
+        lookAheadPoint = _endPoint;
+    }
+
+    return lookAheadPoint;
+}
+
+// Calculate heading error (tenths of degrees, signed)
+template <class DriveT>
+int16_t LineFollowerT<DriveT>::calculateHeadingError() {
+    if (!_lineSet) return 0;
+
+    // Calculate look-ahead point
+    Point2D_int lookAheadPoint = calculateLookAheadPoint();
+
+    // Desired heading is bearing to look-ahead point
+    angle_t desiredHeading = calculateBearing(_currentPosition, lookAheadPoint);
+
+    // Heading error (shortest angular distance)
+    int16_t headingError = angleDifference(desiredHeading, _currentHeading);
+
+    return headingError;
+}
+
+// Calculate distance to end point (mm)
+template <class DriveT>
+distance_t LineFollowerT<DriveT>::calculateDistanceToEnd() {
+    return _currentPosition.distanceTo(_endPoint);
+}
+
+// Task enable callback
+template <class DriveT>
+bool LineFollowerT<DriveT>::OnEnable() {
+    if (!_lineSet) {
+        return false;  // Can't enable without a line set
+    }
+
+    _lineComplete = false;
+    updateSensors();
+
+    return true;
+}
+
+// Task disable callback
+template <class DriveT>
+void LineFollowerT<DriveT>::OnDisable() {
+    // Stop the drive unit when disabled
+    if (_drive) {
+        _drive->setTargetSpeed(0, 0, 200);
+    }
+}
+
+// Main control loop callback - ALL INTEGER MATH!
+template <class DriveT>
+bool LineFollowerT<DriveT>::Callback() {
+    if (!_lineSet) {
+        return false;  // Stop task
+    }
+
+    // Update sensor readings
+    updateSensors();
+
+    // Check if we've reached the end
+    distance_t distanceToEnd = calculateDistanceToEnd();
+    if (distanceToEnd < _completionThreshold) {
+        _lineComplete = true;
+
+        // Stop motors
+        if (_drive) {
+            _drive->setTargetSpeed(0, 0, 200);
+        }
+
+        return false;  // Stop task - line complete
+    }
+
+    // Position lost: wait for GPS instead of steering on a guess
+    wheelSpeed baseSpeed = speedForUncertainty();
+    if (baseSpeed == 0) {
+        if (_drive) {
+            _drive->setTargetSpeed(0, 0, 200);
+        }
+        return true;
+    }
+
+    // Calculate errors
+    distance_t crossTrackError = calculateCrossTrackError();  // mm
+    int16_t headingError = calculateHeadingError();           // tenths of degrees
+
+    // Calculate steering correction (integer math only!)
+    // correction = (K_cte * CTE) + (K_heading * HE)
+    // K values are scaled by 1000, so divide result by 1000
+
+    // Cross-track contribution (K scaled by 1000, CTE in mm)
+    int32_t cteContribution = ((int32_t)_K_crossTrack * crossTrackError) / 1000;
+
+    // Heading contribution (K scaled by 1000, HE in tenths of degrees)
+    // Scale heading error to be comparable to distance
+    // Heading error of 100 tenths (10°) should produce similar effect as 100mm CTE
+    int32_t headingContribution = ((int32_t)_K_heading * headingError) / 1000;
+
+    // Total steering correction
+    int32_t steeringCorrection = cteContribution + headingContribution;
+
+    // Limit correction to ±50% of max speed
+    int32_t maxCorrection = MaxSpeed / 2;
+    if (steeringCorrection > maxCorrection) steeringCorrection = maxCorrection;
+    if (steeringCorrection < -maxCorrection) steeringCorrection = -maxCorrection;
+
+    // Apply to differential drive
+    wheelSpeed leftSpeed = baseSpeed - (wheelSpeed)steeringCorrection;
+    wheelSpeed rightSpeed = baseSpeed + (wheelSpeed)steeringCorrection;
+
+    // Clamp to valid range
+    if (leftSpeed > MaxSpeed) leftSpeed = MaxSpeed;
+    if (leftSpeed < -MaxSpeed) leftSpeed = -MaxSpeed;
+    if (rightSpeed > MaxSpeed) rightSpeed = MaxSpeed;
+    if (rightSpeed < -MaxSpeed) rightSpeed = -MaxSpeed;
+
+    // Send to drive unit
+    if (_drive) {
+        _drive->setTargetSpeed(leftSpeed, rightSpeed, getInterval());
+    }
+
+    return true;  // Continue task
+}
+
+typedef LineFollowerT<DriveUnit> LineFollower;
+
 #endif
@@ -0,0 +1,120 @@
+#ifndef MAGCALIBRATION_H
+#define MAGCALIBRATION_H
+
+#include "globals.hpp"
+
+// MagCalibration - online hard and soft iron calibration for a 3 axis magnetometer
+// INTEGER ONLY - raw sensor units in and out (AK09916: 0.15uT/LSB)
+//
+// Hard iron (magnets, steel near the sensor) shifts the field circle:
+//   offset = (max + min) / 2 per axis
+// Soft iron (and unequal axis gains) squashes it into an ellipse; the
+// axis-aligned part is undone by scaling every axis to the mean radius:
+//   scale = mean radius / (span / 2), Q8
+//
+// Extremes are tracked while driving, so every full turn refines the result.
+// Every DecayInterval samples they are pulled in by 1/2^DecayShift so that a
+// changed setup (battery swap, new payload) is picked up without a reset.
+// An axis only counts once its span is over MinSpan; X and Y are needed for a
+// heading, Z only matters when tilted and keeps its last values until then.
+class MagCalibration {
+public:
+   static constexpr int16_t MinSpan = 150;             // ~22uT, earth field horizontal is 20-50uT
+   static constexpr uint16_t DecayInterval = 1024;
+   static constexpr uint8_t DecayShift = 7;
+   static constexpr int16_t ScaleOne = 256;
+
+private:
+   int16_t _min[3];
+   int16_t _max[3];
+   int16_t _offset[3];
+   int16_t _scale[3];            // Q8
+   int16_t _radius;              // Mean corrected field strength (raw units)
+   uint16_t _samples;
+   bool _valid;
+
+   void recompute() {
+      int32_t sum = 0;
+      uint8_t axes = 0;
+      for (uint8_t i = 0; i < 3; i++) {
+         int16_t span = _max[i] - _min[i];
+         if (span < MinSpan) continue;
+         sum += span / 2;
+         axes++;
+      }
+      _valid = (_max[0] - _min[0] >= MinSpan) && (_max[1] - _min[1] >= MinSpan);
+      if (!_valid) return;
+
+      _radius = sum / axes;
+      for (uint8_t i = 0; i < 3; i++) {
+         int16_t span = _max[i] - _min[i];
+         if (span < MinSpan) continue;
+         _offset[i] = (int16_t)(((int32_t)_max[i] + _min[i]) / 2);
+         int32_t s = (int32_t)_radius * ScaleOne * 2 / span;
+         _scale[i] = (int16_t)constrain(s, ScaleOne / 2, ScaleOne * 2);
+      }
+   }
+
+public:
+   MagCalibration() { reset(); }
+
+   void reset() {
+      for (uint8_t i = 0; i < 3; i++) {
+         _min[i] = INT16_MAX;
+         _max[i] = INT16_MIN;
+         _offset[i] = 0;
+         _scale[i] = ScaleOne;
+      }
+      _radius = 0;
+      _samples = 0;
+      _valid = false;
+   }
+
+   // Feed one raw reading. Returns true if the calibration is usable.
+   bool add(const int16_t m[3]) {
+      bool changed = false;
+      for (uint8_t i = 0; i < 3; i++) {
+         if (m[i] < _min[i]) { _min[i] = m[i]; changed = true; }
+         if (m[i] > _max[i]) { _max[i] = m[i]; changed = true; }
+      }
+      if (++_samples >= DecayInterval) {
+         _samples = 0;
+         for (uint8_t i = 0; i < 3; i++) {
+            if (_max[i] - _min[i] < MinSpan) continue;
+            int16_t center = (int16_t)(((int32_t)_max[i] + _min[i]) / 2);
+            _min[i] += (center - _min[i]) >> DecayShift;
+            _max[i] -= (_max[i] - center) >> DecayShift;
+         }
+         changed = true;
+      }
+      if (changed) recompute();
+      return _valid;
+   }
+
+   // Corrected reading: (raw - offset) * scale
+   void apply(const int16_t in[3], int16_t out[3]) const {
+      for (uint8_t i = 0; i < 3; i++) {
+         out[i] = (int16_t)(((int32_t)(in[i] - _offset[i]) * _scale[i]) / ScaleOne);
+      }
+   }
+
+   // Restore a stored calibration (e.g. from EEPROM); online tracking refines it
+   void set(const int16_t offset[3], const int16_t scale[3], int16_t radius) {
+      for (uint8_t i = 0; i < 3; i++) {
+         _offset[i] = offset[i];
+         _scale[i] = scale[i];
+         _min[i] = offset[i] - (int16_t)((int32_t)radius * ScaleOne / scale[i]);
+         _max[i] = offset[i] + (int16_t)((int32_t)radius * ScaleOne / scale[i]);
+      }
+      _radius = radius;
+      _samples = 0;
+      _valid = true;
+   }
+
+   bool valid() const { return _valid; }
+   int16_t getOffset(uint8_t axis) const { return _offset[axis]; }
+   int16_t getScale(uint8_t axis) const { return _scale[axis]; }
+   int16_t getRadius() const { return _radius; }
+};
+
+#endif
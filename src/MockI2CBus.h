@@ -0,0 +1,112 @@
+#ifndef MOCK_I2CBUS_H
+#define MOCK_I2CBUS_H
+
+#include "I2CBus.h"
+#include "globals.hpp"
+
+/**
+ * MockI2CBus - I2CBus backend without hardware, for host tests and simulation
+ *
+ * - Each device is a 256 byte register file with auto-increment
+ * - Optional hooks per device model registers with side effects
+ *   (FIFO data port, clear-on-read status, reset bits)
+ * - streamReg: a data port register that doesn't auto-increment (FIFO_R_W)
+ * - Transfers complete on the next Callback() after latencyTicks more
+ *   ticks, so callers see the same asynchronous behaviour as on the TWI
+ * - Fault injection: failNext() makes the next transfers NACK
+ */
+class MockI2CBus : public I2CBus {
+public:
+  static constexpr uint8_t MaxDevices = 2;
+
+  // Hooks: return true if handled (read: value in *value)
+  typedef bool (*ReadHook)(uint8_t reg, uint8_t *value, void *context);
+  typedef bool (*WriteHook)(uint8_t reg, uint8_t value, void *context);
+
+  struct Device {
+    uint8_t address;
+    uint8_t regs[256];
+    ReadHook onRead;
+    WriteHook onWrite;
+    void *context;
+    int16_t streamReg;        // -1 = none
+  };
+
+  MockI2CBus(Scheduler* aS) : I2CBus(aS), _devices(0), _latencyTicks(0),
+                              _wait(0), _failCount(0), _transfers(0) {}
+
+  // Register a device; returns its register file (nullptr if full)
+  Device *addDevice(uint8_t address, ReadHook onRead = nullptr,
+                    WriteHook onWrite = nullptr, void *context = nullptr) {
+    if (_devices >= MaxDevices) return nullptr;
+    Device &d = _device[_devices++];
+    d.address = address;
+    memset(d.regs, 0, sizeof(d.regs));
+    d.onRead = onRead;
+    d.onWrite = onWrite;
+    d.context = context;
+    d.streamReg = -1;
+    return &d;
+  }
+
+  Device *device(uint8_t address) {
+    for (uint8_t i = 0; i < _devices; i++) {
+      if (_device[i].address == address) return &_device[i];
+    }
+    return nullptr;
+  }
+
+  // Extra scheduler ticks a transfer stays Busy (0 = completes on the next tick)
+  void setLatency(uint8_t ticks) { _latencyTicks = ticks; }
+  // The next count transfers end with Nack
+  void failNext(uint8_t count = 1) { _failCount = count; }
+  uint16_t getTransfers() const { return _transfers; }
+
+  bool Callback() override {
+    if (_active) {
+      if (_wait > 0) {
+        _wait--;
+      } else {
+        I2CStatus result = transfer(_active);
+        if (finish(result)) start(_active);
+      }
+    }
+    return I2CBus::Callback();
+  }
+
+protected:
+  void start(I2CTransaction *) override { _wait = _latencyTicks; }
+  void abort() override { _wait = 0; }
+
+private:
+  Device _device[MaxDevices];
+  uint8_t _devices;
+  uint8_t _latencyTicks;
+  uint8_t _wait;
+  uint8_t _failCount;
+  uint16_t _transfers;
+
+  I2CStatus transfer(I2CTransaction *t) {
+    _transfers++;
+    Device *d = device(t->address);
+    if (!d || _failCount > 0) {
+      if (_failCount > 0) _failCount--;
+      DEBUG_PRINT2("MockI2C: NACK ", t->address);
+      DEBUG_PRINT("\n");
+      return I2CStatus::Nack;
+    }
+
+    uint8_t reg = t->reg;
+    for (uint8_t i = 0; i < t->length; i++) {
+      if (t->read) {
+        if (!d->onRead || !d->onRead(reg, &t->data[i], d->context)) t->data[i] = d->regs[reg];
+      } else {
+        if (!d->onWrite || !d->onWrite(reg, t->data[i], d->context)) d->regs[reg] = t->data[i];
+      }
+      if (reg != d->streamReg) reg++;
+    }
+    return I2CStatus::Done;
+  }
+};
+
+#endif
@@ -0,0 +1,288 @@
+#ifndef MOVEPROGRAM_H
+#define MOVEPROGRAM_H
+
+#include "globals.hpp"
+
+// Compact flash-resident bytecode for motion patterns
+//
+// Patterns are written as a list of Steps and encoded at compile time into a
+// PROGMEM byte array (see MOVE_PATTERN in movePatterns.h), so they cost no SRAM.
+// AllMovements::Callback() interprets the bytes.
+//
+// Encoding (one opcode byte, then operands):
+//   END                          end of pattern / return from CALL
+//   SPEED  left:i8 right:i8 ms   ramp to speeds over ms, then wait ms
+//   HOLD   ms                    keep current speeds, wait ms
+//   LOOP   count:u8              repeat body up to matching NEXT count times
+//                                (nested MaxLoopDepth deep, CALLs included)
+//   NEXT                         end of LOOP body
+//   BRANCH sensor:u8 skip:u8     if sensor is active, skip the next `skip` bytes
+//                                (at most 255: a longer skip does not compile)
+//   CALL   pattern:u8            run another pattern (CurrentMotion), then return
+//   HALT                         end of a stop pattern: drop interrupted and
+//                                chained patterns, hold zero speed
+//
+// Speeds are quantized to SpeedQuantum (1% of MaxSpeed) so they fit a signed byte.
+// Durations (ms) are unsigned LEB128 varints: <128ms = 1 byte, <16384ms = 2 bytes.
+//
+// Besides raw speed steps, patterns can be described geometrically with
+// straight(), arc() and spiral(); these are compiled for the mower's wheelbase
+// into SPEED/HOLD sequences, so no geometry is computed at runtime.
+namespace MoveProgram {
+
+enum Opcode : uint8_t {
+   OP_END = 0,
+   OP_SPEED,
+   OP_HOLD,
+   OP_LOOP,
+   OP_NEXT,
+   OP_BRANCH,
+   OP_CALL,
+   OP_HALT
+};
+
+// Sensor ids tested by BRANCH (answered by AllMovements' sensor callback)
+enum PatternSensor : uint8_t {
+   SENSOR_OBSTACLE = 0,    // Sonar reports obstacle in range
+   SENSOR_BWF_LEFT,        // Boundary wire detected on the left
+   SENSOR_BWF_RIGHT,       // Boundary wire detected on the right
+   SENSOR_STUCK            // No progress despite drive command
+};
+
+constexpr wheelSpeed SpeedQuantum = MaxSpeed / 100;
+
+// Interpreter limits
+constexpr uint8_t MaxCallDepth = 2;
+constexpr uint8_t MaxLoopDepth = 2;
+constexpr uint8_t MaxOpsPerTick = 16;  // Bound on non-waiting ops per Callback
+
+// Source-level step, only used at compile time
+struct Step {
+   uint8_t op;
+   int16_t a;      // left speed / loop count / sensor / pattern / radius
+   int16_t b;      // right speed / steps to skip / angle / end radius
+   int16_t c;      // speed (geometric steps)
+   int16_t d;      // turns (spiral)
+   uint16_t ms;    // duration
+};
+
+// Geometric source steps - expanded into SPEED/HOLD by the encoder
+enum GeometricOp : uint8_t {
+   GEO_STRAIGHT = 0x80,
+   GEO_ARC,
+   GEO_SPIRAL
+};
+
+constexpr Step speed(wheelSpeed left, wheelSpeed right, uint16_t ms) { return Step{OP_SPEED, left, right, 0, 0, ms}; }
+constexpr Step hold(uint16_t ms)                                  { return Step{OP_HOLD, 0, 0, 0, 0, ms}; }
+constexpr Step loop(uint8_t count)                                { return Step{OP_LOOP, count, 0, 0, 0, 0}; }
+constexpr Step next()                                             { return Step{OP_NEXT, 0, 0, 0, 0, 0}; }
+// Skip the following `steps` steps when sensor is active
+constexpr Step branchIf(PatternSensor sensor, uint8_t steps)      { return Step{OP_BRANCH, sensor, steps, 0, 0, 0}; }
+constexpr Step call(uint8_t pattern)                              { return Step{OP_CALL, pattern, 0, 0, 0, 0}; }
+constexpr Step end()                                              { return Step{OP_END, 0, 0, 0, 0, 0}; }
+// Ends a stop pattern instead of end(): nothing resumes or chains after it
+constexpr Step halt()                                             { return Step{OP_HALT, 0, 0, 0, 0, 0}; }
+
+// Geometric steps, compiled for WheelBaseMM / MaxSpeedMMPerSec (globals.hpp)
+// Angles in tenths of degrees: positive = counter-clockwise (left), negative = clockwise.
+// speed is the speed of the mower centre; negative drives backwards.
+constexpr Step straight(int16_t mm, wheelSpeed speed)             { return Step{GEO_STRAIGHT, mm, 0, speed, 0, 0}; }
+// radius 0 = spot turn (speed is then the wheel speed)
+constexpr Step arc(int16_t radius_mm, angle_t angle, wheelSpeed speed) { return Step{GEO_ARC, radius_mm, angle, speed, 0, 0}; }
+// Archimedean spiral from r0 to r1 over `turns` full turns (negative = clockwise)
+constexpr Step spiral(int16_t r0_mm, int16_t r1_mm, int8_t turns, wheelSpeed speed) { return Step{GEO_SPIRAL, r0_mm, r1_mm, speed, turns, 0}; }
+
+// Ramp time at the start of each geometric segment (rest of the segment is HOLD)
+constexpr uint16_t GeoRampMs = 2 * WheelUpdateRate;
+// Spiral resolution: one constant-radius arc per 1/8 turn
+constexpr int16_t SpiralSegmentsPerTurn = 8;
+
+// Byte sink for the encoder; with out == nullptr it only counts
+struct Writer {
+   uint8_t* out;
+   size_t p;
+   constexpr void put(uint8_t b) { if (out) out[p] = b; p++; }
+};
+
+constexpr void emitVarint(Writer& w, uint16_t v) {
+   while (v >= 0x80) {
+      w.put((uint8_t)((v & 0x7F) | 0x80));
+      v >>= 7;
+   }
+   w.put((uint8_t)v);
+}
+
+constexpr int8_t quantize(int32_t speed) {
+   return (int8_t)(speed / SpeedQuantum);
+}
+
+// Ground speed (mm/s) of a quantized wheel speed
+constexpr int32_t groundSpeed(int8_t q) {
+   return (int32_t)q * SpeedQuantum * MaxSpeedMMPerSec / MaxSpeed;
+}
+
+// SPEED for the ramp, then HOLD(s) for the remaining time
+constexpr void emitSegment(Writer& w, int8_t left, int8_t right, uint32_t ms) {
+   uint16_t ramp = ms < GeoRampMs ? (uint16_t)ms : GeoRampMs;
+   w.put(OP_SPEED);
+   w.put((uint8_t)left);
+   w.put((uint8_t)right);
+   emitVarint(w, ramp);
+   ms -= ramp;
+   while (ms > 0) {
+      uint16_t chunk = ms > 60000 ? 60000 : (uint16_t)ms;
+      w.put(OP_HOLD);
+      emitVarint(w, chunk);
+      ms -= chunk;
+   }
+}
+
+constexpr void emitStraight(Writer& w, int32_t mm, int32_t speed) {
+   int8_t q = quantize(speed);
+   int32_t v = groundSpeed(q);
+   if (v < 0) v = -v;
+   if (mm < 0) mm = -mm;
+   uint32_t ms = v > 0 ? (uint32_t)((int64_t)mm * 1000 / v) : 0;
+   emitSegment(w, q, q, ms);
+}
+
+constexpr void emitArc(Writer& w, int32_t radius, int32_t angle, int32_t speed) {
+   int32_t half = WheelBaseMM / 2;
+   int32_t left = speed, right = speed;
+   if (radius <= 0) {
+      left = -speed;                                   // Spot turn
+   } else {
+      left = (int32_t)((int64_t)speed * (radius - half) / radius);
+      right = (int32_t)((int64_t)speed * (radius + half) / radius);
+      // Keep the outer wheel within MaxSpeed
+      int32_t outer = right < 0 ? -right : right;
+      if (outer > MaxSpeed) {
+         left = (int32_t)((int64_t)left * MaxSpeed / outer);
+         right = (int32_t)((int64_t)right * MaxSpeed / outer);
+      }
+   }
+   if (angle < 0) {                                    // Clockwise: swap wheels
+      int32_t t = left; left = right; right = t;
+      angle = -angle;
+   }
+   int8_t ql = quantize(left);
+   int8_t qr = quantize(right);
+   // Duration from the quantized yaw rate so the heading change is exact:
+   // angle(rad) = (vr - vl) / b * t   ->   t = angle(rad) * b / (vr - vl)
+   int32_t dv = groundSpeed(qr) - groundSpeed(ql);
+   if (dv < 0) dv = -dv;
+   // angle(rad) = angle_tenths * pi / 1800, pi ~ 355/113
+   uint32_t ms = dv > 0 ? (uint32_t)((int64_t)angle * 355 * WheelBaseMM * 1000 / ((int64_t)1800 * 113 * dv)) : 0;
+   emitSegment(w, ql, qr, ms);
+}
+
+constexpr void emitSpiral(Writer& w, int32_t r0, int32_t r1, int32_t turns, int32_t speed) {
+   int32_t dir = turns < 0 ? -1 : 1;
+   int32_t segments = (turns < 0 ? -turns : turns) * SpiralSegmentsPerTurn;
+   for (int32_t i = 0; i < segments; i++) {
+      // Radius at the middle of the segment
+      int32_t r = r0 + (int32_t)((int64_t)(r1 - r0) * (2 * i + 1) / (2 * segments));
+      emitArc(w, r, dir * (ANGLE_360 / SpiralSegmentsPerTurn), speed);
+   }
+}
+
+constexpr void emitStep(Writer& w, const Step& s, size_t branchSkip) {
+   switch (s.op) {
+      case OP_SPEED:
+         w.put(OP_SPEED);
+         w.put((uint8_t)quantize(s.a));
+         w.put((uint8_t)quantize(s.b));
+         emitVarint(w, s.ms);
+         break;
+      case OP_HOLD:
+         w.put(OP_HOLD);
+         emitVarint(w, s.ms);
+         break;
+      case OP_LOOP:
+      case OP_CALL:
+         w.put(s.op);
+         w.put((uint8_t)s.a);
+         break;
+      case OP_BRANCH:
+         w.put(OP_BRANCH);
+         w.put((uint8_t)s.a);
+         w.put((uint8_t)branchSkip);
+         break;
+      case GEO_STRAIGHT: emitStraight(w, s.a, s.c); break;
+      case GEO_ARC:      emitArc(w, s.a, s.b, s.c); break;
+      case GEO_SPIRAL:   emitSpiral(w, s.a, s.b, s.d, s.c); break;
+      default:
+         w.put(s.op);
+         break;
+   }
+}
+
+constexpr size_t stepSize(const Step& s) {
+   Writer w{nullptr, 0};
+   emitStep(w, s, 0);
+   return w.p;
+}
+
+template <size_t NSteps>
+constexpr size_t encodedSize(const Step (&steps)[NSteps]) {
+   size_t n = 0;
+   for (size_t i = 0; i < NSteps; i++) n += stepSize(steps[i]);
+   return n;
+}
+
+// Not constexpr: reaching one of these while a MOVE_PATTERN is encoded stops
+// the compile, and the error names the problem
+inline void branchSkipsMoreThan255Bytes() {}
+inline void loopsNestedDeeperThanMaxLoopDepth() {}
+inline void nextWithoutLoop() {}
+
+// Encoded pattern as stored in flash
+template <size_t N>
+struct Code {
+   uint8_t bytes[N];
+};
+
+template <size_t NBytes, size_t NSteps>
+constexpr Code<NBytes> encode(const Step (&steps)[NSteps]) {
+   Code<NBytes> code{};
+   Writer w{code.bytes, 0};
+   uint8_t loopDepth = 0;
+   for (size_t i = 0; i < NSteps; i++) {
+      size_t skip = 0;
+      if (steps[i].op == OP_BRANCH) {
+         for (size_t k = 1; k <= (size_t)steps[i].b && i + k < NSteps; k++) skip += stepSize(steps[i + k]);
+         if (skip > 255) branchSkipsMoreThan255Bytes();
+      } else if (steps[i].op == OP_LOOP) {
+         if (++loopDepth > MaxLoopDepth) loopsNestedDeeperThanMaxLoopDepth();
+      } else if (steps[i].op == OP_NEXT) {
+         if (loopDepth-- == 0) nextWithoutLoop();
+      }
+      emitStep(w, steps[i], skip);
+   }
+   return code;
+}
+
+// Decode a varint duration from flash and advance pc
+inline uint16_t readVarint(const uint8_t*& pc) {
+   uint16_t v = 0;
+   uint8_t shift = 0;
+   uint8_t b;
+   do {
+      b = pgm_read_byte(pc++);
+      v |= (uint16_t)(b & 0x7F) << shift;
+      shift += 7;
+   } while ((b & 0x80) && shift < 16);
+   return v;
+}
+
+} // namespace MoveProgram
+
+// Define a flash-resident pattern from a list of MoveProgram steps.
+// The step list is a compile-time constant only; just the encoded bytes are emitted.
+#define MOVE_PATTERN(name, ...) \
+   static constexpr MoveProgram::Step name##_steps[] = { __VA_ARGS__ }; \
+   static constexpr MoveProgram::Code<MoveProgram::encodedSize(name##_steps)> name PROGMEM = \
+      MoveProgram::encode<MoveProgram::encodedSize(name##_steps)>(name##_steps);
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef MOWCHECKPOINT_H
+#define MOWCHECKPOINT_H
+
+#include "globals.hpp"
+#include "Arduino.h"
+#include <EEPROM.h>
+#include "Crc16.h"
+#if defined(__AVR__)
+#include <avr/eeprom.h>
+#endif
+
+// Progress of a mowing job, 16 bytes as stored
+struct MowCheckpoint {
+   uint8_t magic;               // MowCheckpoint::Magic (record layout version)
+   uint8_t state;               // ParallelStripeMower state
+   uint16_t sequence;           // +1 per record, the newest valid one counts
+   uint16_t jobId;              // Perimeter and pattern parameters
+   int16_t stripe;              // Stripe being mowed
+   uint8_t lap;                 // Perimeter lap being mowed
+   uint8_t flags;               // MovingRight
+   uint8_t reserved[4];
+   uint16_t crc;                // CRC-16 of the bytes before
+
+   static constexpr uint8_t Magic = 0xA1;
+   static constexpr uint8_t MovingRight = 0x01;
+};
+static_assert(sizeof(MowCheckpoint) == 16, "MowCheckpoint is stored as 16 bytes");
+
+// Byte storage for the checkpoint log. write() may start a write that takes
+// a while (AVR EEPROM: 3.4ms per byte); the log only writes when ready().
+class CheckpointStore {
+public:
+   virtual ~CheckpointStore() {}
+
+   virtual uint16_t size() const = 0;
+   virtual uint8_t read(uint16_t address) = 0;
+   virtual void write(uint16_t address, uint8_t value) = 0;
+   virtual bool ready() { return true; }
+   virtual void commit() {}                 // After the last byte of a record
+};
+
+// Part of the internal EEPROM (Uno: 1KB, 100000 write cycles per byte)
+class EepromCheckpointStore : public CheckpointStore {
+private:
+   uint16_t _base;
+   uint16_t _size;
+
+public:
+   EepromCheckpointStore(uint16_t base = 0, uint16_t size = 256) : _base(base), _size(size) {}
+
+   uint16_t size() const override { return _size; }
+   uint8_t read(uint16_t address) override { return EEPROM.read(_base + address); }
+   void write(uint16_t address, uint8_t value) override { EEPROM.update(_base + address, value); }
+
+#if defined(__AVR__)
+   bool ready() override { return eeprom_is_ready(); }
+#endif
+#if defined(ESP32) || defined(ESP8266)
+   void commit() override { EEPROM.commit(); }
+#endif
+};
+
+// MowCheckpointLog - wear levelled, CRC checked checkpoint records
+//
+// The store is a ring of 16 byte slots. Each save() goes to the slot after the
+// newest one, so every slot is written once per (slots) saves: 16 slots in
+// 256 bytes take ~1.6 million checkpoints before the EEPROM wears out.
+// begin() finds the newest record by sequence number among the slots whose
+// CRC checks out. A write cut short by a power loss fails its CRC, and the
+// record before it is used.
+//
+// Writing does not block: save() stages the record and poll() writes one byte
+// whenever the store is ready. EEPROM update() skips bytes that did not change.
+class MowCheckpointLog {
+public:
+   static constexpr uint8_t RecordSize = sizeof(MowCheckpoint);
+   static constexpr int16_t None = -1;
+
+private:
+   CheckpointStore *_store;
+   uint8_t _slots;
+   int16_t _newest;             // Slot of the newest valid record
+   uint16_t _sequence;
+   MowCheckpoint _pending;
+   int16_t _pendingSlot;        // None when idle
+   uint8_t _pendingByte;
+   uint32_t _saves;
+
+   bool readSlot(uint8_t slot, MowCheckpoint &record) {
+      uint8_t *p = (uint8_t *)&record;
+      uint16_t address = (uint16_t)slot * RecordSize;
+      for (uint8_t i = 0; i < RecordSize; i++) p[i] = _store->read(address + i);
+      return record.magic == MowCheckpoint::Magic &&
+             record.crc == crc16(&record, RecordSize - sizeof(record.crc));
+   }
+
+public:
+   MowCheckpointLog(CheckpointStore *store)
+      : _store(store), _slots(0), _newest(None), _sequence(0), _pending(),
+        _pendingSlot(None), _pendingByte(0), _saves(0) {}
+
+   // Find the newest record. False if the store has none.
+   bool begin() {
+      uint16_t slots = _store->size() / RecordSize;
+      _slots = slots > 255 ? 255 : slots;
+      _newest = None;
+      _pendingSlot = None;
+
+      MowCheckpoint record;
+      for (uint8_t slot = 0; slot < _slots; slot++) {
+         if (!readSlot(slot, record)) continue;
+         if (_newest == None || (int16_t)(record.sequence - _sequence) > 0) {
+            _newest = slot;
+            _sequence = record.sequence;
+         }
+      }
+      return _newest != None;
+   }
+
+   // Newest record (the staged one if it is not written yet)
+   bool load(MowCheckpoint &record) {
+      if (_pendingSlot != None) {
+         record = _pending;
+         return true;
+      }
+      if (_newest == None) return false;
+      return readSlot(_newest, record);
+   }
+
+   // Stage a record; poll() writes it. A record still being written is
+   // replaced (same slot, it was not valid yet anyway).
+   void save(const MowCheckpoint &record) {
+      if (_slots == 0) return;
+      _pending = record;
+      _pending.magic = MowCheckpoint::Magic;
+      _pending.sequence = ++_sequence;
+      _pending.crc = crc16(&_pending, RecordSize - sizeof(_pending.crc));
+      if (_pendingSlot == None) _pendingSlot = (_newest + 1) % _slots;
+      _pendingByte = 0;
+      _saves++;
+   }
+
+   // Call every loop pass; writes at most one byte
+   void poll() {
+      if (_pendingSlot == None || !_store->ready()) return;
+
+      const uint8_t *p = (const uint8_t *)&_pending;
+      _store->write((uint16_t)_pendingSlot * RecordSize + _pendingByte, p[_pendingByte]);
+      if (++_pendingByte < RecordSize) return;
+
+      _store->commit();
+      _newest = _pendingSlot;
+      _pendingSlot = None;
+   }
+
+   // Write everything staged now (e.g. when the battery is low)
+   void flush() {
+      while (_pendingSlot != None) poll();
+   }
+
+   bool isWriting() const { return _pendingSlot != None; }
+   uint8_t getSlots() const { return _slots; }
+   int16_t getNewestSlot() const { return _newest; }
+   uint32_t getSaves() const { return _saves; }
+};
+
+#endif
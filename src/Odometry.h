@@ -0,0 +1,169 @@
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include "globals.hpp"
+#include "Arduino.h"
+#include "WheelEncoder.h"
+#include "MowerTypes.h"
+#include "IntegerMathDefault.h"
+#include <TaskSchedulerDeclarations.h>
+
+// Odometry - differential-drive dead reckoning from two WheelEncoders
+// INTEGER ONLY - position in micrometres internally, mm externally
+//
+// Runs as a Task (default 10ms = 100Hz). Each tick:
+//   dL, dR   = encoder tick deltas * um per tick
+//   dTheta   = (dR - dL) / wheelBase
+//   x += d * cos(theta + dTheta/2),  y += d * sin(theta + dTheta/2)   (midpoint rule)
+// Heading keeps 1/256 of a tenth degree so slow turns don't round away.
+// Coordinate convention as in the rest of the code: heading 0 = +x, CCW positive.
+//
+// Per-wheel velocity is measured edge to edge (ticks between the last counted
+// edges / time between them), which stays accurate at crawl speeds where a
+// 10ms tick count would be 0 or 1. With no new edge the estimate decays as
+// 1 tick / time-since-last-edge and drops to 0 after StopTimeoutUs.
+class Odometry : public Task {
+public:
+   struct WheelState {
+      uint16_t lastTicks;
+      uint32_t lastEdgeUs;
+      int16_t velocity;            // mm/s, positive forward
+   };
+
+private:
+   static constexpr int32_t HeadingScale = 256;               // Q8 tenths of a degree
+   static constexpr int32_t FullTurnQ = (int32_t)ANGLE_360 * HeadingScale;
+   static constexpr uint32_t StopTimeoutUs = 250000;
+
+   WheelEncoder *_left;
+   WheelEncoder *_right;
+   uint16_t _umPerTick;
+   int16_t _wheelBaseMM;
+
+   int32_t _xUm;
+   int32_t _yUm;
+   int32_t _headingQ;              // 0 .. FullTurnQ-1
+   int32_t _travelledMM;
+   int32_t _travelRemUm;
+   uint32_t _pathUm;               // Signed path, wraps: take differences
+
+   WheelState _l;
+   WheelState _r;
+
+   // Distance (um) since the last call and velocity update for one wheel
+   int32_t advance(WheelEncoder *enc, WheelState &w, uint32_t nowUs) {
+      EncoderSnapshot s = enc->snapshot();
+      int16_t dTicks = (int16_t)(s.ticks - w.lastTicks);
+      int32_t dUm = (int32_t)dTicks * _umPerTick;
+
+      if (dTicks != 0) {
+         uint32_t dtUs = s.lastEdgeUs - w.lastEdgeUs;
+         if (w.lastEdgeUs != 0 && dtUs > 0 && dtUs < StopTimeoutUs) {
+            w.velocity = (int16_t)(dUm * 1000 / (int32_t)dtUs);
+         }
+         w.lastTicks = s.ticks;
+         w.lastEdgeUs = s.lastEdgeUs;
+      } else {
+         uint32_t since = nowUs - w.lastEdgeUs;
+         if (since > StopTimeoutUs) {
+            w.velocity = 0;
+         } else if (since > 0) {
+            // Can't be faster than one tick per time since the last edge
+            int32_t bound = (int32_t)((uint32_t)_umPerTick * 1000 / since);
+            if (w.velocity > bound) w.velocity = bound;
+            if (w.velocity < -bound) w.velocity = -bound;
+         }
+      }
+      return dUm;
+   }
+
+public:
+   // ticksPerRev: counted edges per wheel revolution (x2 decoding = 2 * encoder lines)
+   Odometry(Scheduler* aS, WheelEncoder *left, WheelEncoder *right,
+            uint16_t ticksPerRev, uint16_t wheelDiameterMM, unsigned int mSec = 10)
+      : Task(mSec, TASK_FOREVER, aS, false),
+        _left(left), _right(right), _wheelBaseMM(WheelBaseMM)
+   {
+      // circumference (um) / ticks, pi ~ 355/113
+      _umPerTick = (uint16_t)((uint32_t)wheelDiameterMM * 355000UL / 113 / ticksPerRev);
+      reset();
+   };
+
+   void reset() {
+      _xUm = 0;
+      _yUm = 0;
+      _headingQ = 0;
+      _travelledMM = 0;
+      _travelRemUm = 0;
+      _pathUm = 0;
+      resync();
+   }
+
+   // Take the current encoder counts as baseline (keeps the pose)
+   void resync() {
+      _l = WheelState{_left->snapshot().ticks, 0, 0};
+      _r = WheelState{_right->snapshot().ticks, 0, 0};
+   }
+
+   void setWheelBaseMM(int16_t mm) { _wheelBaseMM = mm; }
+
+   // Override the pose, e.g. from a GPS fix or a fused estimate
+   void setPose(distance_t xMM, distance_t yMM, angle_t heading) {
+      _xUm = xMM * 1000;
+      _yUm = yMM * 1000;
+      _headingQ = (int32_t)normalizeAngle(heading) * HeadingScale;
+   }
+
+   bool OnEnable() override {
+      resync();
+      return true;
+   }
+
+   bool Callback() override {
+      uint32_t nowUs = micros();
+      int32_t dL = advance(_left, _l, nowUs);
+      int32_t dR = advance(_right, _r, nowUs);
+      if (dL == 0 && dR == 0) return false;
+
+      // dTheta in Q8 tenths of a degree: (dR - dL)um / base mm = mrad; 1 mrad = 0.5730 tenths
+      // 1800 * 256 / (1000 * pi) = 146.68
+      int32_t dThetaQ = (dR - dL) * 14668 / ((int32_t)_wheelBaseMM * 100);
+
+      angle_t mid = (angle_t)(((_headingQ + dThetaQ / 2 + FullTurnQ) % FullTurnQ) / HeadingScale);
+      int32_t d = (dL + dR) / 2;
+      _xUm += d * cos_lookup(mid) / 1000;
+      _yUm += d * sin_lookup(mid) / 1000;
+
+      _headingQ = (_headingQ + dThetaQ) % FullTurnQ;
+      if (_headingQ < 0) _headingQ += FullTurnQ;
+
+      _pathUm += (uint32_t)d;
+      _travelRemUm += d < 0 ? -d : d;
+      _travelledMM += _travelRemUm / 1000;
+      _travelRemUm %= 1000;
+      return true;
+   }
+
+   // Pose
+   Point2D_int getPositionMM() const { return Point2D_int(_xUm / 1000, _yUm / 1000); }
+   angle_t getHeading() const { return (angle_t)(_headingQ / HeadingScale); }
+
+   // Velocities (mm/s)
+   int16_t getLeftVelocity() const { return _l.velocity; }
+   int16_t getRightVelocity() const { return _r.velocity; }
+   int16_t getLinearVelocity() const { return (int16_t)(((int32_t)_l.velocity + _r.velocity) / 2); }
+   // Yaw rate in tenths of a degree per second
+   int16_t getYawRate() const {
+      return (int16_t)(((int32_t)_r.velocity - _l.velocity) * 573 / _wheelBaseMM);
+   }
+
+   // Total path length (mm), for stall/stuck detection
+   int32_t getTravelledMM() const { return _travelledMM; }
+   // Signed distance along the path (um, backwards negative), wrapping every
+   // 4295m: (int32_t)(now - before) is the distance driven in between
+   uint32_t getPathUm() const { return _pathUm; }
+
+   uint16_t getUmPerTick() const { return _umPerTick; }
+};
+
+#endif
@@ -9,10 +9,24 @@
 #include "IntegerMathDefault.h"
 #include "PerimeterStorage.h"
 #include "PerimeterOffset.h"
+#include "CoverageMap.h"
+#include "CoverageCleanup.h"
+#include "MowCheckpoint.h"
+#include "TransitPlanner.h"
+#include "PoseEKF.h"
 
 // Maximum waypoints for turns
 #define MAX_ARC_WAYPOINTS 16
 
+// Maximum pieces of one stripe or cleanup fragment between exclusion zones;
+// pieces past it are left to the cleanup
+#ifndef MAX_STRIPE_PIECES
+#define MAX_STRIPE_PIECES 4
+#endif
+
+// Transit planner grid cell
+#define TRANSIT_CELL_MM 500
+
 // Parallel stripe mowing pattern with teardrop turns
 // Uses existing LineFollower for straight lines and arc segments
 class ParallelStripeMower {
@@ -38,6 +52,11 @@ private:
     bool _movingRight;             // Direction of current stripe
     int _totalStripes;
 
+    // Pieces of the current stripe or cleanup fragment on the lawn (start, end pairs)
+    Point2D_int _pieces[2 * MAX_STRIPE_PIECES];
+    int _pieceCount;
+    int _piece;
+
     // Mowing area bounds (calculated from perimeter)
     int32_t _minX, _maxX;          // Bounding box in mm
     int32_t _minY, _maxY;
@@ -48,11 +67,31 @@ private:
         PERIMETER_LAPS,
         MOWING_STRIPE,
         EXECUTING_TURN,
-        COMPLETE
+        CLEANUP,                   // Stripes done, mowing the gaps the coverage map shows
+        COMPLETE,
+        RETURNING                  // Driving to the dock (returnTo()), then IDLE
     };
     MowingState _state;
     int _currentLap;
 
+    // Mowed-area record (optional)
+    CoverageMap* _coverage;
+    PoseEKF* _pose;
+    CoverageCleanup _cleanup;
+    bool _cleanupFollowing;
+
+    // Progress record for resuming after a power loss (optional)
+    MowCheckpointLog* _checkpoint;
+    uint16_t _perimeterSignature;
+
+    // Routes around exclusion zones (optional)
+    TransitPlanner* _planner;
+    bool _transiting;              // Following transit legs, not mowing lines
+    bool _transitPlanning;         // Planner still searching
+    uint8_t _transitLeg;
+    Point2D_int _transitFrom;
+    Point2D_int _transitTo;
+
 public:
     ParallelStripeMower(GPSInterface* gps, IMUInterface* imu, LineFollower* lineFollower)
         : _gps(gps), _imu(imu), _lineFollower(lineFollower),
@@ -60,8 +99,12 @@ public:
           _perimeterLaps(3),
           _perimeterOffset(&_perimeter),
           _currentStripe(0), _movingRight(true), _totalStripes(0),
+          _pieceCount(0), _piece(0),
           _minX(0), _maxX(0), _minY(0), _maxY(0),
-          _state(IDLE), _currentLap(0) {
+          _state(IDLE), _currentLap(0),
+          _coverage(nullptr), _pose(nullptr), _cleanupFollowing(false),
+          _checkpoint(nullptr), _perimeterSignature(0),
+          _planner(nullptr), _transiting(false), _transitPlanning(false), _transitLeg(0) {
     }
 
     // Set mowing blade width (in mm)
@@ -93,6 +136,9 @@ public:
 
         calculateBoundingBox();
         calculateTotalStripes();
+        beginCoverage();
+        beginTransit();
+        _perimeterSignature = _perimeter.getSignature();
 
         _perimeter.printStats();
         DEBUG_PRINT("Calculated ");
@@ -100,6 +146,110 @@ public:
         DEBUG_PRINTLN(" stripes");
     }
 
+    // Record the mowed area from the fused pose while mowing
+    void setCoverageMap(CoverageMap* coverage, PoseEKF* pose) {
+        _coverage = coverage;
+        _pose = pose;
+        _cleanup.setMap(coverage);
+        beginCoverage();
+    }
+
+    // Mowed share of the area inside the perimeter (0..100), 0 without a map
+    uint8_t getCoveragePercent() const {
+        if (_coverage == nullptr) return 0;
+        return _coverage->coveragePercent(_perimeter);
+    }
+
+    // Drive around exclusion zones between stripe pieces and cleanup
+    // fragments, and to the dock. Without one the mower drives straight.
+    void setTransitPlanner(TransitPlanner* planner) {
+        _planner = planner;
+        beginTransit();
+    }
+
+    // Save progress at every lap and stripe start (log.begin() called before)
+    void setCheckpointLog(MowCheckpointLog* log) {
+        _checkpoint = log;
+    }
+
+    // Continue an interrupted job from the last checkpoint: the recorded lap
+    // or stripe is mowed again from its start. Call after setPerimeter(),
+    // the pattern setters and setCoverageMap(). False if the checkpoint is
+    // missing, finished or for another perimeter/pattern.
+    bool resumeMowing() {
+        MowCheckpoint cp;
+        if (_checkpoint == nullptr || !_checkpoint->load(cp)) return false;
+        if (_perimeter.getCount() < 3 || cp.jobId != jobId()) {
+            DEBUG_PRINTLN("Checkpoint is for another job");
+            return false;
+        }
+
+        _transiting = false;
+        switch (cp.state) {
+            case PERIMETER_LAPS:
+                _currentLap = cp.lap;
+                _currentStripe = 0;
+                _movingRight = true;
+                markDoneCoverage(_currentLap, 0);
+                _state = PERIMETER_LAPS;
+                startPerimeterLap();
+                break;
+
+            case MOWING_STRIPE:
+                if (cp.stripe < 0 || cp.stripe >= _totalStripes) return false;
+                _currentLap = _perimeterLaps;
+                _currentStripe = cp.stripe;
+                _movingRight = (cp.flags & MowCheckpoint::MovingRight) != 0;
+                markDoneCoverage(_perimeterLaps, _currentStripe);
+                _state = MOWING_STRIPE;
+                startNextStripe();
+                break;
+
+            case CLEANUP:
+                // The coverage map did not survive; what the plan mowed is rebuilt
+                _currentLap = _perimeterLaps;
+                _currentStripe = _totalStripes - 1;
+                markDoneCoverage(_perimeterLaps, _totalStripes);
+                startCleanup();
+                break;
+
+            default:
+                return false;
+        }
+
+        DEBUG_PRINT("Resuming: state ");
+        DEBUG_PRINT(cp.state);
+        DEBUG_PRINT(", lap ");
+        DEBUG_PRINT(cp.lap);
+        DEBUG_PRINT(", stripe ");
+        DEBUG_PRINTLN(cp.stripe);
+        return true;
+    }
+
+    // Add an area inside the perimeter not to mow (flower bed, tree, pond).
+    // Call after setPerimeter(); stripes are split around it.
+    bool addExclusionZone(const Point2D_int* waypoints, int count) {
+        if (!_perimeter.addExclusionZone(waypoints, count)) {
+            DEBUG_PRINTLN("Error: Failed to add exclusion zone");
+            return false;
+        }
+        beginCoverage();
+        beginTransit();
+        _perimeterSignature = _perimeter.getSignature();
+        return true;
+    }
+
+    // Stop mowing and drive to the dock around the exclusion zones; IDLE on
+    // arrival. The checkpoint keeps the stripe being mowed, so resumeMowing()
+    // carries on after charging.
+    void returnTo(const Point2D_int& dock) {
+        DEBUG_PRINTLN("Returning to dock");
+        _lineFollower->disable();
+        _cleanupFollowing = false;
+        _state = RETURNING;
+        startTransit(dock);
+    }
+
     // Get perimeter storage (for direct access)
     PerimeterStorage* getPerimeterStorage() {
         return &_perimeter;
@@ -113,6 +263,7 @@ public:
         }
 
         _state = PERIMETER_LAPS;
+        _transiting = false;
         _currentLap = 0;
         _currentStripe = 0;
         _movingRight = true;
@@ -127,6 +278,9 @@ public:
 
     // Update state machine (call frequently from main loop)
     void update() {
+        trackCoverage();
+        if (_checkpoint != nullptr) _checkpoint->poll();
+
         switch (_state) {
             case PERIMETER_LAPS:
                 // Check if current lap is complete
@@ -147,14 +301,21 @@ public:
                 break;
 
             case MOWING_STRIPE:
-                // Check if stripe is complete
-                if (_lineFollower->isComplete()) {
+                if (_transiting) {
+                    if (updateTransit()) startStripePiece();
+                    break;
+                }
+
+                // Check if stripe is complete (a stripe off the lawn is skipped)
+                if (_pieceCount == 0 || _lineFollower->isComplete()) {
                     _lineFollower->disable();
 
-                    if (_currentStripe >= _totalStripes - 1) {
-                        // All stripes complete!
-                        _state = COMPLETE;
-                        DEBUG_PRINTLN("Mowing complete!");
+                    if (++_piece < _pieceCount) {
+                        // Next piece past an exclusion zone, around it
+                        startTransit(_pieces[2 * _piece]);
+                    } else if (_currentStripe >= _totalStripes - 1) {
+                        // All stripes complete - mow what they missed
+                        startCleanup();
                     } else {
                         // Execute turn to next stripe
                         _state = EXECUTING_TURN;
@@ -175,6 +336,61 @@ public:
                 }
                 break;
 
+            case CLEANUP:
+                // One planning step or one fragment piece per pass
+                if (_transiting) {
+                    if (!updateTransit()) break;
+                    _lineFollower->setLine(_pieces[2 * _piece], _pieces[2 * _piece + 1]);
+                    _lineFollower->enable();
+                    _cleanupFollowing = true;
+                    break;
+                }
+                if (_cleanupFollowing) {
+                    if (!_lineFollower->isComplete()) break;
+                    _lineFollower->disable();
+                    _cleanupFollowing = false;
+                    if (++_piece < _pieceCount) {
+                        // Next piece past an exclusion zone, around it
+                        startTransit(_pieces[2 * _piece]);
+                        break;
+                    }
+                }
+                {
+                    Point2D_int start, end;
+                    if (_cleanup.takeFragment(start, end)) {
+                        DEBUG_PRINT("Cleanup stripe (");
+                        DEBUG_PRINT(start.x);
+                        DEBUG_PRINT(",");
+                        DEBUG_PRINT(start.y);
+                        DEBUG_PRINT(") -> (");
+                        DEBUG_PRINT(end.x);
+                        DEBUG_PRINT(",");
+                        DEBUG_PRINT(end.y);
+                        DEBUG_PRINTLN(")");
+                        clipCleanupFragment(start, end);
+                        if (_pieceCount == 0) {
+                            DEBUG_PRINTLN("Cleanup stripe is not on the lawn");
+                            break;
+                        }
+                        startTransit(_pieces[0]);
+                    } else if (!_cleanup.step()) {
+                        _state = COMPLETE;
+                        saveCheckpoint();
+                        DEBUG_PRINT("Mowing complete! Coverage ");
+                        DEBUG_PRINT(getCoveragePercent());
+                        DEBUG_PRINTLN("%");
+                    }
+                }
+                break;
+
+            case RETURNING:
+                if (updateTransit()) {
+                    _lineFollower->disable();
+                    _state = IDLE;
+                    DEBUG_PRINTLN("At the dock");
+                }
+                break;
+
             case COMPLETE:
             case IDLE:
             default:
@@ -194,6 +410,142 @@ public:
     }
 
 private:
+    void beginCoverage() {
+        if (_coverage == nullptr || _perimeter.getCount() < 3) return;
+        _coverage->setBladeWidth(_stripeWidth_mm);
+        if (!_coverage->begin(_perimeter)) {
+            DEBUG_PRINTLN("Error: Coverage map does not fit its store");
+            return;
+        }
+        _coverage->excludeOutside(_perimeter);      // Never a gap to clean up
+    }
+
+    void beginTransit() {
+        _transiting = false;
+        if (_planner == nullptr || _perimeter.getCount() < 3) return;
+        if (!_planner->begin(_perimeter, TRANSIT_CELL_MM, _stripeWidth_mm / 2)) {
+            DEBUG_PRINTLN("Error: Transit grid does not fit its workspace");
+        }
+    }
+
+    // Plan a drive from here to 'to'; updateTransit() follows it
+    void startTransit(const Point2D_int& to) {
+        _transitFrom = _gps->getPosition();
+        if (_pose != nullptr && _pose->isValid()) _transitFrom = _pose->getPose().position;
+        _transitTo = to;
+        _transitLeg = 0;
+        _transiting = true;
+        _transitPlanning = _planner != nullptr && _planner->isValid() &&
+                           _planner->plan(_transitFrom, to) == TransitPlanner::SEARCHING;
+    }
+
+    // One planner step or one leg per pass; true once there. A straight path
+    // (or none found) is one leg, left to the next line's approach unless
+    // returning to the dock.
+    bool updateTransit() {
+        if (_transitPlanning) {
+            if (_planner->step() == TransitPlanner::SEARCHING) return false;
+            _transitPlanning = false;
+        }
+        if (_transitLeg > 0) {
+            if (!_lineFollower->isComplete()) return false;
+            _lineFollower->disable();
+        }
+
+        bool found = _planner != nullptr && _planner->getStatus() == TransitPlanner::FOUND;
+        if (_transitLeg == 0 && _planner != nullptr && _planner->isValid() && !found) {
+            DEBUG_PRINTLN("No transit path - driving straight");
+        }
+        uint8_t points = found ? _planner->getPathCount() : 2;
+        uint8_t legs = _state == RETURNING ? points - 1 : points - 2;
+        if (_transitLeg >= legs) {
+            _transiting = false;
+            return true;
+        }
+
+        Point2D_int a = found ? _planner->getPathPoint(_transitLeg) : _transitFrom;
+        Point2D_int b = found ? _planner->getPathPoint(_transitLeg + 1) : _transitTo;
+        _lineFollower->setLine(a, b);
+        _lineFollower->enable();
+        _transitLeg++;
+        return false;
+    }
+
+    void startCleanup() {
+        if (_coverage == nullptr || !_coverage->isValid()) {
+            _state = COMPLETE;
+            saveCheckpoint();
+            DEBUG_PRINTLN("Mowing complete!");
+            return;
+        }
+
+        Point2D_int position = _gps->getPosition();
+        if (_pose != nullptr && _pose->isValid()) position = _pose->getPose().position;
+
+        DEBUG_PRINTLN("Stripes complete - cleaning up gaps");
+        _cleanup.begin(position, _stripeWidth_mm);
+        _cleanupFollowing = false;
+        _transiting = false;
+        _state = CLEANUP;
+        saveCheckpoint();
+    }
+
+    // Perimeter and pattern parameters; a checkpoint only resumes the same job
+    uint16_t jobId() const {
+        int16_t params[4] = {(int16_t)_stripeWidth_mm, (int16_t)_bufferZone_mm,
+                             (int16_t)_turnRadius_mm, (int16_t)_perimeterLaps};
+        return crc16(params, sizeof(params), _perimeterSignature);
+    }
+
+    void saveCheckpoint() {
+        if (_checkpoint == nullptr) return;
+
+        MowCheckpoint cp = {};
+        cp.state = _state;
+        cp.jobId = jobId();
+        cp.stripe = _currentStripe;
+        cp.lap = _currentLap;
+        cp.flags = _movingRight ? MowCheckpoint::MovingRight : 0;
+        _checkpoint->save(cp);
+    }
+
+    // Mark what the recorded progress has mowed: 'laps' perimeter laps and
+    // stripes 0 .. stripes-1
+    void markDoneCoverage(int laps, int stripes) {
+        if (_coverage == nullptr || !_coverage->isValid()) return;
+
+        if (laps > 0) {
+            // Lap k runs k stripe widths in; outside the lawn is already excluded
+            uint16_t band = 2 * laps * _stripeWidth_mm;
+            int count = _perimeter.getCount();
+            Point2D_int a = _perimeter.getWaypoint(count - 1);
+            for (int i = 0; i < count; i++) {
+                Point2D_int b = _perimeter.getWaypoint(i);
+                _coverage->markSwath(a, b, band);
+                a = b;
+            }
+        }
+        for (int i = 0; i < stripes; i++) {
+            Point2D_int start, end;
+            stripeLine(i, (i % 2) == 0, start, end);
+            _coverage->markSwath(start, end, _stripeWidth_mm);
+        }
+        _coverage->lift();
+    }
+
+    // Sweep the blade along the pose while a mowing state is active
+    void trackCoverage() {
+        if (_coverage == nullptr || _pose == nullptr) return;
+
+        PoseEstimate pose = _pose->getPose();
+        if (pose.valid && (_state == PERIMETER_LAPS || _state == MOWING_STRIPE ||
+                           _state == EXECUTING_TURN || _state == CLEANUP)) {
+            _coverage->track(pose.position, pose.sigmaMM);
+        } else {
+            _coverage->lift();
+        }
+    }
+
     // Calculate bounding box of perimeter
     void calculateBoundingBox() {
         _perimeter.getBounds(_minX, _maxX, _minY, _maxY);
@@ -229,6 +581,8 @@ private:
 
     // Start a perimeter lap
     void startPerimeterLap() {
+        saveCheckpoint();
+
         // Follow perimeter with offset based on lap number
         // Lap 0: at perimeter, Lap 1: 250mm in, Lap 2: 500mm in
         int offset_mm = _currentLap * _stripeWidth_mm;
@@ -264,29 +618,35 @@ private:
         }
     }
 
-    // Start next mowing stripe
+    // Start next mowing stripe: its pieces on the lawn, the blade kept half
+    // a width off the perimeter and exclusion zones
     void startNextStripe() {
-        Point2D_int start, end;
-
-        // Calculate stripe Y position (left-to-right stripes in this example)
-        int32_t stripeX = _minX + _bufferZone_mm + (_currentStripe * _stripeWidth_mm);
+        saveCheckpoint();
 
-        if (_movingRight) {
-            // Moving from bottom to top
-            start.x = stripeX;
-            start.y = _minY + _bufferZone_mm;
-            end.x = stripeX;
-            end.y = _maxY - _bufferZone_mm;
-        } else {
-            // Moving from top to bottom
-            start.x = stripeX;
-            start.y = _maxY - _bufferZone_mm;
-            end.x = stripeX;
-            end.y = _minY + _bufferZone_mm;
+        Point2D_int start, end;
+        stripeLine(_currentStripe, _movingRight, start, end);
+        _pieceCount = _perimeter.clipSegment(start, end, _pieces, MAX_STRIPE_PIECES, _stripeWidth_mm / 2);
+        _piece = 0;
+
+        if (_pieceCount == 0) {
+            DEBUG_PRINT("Stripe ");
+            DEBUG_PRINT(_currentStripe);
+            DEBUG_PRINTLN(" is not on the lawn");
+            return;
         }
+        startStripePiece();
+    }
+
+    void startStripePiece() {
+        Point2D_int start = _pieces[2 * _piece];
+        Point2D_int end = _pieces[2 * _piece + 1];
 
         DEBUG_PRINT("Stripe ");
         DEBUG_PRINT(_currentStripe);
+        if (_pieceCount > 1) {
+            DEBUG_PRINT(" piece ");
+            DEBUG_PRINT(_piece);
+        }
         DEBUG_PRINT(": (");
         DEBUG_PRINT(start.x);
         DEBUG_PRINT(",");
@@ -301,6 +661,46 @@ private:
         _lineFollower->enable();
     }
 
+    // Pieces of a cleanup fragment on the lawn, clipped like a stripe. The
+    // ends are pushed out by the margin first, so an end on the perimeter or
+    // a zone edge becomes a crossing and is pulled back in.
+    void clipCleanupFragment(Point2D_int start, Point2D_int end) {
+        int32_t margin = _stripeWidth_mm / 2;
+        int64_t dx = end.x - start.x;
+        int64_t dy = end.y - start.y;
+        int32_t len = (int32_t)IntegerMath::integerSqrt64(dx * dx + dy * dy);
+        if (len > 0) {
+            int32_t mx = (int32_t)(dx * margin / len);
+            int32_t my = (int32_t)(dy * margin / len);
+            start.x -= mx;
+            start.y -= my;
+            end.x += mx;
+            end.y += my;
+        }
+        _pieceCount = _perimeter.clipSegment(start, end, _pieces, MAX_STRIPE_PIECES, margin);
+        _piece = 0;
+    }
+
+    // Start and end of a stripe
+    void stripeLine(int stripe, bool movingRight, Point2D_int& start, Point2D_int& end) const {
+        // Calculate stripe Y position (left-to-right stripes in this example)
+        int32_t stripeX = _minX + _bufferZone_mm + (stripe * _stripeWidth_mm);
+
+        if (movingRight) {
+            // Moving from bottom to top
+            start.x = stripeX;
+            start.y = _minY + _bufferZone_mm;
+            end.x = stripeX;
+            end.y = _maxY - _bufferZone_mm;
+        } else {
+            // Moving from top to bottom
+            start.x = stripeX;
+            start.y = _maxY - _bufferZone_mm;
+            end.x = stripeX;
+            end.y = _minY + _bufferZone_mm;
+        }
+    }
+
     // Execute teardrop turn between stripes
     void startTurn() {
         DEBUG_PRINT("Executing turn from stripe ");
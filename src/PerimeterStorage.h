@@ -4,14 +4,31 @@
 #include "globals.hpp"
 #include "Arduino.h"
 #include "MowerGeometry.h"
+#include "Crc16.h"
 
-// Maximum perimeter waypoints
+// Maximum perimeter waypoints (outer ring and exclusion zones together)
 #define MAX_PERIMETER_WAYPOINTS 1000
 
+// Maximum exclusion zones (holes: flower beds, trees, ponds)
+#ifndef MAX_EXCLUSION_ZONES
+#define MAX_EXCLUSION_ZONES 20
+#endif
+
+// Maximum boundary crossings of one line (getCrossings(), clipSegment()):
+// two for the outer ring and each zone, plus slack for concave rings
+#ifndef MAX_BOUNDARY_CROSSINGS
+#define MAX_BOUNDARY_CROSSINGS (2 * (MAX_EXCLUSION_ZONES + 1) + 16)
+#endif
+
 // Efficient perimeter storage using relative coordinates
 // Stores waypoints as 16-bit offsets from previous point
 // This allows ±32.767m range per segment while using only 4 bytes per waypoint
 // Total memory: 1000 waypoints × 4 bytes = 4KB (vs 8KB for absolute coordinates)
+//
+// Exclusion zones are more rings in the same offset pool, after the outer
+// ring: an absolute first corner, offsets, and a bounding box that lets the
+// queries skip zones far from the point or line. The lawn is inside the
+// outer ring and outside every zone.
 class PerimeterStorage {
 private:
     // Storage format: relative offsets in millimeters
@@ -28,24 +45,163 @@ private:
 
     int _waypointCount;
 
-    // Bounding box (calculated from waypoints)
-    int32_t _minX, _maxX;
-    int32_t _minY, _maxY;
-    bool _boundsValid;
+    // Bounding box (calculated from waypoints, cached)
+    mutable int32_t _minX, _maxX;
+    mutable int32_t _minY, _maxY;
+    mutable bool _boundsValid;
+
+    // Exclusion zones; offsets in _waypoints[first .. first + count - 2]
+    struct ExclusionZone {
+        Point2D_int origin;
+        Point2D_int last;           // For the next offset
+        int first;
+        int count;
+        int32_t minX, maxX;
+        int32_t minY, maxY;
+    };
+    ExclusionZone _zones[MAX_EXCLUSION_ZONES];
+    int _zoneCount;
+    int _poolUsed;                  // Offsets used by the outer ring and the zones
+
+    // A closed ring in the pool: outer ring (-1) or zone
+    struct Ring {
+        Point2D_int origin;
+        int first;
+        int count;
+    };
+
+    Ring ring(int zone) const {
+        Ring r;
+        if (zone < 0) {
+            r.origin = _origin;
+            r.first = 0;
+            r.count = _waypointCount;
+        } else {
+            r.origin = _zones[zone].origin;
+            r.first = _zones[zone].first;
+            r.count = _zones[zone].count;
+        }
+        return r;
+    }
+
+    // End of edge i of a ring (edge i runs from corner i to corner i + 1, the last one closes it)
+    Point2D_int edgeEnd(const Ring& r, int i, const Point2D_int& a) const {
+        if (i >= r.count - 1) return r.origin;
+        return Point2D_int(a.x + _waypoints[r.first + i].dx, a.y + _waypoints[r.first + i].dy);
+    }
+
+    int ringCrossings(const Ring& r, int32_t y, int32_t* xs, int n, int maxCount) const {
+        Point2D_int a = r.origin;
+        for (int i = 0; i < r.count; i++) {
+            Point2D_int b = edgeEnd(r, i, a);
+            if ((a.y <= y) != (b.y <= y)) {
+                // Counted past maxCount, so the caller sees the overflow
+                if (n < maxCount) xs[n] = a.x + (int32_t)((int64_t)(y - a.y) * (b.x - a.x) / (b.y - a.y));
+                n++;
+            }
+            a = b;
+        }
+        return n;
+    }
+
+    // Even-odd test against one ring
+    bool ringContains(const Ring& r, const Point2D_int& p) const {
+        bool inside = false;
+        Point2D_int a = r.origin;
+        for (int i = 0; i < r.count; i++) {
+            Point2D_int b = edgeEnd(r, i, a);
+            if ((a.y <= p.y) != (b.y <= p.y)) {
+                int32_t x = a.x + (int32_t)((int64_t)(p.y - a.y) * (b.x - a.x) / (b.y - a.y));
+                if (x > p.x) inside = !inside;
+            }
+            a = b;
+        }
+        return inside;
+    }
+
+    // Point to edge distance in 64 bit: points and edges may be more than
+    // ~46m apart (MowerGeometry::distanceToLineSegment and vectorLength
+    // overflow there)
+    static distance_t edgeDistance(const Point2D_int& p, const Point2D_int& a, const Point2D_int& b) {
+        int64_t dx = b.x - a.x;
+        int64_t dy = b.y - a.y;
+        int64_t t = (p.x - a.x) * dx + (p.y - a.y) * dy;
+        int64_t lenSq = dx * dx + dy * dy;
+        int32_t qx = a.x;
+        int32_t qy = a.y;
+        if (t >= lenSq) {
+            qx = b.x;
+            qy = b.y;
+        } else if (t > 0) {
+            qx = a.x + (int32_t)(dx * t / lenSq);
+            qy = a.y + (int32_t)(dy * t / lenSq);
+        }
+        int64_t ex = p.x - qx;
+        int64_t ey = p.y - qy;
+        return (distance_t)IntegerMath::integerSqrt64(ex * ex + ey * ey);
+    }
+
+    distance_t ringDistance(const Ring& r, const Point2D_int& p, distance_t best) const {
+        Point2D_int a = r.origin;
+        for (int i = 0; i < r.count; i++) {
+            Point2D_int b = edgeEnd(r, i, a);
+            distance_t d = edgeDistance(p, a, b);
+            if (d < best) best = d;
+            a = b;
+        }
+        return best;
+    }
+
+    // Segment a + t * d (t in Q16) against the edges of one ring
+    int ringIntersections(const Ring& r, const Point2D_int& a, int32_t dx, int32_t dy,
+                          int32_t* ts, int n, int maxCount) const {
+        Point2D_int p = r.origin;
+        for (int i = 0; i < r.count; i++) {
+            Point2D_int q = edgeEnd(r, i, p);
+            int64_t ex = q.x - p.x;
+            int64_t ey = q.y - p.y;
+            int64_t denom = dx * ey - dy * ex;
+            if (denom != 0) {
+                int64_t px = p.x - a.x;
+                int64_t py = p.y - a.y;
+                int64_t tNum = px * ey - py * ex;
+                int64_t uNum = px * dy - py * dx;
+                if (denom < 0) {
+                    denom = -denom;
+                    tNum = -tNum;
+                    uNum = -uNum;
+                }
+                if (tNum > 0 && tNum < denom && uNum >= 0 && uNum <= denom) {
+                    if (n < maxCount) ts[n] = (int32_t)((tNum << 16) / denom);
+                    n++;
+                }
+            }
+            p = q;
+        }
+        return n;
+    }
+
+    bool zoneBoxContains(const ExclusionZone& z, const Point2D_int& p) const {
+        return p.x >= z.minX && p.x <= z.maxX && p.y >= z.minY && p.y <= z.maxY;
+    }
 
 public:
     PerimeterStorage() : _origin{0, 0}, _waypointCount(0),
                          _minX(0), _maxX(0), _minY(0), _maxY(0),
-                         _boundsValid(false) {
+                         _boundsValid(false), _zoneCount(0), _poolUsed(0) {
     }
 
     // Add waypoint from absolute coordinates
     // Returns false if storage is full
     bool addWaypoint(int32_t x, int32_t y) {
-        if (_waypointCount >= MAX_PERIMETER_WAYPOINTS) {
+        if (_poolUsed >= MAX_PERIMETER_WAYPOINTS - 1 && _waypointCount > 0) {
             DEBUG_PRINTLN("Error: Perimeter storage full!");
             return false;
         }
+        if (_zoneCount > 0) {
+            DEBUG_PRINTLN("Error: Perimeter is closed once exclusion zones are added");
+            return false;
+        }
 
         if (_waypointCount == 0) {
             // First waypoint - store as origin
@@ -75,6 +231,7 @@ public:
         _waypoints[_waypointCount - 1].dx = (int16_t)dx;
         _waypoints[_waypointCount - 1].dy = (int16_t)dy;
         _waypointCount++;
+        _poolUsed++;
         _boundsValid = false;
 
         return true;
@@ -129,16 +286,112 @@ public:
         return _waypointCount;
     }
 
-    // Clear all waypoints
+    // Clear all waypoints (and the exclusion zones)
     void clear() {
         _waypointCount = 0;
         _origin.x = 0;
         _origin.y = 0;
         _boundsValid = false;
+        _zoneCount = 0;
+        _poolUsed = 0;
+    }
+
+    // Start a new exclusion zone; addZoneWaypoint() adds its corners.
+    // The outer ring is closed from then on.
+    bool beginExclusionZone() {
+        if (_zoneCount >= MAX_EXCLUSION_ZONES) {
+            DEBUG_PRINTLN("Error: Too many exclusion zones");
+            return false;
+        }
+        _zones[_zoneCount].first = _poolUsed;
+        _zones[_zoneCount].count = 0;
+        _zoneCount++;
+        return true;
+    }
+
+    // Add a corner to the last exclusion zone (at least 3 make it count)
+    bool addZoneWaypoint(int32_t x, int32_t y) {
+        if (_zoneCount == 0) return false;
+        ExclusionZone& z = _zones[_zoneCount - 1];
+
+        if (z.count == 0) {
+            z.origin = Point2D_int(x, y);
+            z.last = z.origin;
+            z.minX = z.maxX = x;
+            z.minY = z.maxY = y;
+            z.count = 1;
+            return true;
+        }
+
+        int32_t dx = x - z.last.x;
+        int32_t dy = y - z.last.y;
+        if (_poolUsed >= MAX_PERIMETER_WAYPOINTS - 1 ||
+            dx < -32767 || dx > 32767 || dy < -32767 || dy > 32767) {
+            DEBUG_PRINTLN("Error: Exclusion zone waypoint rejected");
+            return false;
+        }
+
+        _waypoints[_poolUsed].dx = (int16_t)dx;
+        _waypoints[_poolUsed].dy = (int16_t)dy;
+        _poolUsed++;
+        z.count++;
+        z.last = Point2D_int(x, y);
+        if (x < z.minX) z.minX = x;
+        if (x > z.maxX) z.maxX = x;
+        if (y < z.minY) z.minY = y;
+        if (y > z.maxY) z.maxY = y;
+        return true;
+    }
+
+    // Add a whole exclusion zone; nothing is kept if it does not fit
+    bool addExclusionZone(const Point2D_int* points, int count) {
+        int poolUsed = _poolUsed;
+        if (!beginExclusionZone()) return false;
+        for (int i = 0; i < count; i++) {
+            if (!addZoneWaypoint(points[i].x, points[i].y)) {
+                _zoneCount--;
+                _poolUsed = poolUsed;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void clearExclusionZones() {
+        _zoneCount = 0;
+        _poolUsed = _waypointCount > 0 ? _waypointCount - 1 : 0;
+    }
+
+    int getZoneCount() const {
+        return _zoneCount;
+    }
+
+    int getZoneWaypointCount(int zone) const {
+        return (zone >= 0 && zone < _zoneCount) ? _zones[zone].count : 0;
+    }
+
+    Point2D_int getZoneWaypoint(int zone, int index) const {
+        if (zone < 0 || zone >= _zoneCount || index < 0 || index >= _zones[zone].count) {
+            return Point2D_int{0, 0};
+        }
+        Point2D_int pos = _zones[zone].origin;
+        for (int i = 0; i < index; i++) {
+            pos.x += _waypoints[_zones[zone].first + i].dx;
+            pos.y += _waypoints[_zones[zone].first + i].dy;
+        }
+        return pos;
+    }
+
+    void getZoneBounds(int zone, int32_t& minX, int32_t& maxX, int32_t& minY, int32_t& maxY) const {
+        const ExclusionZone& z = _zones[zone];
+        minX = z.minX;
+        maxX = z.maxX;
+        minY = z.minY;
+        maxY = z.maxY;
     }
 
     // Calculate bounding box
-    void calculateBounds() {
+    void calculateBounds() const {
         if (_waypointCount == 0) {
             _minX = _maxX = _minY = _maxY = 0;
             _boundsValid = true;
@@ -173,7 +426,7 @@ public:
     }
 
     // Get bounding box
-    void getBounds(int32_t& minX, int32_t& maxX, int32_t& minY, int32_t& maxY) {
+    void getBounds(int32_t& minX, int32_t& maxX, int32_t& minY, int32_t& maxY) const {
         if (!_boundsValid) {
             calculateBounds();
         }
@@ -184,13 +437,13 @@ public:
     }
 
     // Get bounding box width in mm
-    int32_t getWidth() {
+    int32_t getWidth() const {
         if (!_boundsValid) calculateBounds();
         return _maxX - _minX;
     }
 
     // Get bounding box height in mm
-    int32_t getHeight() {
+    int32_t getHeight() const {
         if (!_boundsValid) calculateBounds();
         return _maxY - _minY;
     }
@@ -238,8 +491,9 @@ public:
 
     // Get memory usage in bytes
     int getMemoryUsage() const {
-        // Origin (8 bytes) + waypoints (4 bytes each) + overhead
-        return sizeof(Point2D_int) + (_waypointCount - 1) * sizeof(RelativeWaypoint);
+        // Origin (8 bytes) + waypoints (4 bytes each) + zone headers
+        return sizeof(Point2D_int) + _poolUsed * sizeof(RelativeWaypoint) +
+               _zoneCount * sizeof(ExclusionZone);
     }
 
     // Print statistics
@@ -252,6 +506,11 @@ public:
         DEBUG_PRINT((getMemoryUsage() * 100) / (MAX_PERIMETER_WAYPOINTS * 4));
         DEBUG_PRINTLN("% of max)");
 
+        if (_zoneCount > 0) {
+            DEBUG_PRINT("Exclusion zones: ");
+            DEBUG_PRINTLN(_zoneCount);
+        }
+
         if (_waypointCount > 0) {
             DEBUG_PRINT("Area: ");
             DEBUG_PRINT(getWidth());
@@ -261,28 +520,183 @@ public:
         }
     }
 
-    // Check if a point is approximately on the perimeter (within threshold)
-    bool isOnPerimeter(const Point2D_int& point, distance_t threshold_mm = 500) const {
-        if (_waypointCount < 2) return false;
+    // CRC-16 over origins and offsets: identifies the perimeter and its
+    // zones (e.g. in a stored checkpoint) without keeping a copy
+    uint16_t getSignature() const {
+        uint16_t crc = crc16(&_origin.x, sizeof(_origin.x));
+        crc = crc16(&_origin.y, sizeof(_origin.y), crc);
+        crc = crc16(&_waypointCount, sizeof(_waypointCount), crc);
+        crc = crc16(_waypoints, sizeof(RelativeWaypoint) * _poolUsed, crc);
+        for (int z = 0; z < _zoneCount; z++) {
+            crc = crc16(&_zones[z].origin.x, sizeof(_zones[z].origin.x), crc);
+            crc = crc16(&_zones[z].origin.y, sizeof(_zones[z].origin.y), crc);
+            crc = crc16(&_zones[z].count, sizeof(_zones[z].count), crc);
+        }
+        return crc;
+    }
 
-        Point2D_int prev = _origin;
+    // X coordinates where the horizontal line y crosses the lawn boundary
+    // (outer ring and exclusion zones), unsorted. An edge counts from its
+    // lower end inclusive to its upper end exclusive, so a vertex on the line
+    // is counted once and the crossings pair up (inside = between crossing 2k
+    // and 2k+1 after sorting). Zones whose box misses y are skipped.
+    // Returns the number stored; -1 (logged) if there are more than maxCount,
+    // the stored ones would not pair up. One pass over the offsets.
+    int getCrossings(int32_t y, int32_t* xs, int maxCount) const {
+        if (_waypointCount < 3) return 0;
+
+        int n = ringCrossings(ring(-1), y, xs, 0, maxCount);
+        for (int z = 0; z < _zoneCount; z++) {
+            if (_zones[z].count < 3 || y < _zones[z].minY || y >= _zones[z].maxY) continue;
+            n = ringCrossings(ring(z), y, xs, n, maxCount);
+        }
+        if (n > maxCount) {
+            DEBUG_PRINT("Error: ");
+            DEBUG_PRINT(n);
+            DEBUG_PRINT(" boundary crossings at y=");
+            DEBUG_PRINTLN(y);
+            return -1;
+        }
+        return n;
+    }
 
-        // Check each segment
-        for (int i = 1; i < _waypointCount; i++) {
-            Point2D_int curr = getWaypoint(i);
+    // Point on the lawn: inside the outer ring and outside every zone.
+    // Bounding boxes reject most points before any edge is looked at.
+    bool contains(const Point2D_int& point) const {
+        if (_waypointCount < 3) return false;
+        if (!_boundsValid) calculateBounds();
+        if (point.x < _minX || point.x > _maxX || point.y < _minY || point.y > _maxY) return false;
+        if (!ringContains(ring(-1), point)) return false;
 
-            int32_t dist = MowerGeometry::distanceToLineSegment(point, prev, curr);
+        for (int z = 0; z < _zoneCount; z++) {
+            if (_zones[z].count < 3 || !zoneBoxContains(_zones[z], point)) continue;
+            if (ringContains(ring(z), point)) return false;
+        }
+        return true;
+    }
 
-            if (dist <= threshold_mm) {
-                return true;
+    // Distance to the nearest boundary edge, outer ring or zone. A zone whose
+    // box is farther than the best edge so far is skipped. zone = -1 for the
+    // outer ring, else the zone index.
+    distance_t distanceToBoundary(const Point2D_int& point, int* zone = nullptr) const {
+        distance_t best = ringDistance(ring(-1), point, INT32_MAX);
+        int nearest = -1;
+
+        for (int z = 0; z < _zoneCount; z++) {
+            const ExclusionZone& e = _zones[z];
+            if (e.count < 2) continue;
+            int32_t dx = point.x < e.minX ? e.minX - point.x : (point.x > e.maxX ? point.x - e.maxX : 0);
+            int32_t dy = point.y < e.minY ? e.minY - point.y : (point.y > e.maxY ? point.y - e.maxY : 0);
+            if (dx >= best || dy >= best) continue;
+
+            distance_t d = ringDistance(ring(z), point, best);
+            if (d < best) {
+                best = d;
+                nearest = z;
             }
+        }
+
+        if (zone != nullptr) *zone = nearest;
+        return best;
+    }
+
+    // Pieces of the segment a -> b that lie on the lawn, in order from a.
+    // Piece ends on the boundary are pulled in by marginMM (pieces shorter
+    // than that are dropped); a and b themselves are kept as they are.
+    // pieces[2k] = start, pieces[2k + 1] = end. Returns the count; pieces
+    // past maxPieces are dropped (logged).
+    // Zones whose box does not overlap the segment's box are not intersected.
+    int clipSegment(const Point2D_int& a, const Point2D_int& b, Point2D_int* pieces, int maxPieces,
+                    distance_t marginMM = 0) const {
+        if (_waypointCount < 3 || maxPieces <= 0) return 0;
+
+        int32_t dx = b.x - a.x;
+        int32_t dy = b.y - a.y;
+        int32_t ts[MAX_BOUNDARY_CROSSINGS + 2];
+        int n = 0;
+        ts[n++] = 0;
+        n = ringIntersections(ring(-1), a, dx, dy, ts, n, MAX_BOUNDARY_CROSSINGS + 1);
+
+        int32_t segMinX = a.x < b.x ? a.x : b.x;
+        int32_t segMaxX = a.x < b.x ? b.x : a.x;
+        int32_t segMinY = a.y < b.y ? a.y : b.y;
+        int32_t segMaxY = a.y < b.y ? b.y : a.y;
+        for (int z = 0; z < _zoneCount; z++) {
+            const ExclusionZone& e = _zones[z];
+            if (e.count < 3 || e.maxX < segMinX || e.minX > segMaxX || e.maxY < segMinY || e.minY > segMaxY) continue;
+            n = ringIntersections(ring(z), a, dx, dy, ts, n, MAX_BOUNDARY_CROSSINGS + 1);
+        }
+        if (n > MAX_BOUNDARY_CROSSINGS + 1) {
+            DEBUG_PRINT("Error: Segment has ");
+            DEBUG_PRINT(n - 1);
+            DEBUG_PRINTLN(" boundary crossings, not clipped");
+            return 0;
+        }
+        ts[n++] = 65536;
+
+        for (int i = 1; i < n; i++) {
+            int32_t v = ts[i];
+            int j = i;
+            for (; j > 0 && ts[j - 1] > v; j--) ts[j] = ts[j - 1];
+            ts[j] = v;
+        }
 
-            prev = curr;
+        // Keep the intervals whose middle is on the lawn, joining touching ones
+        int count = 0;
+        int dropped = 0;
+        int32_t open = -1;
+        for (int i = 0; i + 1 < n; i++) {
+            if (ts[i + 1] == ts[i]) continue;
+            int32_t mid = (ts[i] + ts[i + 1]) / 2;
+            Point2D_int m(a.x + (int32_t)(((int64_t)dx * mid) >> 16), a.y + (int32_t)(((int64_t)dy * mid) >> 16));
+            bool inside = contains(m);
+            if (inside && open < 0) open = ts[i];
+            if ((!inside || i + 2 >= n) && open >= 0) {
+                int32_t close = inside ? ts[i + 1] : ts[i];
+                Point2D_int s(a.x + (int32_t)(((int64_t)dx * open) >> 16), a.y + (int32_t)(((int64_t)dy * open) >> 16));
+                Point2D_int e(a.x + (int32_t)(((int64_t)dx * close) >> 16), a.y + (int32_t)(((int64_t)dy * close) >> 16));
+                bool trimStart = open > 0;
+                bool trimEnd = close < 65536;
+                open = -1;
+
+                int64_t lx = e.x - s.x;
+                int64_t ly = e.y - s.y;
+                int32_t len = (int32_t)IntegerMath::integerSqrt64(lx * lx + ly * ly);
+                if (len <= (trimStart + trimEnd) * marginMM) continue;
+                if (count >= maxPieces) {
+                    dropped++;
+                    continue;
+                }
+                if (marginMM > 0 && len > 0) {
+                    int32_t mx = (int32_t)((int64_t)(e.x - s.x) * marginMM / len);
+                    int32_t my = (int32_t)((int64_t)(e.y - s.y) * marginMM / len);
+                    if (trimStart) {
+                        s.x += mx;
+                        s.y += my;
+                    }
+                    if (trimEnd) {
+                        e.x -= mx;
+                        e.y -= my;
+                    }
+                }
+                pieces[2 * count] = s;
+                pieces[2 * count + 1] = e;
+                count++;
+            }
+        }
+        if (dropped > 0) {
+            DEBUG_PRINT("Warning: Segment has ");
+            DEBUG_PRINT(dropped);
+            DEBUG_PRINTLN(" more pieces on the lawn than fit");
         }
+        return count;
+    }
 
-        // Check closing segment
-        int32_t dist = MowerGeometry::distanceToLineSegment(point, prev, _origin);
-        return dist <= threshold_mm;
+    // Check if a point is approximately on the lawn boundary (within threshold),
+    // exclusion zones included
+    bool isOnPerimeter(const Point2D_int& point, distance_t threshold_mm = 500) const {
+        if (_waypointCount < 2) return false;
+        return distanceToBoundary(point) <= threshold_mm;
     }
 };
 
@@ -0,0 +1,497 @@
+#ifndef POSEEKF_H
+#define POSEEKF_H
+
+#include "globals.hpp"
+#include "Arduino.h"
+#include "MowerTypes.h"
+#include "IntegerMathDefault.h"
+#include "Odometry.h"
+#include "IMUInterface.h"
+#include "GPSInterface.h"
+#include <TaskSchedulerDeclarations.h>
+
+// Fused pose for the controllers: position in mm, heading in tenths
+// (0 = +x, CCW positive) and the 1 sigma uncertainty of both
+struct PoseEstimate {
+   Point2D_int position;
+   angle_t heading;
+   uint16_t sigmaMM;            // Larger of the x and y standard deviations
+   uint16_t headingSigma;       // Tenths of a degree
+   bool valid;                  // Initialized (setPose() or first GPS fix)
+};
+
+// PoseEKF - Extended Kalman Filter over (x, y, heading, gyro bias)
+// INTEGER ONLY - state in um, urad, urad/s; covariance int64 in those units squared
+//
+// Runs as a Task (default 20ms = 50Hz). Each tick:
+//   predict   d = odometry path delta, dTheta = gyro rotation delta - bias * dt
+//             x += d cos(theta + dTheta/2), y += d sin(...), theta += dTheta
+//             P = F P F^T + Q          F = I + (dx/dtheta, dy/dtheta, dtheta/dbias)
+//   correct   on every new GPS epoch: x, then y as two scalar updates
+//             (R is diagonal, so this equals the 2x2 update without an inverse)
+// Without an initialized IMU the odometry heading delta is used instead of the gyro.
+//
+// F has only three off-diagonal terms, so F P F^T is hand-unrolled on the 10
+// unique elements of the symmetric P (about 16 multiplies). Jacobian terms
+// and Kalman gains are Q16. Variances are capped at MaxVar, which keeps every
+// gain * covariance product below 2^63.
+//
+// Process noise:
+//   position  odoVar per mm travelled, random walk (mm^2 per m) along the
+//             track, 1/16 of it across (wheels slip lengthwise, sideways the heading covers it)
+//   heading   gyroVar per ms + (dTheta / 100)^2 scale error (/20 with odometry heading)
+//   bias      biasWalk per s
+// GPS fixes further than GateSigma sigma from the prediction are dropped;
+// after MaxRejects in a row the filter trusts the GPS again (re-initializes the position).
+//
+// Latency: a fix describes the epoch latencyMs before it arrived (RTK 50-150ms).
+// The last HistorySize steps (d, dTheta, end time) are kept; a fix rewinds
+// the state through the steps after its epoch (exact integer inverse),
+// corrects there and replays them, so the pose stays current. Only x, y and
+// theta are replayed, P is used as predicted to now.
+class PoseEKF : public Task {
+public:
+   // Upper triangle of the symmetric covariance. Order: x, y, theta (t), bias (b)
+   struct Covariance {
+      int64_t xx, xy, xt, xb;
+      int64_t yy, yt, yb;
+      int64_t tt, tb;
+      int64_t bb;
+   };
+
+   static constexpr int32_t TwoPi = 6283185;              // urad
+   static constexpr int32_t Pi = 3141593;
+   static constexpr int64_t MaxVar = 100000000000000LL;  // 1e14: 10m, 10rad, 10rad/s
+   static constexpr int64_t MinVar = 1;
+   static constexpr int32_t MaxBias = 175000;             // urad/s, 10 deg/s
+   static constexpr int32_t GateSigma = 5;
+   static constexpr uint8_t MaxRejects = 5;
+   static constexpr uint16_t MaxStepMs = 1000;            // Longer gaps are taken as this
+   static constexpr uint8_t LateralShift = 4;             // Sideways slip: 1/16 of the variance along
+   static constexpr uint8_t HistorySize = 16;             // Steps kept for latency replay, 320ms at 20ms
+
+private:
+   Odometry *_odo;
+   IMUInterface *_imu;
+   GPSInterface *_gps;
+
+   // State
+   int32_t _xUm;
+   int32_t _yUm;
+   int32_t _theta;                 // urad, 0 .. TwoPi-1
+   int32_t _bias;                  // urad/s, positive = gyro reads high
+   int32_t _biasRem;               // bias * ms not yet applied, 1/1000 urad
+   Covariance _p;
+   bool _valid;
+
+   // Noise
+   int32_t _odoVar;                // um^2 per um travelled (= mm^2 per m)
+   int32_t _gyroVar;               // urad^2 per ms
+   int32_t _biasWalk;              // (urad/s)^2 per s
+   int32_t _biasWalkRem;
+
+   // Inputs seen at the last tick
+   uint32_t _lastPathUm;
+   int32_t _lastGyro;
+   angle_t _lastOdoHeading;
+   uint16_t _lastFixCount;
+   time_ms_t _lastMs;
+
+   uint8_t _rejects;               // In a row
+   uint16_t _rejected;             // Total
+
+   // Recent steps for the latency replay, oldest overwritten
+   struct Step {
+      uint16_t t;                  // millis() at the end of the step, low 16 bits
+      uint16_t dtMs;
+      int32_t dUm;
+      int32_t dTheta;              // Rotation applied, urad (bias removed)
+   };
+   static constexpr uint8_t HistoryMask = HistorySize - 1;
+   static_assert((HistorySize & HistoryMask) == 0, "HistorySize must be a power of two");
+   Step _history[HistorySize];
+   uint8_t _historyHead;           // Next slot
+   uint8_t _historyCount;
+   uint16_t _latencyMs;
+
+   static int64_t mulQ16(int32_t k, int64_t v) { return ((int64_t)k * v) >> 16; }
+
+   static int32_t wrapTwoPi(int32_t a) {
+      while (a >= TwoPi) a -= TwoPi;
+      while (a < 0) a += TwoPi;
+      return a;
+   }
+
+   static int32_t wrapPi(int32_t a) {
+      while (a > Pi) a -= TwoPi;
+      while (a <= -Pi) a += TwoPi;
+      return a;
+   }
+
+   // urad <-> tenths of a degree, pi ~ 355/113
+   static angle_t toTenths(int32_t urad) {
+      return normalizeAngle((angle_t)(((int64_t)urad * 203400 + 177500000) / 355000000));
+   }
+
+   static int32_t fromTenths(int32_t tenths) {
+      return (int32_t)((int64_t)tenths * 355000000 / 203400);
+   }
+
+   // Standard deviation of a variance in the same unit, for v up to MaxVar
+   static uint32_t sigmaOf(int64_t v) {
+      if (v <= 0) return 0;
+      if (v <= (int64_t)0xFFFFFFFF) return fast_sqrt((uint32_t)v);
+      return fast_sqrt((uint32_t)(v >> 16)) << 8;
+   }
+
+   // Move the state along one step (midpoint rule); returns the heading used
+   angle_t advance(int32_t dUm, int32_t dTheta) {
+      angle_t mid = toTenths(wrapTwoPi(_theta + dTheta / 2));
+      _xUm += dUm * cos_lookup(mid) / 1000;
+      _yUm += dUm * sin_lookup(mid) / 1000;
+      _theta = wrapTwoPi(_theta + dTheta);
+      return mid;
+   }
+
+   // Exact inverse of advance()
+   void retreat(int32_t dUm, int32_t dTheta) {
+      _theta = wrapTwoPi(_theta - dTheta);
+      angle_t mid = toTenths(wrapTwoPi(_theta + dTheta / 2));
+      _xUm -= dUm * cos_lookup(mid) / 1000;
+      _yUm -= dUm * sin_lookup(mid) / 1000;
+   }
+
+   // Undo the steps that ended after epoch; returns how many
+   uint8_t rewind(time_ms_t epoch) {
+      uint8_t n = 0;
+      while (n < _historyCount) {
+         const Step &st = _history[(uint8_t)(_historyHead - 1 - n) & HistoryMask];
+         if ((int16_t)(st.t - (uint16_t)epoch) <= 0) break;
+         retreat(st.dUm, st.dTheta);
+         n++;
+      }
+      return n;
+   }
+
+   // Redo the last n steps, with the bias change of the correction applied to them
+   void replay(uint8_t n, int32_t dBias) {
+      while (n > 0) {
+         Step &st = _history[(uint8_t)(_historyHead - n) & HistoryMask];
+         st.dTheta -= dBias * st.dtMs / 1000;
+         advance(st.dUm, st.dTheta);
+         n--;
+      }
+   }
+
+   static void addVar(int64_t &p, int64_t q) {
+      if (p < MaxVar - q) p += q;
+      else p = MaxVar;
+   }
+
+   static void floorVar(int64_t &p) {
+      if (p < MinVar) p = MinVar;
+   }
+
+   // P = F P F^T with F = [1 0 a 0; 0 1 c 0; 0 0 1 e; 0 0 0 1], gains Q16
+   void predictCovariance(int32_t a, int32_t c, int32_t e) {
+      Covariance &p = _p;
+      // Rows of F P (row b is unchanged)
+      int64_t r0x = p.xx + mulQ16(a, p.xt);
+      int64_t r0y = p.xy + mulQ16(a, p.yt);
+      int64_t r0t = p.xt + mulQ16(a, p.tt);
+      int64_t r0b = p.xb + mulQ16(a, p.tb);
+      int64_t r1y = p.yy + mulQ16(c, p.yt);
+      int64_t r1t = p.yt + mulQ16(c, p.tt);
+      int64_t r1b = p.yb + mulQ16(c, p.tb);
+      int64_t r2t = p.tt + mulQ16(e, p.tb);
+      int64_t r2b = p.tb + mulQ16(e, p.bb);
+      // (F P) F^T, upper triangle
+      p.xx = r0x + mulQ16(a, r0t);
+      p.xy = r0y + mulQ16(c, r0t);
+      p.xt = r0t + mulQ16(e, r0b);
+      p.xb = r0b;
+      p.yy = r1y + mulQ16(c, r1t);
+      p.yt = r1t + mulQ16(e, r1b);
+      p.yb = r1b;
+      p.tt = r2t + mulQ16(e, r2b);
+      p.tb = r2b;
+   }
+
+   // Scalar measurement of state i (col = column i of P, innovation in state
+   // units, r = measurement variance). K = col / (P_ii + r), P -= K col^T.
+   void correctState(const int64_t col[4], uint8_t i, int32_t innovation, int64_t r) {
+      int64_t s = col[i] + r;
+      int64_t k[4];
+      for (uint8_t j = 0; j < 4; j++) k[j] = (col[j] << 16) / s;
+
+      _xUm += (int32_t)((k[0] * innovation) >> 16);
+      _yUm += (int32_t)((k[1] * innovation) >> 16);
+      _theta = wrapTwoPi(_theta + (int32_t)((k[2] * innovation) >> 16));
+      _bias += (int32_t)((k[3] * innovation) >> 16);
+      _bias = constrain(_bias, -MaxBias, MaxBias);
+
+      Covariance &p = _p;
+      p.xx -= (k[0] * col[0]) >> 16;
+      p.xy -= (k[0] * col[1]) >> 16;
+      p.xt -= (k[0] * col[2]) >> 16;
+      p.xb -= (k[0] * col[3]) >> 16;
+      p.yy -= (k[1] * col[1]) >> 16;
+      p.yt -= (k[1] * col[2]) >> 16;
+      p.yb -= (k[1] * col[3]) >> 16;
+      p.tt -= (k[2] * col[2]) >> 16;
+      p.tb -= (k[2] * col[3]) >> 16;
+      p.bb -= (k[3] * col[3]) >> 16;
+      floorVar(p.xx);
+      floorVar(p.yy);
+      floorVar(p.tt);
+      floorVar(p.bb);
+   }
+
+   static int32_t clampInnovation(int64_t v) {
+      if (v > INT32_MAX) return INT32_MAX;
+      if (v < -INT32_MAX) return -INT32_MAX;
+      return (int32_t)v;
+   }
+
+   // Innovation within GateSigma standard deviations: v^2 <= G^2 s
+   static bool inGate(int32_t innovation, int64_t s) {
+      int64_t v = innovation < 0 ? -(int64_t)innovation : innovation;
+      if (v > 3000000000LL) return false;
+      return v * v <= (int64_t)GateSigma * GateSigma * s;
+   }
+
+   void resetPosition(distance_t xMM, distance_t yMM, int64_t var) {
+      _xUm = xMM * 1000;
+      _yUm = yMM * 1000;
+      _p.xx = var;
+      _p.yy = var;
+      _p.xy = _p.xt = _p.xb = 0;
+      _p.yt = _p.yb = 0;
+   }
+
+   void takeFix() {
+      distance_t sigma = _gps->getAccuracyMM();
+      Point2D_int fix = _gps->getPosition();
+      int64_t r = (int64_t)sigma * sigma * 1000000;     // um^2
+
+      if (!_valid) {
+         angle_t heading = _imu && _imu->isInitialized() ? _imu->getHeading() : _odo->getHeading();
+         resetPosition(fix.x, fix.y, r);
+         _theta = wrapTwoPi(fromTenths(heading));
+         _p.tt = InitHeadingVar;
+         _p.tb = 0;
+         _valid = true;
+         return;
+      }
+
+      // Back to the epoch of the fix, correct, forward to now
+      uint8_t n = rewind(_gps->getFixArrivalMs() - _latencyMs);
+      int32_t bias = _bias;
+      if (!correctPosition(fix.x, fix.y, r)) {
+         _rejected++;
+         if (++_rejects >= MaxRejects) {
+            // Consistently off: the prediction is wrong (wheels slipped, robot lifted)
+            resetPosition(fix.x, fix.y, r);
+            _rejects = 0;
+         }
+      } else {
+         _rejects = 0;
+      }
+      replay(n, _bias - bias);
+   }
+
+public:
+   static constexpr int64_t InitHeadingVar = 30461742000LL;  // (10 deg)^2 in urad^2
+   static constexpr int64_t InitBiasVar = 12180000LL;        // (0.2 deg/s)^2 in (urad/s)^2
+
+   PoseEKF(Scheduler* aS, Odometry *odo, IMUInterface *imu, GPSInterface *gps, unsigned int mSec = 20)
+      : Task(mSec, TASK_FOREVER, aS, false), _odo(odo), _imu(imu), _gps(gps),
+        _odoVar(400), _gyroVar(100), _biasWalk(100), _latencyMs(100)
+   {
+      reset();
+   }
+
+   // Forget the pose; the next GPS fix (or setPose()) initializes it again
+   void reset() {
+      _xUm = _yUm = 0;
+      _theta = 0;
+      _bias = 0;
+      _biasRem = 0;
+      _biasWalkRem = 0;
+      _p = Covariance{MaxVar, 0, 0, 0, MaxVar, 0, 0, MaxVar, 0, InitBiasVar};
+      _valid = false;
+      _rejects = 0;
+      _rejected = 0;
+      _historyHead = 0;
+      _historyCount = 0;
+      resync();
+   }
+
+   // Take the current inputs as baseline
+   void resync() {
+      _lastPathUm = _odo->getPathUm();
+      _lastGyro = _imu ? _imu->getGyroAngle() : 0;
+      _lastOdoHeading = _odo->getHeading();
+      _lastFixCount = _gps ? _gps->getFixCount() : 0;
+      _lastMs = millis();
+   }
+
+   // Known pose (e.g. docked at the charger); sigmas in mm and tenths
+   void setPose(distance_t xMM, distance_t yMM, angle_t heading,
+                uint16_t sigmaMM = 100, uint16_t headingSigma = 50) {
+      resetPosition(xMM, yMM, (int64_t)sigmaMM * sigmaMM * 1000000);
+      _theta = wrapTwoPi(fromTenths(heading));
+      int64_t ht = fromTenths(headingSigma);
+      _p.tt = ht * ht;
+      _p.tb = 0;
+      _valid = true;
+      _historyCount = 0;            // Nothing before this pose to replay
+   }
+
+   // Noise tuning: odometry mm^2 per m driven, gyro urad^2 per ms, bias (urad/s)^2 per s
+   void setProcessNoise(int32_t odoVar, int32_t gyroVar, int32_t biasWalk) {
+      _odoVar = odoVar;
+      _gyroVar = gyroVar;
+      _biasWalk = biasWalk;
+   }
+
+   // Age of a GPS fix when it arrives (epoch to last byte), ms.
+   // Replay reaches back HistorySize ticks at most.
+   void setGpsLatencyMs(uint16_t ms) { _latencyMs = ms; }
+   uint16_t getGpsLatencyMs() const { return _latencyMs; }
+
+   bool OnEnable() override {
+      resync();
+      return true;
+   }
+
+   // One prediction step ending at now: dUm driven, dGyro urad turned as
+   // measured, over dtMs. Called by the Task; public for feeding recorded or
+   // simulated increments.
+   void predict(time_ms_t now, int32_t dUm, int32_t dGyro, uint16_t dtMs, int16_t scaleDiv = 100) {
+      _biasRem += _bias * dtMs;
+      int32_t dBias = _biasRem / 1000;
+      _biasRem -= dBias * 1000;
+      int32_t dTheta = dGyro - dBias;
+
+      angle_t mid = advance(dUm, dTheta);
+      int32_t c = cos_lookup(mid);
+      int32_t s = sin_lookup(mid);
+
+      Step &st = _history[_historyHead & HistoryMask];
+      st.t = (uint16_t)now;
+      st.dtMs = dtMs;
+      st.dUm = dUm;
+      st.dTheta = dTheta;
+      _historyHead++;
+      if (_historyCount < HistorySize) _historyCount++;
+
+      // Jacobian, Q16: d(x, y)/dtheta = (-d sin, d cos) per rad = 1e-6 per urad,
+      // dtheta/dbias = -dt
+      int32_t a = (int32_t)(-(int64_t)dUm * s * 65536 / 1000000000);
+      int32_t b = (int32_t)((int64_t)dUm * c * 65536 / 1000000000);
+      int32_t e = -(int32_t)((int32_t)dtMs * 65536 / 1000);
+      predictCovariance(a, b, e);
+
+      // Odometry noise along the track, LateralShift less across it (rotated into x, y)
+      int64_t along = (int64_t)(dUm < 0 ? -dUm : dUm) * _odoVar;
+      int64_t across = along >> LateralShift;
+      int64_t cc = (int64_t)c * c;
+      int64_t ss = (int64_t)s * s;
+      addVar(_p.xx, (along * cc + across * ss) / 1000000);
+      addVar(_p.yy, (along * ss + across * cc) / 1000000);
+      _p.xy += (along - across) * c * s / 1000000;
+      int64_t scale = dTheta / scaleDiv;
+      addVar(_p.tt, (int64_t)_gyroVar * dtMs + scale * scale);
+      _biasWalkRem += _biasWalk * dtMs;
+      int32_t qBias = _biasWalkRem / 1000;
+      _biasWalkRem -= qBias * 1000;
+      addVar(_p.bb, qBias);
+   }
+
+   // Position measurement of an earlier epoch (millis()), see setGpsLatencyMs()
+   bool correctPositionAt(time_ms_t epoch, distance_t xMM, distance_t yMM, int64_t r) {
+      uint8_t n = rewind(epoch);
+      int32_t bias = _bias;
+      bool ok = correctPosition(xMM, yMM, r);
+      replay(n, _bias - bias);
+      return ok;
+   }
+
+   // Position measurement (mm) with variance r (um^2) of the current pose.
+   // False if outside the gate.
+   bool correctPosition(distance_t xMM, distance_t yMM, int64_t r) {
+      int32_t ix = clampInnovation((int64_t)xMM * 1000 - _xUm);
+      int32_t iy = clampInnovation((int64_t)yMM * 1000 - _yUm);
+      if (!inGate(ix, _p.xx + r) || !inGate(iy, _p.yy + r)) return false;
+
+      int64_t colX[4] = {_p.xx, _p.xy, _p.xt, _p.xb};
+      correctState(colX, 0, ix, r);
+      // y innovation again: the x update moved y by its correlation
+      iy = clampInnovation((int64_t)yMM * 1000 - _yUm);
+      int64_t colY[4] = {_p.xy, _p.yy, _p.yt, _p.yb};
+      correctState(colY, 1, iy, r);
+      return true;
+   }
+
+   // Absolute heading measurement (tenths, e.g. a moving base baseline) with its sigma
+   bool correctHeading(angle_t heading, angle_t sigma) {
+      if (!_valid) return false;
+      int32_t innovation = wrapPi(fromTenths(heading) - _theta);
+      int64_t r = (int64_t)fromTenths(sigma) * fromTenths(sigma);
+      if (!inGate(innovation, _p.tt + r)) return false;
+      int64_t col[4] = {_p.xt, _p.yt, _p.tt, _p.tb};
+      correctState(col, 2, innovation, r);
+      return true;
+   }
+
+   bool Callback() override {
+      time_ms_t now = millis();
+      time_ms_t dt = now - _lastMs;
+      _lastMs = now;
+      if (dt > MaxStepMs) dt = MaxStepMs;
+
+      uint32_t path = _odo->getPathUm();
+      int32_t dUm = (int32_t)(path - _lastPathUm);
+      _lastPathUm = path;
+
+      angle_t odoHeading = _odo->getHeading();
+      int32_t dOdo = angleDifference(odoHeading, _lastOdoHeading);
+      _lastOdoHeading = odoHeading;
+
+      int32_t gyro = _imu ? _imu->getGyroAngle() : 0;
+      int32_t dGyro = gyro - _lastGyro;
+      _lastGyro = gyro;
+
+      if (_valid) {
+         if (_imu && _imu->isInitialized()) predict(now, dUm, fromTenths(dGyro), (uint16_t)dt);
+         else predict(now, dUm, fromTenths(dOdo), (uint16_t)dt, 20);
+      }
+
+      if (_gps && _gps->getFixCount() != _lastFixCount) {
+         _lastFixCount = _gps->getFixCount();
+         if (_gps->hasFix()) takeFix();
+      }
+      return true;
+   }
+
+   PoseEstimate getPose() const {
+      PoseEstimate e;
+      e.position = Point2D_int(_xUm / 1000, _yUm / 1000);
+      e.heading = toTenths(_theta);
+      uint32_t s = sigmaOf(_p.xx > _p.yy ? _p.xx : _p.yy) / 1000;
+      e.sigmaMM = s > 0xFFFF ? 0xFFFF : (uint16_t)s;
+      uint32_t h = (uint32_t)(((uint64_t)sigmaOf(_p.tt) * 203400 + 177500000) / 355000000);
+      e.headingSigma = h > 0xFFFF ? 0xFFFF : (uint16_t)h;
+      e.valid = _valid;
+      return e;
+   }
+
+   bool isValid() const { return _valid; }
+   const Covariance& getCovariance() const { return _p; }
+   // Residual gyro bias the filter estimated, urad/s
+   int32_t getGyroBias() const { return _bias; }
+   uint16_t getRejectedFixes() const { return _rejected; }
+};
+
+#endif
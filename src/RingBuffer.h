@@ -0,0 +1,210 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Compiler/CPU ordering between data writes and index publication.
+// AVR is single core, so only the compiler must not reorder around the ISR.
+#if defined(__AVR__)
+  #define RING_BARRIER() __atomic_signal_fence(__ATOMIC_SEQ_CST)
+#else
+  #define RING_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+// Lock-free single-producer / single-consumer ring buffer
+// For ISR -> task channels (sonar, encoders, BWF, GPS bytes).
+//
+// - Size must be a power of two; indices wrap with a mask, never with % or compares
+// - head is written only by the producer, tail only by the consumer
+// - Indices are free-running Index values (default uint8_t = atomic load/store on AVR)
+// - Overwrite = true: a full ring drops the OLDEST item. The producer never
+//   touches tail; it opens an overrun (overrun != overrunSeen) and keeps the
+//   oldest valid index and a count of overwritten items until the consumer
+//   takes them and skips ahead. The indices may lap any number of times in
+//   between, the overrun mark says the ring is full. The consumer re-checks
+//   version after each copy, so a slot overwritten mid-read is never returned.
+//   This assumes the producer is an ISR (runs to completion before the consumer
+//   resumes), which holds for AVR and for same-core ISRs elsewhere.
+// - Overwrite = false: a full ring rejects the NEWEST item (push returns false)
+template <class T, uint16_t Size, bool Overwrite = true, class Index = uint8_t>
+class RingBuffer {
+   static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "Size must be a power of two");
+   static_assert(Size <= (((uint32_t)(Index)~(Index)0) + 1) / 2, "Index type too small for Size");
+#if defined(__AVR__)
+   static_assert(sizeof(Index) == 1, "Index must be 8 bit on AVR to be read atomically");
+#endif
+
+   static constexpr Index Mask = (Index)(Size - 1);
+
+   T data[Size];
+   volatile Index head = 0;     // Next slot to write (producer)
+   volatile Index tail = 0;     // Next slot to read (consumer)
+
+   // Overwrite mode only
+   volatile Index overrun = 0;          // Producer: != overrunSeen while an overrun is open
+   volatile Index version = 0;          // Producer: changes on every overwrite
+   volatile Index oldest = 0;           // Producer: first valid item
+   volatile uint16_t overwritten = 0;   // Producer: items lost, free running
+   volatile Index overrunSeen = 0;      // Consumer: closes the overrun
+   uint16_t overwrittenSeen = 0;
+   uint16_t dropped = 0;        // Items lost to overwrite (consumer side count)
+
+   // Producer: n items arrive, the last written of them go in at h; count
+   // the unread ones lost (replaced, or not written at all)
+   inline void noteOverwrite(Index h, uint16_t n, uint16_t written) {
+      bool open = overrun != overrunSeen;
+      uint16_t lost = n;
+      if (!open) {
+         uint16_t used = (Index)(h - tail);
+         lost = used + n > Size ? used + n - Size : 0;
+      }
+      if (lost == 0) return;
+      overwritten = overwritten + lost;
+      oldest = (Index)(h + written - Size);
+      if (!open) overrun = overrun + 1;
+      RING_BARRIER();
+      version = version + 1;
+   }
+
+   // Consumer: skip items that the producer has already overwritten
+   inline Index catchUp() {
+      if (Overwrite) {
+         for (;;) {
+            Index v = version;
+            Index mark = overrun;
+            uint16_t total = overwritten;
+            Index o = oldest;
+            RING_BARRIER();
+            if (version != v) continue;       // Producer wrote meanwhile, read again
+            dropped += (uint16_t)(total - overwrittenSeen);
+            overwrittenSeen = total;
+            if (mark != overrunSeen) {
+               tail = o;
+               overrunSeen = mark;
+            }
+            break;
+         }
+      }
+      // A push between reading oldest and closing the overrun moved it on
+      // (counted on the next call)
+      Index h = head;
+      Index t = tail;
+      if ((Index)(h - t) > Size) {
+         t = (Index)(h - Size);
+         tail = t;
+      }
+      return t;
+   }
+
+   inline bool overrunOpen() { return Overwrite && overrun != overrunSeen; }
+
+public:
+   // ---------------- Producer side ----------------
+
+   bool push(const T& item) {
+      Index h = head;
+      if (Overwrite) {
+         noteOverwrite(h, 1, 1);
+      } else if ((Index)(h - tail) >= Size) {
+         return false;
+      }
+      data[h & Mask] = item;
+      RING_BARRIER();
+      head = (Index)(h + 1);
+      return true;
+   }
+
+   // Push up to n items, returns number pushed
+   uint16_t pushN(const T* items, uint16_t n) {
+      Index h = head;
+      if (!Overwrite) {
+         uint16_t space = Size - (Index)(h - tail);
+         if (n > space) n = space;
+      } else {
+         uint16_t written = n > Size ? Size : n;
+         noteOverwrite(h, n, written);
+         items += n - written;          // Only the newest Size items survive anyway
+         n = written;
+      }
+      for (uint16_t i = 0; i < n; i++) {
+         data[(Index)(h + i) & Mask] = items[i];
+      }
+      RING_BARRIER();
+      head = (Index)(h + n);
+      return n;
+   }
+
+   // ---------------- Consumer side ----------------
+
+   bool pull(T& item) {
+      for (;;) {
+         Index v = version;
+         Index t = catchUp();
+         if (t == head) return false;
+         item = data[t & Mask];
+         RING_BARRIER();
+         // Producer overwrote while copying - copy may be torn, retry
+         if (Overwrite && version != v) continue;
+         tail = (Index)(t + 1);
+         return true;
+      }
+   }
+
+   // Pull up to max items, returns number pulled
+   uint16_t pullN(T* items, uint16_t max) {
+      uint16_t n = 0;
+      while (n < max && pull(items[n])) n++;
+      return n;
+   }
+
+   // Copy the most recent item without consuming anything
+   bool peekLatest(T& item) {
+      for (;;) {
+         Index v = version;
+         Index h = head;
+         if (catchUp() == h) return false;
+         item = data[(Index)(h - 1) & Mask];
+         RING_BARRIER();
+         // Newest slot rewritten while copying - retry
+         if (Overwrite && version != v) continue;
+         return true;
+      }
+   }
+
+   // Drop everything currently queued
+   void clear() {
+      for (;;) {
+         Index v = version;
+         catchUp();
+         tail = head;
+         if (!Overwrite || version == v) return;
+      }
+   }
+
+   // Items lost because the ring was full (Overwrite mode); resets the count
+   uint16_t takeDropped() {
+      catchUp();
+      uint16_t d = dropped;
+      dropped = 0;
+      return d;
+   }
+
+   // ---------------- Either side ----------------
+
+   inline uint16_t count() {
+      if (overrunOpen()) return Size;
+      Index n = (Index)(head - tail);
+      return n > Size ? Size : n;
+   }
+
+   inline bool dataAvailable() { return head != tail || overrunOpen(); }
+
+   inline bool spaceAvailable() { return Overwrite || count() < Size; }
+
+   constexpr bool canOverwrite() { return Overwrite; }
+
+   constexpr int depth() { return Size; }
+};
+
+#endif
@@ -37,7 +37,6 @@ void sSonar::Measure() {
 
 bool sSonar::Callback() { 
    if (SonarDistance == 0) return true; 
-   Response->push(SonarDistance);
    Measure();
    return true;
 };
@@ -58,22 +57,24 @@ void sSonar::Stop() {
 
 //
 // Static interupt handlers
-void sSonar::responseStart(sSonar *_this) {
+void sSonar::responseStart(sSonar *_this, bool pinstate, PcInt::timestamp_t when) {
    PcInt::detachInterrupt(_this->ResponsePin);
-   _this->_responseStartMicros = micros();
+   _this->_responseStartMicros = when;
    PcInt::attachInterrupt(_this->ResponsePin, responseEnd, _this, FALLING);
 };
 
 // Static interupt handlers
-void sSonar::responseEnd(sSonar *_this) {
+void sSonar::responseEnd(sSonar *_this, bool pinstate, PcInt::timestamp_t when) {
    PcInt::detachInterrupt(_this->ResponsePin);
-   _this->SonarDistance = micros() - _this->_responseStartMicros;
+   _this->SonarDistance = when - _this->_responseStartMicros;
+   _this->Response->push(_this->SonarDistance);
 };
 
+// 32 bit intermediates: 500mm * _soundSpeedFactor overflows a 16 bit int
 unsigned int sSonar::SonarInMM(unsigned int distance) { 
-   return distance * 128 / _soundSpeedFactor; 
+   return (uint32_t)distance * 128 / _soundSpeedFactor; 
 };
 
 unsigned int sSonar::MMtoMeasure(unsigned int MM) { 
-   return MM *  _soundSpeedFactor / 128 ; 
+   return (uint32_t)MM *  _soundSpeedFactor / 128 ; 
 };
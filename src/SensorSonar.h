@@ -15,9 +15,9 @@ private:
     
    volatile unsigned long _responseStartMicros;
 
-   unsigned int SonarDistance;
+   volatile unsigned int SonarDistance;
 
-   SonarQueue *Response;
+   SonarQueue *Response;        // Filled from the echo ISR (producer)
    static constexpr int  _soundSpeedFactor =2560000 / (3310 + 6 * 22);
 
 public:
@@ -31,8 +31,8 @@ public:
    void Measure();
    void Stop();
 
-   static void responseStart(sSonar *);
-   static void responseEnd(sSonar *);
+   static void responseStart(sSonar *, bool pinstate, PcInt::timestamp_t when);
+   static void responseEnd(sSonar *, bool pinstate, PcInt::timestamp_t when);
    static unsigned int SonarInMM(unsigned int distance); 
    static unsigned int MMtoMeasure(unsigned int MM); 
     
@@ -0,0 +1,148 @@
+#include <Arduino.h>
+#include <SensorSonarArray.h>
+#include <SensorSonar.h>
+#include <TaskSchedulerDeclarations.h>
+#include <YetAnotherPcInt.h>
+#include <globals.hpp>
+
+SonarArray::SonarArray(Scheduler* aS, SonarScanQueue *_Response)
+            : Task(1, TASK_FOREVER, aS, false) {
+
+   Response = _Response;
+   _count = 0;
+   _orderCount = 0;
+   _slot = 0;
+   _settleUs = DefaultSettleUs;
+   _active = NoSensor;
+   _echoStartUs = 0;
+   _echoUs = 0;
+   _echoHigh = false;
+   _echoDone = false;
+   _fireUs = 0;
+   _nextFireUs = 0;
+   memset(&_scan, 0, sizeof(_scan));
+   memset(_sampleMs, 0, sizeof(_sampleMs));
+};
+
+SonarArray::~SonarArray() {
+   for (uint8_t i = 0; i < _count; i++) PcInt::detachInterrupt(_channels[i].echoPin);
+};
+
+uint8_t SonarArray::addSensor(uint8_t trigger_pin, uint8_t echo_pin, unsigned int maxRangeMM) {
+   if (_count >= MaxSonars) return NoSensor;
+
+   Channel &ch = _channels[_count];
+   ch.owner = this;
+   ch.index = _count;
+   ch.triggerPin = trigger_pin;
+   ch.echoPin = echo_pin;
+   uint32_t window = (uint32_t)sSonar::MMtoMeasure(maxRangeMM) + TriggerToEchoUs;
+   ch.windowUs = window > 0xFFFF ? 0xFFFF : (uint16_t)window;
+
+   pinMode(trigger_pin, OUTPUT);
+   digitalWrite(trigger_pin, LOW);
+   pinMode(echo_pin, INPUT);
+
+   _order[_orderCount++] = _count;
+   _scan.count = ++_count;
+   return ch.index;
+};
+
+void SonarArray::setFiringOrder(const uint8_t *order, uint8_t n) {
+   _orderCount = 0;
+   for (uint8_t i = 0; i < n && _orderCount < MaxSonars; i++) {
+      if (order[i] < _count) _order[_orderCount++] = order[i];
+   }
+   _slot = 0;
+};
+
+void SonarArray::fire(uint8_t channel) {
+   Channel &ch = _channels[channel];
+
+   // Module still busy with an earlier ping (echo line high): skip this round
+   if (digitalRead(ch.echoPin) == HIGH) {
+      _active = channel;
+      record(0);
+      return;
+   }
+
+   _echoDone = false;
+   _echoHigh = false;
+   _active = channel;
+
+   digitalWrite(ch.triggerPin, HIGH);
+   delayMicroseconds(10);
+   digitalWrite(ch.triggerPin, LOW);
+   _fireUs = micros();
+};
+
+void SonarArray::record(unsigned int echoUs) {
+   uint8_t channel = _active;
+   _active = NoSensor;                // ISR ignores edges from here on
+
+   _scan.echoUs[channel] = echoUs;
+   _sampleMs[channel] = millis();
+
+   if (++_slot < _orderCount) return;
+
+   // Round complete: publish the vector
+   _slot = 0;
+   _scan.stampMs = millis();
+   for (uint8_t i = 0; i < _count; i++) {
+      time_ms_t age = _scan.stampMs - _sampleMs[i];
+      _scan.ageMs[i] = age > 255 ? 255 : (uint8_t)age;
+   }
+   Response->push(_scan);
+};
+
+bool SonarArray::Callback() {
+   if (_orderCount == 0) return false;
+
+   unsigned long now = micros();
+
+   if (_active != NoSensor) {
+      if (_echoDone) {
+         record(_echoUs);
+      } else if (now - _fireUs > _channels[_active].windowUs) {
+         record(0);                   // Nothing within range
+      } else {
+         return false;
+      }
+      _nextFireUs = now + _settleUs;
+      return true;
+   }
+
+   if ((long)(now - _nextFireUs) < 0) return false;
+   fire(_order[_slot]);
+   return true;
+};
+
+bool SonarArray::OnEnable() {
+   for (uint8_t i = 0; i < _count; i++) {
+      PcInt::attachInterrupt(_channels[i].echoPin, echoChange, &_channels[i], CHANGE);
+   }
+   _active = NoSensor;
+   _slot = 0;
+   _nextFireUs = micros();
+   return true;
+};
+
+void SonarArray::OnDisable() {
+   _active = NoSensor;
+   for (uint8_t i = 0; i < _count; i++) PcInt::detachInterrupt(_channels[i].echoPin);
+};
+
+//
+// Static interupt handler - one per echo pin, attached once, both edges
+void SonarArray::echoChange(Channel *ch, bool pinstate, PcInt::timestamp_t when) {
+   SonarArray *_this = ch->owner;
+   if (_this->_active != ch->index || _this->_echoDone) return;
+
+   if (pinstate) {
+      _this->_echoStartUs = when;
+      _this->_echoHigh = true;
+   } else if (_this->_echoHigh) {
+      _this->_echoUs = when - _this->_echoStartUs;
+      _this->_echoDone = true;
+   }
+};
@@ -0,0 +1,91 @@
+#ifndef SENSORSONARARRAY_H
+#define SENSORSONARARRAY_H
+
+#define _TASK_OO_CALLBACKS
+
+#include <TaskSchedulerDeclarations.h>
+#include <Arduino.h>
+#include <YetAnotherPcInt.h>
+#include <globals.hpp>
+
+constexpr uint8_t MaxSonars = 4;
+
+// One round of the sonar array: every sensor in the firing order sampled once
+typedef struct {
+   time_ms_t stampMs;                 // millis() when the round completed
+   unsigned int echoUs[MaxSonars];    // Echo time (us, same units as sSonar); 0 = no echo in window
+   uint8_t ageMs[MaxSonars];          // Sample taken this many ms before stampMs (saturates at 255)
+   uint8_t count;                     // Number of sensors configured
+} SonarScan;
+
+typedef RingBuffer<SonarScan, 4> SonarScanQueue;
+
+// SonarArray - time-multiplexed ultrasonic sensors (e.g. front-left, front, front-right)
+//
+// Only one sensor pings at a time. After each ping the array waits until the
+// echo arrives or the sensor's echo window (its max range) expires, then a
+// settle time for residual echoes to die out, before the next sensor in the
+// firing order is triggered. A ping from one sensor therefore can't be heard
+// as a (too short) echo by the next one, and the next ping goes out as soon
+// as the acoustics allow instead of on a fixed period.
+//
+// A SonarScan is pushed into the queue after every full round.
+class SonarArray: public Task {
+private:
+   struct Channel {
+      SonarArray *owner;
+      uint8_t index;
+      uint8_t triggerPin;
+      uint8_t echoPin;
+      uint16_t windowUs;              // Longest echo accepted
+   };
+
+   static constexpr uint8_t NoSensor = 0xFF;
+   static constexpr uint16_t DefaultSettleUs = 6000;
+   static constexpr uint16_t TriggerToEchoUs = 500;   // Burst time before the echo line rises
+
+   Channel _channels[MaxSonars];
+   uint8_t _count;
+   uint8_t _order[MaxSonars];
+   uint8_t _orderCount;
+   uint8_t _slot;                     // Position in the firing order
+   uint16_t _settleUs;
+
+   volatile uint8_t _active;          // Channel currently pinging, NoSensor between pings
+   volatile unsigned long _echoStartUs;
+   volatile unsigned int _echoUs;
+   volatile bool _echoHigh;           // Rising edge seen for the active ping
+   volatile bool _echoDone;
+   unsigned long _fireUs;
+   unsigned long _nextFireUs;
+
+   SonarScan _scan;
+   time_ms_t _sampleMs[MaxSonars];
+   SonarScanQueue *Response;
+
+   void fire(uint8_t channel);
+   void record(unsigned int echoUs);
+
+public:
+   SonarArray(Scheduler* aS, SonarScanQueue *_Response);
+   ~SonarArray();
+
+   // Add a sensor; returns its index in SonarScan::echoUs (NoSensor if full)
+   uint8_t addSensor(uint8_t trigger_pin, uint8_t echo_pin, unsigned int maxRangeMM);
+
+   // Firing order by sensor index (default: order added), up to MaxSonars slots.
+   // A sensor may appear more than once, e.g. front, left, front, right.
+   void setFiringOrder(const uint8_t *order, uint8_t n);
+
+   // Quiet time after each ping before the next sensor fires
+   void setSettleTime(uint16_t us) { _settleUs = us; }
+
+   uint8_t sensorCount() const { return _count; }
+
+   bool Callback() override;
+   bool OnEnable() override;
+   void OnDisable() override;
+
+   static void echoChange(Channel *ch, bool pinstate, PcInt::timestamp_t when);
+};
+#endif
@@ -0,0 +1,120 @@
+#include <Arduino.h>
+#include <SensorSonarICP.h>
+#include <TaskSchedulerDeclarations.h>
+#include <globals.hpp>
+
+// Only built for the ICP backend: it owns the Timer1 capture and compare B vectors
+#if SONAR_BACKEND_ICP && defined(__AVR__)
+
+sSonarICP *sSonarICP::_instance = nullptr;
+
+sSonarICP::sSonarICP(Scheduler* aS, unsigned int timeOut, SonarQueue *_Response,
+                     uint8_t trigger_pin)
+            : Task(1,timeOut, aS, false) {
+
+   TriggerPin = trigger_pin;
+   Response = _Response;
+
+   pinMode(TriggerPin, OUTPUT);
+   digitalWrite(TriggerPin, LOW);
+   pinMode(SONARECHO_ICP, INPUT);
+   _triggerPort = portOutputRegister(digitalPinToPort(TriggerPin));
+   _triggerMask = digitalPinToBitMask(TriggerPin);
+
+   _echoStartTicks = 0;
+   SonarDistance = 0;
+   _instance = this;
+};
+
+sSonarICP::~sSonarICP() {
+   Stop();
+   _instance = nullptr;
+};
+
+void sSonarICP::Measure() {
+   SonarDistance = 0;
+
+   uint8_t sreg = SREG;
+   cli();
+   TIMSK1 &= ~_BV(ICIE1);            // Ignore edges until the trigger pulse is done
+   *_triggerPort |= _triggerMask;    // Trigger HIGH
+   OCR1B = TCNT1 + TriggerTicks;     // ...compare B ends it
+   TIFR1 = _BV(OCF1B);
+   TIMSK1 |= _BV(OCIE1B);
+   SREG = sreg;
+};
+
+bool sSonarICP::Callback() {
+   if (SonarDistance == 0) return true;
+   Measure();
+   return true;
+};
+
+bool sSonarICP::OnEnable() {
+   // Timer1 free running, normal mode, F_CPU/8, capture noise canceller
+   // (overrides the 8 bit PWM setup done by the Arduino core)
+   uint8_t sreg = SREG;
+   cli();
+   TCCR1A = 0;
+   TCCR1B = _BV(ICNC1) | _BV(CS11);
+   TCCR1C = 0;
+   TIMSK1 = 0;
+   SREG = sreg;
+
+   Measure();
+   return true;
+};
+
+// Timeout (no echo within timeOut iterations): disarm and try again
+void sSonarICP::OnDisable() {
+   TIMSK1 &= ~(_BV(ICIE1) | _BV(OCIE1B));
+   *_triggerPort &= ~_triggerMask;
+   restartDelayed(2);
+};
+
+void sSonarICP::Stop() {
+   TIMSK1 &= ~(_BV(ICIE1) | _BV(OCIE1B));
+   *_triggerPort &= ~_triggerMask;
+   disable();
+};
+
+//
+// Static interupt handlers
+void sSonarICP::triggerEnd() {
+   sSonarICP *_this = _instance;
+   *_this->_triggerPort &= ~_this->_triggerMask;  // Trigger LOW
+   TIMSK1 &= ~_BV(OCIE1B);
+   TCCR1B |= _BV(ICES1);                          // Arm for the rising echo edge
+   TIFR1 = _BV(ICF1);                             // Clear after changing edge
+   TIMSK1 |= _BV(ICIE1);
+};
+
+void sSonarICP::captureEdge() {
+   sSonarICP *_this = _instance;
+   uint16_t ticks = ICR1;
+
+   if (TCCR1B & _BV(ICES1)) {                     // Rising: echo start
+      _this->_echoStartTicks = ticks;
+      TCCR1B &= ~_BV(ICES1);
+      TIFR1 = _BV(ICF1);
+      return;
+   }
+
+   // Falling: echo end, 16 bit difference is wrap safe
+   TIMSK1 &= ~_BV(ICIE1);
+   uint16_t width = ticks - _this->_echoStartTicks;
+   unsigned int us = (width + TicksPerUs / 2) / TicksPerUs;
+   if (us == 0) us = 1;                           // 0 means "no reading" to Callback
+   _this->SonarDistance = us;
+   _this->Response->push(us);
+};
+
+ISR(TIMER1_COMPB_vect) {
+   sSonarICP::triggerEnd();
+}
+
+ISR(TIMER1_CAPT_vect) {
+   sSonarICP::captureEdge();
+}
+
+#endif
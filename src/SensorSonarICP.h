@@ -0,0 +1,55 @@
+#ifndef SENSORSONARICP_H
+#define SENSORSONARICP_H
+
+#define _TASK_OO_CALLBACKS
+
+#include <TaskSchedulerDeclarations.h>
+#include <Arduino.h>
+#include <globals.hpp>
+#include <SensorSonar.h>
+
+// sSonarICP - sonar backend timed by Timer1 input capture (ICP1, pin D8)
+//
+// The echo edges are latched by hardware into ICR1, so the timestamp does not
+// depend on interrupt latency (0.5us ticks at 16MHz, noise canceller on).
+// The 10us trigger pulse is ended by a Timer1 compare match, so Measure()
+// never busy-waits. Only one instance can exist (there is one ICP1 pin).
+//
+// Distances are pushed in microseconds, same units as sSonar, so
+// sSonar::MMtoMeasure()/SonarInMM() apply unchanged.
+// Timer1 runs free at F_CPU/8 and wraps after 65536 ticks (32ms at 16MHz):
+// keep timeOut (ms) below that so a missing echo is dropped, not wrapped.
+class sSonarICP: public Task  {
+private:
+   uint8_t TriggerPin;
+   volatile uint8_t *_triggerPort;   // Direct port access, used from the compare ISR
+   uint8_t _triggerMask;
+
+   volatile uint16_t _echoStartTicks;
+   volatile unsigned int SonarDistance;
+
+   SonarQueue *Response;             // Filled from the capture ISR (producer)
+
+   static sSonarICP *_instance;
+
+public:
+   static constexpr uint16_t TicksPerUs = F_CPU / 8 / 1000000UL;
+   static constexpr uint16_t TriggerTicks = 12 * TicksPerUs;   // >= 10us trigger pulse
+
+   sSonarICP(Scheduler* aS, unsigned int timeOut, SonarQueue *_Response, uint8_t trigger_pin);
+   ~sSonarICP();
+
+   bool Callback() override;
+   bool OnEnable() override;
+   void OnDisable() override;
+   void Measure();
+   void Stop();
+
+   // Called from the Timer1 ISRs
+   static void triggerEnd();
+   static void captureEdge();
+
+   static unsigned int SonarInMM(unsigned int distance) { return sSonar::SonarInMM(distance); }
+   static unsigned int MMtoMeasure(unsigned int MM) { return sSonar::MMtoMeasure(MM); }
+};
+#endif
@@ -0,0 +1,181 @@
+#ifndef SONARFILTER_H
+#define SONARFILTER_H
+
+#include "globals.hpp"
+#include "SensorSonar.h"
+
+// SonarFilter - streaming filter for one ultrasonic sensor (integer only)
+//
+//   raw echo -> jump gate -> running median of N -> alpha-beta tracker
+//                                                    -> distance, closing speed, time to collision
+//
+// - Jump gate: a reading further from the prediction than the mower/obstacle
+//   could have moved since the last sample is held back. It is only accepted
+//   once ConfirmCount consecutive readings agree with it (a real obstacle
+//   stepping into the beam), so single spurious echoes never get through.
+// - Median of N (odd, <= 9): insertion into a sorted copy of the window,
+//   O(N) per sample, no dynamic memory.
+// - Alpha-beta tracker in Q4 fixed point (1/16 mm): smooths the median and
+//   estimates the rate of change. Closing speed is positive when approaching.
+//
+// Constant memory (~4N + 20 bytes), at most two 32 bit divisions per sample:
+// the prediction (shared by the gate and the tracker) and the rate update.
+template <uint8_t N = 5>
+class SonarFilter {
+   static_assert(N >= 3 && N <= 9 && (N & 1), "Median window must be odd, 3..9");
+
+public:
+   static constexpr uint16_t NoCollision = 0xFFFF;     // timeToCollisionMs() when not closing
+
+private:
+   static constexpr int32_t Q = 16;                    // Fixed point scale of the tracker
+   static constexpr int32_t AlphaDiv = 2;              // alpha = 1/2
+   static constexpr int32_t BetaDiv = 8;               // beta  = 1/8
+   static constexpr time_ms_t MaxGapMs = 1000;         // Longer gaps restart the tracker
+   static constexpr int16_t MinClosingMMs = 20;        // Below this TTC is NoCollision
+
+   uint16_t _window[N];       // Last N accepted readings, in arrival order
+   uint16_t _sorted[N];       // Same values, sorted
+   uint8_t _next;             // Oldest slot in _window
+   uint8_t _filled;
+
+   int32_t _dQ;               // Tracked distance (mm * Q)
+   int32_t _vQ;               // Tracked rate (mm/s * Q), negative = approaching
+   time_ms_t _lastMs;
+
+   uint16_t _pending;         // Gated reading waiting for confirmation
+   uint8_t _pendingCount;
+
+   uint16_t _maxRangeMM;      // "No echo" reads as this distance
+   uint16_t _maxClosingMMs;   // Fastest physically possible approach
+   uint16_t _toleranceMM;     // Measurement noise allowed on top of that
+   uint8_t _confirmCount;
+
+   void seed(uint16_t mm) {
+      for (uint8_t i = 0; i < N; i++) {
+         _window[i] = mm;
+         _sorted[i] = mm;
+      }
+      _next = 0;
+      _filled = N;
+      _dQ = (int32_t)mm * Q;
+      _vQ = 0;
+      _pendingCount = 0;
+   }
+
+   // Replace the oldest reading by mm, keeping _sorted ordered
+   void insert(uint16_t mm) {
+      uint16_t old = _window[_next];
+      _window[_next] = mm;
+      if (++_next >= N) _next = 0;
+
+      uint8_t i = 0;
+      while (_sorted[i] != old) i++;
+      // Shift neighbours over the removed slot until mm fits
+      while (i > 0 && _sorted[i - 1] > mm) { _sorted[i] = _sorted[i - 1]; i--; }
+      while (i < N - 1 && _sorted[i + 1] < mm) { _sorted[i] = _sorted[i + 1]; i++; }
+      _sorted[i] = mm;
+   }
+
+   // predQ: _dQ advanced by dt at the tracked rate
+   void track(uint16_t mm, time_ms_t dt, int32_t predQ) {
+      int32_t r = (int32_t)mm * Q - predQ;
+      _dQ = predQ + r / AlphaDiv;
+      _vQ += r * 1000 / ((int32_t)dt * BetaDiv);
+   }
+
+public:
+   SonarFilter(uint16_t maxRangeMM = 2500, uint16_t maxClosingMMs = 2000,
+               uint16_t toleranceMM = 50, uint8_t confirmCount = 2) {
+      _maxRangeMM = maxRangeMM;
+      _maxClosingMMs = maxClosingMMs;
+      _toleranceMM = toleranceMM;
+      _confirmCount = confirmCount;
+      reset();
+   }
+
+   void reset() {
+      _filled = 0;
+      _next = 0;
+      _dQ = 0;
+      _vQ = 0;
+      _lastMs = 0;
+      _pending = 0;
+      _pendingCount = 0;
+   }
+
+   // Feed a distance (mm, 0 = no echo). Returns false if the reading was gated.
+   bool update(uint16_t mm, time_ms_t stampMs) {
+      if (mm == 0 || mm > _maxRangeMM) mm = _maxRangeMM;
+
+      time_ms_t dt = stampMs - _lastMs;
+      if (_filled == 0 || dt > MaxGapMs) {
+         seed(mm);
+         _lastMs = stampMs;
+         return true;
+      }
+      if (dt == 0) dt = 1;
+
+      // Gate against the prediction: max travel since the last sample + noise,
+      // compared in mm/1000 (dt <= MaxGapMs keeps it in 32 bits)
+      int32_t predQ = _dQ + _vQ * (int32_t)dt / 1000;
+      int32_t jump = (int32_t)mm - predQ / Q;
+      if (jump < 0) jump = -jump;
+      int32_t gate = (int32_t)_maxClosingMMs * (int32_t)dt + (int32_t)_toleranceMM * 1000;
+
+      if (jump * 1000 > gate) {
+         int32_t d = (int32_t)mm - _pending;
+         if (_pendingCount > 0 && d <= (int32_t)_toleranceMM && d >= -(int32_t)_toleranceMM) {
+            _pendingCount++;
+         } else {
+            _pending = mm;
+            _pendingCount = 1;
+         }
+         if (_pendingCount < _confirmCount) return false;
+         // Confirmed step change: restart from the new distance
+         seed(mm);
+         _lastMs = stampMs;
+         return true;
+      }
+
+      _pendingCount = 0;
+      insert(mm);
+      track(_sorted[N / 2], dt, predQ);
+      _lastMs = stampMs;
+      return true;
+   }
+
+   // Feed an echo time as produced by sSonar/sSonarICP/SonarArray (us)
+   bool updateEcho(unsigned int echoUs, time_ms_t stampMs) {
+      return update(echoUs == 0 ? 0 : sSonar::SonarInMM(echoUs), stampMs);
+   }
+
+   bool valid() const { return _filled != 0; }
+
+   // Median of the last N accepted readings (mm)
+   uint16_t medianMM() const { return _sorted[N / 2]; }
+
+   // Tracked distance (mm)
+   uint16_t distanceMM() const {
+      int32_t d = _dQ / Q;
+      return d < 0 ? 0 : (uint16_t)d;
+   }
+
+   // Approach speed (mm/s), positive when the obstacle gets closer
+   int16_t closingSpeedMMs() const {
+      int32_t v = -_vQ / Q;
+      if (v > INT16_MAX) v = INT16_MAX;
+      if (v < INT16_MIN) v = INT16_MIN;
+      return (int16_t)v;
+   }
+
+   // Time until contact at the current closing speed (ms), NoCollision if not closing
+   uint16_t timeToCollisionMs() const {
+      int16_t v = closingSpeedMMs();
+      if (v < MinClosingMMs) return NoCollision;
+      uint32_t t = (uint32_t)distanceMM() * 1000 / v;
+      return t >= NoCollision ? NoCollision - 1 : (uint16_t)t;
+   }
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef SPEEDCONTROL_H
+#define SPEEDCONTROL_H
+
+#include "globals.hpp"
+#include "DriveUnit.h"
+#include "Odometry.h"
+#include <TaskSchedulerDeclarations.h>
+
+// SpeedControlT - runs the per-wheel velocity loops at a fixed rate
+// While enabled the DriveUnit wheels are closed loop: the ramped wheel speed
+// is the setpoint (and feed-forward), Odometry's measured wheel velocity the
+// feedback. Disabling returns the wheels to open loop.
+template <class DriveT>
+class SpeedControlT : public Task {
+private:
+   DriveT* _drive;
+   Odometry* _odometry;
+
+public:
+   SpeedControlT(Scheduler* aS, DriveT* drive, Odometry* odometry, unsigned int mSec = SpeedControlRate)
+      : Task(mSec, TASK_FOREVER, aS, false), _drive(drive), _odometry(odometry)
+   {
+   };
+
+   bool Callback() override {
+      _drive->controlStep(_odometry->getLeftVelocity(), _odometry->getRightVelocity());
+      return true;
+   };
+
+   bool OnEnable() override {
+      DEBUG_PRINTLN("SpeedControl OnEnable:");
+      _drive->setClosedLoop(true);
+      return true;
+   };
+
+   void OnDisable() override {
+      _drive->setClosedLoop(false);
+   };
+};
+
+typedef SpeedControlT<DriveUnit> SpeedControl;
+
+#endif
@@ -0,0 +1,700 @@
+#ifndef TRANSITPLANNER_H
+#define TRANSITPLANNER_H
+
+#include "globals.hpp"
+#include "Arduino.h"
+#include "MowerTypes.h"
+#include "IntegerMathDefault.h"
+#include "PerimeterStorage.h"
+
+// TransitPlanner - any-angle paths across the lawn around exclusion zones
+// INTEGER ONLY - cells for planning, mm for the path
+//
+// begin() rasterises the perimeter and its exclusion zones into a coarse
+// occupancy grid: a cell is free if its center is on the lawn and farther
+// than the clearance plus one cell from every edge, so a straight leg
+// through free cells keeps the clearance.
+//
+// plan() runs A* over the 8 neighbours (no corner cutting), costs in 1/16
+// cell (16 straight, 23 diagonal), octile distance as heuristic:
+//   open list    binary heap of node indices, ordered by f, ties to larger g
+//   nodes        fixed pool for the open cells only, cell -> node hash
+//                (open addressing); a node is returned when its cell closes
+//   closed set   1 bit per cell
+//   parents      3 bits per cell (direction to the parent), so a closed
+//                cell costs 4 bits instead of a node
+// The grid path is then pulled straight (any-angle smoothing): from the goal
+// back along the parents, a corner is kept only where the straight line from
+// the last corner would leave the free cells. The result is a few straight
+// legs, start and goal at the exact points. Each parent costs a line of
+// sight check, so pulling is stepped too (status stays SEARCHING).
+//
+// A start or goal in a blocked cell (the charger sits on the perimeter) is
+// moved to the nearest free cell first. If start and goal see each other no
+// search is needed.
+//
+// Everything lives in one caller supplied workspace of a fixed number of
+// bytes: five bit planes of cols * rows, the rest is nodes at 14 bytes each.
+// A search whose open list outgrows the nodes ends with NO_MEMORY.
+// Incremental: step() expands at most setStepBudget() cells per call, or
+// pulls the path straight with line of sight checks over at most 8 times as
+// many cells (at least one check).
+class TransitPlanner {
+public:
+   static constexpr uint16_t None = 0xFFFF;
+   static constexpr uint8_t MaxPathPoints = 16;          // Corners between start and goal
+   static constexpr uint8_t MaxSnapCells = 8;            // How far start/goal may be moved
+   static constexpr uint16_t MinNodes = 16;
+   static constexpr uint16_t DefaultExpansionsPerStep = 16;
+   static constexpr uint8_t DefaultWeight = 16;          // Heuristic weight, 1/16 (16 = A*)
+   static constexpr uint16_t MaxCrossings = MAX_BOUNDARY_CROSSINGS;   // Per row (zones included)
+   static constexpr uint8_t Planes = 5;                  // Blocked, closed, 3 parent bits
+   static constexpr uint8_t BytesPerNode = 14;           // Node, heap entry, 2 hash slots
+
+   enum Status : uint8_t {
+      IDLE,
+      SEARCHING,
+      FOUND,
+      NO_PATH,
+      NO_MEMORY
+   };
+
+private:
+   enum Plane : uint8_t {
+      BLOCKED,
+      CLOSED,
+      PARENT                       // PARENT .. PARENT + 2
+   };
+
+   struct Node {
+      uint16_t cell;               // Next free node while released
+      uint16_t g;                  // Cost from the start, 1/16 cell
+      uint16_t f;                  // g + weighted octile distance to the goal
+      uint16_t heapPos;
+   };
+
+   uint16_t *_workspace;
+   uint32_t _bytes;
+   bool _valid;
+
+   // Grid
+   int32_t _originX, _originY;       // Corner of cell (0, 0)
+   uint16_t _cellMM;
+   uint16_t _cols, _rows;
+   uint16_t _stride;                 // Plane bytes per row
+   uint32_t _planeBytes;
+   uint8_t *_planes;
+
+   // Search
+   Node *_nodes;
+   uint16_t *_heap;
+   uint16_t *_hash;
+   uint16_t _maxNodes;
+   uint16_t _nodesUsed;              // Never used before (then the free list)
+   uint16_t _freeNode;
+   uint16_t _openCount;
+   uint16_t _peakOpen;
+   uint16_t _heapCount;
+   uint8_t _hashBits;
+   uint16_t _expansionsPerStep;
+   uint8_t _weight;
+   uint32_t _expanded;
+   Status _status;
+   uint16_t _startCell;
+   uint16_t _goalCell;
+   bool _startMoved;                 // Start/goal not in their own free cell
+   bool _goalMoved;
+   bool _pulling;                    // Goal reached, pulling the path straight
+   uint16_t _pullCell;               // Next parent walk from here
+   uint16_t _pullAnchor;             // Last corner kept
+
+   // Path: _from, cell centers of _pathCells, _to
+   Point2D_int _from;
+   Point2D_int _to;
+   uint16_t _pathCells[MaxPathPoints];
+   uint8_t _pathCount;
+
+   static int8_t stepX(uint8_t dir) {
+      static const int8_t dx[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+      return dx[dir];
+   }
+
+   static int8_t stepY(uint8_t dir) {
+      static const int8_t dy[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+      return dy[dir];
+   }
+
+   // -- Bit planes --
+
+   bool bit(uint8_t plane, int32_t col, int32_t row) const {
+      return (_planes[plane * _planeBytes + (uint32_t)row * _stride + (col >> 3)] >> (col & 7)) & 1;
+   }
+
+   void setBit(uint8_t plane, int32_t col, int32_t row, bool value) {
+      uint8_t &b = _planes[plane * _planeBytes + (uint32_t)row * _stride + (col >> 3)];
+      if (value) {
+         b |= 1 << (col & 7);
+      } else {
+         b &= ~(1 << (col & 7));
+      }
+   }
+
+   bool isBlocked(int32_t col, int32_t row) const {
+      if (col < 0 || row < 0 || col >= _cols || row >= _rows) return true;
+      return bit(BLOCKED, col, row);
+   }
+
+   uint8_t parentDir(uint16_t cell) const {
+      uint16_t col = cell % _cols;
+      uint16_t row = cell / _cols;
+      return bit(PARENT, col, row) | (bit(PARENT + 1, col, row) << 1) | (bit(PARENT + 2, col, row) << 2);
+   }
+
+   void setParentDir(uint16_t cell, uint8_t dir) {
+      uint16_t col = cell % _cols;
+      uint16_t row = cell / _cols;
+      for (uint8_t i = 0; i < 3; i++) setBit(PARENT + i, col, row, (dir >> i) & 1);
+   }
+
+   uint16_t parentOf(uint16_t cell) const {
+      uint8_t dir = parentDir(cell);
+      return (uint16_t)(cell + stepY(dir) * (int32_t)_cols + stepX(dir));
+   }
+
+   // -- Grid --
+
+   // Block the cells whose center is within radius of p
+   void blockDisc(const Point2D_int &p, int32_t radius) {
+      int32_t c0 = (p.x - radius - _originX) / (int32_t)_cellMM;
+      int32_t c1 = (p.x + radius - _originX) / (int32_t)_cellMM;
+      int32_t r0 = (p.y - radius - _originY) / (int32_t)_cellMM;
+      int32_t r1 = (p.y + radius - _originY) / (int32_t)_cellMM;
+      int64_t r2 = (int64_t)radius * radius;
+      for (int32_t row = r0 < 0 ? 0 : r0; row <= r1 && row < _rows; row++) {
+         int64_t dy = _originY + row * (int32_t)_cellMM + _cellMM / 2 - p.y;
+         for (int32_t col = c0 < 0 ? 0 : c0; col <= c1 && col < _cols; col++) {
+            int64_t dx = _originX + col * (int32_t)_cellMM + _cellMM / 2 - p.x;
+            if (dx * dx + dy * dy <= r2) setBit(BLOCKED, col, row, true);
+         }
+      }
+   }
+
+   // Samples every quarter cell along the edge
+   void blockEdge(const Point2D_int &a, const Point2D_int &b, int32_t radius) {
+      int32_t len = IntegerMath::vectorLength(b.x - a.x, b.y - a.y);
+      int32_t steps = len / (_cellMM / 4 + 1) + 1;
+      for (int32_t i = 0; i <= steps; i++) {
+         Point2D_int p(a.x + (int32_t)((int64_t)(b.x - a.x) * i / steps),
+                       a.y + (int32_t)((int64_t)(b.y - a.y) * i / steps));
+         blockDisc(p, radius);
+      }
+   }
+
+   // Free cells = centers between crossing pairs of the row's center line
+   void rasterise(const PerimeterStorage &perimeter, uint16_t clearanceMM) {
+      for (uint32_t i = 0; i < _planeBytes; i++) _planes[BLOCKED * _planeBytes + i] = 0xFF;
+
+      int32_t xs[MaxCrossings];
+      for (uint16_t row = 0; row < _rows; row++) {
+         int32_t y = _originY + (int32_t)row * _cellMM + _cellMM / 2;
+         int n = perimeter.getCrossings(y, xs, MaxCrossings);   // -1: the row stays blocked
+         for (int i = 1; i < n; i++) {
+            int32_t v = xs[i];
+            int j = i;
+            for (; j > 0 && xs[j - 1] > v; j--) xs[j] = xs[j - 1];
+            xs[j] = v;
+         }
+         for (int k = 0; k + 1 < n; k += 2) {
+            // Centers x with xs[k] <= x < xs[k + 1]
+            int32_t c0 = xs[k] - _originX - _cellMM / 2;
+            c0 = c0 <= 0 ? 0 : (c0 + _cellMM - 1) / _cellMM;
+            int32_t c1 = xs[k + 1] - _originX - _cellMM / 2;
+            c1 = c1 <= 0 ? -1 : (c1 - 1) / _cellMM;
+            for (int32_t col = c0; col <= c1 && col < _cols; col++) setBit(BLOCKED, col, row, false);
+         }
+      }
+
+      // A leg between free cell centers passes at most ~0.7 cell off them
+      int32_t radius = clearanceMM + _cellMM;
+      int count = perimeter.getCount();
+      for (int i = 0; i < count; i++) {
+         blockEdge(perimeter.getWaypoint(i), perimeter.getWaypoint((i + 1) % count), radius);
+      }
+      for (int z = 0; z < perimeter.getZoneCount(); z++) {
+         int zoneCount = perimeter.getZoneWaypointCount(z);
+         for (int i = 0; i < zoneCount; i++) {
+            blockEdge(perimeter.getZoneWaypoint(z, i), perimeter.getZoneWaypoint(z, (i + 1) % zoneCount), radius);
+         }
+      }
+   }
+
+   // Cells the straight line between two cell centers passes through, corners
+   // included (both cells beside a corner must be free)
+   bool cellLineOfSight(uint16_t from, uint16_t to) const {
+      int32_t x = from % _cols;
+      int32_t y = from / _cols;
+      int32_t x1 = to % _cols;
+      int32_t y1 = to / _cols;
+      int32_t dx = x1 > x ? x1 - x : x - x1;
+      int32_t dy = y1 > y ? y1 - y : y - y1;
+      int8_t sx = x1 > x ? 1 : -1;
+      int8_t sy = y1 > y ? 1 : -1;
+      int32_t n = 1 + dx + dy;
+      int32_t error = dx - dy;
+      dx *= 2;
+      dy *= 2;
+
+      for (; n > 0; n--) {
+         if (isBlocked(x, y)) return false;
+         if (error > 0) {
+            x += sx;
+            error -= dy;
+         } else if (error < 0) {
+            y += sy;
+            error += dx;
+         } else {
+            if (isBlocked(x + sx, y) || isBlocked(x, y + sy)) return false;
+            x += sx;
+            y += sy;
+            error += dx - dy;
+            n--;
+         }
+      }
+      return true;
+   }
+
+   uint16_t cellOf(const Point2D_int &p, bool &clamped) const {
+      int32_t col = (p.x - _originX) / (int32_t)_cellMM;
+      int32_t row = (p.y - _originY) / (int32_t)_cellMM;
+      if (p.x < _originX) col = -1;
+      if (p.y < _originY) row = -1;
+      clamped = col < 0 || row < 0 || col >= _cols || row >= _rows;
+      col = col < 0 ? 0 : (col >= _cols ? _cols - 1 : col);
+      row = row < 0 ? 0 : (row >= _rows ? _rows - 1 : row);
+      return (uint16_t)(row * _cols + col);
+   }
+
+   // Nearest free cell, square rings of growing size
+   uint16_t nearestFree(uint16_t cell) const {
+      int32_t col = cell % _cols;
+      int32_t row = cell / _cols;
+      if (!isBlocked(col, row)) return cell;
+
+      for (int32_t d = 1; d <= MaxSnapCells; d++) {
+         uint16_t best = None;
+         int32_t bestD2 = 0;
+         for (int32_t r = row - d; r <= row + d; r++) {
+            int32_t step = (r == row - d || r == row + d) ? 1 : 2 * d;
+            for (int32_t c = col - d; c <= col + d; c += step) {
+               if (isBlocked(c, r)) continue;
+               int32_t d2 = (c - col) * (c - col) + (r - row) * (r - row);
+               if (best == None || d2 < bestD2) {
+                  best = (uint16_t)(r * _cols + c);
+                  bestD2 = d2;
+               }
+            }
+         }
+         if (best != None) return best;
+      }
+      return None;
+   }
+
+   // Octile distance to the goal, 1/16 cell, weighted
+   uint16_t heuristic(uint16_t cell) const {
+      int32_t dx = (int32_t)(cell % _cols) - (int32_t)(_goalCell % _cols);
+      int32_t dy = (int32_t)(cell / _cols) - (int32_t)(_goalCell / _cols);
+      if (dx < 0) dx = -dx;
+      if (dy < 0) dy = -dy;
+      uint32_t h = dx > dy ? 16 * dx + 7 * dy : 16 * dy + 7 * dx;
+      h = (h * _weight) >> 4;
+      return h > 0xFFFE ? 0xFFFE : h;
+   }
+
+   // -- Node pool and hash --
+
+   uint16_t hashOf(uint16_t cell) const {
+      return (uint16_t)(cell * 40503U) >> (16 - _hashBits);
+   }
+
+   uint16_t findNode(uint16_t cell) const {
+      uint16_t mask = (1U << _hashBits) - 1;
+      for (uint16_t h = hashOf(cell);; h = (h + 1) & mask) {
+         uint16_t n = _hash[h];
+         if (n == None || _nodes[n].cell == cell) return n;
+      }
+   }
+
+   uint16_t addNode(uint16_t cell) {
+      uint16_t n;
+      if (_freeNode != None) {
+         n = _freeNode;
+         _freeNode = _nodes[n].cell;
+      } else if (_nodesUsed < _maxNodes) {
+         n = _nodesUsed++;
+      } else {
+         return None;
+      }
+
+      uint16_t mask = (1U << _hashBits) - 1;
+      uint16_t h = hashOf(cell);
+      while (_hash[h] != None) h = (h + 1) & mask;
+      _hash[h] = n;
+      _nodes[n].cell = cell;
+      if (++_openCount > _peakOpen) _peakOpen = _openCount;
+      return n;
+   }
+
+   // Linear probing delete: later entries of the cluster move back
+   void releaseNode(uint16_t n) {
+      uint16_t mask = (1U << _hashBits) - 1;
+      uint16_t i = hashOf(_nodes[n].cell);
+      while (_hash[i] != n) i = (i + 1) & mask;
+      for (uint16_t j = (i + 1) & mask; _hash[j] != None; j = (j + 1) & mask) {
+         uint16_t k = hashOf(_nodes[_hash[j]].cell);
+         bool stays = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+         if (stays) continue;
+         _hash[i] = _hash[j];
+         i = j;
+      }
+      _hash[i] = None;
+
+      _nodes[n].cell = _freeNode;
+      _freeNode = n;
+      _openCount--;
+   }
+
+   // -- Open list (binary min-heap) --
+
+   bool before(uint16_t a, uint16_t b) const {
+      if (_nodes[a].f != _nodes[b].f) return _nodes[a].f < _nodes[b].f;
+      return _nodes[a].g > _nodes[b].g;
+   }
+
+   void place(uint16_t pos, uint16_t n) {
+      _heap[pos] = n;
+      _nodes[n].heapPos = pos;
+   }
+
+   void siftUp(uint16_t pos) {
+      uint16_t n = _heap[pos];
+      while (pos > 0) {
+         uint16_t parent = (pos - 1) >> 1;
+         if (!before(n, _heap[parent])) break;
+         place(pos, _heap[parent]);
+         pos = parent;
+      }
+      place(pos, n);
+   }
+
+   void siftDown(uint16_t pos) {
+      uint16_t n = _heap[pos];
+      for (;;) {
+         uint16_t child = 2 * pos + 1;
+         if (child >= _heapCount) break;
+         if (child + 1 < _heapCount && before(_heap[child + 1], _heap[child])) child++;
+         if (!before(_heap[child], n)) break;
+         place(pos, _heap[child]);
+         pos = child;
+      }
+      place(pos, n);
+   }
+
+   void push(uint16_t n) {
+      place(_heapCount, n);
+      siftUp(_heapCount++);
+   }
+
+   uint16_t pop() {
+      uint16_t n = _heap[0];
+      if (--_heapCount > 0) {
+         place(0, _heap[_heapCount]);
+         siftDown(0);
+      }
+      return n;
+   }
+
+   // -- Search --
+
+   void expand(uint16_t u) {
+      uint16_t cell = _nodes[u].cell;
+      int32_t col = cell % _cols;
+      int32_t row = cell / _cols;
+
+      for (uint8_t dir = 0; dir < 8; dir++) {
+         int8_t dx = stepX(dir);
+         int8_t dy = stepY(dir);
+         int32_t c = col + dx;
+         int32_t r = row + dy;
+         if (isBlocked(c, r) || bit(CLOSED, c, r)) continue;
+         bool diagonal = dx != 0 && dy != 0;
+         if (diagonal && (isBlocked(col + dx, row) || isBlocked(col, row + dy))) continue;
+
+         uint32_t g = (uint32_t)_nodes[u].g + (diagonal ? 23 : 16);
+         if (g >= 0xFFFF) continue;
+         uint16_t next = (uint16_t)(r * _cols + c);
+         uint16_t n = findNode(next);
+         if (n == None) {
+            n = addNode(next);
+            if (n == None) {
+               _status = NO_MEMORY;
+               return;
+            }
+            _nodes[n].g = g;
+            uint32_t f = g + heuristic(next);
+            _nodes[n].f = f > 0xFFFF ? 0xFFFF : f;
+            push(n);
+         } else if (g < _nodes[n].g) {
+            _nodes[n].f -= _nodes[n].g - g;
+            _nodes[n].g = g;
+            siftUp(_nodes[n].heapPos);
+         } else {
+            continue;
+         }
+         setParentDir(next, (dir + 4) & 7);
+      }
+   }
+
+   // Cells cellLineOfSight() tests at most
+   uint16_t lineCells(uint16_t from, uint16_t to) const {
+      int32_t dx = (int32_t)(from % _cols) - (int32_t)(to % _cols);
+      int32_t dy = (int32_t)(from / _cols) - (int32_t)(to / _cols);
+      return (uint16_t)(1 + (dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy));
+   }
+
+   void startPull() {
+      _pulling = true;
+      _pathCount = 0;
+      _pathCells[_pathCount++] = _goalCell;
+      _pullCell = _goalCell;
+      _pullAnchor = _goalCell;
+   }
+
+   // From the goal back along the parents, keeping a corner only where the
+   // line from the last corner is blocked; then start to goal order. The
+   // exact start/goal replace their cell centers unless they were moved.
+   // Stops after budget cells of line of sight checks; SEARCHING until the
+   // start is reached.
+   Status pullStep(uint32_t budget) {
+      uint32_t tested = 0;
+      while (_pullCell != _startCell) {
+         uint16_t cell = parentOf(_pullCell);
+         uint16_t cost = lineCells(_pullAnchor, cell);
+         if (tested > 0 && tested + cost > budget) return SEARCHING;
+         tested += cost;
+         if (!cellLineOfSight(_pullAnchor, cell)) {
+            if (_pathCount >= MaxPathPoints - 1) return NO_MEMORY;
+            _pathCells[_pathCount++] = _pullCell;
+            _pullAnchor = _pullCell;
+         }
+         _pullCell = cell;
+      }
+      _pulling = false;
+
+      uint8_t count = _pathCount;
+      if (_goalCell != _startCell) _pathCells[count++] = _startCell;
+      for (uint8_t i = 0; i < count / 2; i++) {
+         uint16_t t = _pathCells[i];
+         _pathCells[i] = _pathCells[count - 1 - i];
+         _pathCells[count - 1 - i] = t;
+      }
+      keepMovedEnds(count);
+      return FOUND;
+   }
+
+   // _pathCells holds the corners start cell .. goal cell; drop the end
+   // cells that the exact start/goal stand for
+   void keepMovedEnds(uint8_t count) {
+      uint8_t first = _startMoved ? 0 : 1;
+      uint8_t last = _goalMoved ? count : count - 1;
+      if (count == 1 && (_startMoved || _goalMoved)) {
+         first = 0;
+         last = 1;
+      }
+      _pathCount = 0;
+      for (uint8_t i = first; i < last; i++) _pathCells[_pathCount++] = _pathCells[i];
+   }
+
+public:
+   // workspace: caller's array of bytes / 2 words
+   TransitPlanner(uint16_t *workspace, uint32_t bytes)
+      : _workspace(workspace), _bytes(bytes), _valid(false),
+        _originX(0), _originY(0), _cellMM(500), _cols(0), _rows(0), _stride(0), _planeBytes(0),
+        _planes(nullptr), _nodes(nullptr), _heap(nullptr), _hash(nullptr),
+        _maxNodes(0), _nodesUsed(0), _freeNode(None), _openCount(0), _peakOpen(0), _heapCount(0),
+        _hashBits(0), _expansionsPerStep(DefaultExpansionsPerStep), _weight(DefaultWeight),
+        _expanded(0), _status(IDLE), _startCell(None), _goalCell(None),
+        _startMoved(false), _goalMoved(false), _pulling(false), _pullCell(None), _pullAnchor(None),
+        _pathCount(0) {}
+
+   // Build the occupancy grid. False if the planes and MinNodes do not fit
+   // the workspace (use larger cells).
+   bool begin(const PerimeterStorage &perimeter, uint16_t cellMM = 500, uint16_t clearanceMM = 300) {
+      _valid = false;
+      _status = IDLE;
+      _pathCount = 0;
+      if (perimeter.getCount() < 3 || cellMM < 16) return false;
+
+      int32_t minX, maxX, minY, maxY;
+      perimeter.getBounds(minX, maxX, minY, maxY);
+      _cellMM = cellMM;
+      _originX = minX;
+      _originY = minY;
+      uint32_t cols = (uint32_t)(maxX - minX) / cellMM + 1;
+      uint32_t rows = (uint32_t)(maxY - minY) / cellMM + 1;
+      if (cols * rows >= None) {
+         DEBUG_PRINTLN("Transit grid too large");
+         return false;
+      }
+      _cols = cols;
+      _rows = rows;
+      _stride = (cols + 7) / 8;
+      _planeBytes = (uint32_t)_stride * _rows;
+
+      // Layout: planes, nodes, heap, hash
+      uint32_t planeWords = (Planes * _planeBytes + 1) / 2;
+      uint32_t rest = _bytes > 2 * planeWords ? _bytes - 2 * planeWords : 0;
+      uint32_t nodes = rest / BytesPerNode;
+      _hashBits = 0;
+      while (((uint32_t)2 << _hashBits) <= 2 * nodes && _hashBits < 15) _hashBits++;
+      uint32_t maxLoad = ((uint32_t)3 << _hashBits) / 4;
+      _maxNodes = nodes < maxLoad ? nodes : maxLoad;
+      if (_maxNodes < MinNodes) {
+         DEBUG_PRINTLN("Transit grid does not fit the workspace");
+         return false;
+      }
+
+      _planes = (uint8_t *)_workspace;
+      _nodes = (Node *)(_workspace + planeWords);
+      _heap = (uint16_t *)(_nodes + _maxNodes);
+      _hash = _heap + _maxNodes;
+
+      rasterise(perimeter, clearanceMM);
+      _valid = true;
+      return true;
+   }
+
+   // Start a search; step() continues it. FOUND at once if the straight
+   // line is free.
+   Status plan(const Point2D_int &from, const Point2D_int &to) {
+      _from = from;
+      _to = to;
+      _pathCount = 0;
+      _pulling = false;
+      _expanded = 0;
+      _peakOpen = 0;
+      if (!_valid) return _status = NO_PATH;
+
+      bool fromClamped, toClamped;
+      uint16_t fromCell = cellOf(from, fromClamped);
+      uint16_t toCell = cellOf(to, toClamped);
+      _startCell = nearestFree(fromCell);
+      _goalCell = nearestFree(toCell);
+      if (_startCell == None || _goalCell == None) return _status = NO_PATH;
+      _startMoved = fromClamped || _startCell != fromCell;
+      _goalMoved = toClamped || _goalCell != toCell;
+
+      if (cellLineOfSight(_startCell, _goalCell)) {
+         uint8_t count = 0;
+         _pathCells[count++] = _startCell;
+         if (_goalCell != _startCell) _pathCells[count++] = _goalCell;
+         keepMovedEnds(count);
+         return _status = FOUND;
+      }
+
+      for (uint32_t i = 0; i < _planeBytes; i++) _planes[CLOSED * _planeBytes + i] = 0;
+      for (uint32_t i = 0; i < ((uint32_t)1 << _hashBits); i++) _hash[i] = None;
+      _nodesUsed = 0;
+      _freeNode = None;
+      _openCount = 0;
+      _heapCount = 0;
+
+      uint16_t start = addNode(_startCell);
+      _nodes[start].g = 0;
+      _nodes[start].f = heuristic(_startCell);
+      push(start);
+      _status = SEARCHING;
+      return _status;
+   }
+
+   // Expand up to setStepBudget() cells, or pull the path straight
+   Status step() {
+      if (_status != SEARCHING) return _status;
+      if (_pulling) return _status = pullStep((uint32_t)_expansionsPerStep * 8);
+
+      for (uint16_t k = 0; k < _expansionsPerStep; k++) {
+         if (_heapCount == 0) return _status = NO_PATH;
+         uint16_t u = pop();
+         uint16_t cell = _nodes[u].cell;
+         setBit(CLOSED, cell % _cols, cell / _cols, true);
+         _expanded++;
+
+         if (cell == _goalCell) {
+            startPull();
+            return _status;
+         }
+         expand(u);
+         releaseNode(u);
+         if (_status == NO_MEMORY) return _status;
+      }
+      return _status;
+   }
+
+   // plan() and step() until done
+   Status findPath(const Point2D_int &from, const Point2D_int &to) {
+      plan(from, to);
+      while (_status == SEARCHING) step();
+      return _status;
+   }
+
+   // Heuristic weight in 1/16: above 16 the path may be up to weight/16
+   // times longer than the best, for fewer expanded cells
+   void setHeuristicWeight(uint8_t weight16) {
+      _weight = weight16 < 16 ? 16 : weight16;
+   }
+
+   void setStepBudget(uint16_t expansions) {
+      _expansionsPerStep = expansions > 0 ? expansions : 1;
+   }
+
+   // Path corners in mm: from, ..., to (FOUND only)
+   uint8_t getPathCount() const {
+      return _status == FOUND ? _pathCount + 2 : 0;
+   }
+
+   Point2D_int getPathPoint(uint8_t i) const {
+      if (i == 0) return _from;
+      if (i > _pathCount) return _to;
+      return cellCenter(_pathCells[i - 1]);
+   }
+
+   Point2D_int cellCenter(uint16_t cell) const {
+      return Point2D_int(_originX + (int32_t)(cell % _cols) * _cellMM + _cellMM / 2,
+                         _originY + (int32_t)(cell / _cols) * _cellMM + _cellMM / 2);
+   }
+
+   bool isFree(const Point2D_int &p) const {
+      bool clamped;
+      uint16_t cell = cellOf(p, clamped);
+      return _valid && !clamped && !isBlocked(cell % _cols, cell / _cols);
+   }
+
+   // Straight drive from a to b stays in free cells
+   bool lineOfSight(const Point2D_int &a, const Point2D_int &b) const {
+      bool clampedA, clampedB;
+      uint16_t ca = cellOf(a, clampedA);
+      uint16_t cb = cellOf(b, clampedB);
+      return _valid && !clampedA && !clampedB && cellLineOfSight(ca, cb);
+   }
+
+   Status getStatus() const { return _status; }
+   bool isValid() const { return _valid; }
+   uint16_t getCols() const { return _cols; }
+   uint16_t getRows() const { return _rows; }
+   uint16_t getCellMM() const { return _cellMM; }
+   uint16_t getMaxNodes() const { return _maxNodes; }
+   uint16_t getPeakOpen() const { return _peakOpen; }          // Last search
+   uint32_t getExpanded() const { return _expanded; }          // Last search
+   uint32_t getGridBytes() const { return Planes * _planeBytes; }
+};
+
+#endif
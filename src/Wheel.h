@@ -4,12 +4,20 @@
 #include "globals.hpp"
 #include "Arduino.h"
 #include "motor.hpp"
+#include "WheelSpeedPID.h"
 
-// Wheel class - manages speed interpolation for a single wheel
+// WheelT - manages speed interpolation for a single wheel
 // Uses composition (HAS-A motor) instead of inheritance (IS-A motor)
-class Wheel {
+// MotorT is held by value and called directly (static dispatch). It only
+// needs move(int), stop(), reset() and getSpeed() - e.g. L298Driver, or
+// MotorRef to forward to a runtime-polymorphic Motor*.
+// Open loop by default. With setClosedLoop(true) the interpolated speed is the
+// setpoint of a WheelSpeedPID and controlStep() (fixed rate, measured speed)
+// writes the motor instead.
+template <class MotorT>
+class WheelT {
 private:
-   Motor* _motor;         // Motor driver (L298, etc.) - composition!
+   MotorT _motor;         // Motor driver (L298Driver, MotorRef, etc.) - composition!
    int  TargetSpeed;     // integer speed (-1023..+1023)
    int  CurSpeed;        // integer speed currently applied
    // Fixed-point accumulator for smooth interpolation
@@ -18,18 +26,22 @@ private:
    int32_t cur_acc;      // CurSpeed * SCALE
    int32_t target_acc;   // TargetSpeed * SCALE
    int32_t step_acc;     // per-iteration increment in accumulator units
+   // Closed-loop speed control (optional)
+   WheelSpeedPID _pid;
+   bool _closedLoop;
+   int  _command;        // Last motor command in closed loop
 
 public:
    // Constructor - takes a motor driver as parameter (dependency injection)
-   Wheel(Motor* motor) : _motor(motor) {
+   WheelT(const MotorT& motor) : _motor(motor) {
       CurSpeed = 0;
       TargetSpeed = 0;
       cur_acc = 0;
       target_acc = 0;
       step_acc = 0;
-      if (_motor) {
-         _motor->reset();
-      }
+      _closedLoop = false;
+      _command = 0;
+      _motor.reset();
    };
 
    // Emit interpolated speed
@@ -40,9 +52,7 @@ public:
       // Only update motor if changed
       if (newSpeed != CurSpeed) {
          CurSpeed = newSpeed;
-         if (_motor) {
-            _motor->move(CurSpeed);
-         }
+         if (!_closedLoop) _motor.move(CurSpeed);
       }
    };
 
@@ -53,9 +63,7 @@ public:
       cur_acc = (int32_t)CurSpeed * SCALE;
       target_acc = (int32_t)TargetSpeed * SCALE;
       step_acc = 0;
-      if (_motor) {
-         _motor->move(TargetSpeed);
-      }
+      if (!_closedLoop) _motor.move(TargetSpeed);
    };
 
    // Set target speed with number of interpolation steps
@@ -79,12 +87,43 @@ public:
       DEBUG_PRINTLN(iterations);
    };
 
+   // Closed-loop step: measured ground speed in mm/s (e.g. Odometry velocity)
+   void controlStep(int16_t measuredMMs) {
+      if (!_closedLoop) return;
+      int measured = (int)((int32_t)measuredMMs * MaxSpeed / MaxSpeedMMPerSec);
+      int cmd = _pid.update(CurSpeed, measured);
+      if (cmd != _command) {
+         _command = cmd;
+         _motor.move(cmd);
+      }
+   };
+
+   // Switch between open loop (speed -> motor) and PID velocity control
+   void setClosedLoop(bool on) {
+      if (on == _closedLoop) return;
+      _closedLoop = on;
+      _pid.reset();
+      _command = CurSpeed;
+      _motor.move(CurSpeed);
+   };
+
+   bool isClosedLoop() const { return _closedLoop; }
+
+   // PID gains, Q8 (256 = 1.0), per control step
+   void setSpeedGains(int16_t kp, int16_t ki, int16_t kd) { _pid.setGains(kp, ki, kd); }
+
    // Get current speed
    int getCurrentSpeed() const { return CurSpeed; }
 
+   // Get last command sent to the motor (differs from current speed in closed loop)
+   int getCommand() const { return _closedLoop ? _command : CurSpeed; }
+
    // Get target speed
    int getTargetSpeed() const { return TargetSpeed; }
 
+   // Access the composed motor driver
+   MotorT& motor() { return _motor; }
+
    // Reset wheel
    void reset() {
       CurSpeed = 0;
@@ -92,9 +131,9 @@ public:
       cur_acc = 0;
       target_acc = 0;
       step_acc = 0;
-      if (_motor) {
-         _motor->reset();
-      }
+      _pid.reset();
+      _command = 0;
+      _motor.reset();
    };
 
    // Stop wheel
@@ -104,10 +143,13 @@ public:
       cur_acc = 0;
       target_acc = 0;
       step_acc = 0;
-      if (_motor) {
-         _motor->stop();
-      }
+      _pid.reset();
+      _command = 0;
+      _motor.stop();
    };
 };
 
+// Wheel - runtime-polymorphic wheel driving any Motor* (L298, VirtualMotor, ...)
+using Wheel = WheelT<MotorRef>;
+
 #endif
@@ -0,0 +1,90 @@
+#ifndef WHEELENCODER_H
+#define WHEELENCODER_H
+
+#include "globals.hpp"
+#include "Arduino.h"
+#include <YetAnotherPcInt.h>
+
+// Consistent copy of the encoder state taken outside the ISR
+typedef struct {
+   uint16_t ticks;          // Free-running tick count (wraps, use int16_t differences)
+   uint32_t lastEdgeUs;     // ISR entry time of the last counted edge
+} EncoderSnapshot;
+
+// WheelEncoder - quadrature wheel encoder on PCINT pins
+//
+// Channel A is decoded on both edges (x2); channel B, read in the same ISR,
+// gives the direction. Without a B channel (pinB = NoPin) the direction comes
+// from setDirectionHint(), e.g. the sign of the commanded wheel speed.
+//
+// The ISR only touches a 16 bit counter and the edge timestamp (from the PCINT
+// dispatcher), so it is a few dozen cycles. The counter wraps freely: readers
+// take differences as int16_t, which is exact as long as they poll at least
+// every 32767 ticks. snapshot() re-reads until the ISR did not fire in
+// between, so no interrupt locking is needed.
+class WheelEncoder {
+public:
+   static constexpr uint8_t NoPin = 0xFF;
+
+private:
+   uint8_t _pinA;
+   uint8_t _pinB;
+   volatile uint8_t *_portB;        // Direct input register of channel B
+   uint8_t _maskB;
+   bool _invert;                    // Mirrored mounting (left wheel)
+   volatile int8_t _dirHint;
+
+   volatile uint16_t _ticks;
+   volatile uint32_t _lastEdgeUs;
+   volatile uint8_t _seq;           // Bumped by every counted edge
+
+public:
+   WheelEncoder(uint8_t pinA, uint8_t pinB = NoPin, bool invert = false)
+      : _pinA(pinA), _pinB(pinB), _portB(nullptr), _maskB(0), _invert(invert), _dirHint(1),
+        _ticks(0), _lastEdgeUs(0), _seq(0) {}
+
+   void begin() {
+      pinMode(_pinA, INPUT_PULLUP);
+      if (_pinB != NoPin) {
+         pinMode(_pinB, INPUT_PULLUP);
+         _portB = portInputRegister(digitalPinToPort(_pinB));
+         _maskB = digitalPinToBitMask(_pinB);
+      }
+      PcInt::attachInterrupt(_pinA, edge, this, CHANGE);
+   }
+
+   void end() {
+      PcInt::detachInterrupt(_pinA);
+   }
+
+   // Direction used when there is no B channel: +1 forward, -1 reverse
+   void setDirectionHint(int speed) { _dirHint = speed < 0 ? -1 : 1; }
+
+   EncoderSnapshot snapshot() const {
+      EncoderSnapshot s;
+      uint8_t seq;
+      do {
+         seq = _seq;
+         s.ticks = _ticks;
+         s.lastEdgeUs = _lastEdgeUs;
+      } while (seq != _seq);
+      return s;
+   }
+
+   // Static interupt handler
+   static void edge(WheelEncoder *_this, bool pinstate, PcInt::timestamp_t when) {
+      int8_t dir;
+      if (_this->_portB) {
+         bool b = (*_this->_portB & _this->_maskB) != 0;
+         dir = (pinstate == b) ? 1 : -1;
+      } else {
+         dir = _this->_dirHint;
+      }
+      if (_this->_invert) dir = -dir;
+      _this->_ticks += dir;
+      _this->_lastEdgeUs = when;
+      _this->_seq++;
+   }
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef WHEELSPEEDPID_H
+#define WHEELSPEEDPID_H
+
+#include "globals.hpp"
+
+// WheelSpeedPID - fixed-point velocity loop for one wheel
+// INTEGER ONLY - speeds in wheelSpeed units (MaxSpeed = MaxSpeedMMPerSec)
+//
+//   out = setpoint                           feed-forward: the open-loop command
+//       + Kp * err + I - Kd * d(measured)    correction
+//
+// - Gains are Q8 (256 = 1.0) and per call: the loop must run at a fixed rate,
+//   so dt is folded into Ki and Kd.
+// - Derivative acts on the measurement, not the error, so setpoint ramps
+//   don't kick it.
+// - Anti-windup: the integrator is clamped to +/- IntegratorLimit and doesn't
+//   grow while the output is saturated in the same direction.
+class WheelSpeedPID {
+public:
+   static constexpr int32_t GainOne = 256;
+   static constexpr int OutputLimit = 1023;     // Motor speed range (motor.hpp)
+   static constexpr int32_t IntegratorLimit = (int32_t)(MaxSpeed / 2) * GainOne;
+
+private:
+   int16_t _kp;
+   int16_t _ki;
+   int16_t _kd;
+   int32_t _iAcc;           // Integrator, Q8
+   int16_t _lastMeasured;
+
+public:
+   WheelSpeedPID(int16_t kp = 128, int16_t ki = 16, int16_t kd = 0)
+      : _kp(kp), _ki(ki), _kd(kd), _iAcc(0), _lastMeasured(0) {}
+
+   void setGains(int16_t kp, int16_t ki, int16_t kd) {
+      _kp = kp;
+      _ki = ki;
+      _kd = kd;
+   }
+
+   void reset() {
+      _iAcc = 0;
+      _lastMeasured = 0;
+   }
+
+   // One control step: returns the motor command (-OutputLimit..OutputLimit)
+   int update(int setpoint, int measured) {
+      // Commanded stop: stop, don't let the integrator hold the wheel
+      if (setpoint == 0) {
+         reset();
+         _lastMeasured = measured;
+         return 0;
+      }
+
+      int32_t err = (int32_t)setpoint - measured;
+      int32_t dMeas = (int32_t)measured - _lastMeasured;
+      _lastMeasured = measured;
+
+      int32_t pd = _kp * err - _kd * dMeas;
+      int32_t iNext = _iAcc + _ki * err;
+      if (iNext > IntegratorLimit) iNext = IntegratorLimit;
+      if (iNext < -IntegratorLimit) iNext = -IntegratorLimit;
+
+      int32_t out = setpoint + (pd + iNext) / GainOne;
+
+      if (out > OutputLimit) {
+         out = OutputLimit;
+         if (err < 0) _iAcc = iNext;       // Only integrate back out of saturation
+      } else if (out < -OutputLimit) {
+         out = -OutputLimit;
+         if (err > 0) _iAcc = iNext;
+      } else {
+         _iAcc = iNext;
+      }
+      return (int)out;
+   }
+};
+
+#endif
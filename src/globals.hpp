@@ -6,6 +6,7 @@
 #include "Arduino.h"
 #include <TaskSchedulerDeclarations.h>
 #include <queue.h>
+#include "RingBuffer.h"
 #include "MowerTypes.h"
 
 // Debug output control
@@ -31,7 +32,21 @@ typedef enum {
    CIRCLE,
    TURN_LEFT,
    SLOW_DOWN,
-   AVOID_OBSTACLE
+   AVOID_OBSTACLE,
+   EMERGENCY_STOP,
+   GENTLE_STOP,
+   SPOT_TURN_LEFT_90,
+   SPOT_TURN_RIGHT_90,
+   SPOT_TURN_180,
+   REVERSE_AND_TURN,
+   GENTLE_ARC_LEFT,
+   GENTLE_ARC_RIGHT,
+   PERIMETER_SEARCH_SPIRAL,
+   GPS_DRIFT_CORRECTION,
+   OBSTACLE_NUDGE_LEFT,
+   OBSTACLE_NUDGE_RIGHT,
+   TEARDROP_TURN_180,
+   TEARDROP_TURN_180_LEFT
 } CurrentMotion;
 
 typedef int16_t wheelSpeed;
@@ -64,11 +79,31 @@ constexpr wheelSpeed Speed10 = .1 * MaxSpeed;
 constexpr wheelSpeed Speed00 =  0;
 
 constexpr unsigned int WheelUpdateRate = 64; //How many mSec between speed updates.
+constexpr unsigned int SpeedControlRate = 10; //mSec between closed-loop wheel speed steps (= Odometry rate)
+
+// Drive geometry - used to compile geometric patterns (arc/straight/spiral). Calibrate per mower.
+constexpr int WheelBaseMM = 400;           // Distance between the wheel contact points
+constexpr int MaxSpeedMMPerSec = 500;      // Ground speed at MaxSpeed
+constexpr int WheelDiameterMM = 200;
+constexpr int EncoderTicksPerRev = 180;    // Counted edges per wheel turn (x2 decoding = 2 * encoder lines)
+
+// Sonar backend: 0 = PCINT edge handlers (sSonar), 1 = Timer1 input capture (sSonarICP)
+// The ICP backend needs the echo on ICP1 (D8) and Timer1 (no analogWrite on 9/10, no Servo).
+#define SONAR_BACKEND_ICP 0
+
+// I2C: 0 = blocking Wire calls (IMUInterface::begin/update), 1 = interrupt driven
+// transaction queue (I2CBusTWI + IMUAsync). With 1 the TWI vector belongs to
+// I2CBusTWI, so nothing may use Wire.
+#define I2C_ASYNC 0
 
 //// Pin assignments
 //DriveUnit
 constexpr unsigned int LEFTENABLE = 5;     // PWM support needed
+#if SONAR_BACKEND_ICP
+constexpr unsigned int LEFTIN1 = 12;       // D8 is taken by the sonar echo (ICP1)
+#else
 constexpr unsigned int LEFTIN1 = 8;
+#endif
 constexpr unsigned int LEFTIN2 = 9;
 
 constexpr unsigned int RIGHTENABLE = 6;     // PWM support needed
@@ -78,11 +113,25 @@ constexpr unsigned int RIGHTIN2 = 11;
 //Sonar
 constexpr unsigned int SONARTRIG = 4;
 constexpr unsigned int SONARECHO = 2;      // Interupt attached.
+constexpr unsigned int SONARECHO_ICP = 8;  // ICP1 - fixed by hardware (SONAR_BACKEND_ICP)
+// Sonar array (SonarArray): front uses SONARTRIG/SONARECHO
+constexpr unsigned int SONARTRIG_LEFT = 14;   // A0
+constexpr unsigned int SONARECHO_LEFT = 15;   // A1, interupt attached.
+constexpr unsigned int SONARTRIG_RIGHT = 16;  // A2
+constexpr unsigned int SONARECHO_RIGHT = 17;  // A3, interupt attached.
+
+//Wheel encoders (WheelEncoder) - all on PCINT1 (port C).
+//A0-A3 are shared with the sonar array side sensors; running both needs a board with more pins.
+constexpr unsigned int LEFTENC_A = 14;     // A0, interupt attached.
+constexpr unsigned int LEFTENC_B = 15;     // A1, direction only (0xFF = none)
+constexpr unsigned int RIGHTENC_A = 16;    // A2, interupt attached.
+constexpr unsigned int RIGHTENC_B = 17;    // A3, direction only (0xFF = none)
 
 //Boundary Wire Fence detection
 constexpr unsigned int BWFINPUT = 3;       // Interupt attached.
 constexpr unsigned int BWFSIDE = 7;         // Interupt attached.
 
-typedef  Queue<unsigned int,4,0>  SonarQueue;  // <int,4,0> 
+// Sensor data from ISRs: lock-free SPSC ring, oldest reading dropped when full
+typedef  RingBuffer<unsigned int,4>  SonarQueue;
 
 #endif
\ No newline at end of file
@@ -2,11 +2,22 @@
 #include "globals.hpp"
 #include <TaskScheduler.h>
 #include <SensorSonar.h>
+#include <SensorSonarICP.h>
+#include <SensorSonarArray.h>
+#include <SonarFilter.h>
+#include <WheelEncoder.h>
+#include <Odometry.h>
+#include <SpeedControl.h>
 #include <AllMoves.h>
 #include <DriveUnit.h>
 #include <Queue.h>
 #include <GPSInterface.h>
 #include <IMUInterface.h>
+#if I2C_ASYNC
+#include <I2CBusTWI.h>
+#include <IMUAsync.h>
+#endif
+#include <PoseEKF.h>
 #include <LineFollower.h>
 
 #include "Serial_mon.h"
@@ -16,18 +27,39 @@ unsigned int _distance;
 SerialSetup s(115200);
  
 SonarQueue SonarData; 
+SonarFilter<5> sonarFilter;          // Median-of-5, jump gate, time to collision
 
 //Scheduler and Tasks
 Scheduler TS;
-DriveUnit drivingUnit(&TS,WheelUpdateRate);
+// L298 drivers held by value: no heap, per-tick move() resolved at compile time
+L298DriveUnit drivingUnit(&TS, WheelUpdateRate,
+                          L298Driver(LEFTENABLE, LEFTIN1, LEFTIN2),
+                          L298Driver(RIGHTENABLE, RIGHTIN1, RIGHTIN2));
+#if SONAR_BACKEND_ICP
+sSonarICP sonarA0(&TS,25, &SonarData ,SONARTRIG);
+#else
 sSonar sonarA0(&TS,25, &SonarData ,SONARTRIG, SONARECHO);
+#endif
+
+// Wheel encoders and dead reckoning (100Hz)
+WheelEncoder leftEncoder(LEFTENC_A, LEFTENC_B, true);   // Mirrored mounting
+WheelEncoder rightEncoder(RIGHTENC_A, RIGHTENC_B);
+Odometry odometry(&TS, &leftEncoder, &rightEncoder, EncoderTicksPerRev, WheelDiameterMM);
+SpeedControlT<L298DriveUnit> speedControl(&TS, &drivingUnit, &odometry);   // Closed-loop wheel speeds (optional)
 
 // GPS and IMU sensors
 GPSInterface gps;
 IMUInterface imu;
+#if I2C_ASYNC
+I2CBusTWI i2c(&TS);                   // Interrupt driven I2C, owns the TWI (no Wire)
+IMUAsync imuAsync(&TS, &i2c, &imu);   // Setup, calibration and sampling in the background
+#endif
+
+// Fused pose (50Hz): odometry and gyro, corrected by every GPS fix
+PoseEKF poseEKF(&TS, &odometry, &imu, &gps);
 
 // Line follower controller
-LineFollower lineFollower(&TS, &gps, &imu, &drivingUnit); 
+LineFollowerT<L298DriveUnit> lineFollower(&TS, &gps, &imu, &drivingUnit);
 
 void setMainTargetSpeed(movement m) { 
    drivingUnit.setTargetSpeed( m.leftSpeed, m.rightSpeed,m.mSec);
@@ -41,9 +73,18 @@ void setup() {
    Serial.println("Mower Control System Starting...");
 
    // Initialize sensors
-   gps.begin();
+   gps.begin();           // Simulated fix; with a receiver: gps.begin(&Serial1) (port begun at its baud rate)
+#if I2C_ASYNC
+   i2c.begin();
+   imuAsync.begin(true);  // Calibrates in the background (must be stationary until imuAsync.ready())
+#else
    imu.begin(true);  // true = enable magnetometer for compass heading
    imu.calibrate();  // Calibrate gyro (must be stationary)
+#endif
+   leftEncoder.begin();
+   rightEncoder.begin();
+   odometry.enable();
+   // speedControl.enable();   // Match wheel speeds to the ramp using encoder feedback
 
    // ===== EXAMPLE 1: Use predefined movement patterns =====
    // Uncomment to use circle pattern
@@ -64,23 +105,41 @@ void setup() {
    // Set initial position and heading for testing (normally from GPS/IMU)
    gps.setPositionTenthsOfMeters(0, -10);  // Start 1 meter to the left of the line
    imu.setHeadingDegrees(45);      // Facing 45 degrees (Northeast)
+   odometry.setPose(0, -1000, DEGREES_TO_ANGLE(45));
+   poseEKF.setPose(0, -1000, DEGREES_TO_ANGLE(45));
+   poseEKF.setGpsLatencyMs(100);   // Epoch to arrival of the receiver's fix, replayed away
+   poseEKF.enable();
+   lineFollower.setPoseEstimator(&poseEKF);   // Steer on the fused pose, slow down when it is uncertain
 
    // Enable line follower (starts following the line)
    lineFollower.enable();
 
    Serial.println("Line follower enabled - following line from (0,0) to (10,0)");
    Serial.println("Starting position: (0, -1), heading: 45 degrees");
+
+   // ===== EXAMPLE 3: Three-sensor sonar array (instead of sonarA0) =====
+   // Needs globals: SonarScanQueue SonarScans; SonarArray sonars(&TS, &SonarScans);
+   // uint8_t left  = sonars.addSensor(SONARTRIG_LEFT,  SONARECHO_LEFT,  1500);
+   // uint8_t front = sonars.addSensor(SONARTRIG,       SONARECHO,       2500);
+   // uint8_t right = sonars.addSensor(SONARTRIG_RIGHT, SONARECHO_RIGHT, 1500);
+   // const uint8_t order[] = { front, left, front, right };   // Front sampled twice per round
+   // sonars.setFiringOrder(order, 4);
+   // sonars.enable();
 };
 
 void loop() {
    // Main task scheduler - handles all periodic tasks
    TS.execute();
 
+   // Drain the GPS receive buffer every pass (fixes at 10-20Hz, 64 byte UART buffer)
+   gps.update();
+
    // Update sensors periodically
    static unsigned long lastSensorUpdate = 0;
    if (millis() - lastSensorUpdate > 50) {  // Update at ~20Hz
-      gps.update();
+#if !I2C_ASYNC
       imu.update();
+#endif
       lastSensorUpdate = millis();
    }
 
@@ -114,17 +173,19 @@ void loop() {
       }
    }
 
-   if (SonarData.pull(_distance)) { // We have a measured distance to handle
-      if (_distance < sSonar::MMtoMeasure(500)) {
-         Serial.println("Obstacle detected - slowing down");
-         lineFollower.setBaseSpeed(Speed20);  // Slow down
-      }
-      else if (_distance < sSonar::MMtoMeasure(150)) {
+   if (SonarData.pull(_distance) && sonarFilter.updateEcho(_distance, millis())) {
+      // Act on time to collision, not on single raw readings
+      uint16_t ttc = sonarFilter.timeToCollisionMs();
+      if (sonarFilter.distanceMM() < 150 || ttc < 1000) {
          // Stop line following and avoid obstacle
          Serial.println("Obstacle too close - stopping");
          lineFollower.disable();
          sonarA0.Stop();
-         moves.setCurrentPattern(AVOIDOBSTACLE);
+         moves.preempt(AVOID_OBSTACLE, PRIORITY_OBSTACLE);
+      }
+      else if (sonarFilter.distanceMM() < 500 || ttc < 3000) {
+         Serial.println("Obstacle detected - slowing down");
+         lineFollower.setBaseSpeed(Speed20);  // Slow down
       }
    }
 */
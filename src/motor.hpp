@@ -75,4 +75,26 @@ class Motor {
       static const int MOTOR_SPEED_MIN = -1023;
 };
 
+/**
+ * MotorRef - non-owning handle to a runtime-polymorphic Motor
+ *
+ * Gives a Motor* the same by-value interface as the static drivers
+ * (L298Driver, ...) so WheelT/DriveUnitT can be instantiated for both.
+ * A null handle silently ignores all commands.
+ */
+class MotorRef {
+   public:
+      MotorRef(Motor* motor = nullptr) : _motor(motor) {};
+
+      void move(int speed) { if (_motor) _motor->move(speed); }
+      void stop()          { if (_motor) _motor->stop(); }
+      void reset()         { if (_motor) _motor->reset(); }
+      int  getSpeed()      { return _motor ? _motor->getSpeed() : 0; }
+
+      Motor* get() const   { return _motor; }
+
+   private:
+      Motor* _motor;
+};
+
 #endif
\ No newline at end of file
@@ -1,192 +1,191 @@
-
-inline static constexpr movement Continous[] = { 
-   { Speed70, Speed70, 3001},
-   { Speed80, Speed80, 3001}, 
-   { Speed90, Speed90, 3001}, 
-   { Speed90, Speed90, 8001}, 
-   { 0, 0, 0 }
-};
-
-inline static constexpr movement ChargerBackout[] = { 
-   { -Speed20, -Speed20, 1002},
-   { Speed00, -Speed20, 402}, 
-   { Speed30,  Speed00, 1002}, 
-   { Speed40,  Speed40, 602}, 
-   { Speed90,  Speed90, 802}, 
-   { 0, 0, 0 }
-};
-
-inline static constexpr movement BWFLeft[] = {
-   { Speed40, Speed00, 403},
-   { Speed40, -Speed10, 203},
-   { Speed40, Speed10, 403},
-   { Speed40, Speed40, 603},
-   { Speed80, Speed80, 703},
-   { 0, 0, 0 }
-};
-
-inline static constexpr movement BWFRight[] = {
-   { Speed00, Speed40, 404},
-   { -Speed10, -Speed40, 204},
-   { Speed10, Speed40, 404},
-   { Speed40, Speed40, 604},
-   { Speed80, Speed80, 704},
-   { 0, 0, 0 }
-};
-
-inline static constexpr movement Circle[] = {
-   { Speed40, -Speed40, 605},
-   { -Speed10, -Speed40, 705},
-   { Speed70, Speed60, 805},
-   { Speed90, Speed90, 905},
-   { 0, 0, 0 }
-};
-
-inline static constexpr movement TurnLeft[] = {
-   { Speed10, Speed60, 306},
-   { Speed00 , Speed40, 1006},
-   { Speed40, Speed40, 406},
-   { Speed90, Speed90, 806},
-   { 0, 0, 0 }
-};
-
-inline static constexpr movement SlowDown[] = {
-   { Speed30, Speed30, 507},
-   { Speed20 , Speed20, 107},
-   { Speed20 , Speed20, 3007},
-   { 0, 0, 0 }
-};
-
-inline static constexpr movement AvoidObstacle[] = {
-   { Speed20, -Speed30, 308},
-   { Speed20 , -Speed40, 408},
-   { Speed30 , Speed30, 2008},
-   { 0, 0, 0 }
-};
+#ifndef MOVEPATTERNS_H
+#define MOVEPATTERNS_H
+
+#include "MoveProgram.h"
+
+// Motion patterns - encoded at compile time into PROGMEM bytecode (see MoveProgram.h)
+// Speeds are quantized to 1% of MaxSpeed, so use multiples of Speed10/SpeedQuantum.
+// Turns and arcs use the geometric steps so they follow WheelBaseMM/MaxSpeedMMPerSec.
+namespace MovePatterns {
+using namespace MoveProgram;
+
+MOVE_PATTERN(Continous,
+   speed(Speed70, Speed70, 3001),
+   speed(Speed80, Speed80, 3001), 
+   speed(Speed90, Speed90, 3001), 
+   speed(Speed90, Speed90, 8001), 
+   end()
+)
+
+MOVE_PATTERN(ChargerBackout,
+   speed(-Speed20, -Speed20, 1002),
+   speed(Speed00, -Speed20, 402), 
+   speed(Speed30, Speed00, 1002), 
+   speed(Speed40, Speed40, 602), 
+   speed(Speed90, Speed90, 802), 
+   end()
+)
+
+MOVE_PATTERN(BWFLeft,
+   speed(Speed40, Speed00, 403),
+   speed(Speed40, -Speed10, 203),
+   speed(Speed40, Speed10, 403),
+   speed(Speed40, Speed40, 603),
+   speed(Speed80, Speed80, 703),
+   end()
+)
+
+MOVE_PATTERN(BWFRight,
+   speed(Speed00, Speed40, 404),
+   speed(-Speed10, -Speed40, 204),
+   speed(Speed10, Speed40, 404),
+   speed(Speed40, Speed40, 604),
+   speed(Speed80, Speed80, 704),
+   end()
+)
+
+MOVE_PATTERN(Circle,
+   speed(Speed40, -Speed40, 605),
+   speed(-Speed10, -Speed40, 705),
+   speed(Speed70, Speed60, 805),
+   speed(Speed90, Speed90, 905),
+   end()
+)
+
+MOVE_PATTERN(TurnLeft,
+   speed(Speed10, Speed60, 306),
+   speed(Speed00, Speed40, 1006),
+   speed(Speed40, Speed40, 406),
+   speed(Speed90, Speed90, 806),
+   end()
+)
+
+MOVE_PATTERN(SlowDown,
+   speed(Speed30, Speed30, 507),
+   speed(Speed20, Speed20, 107),
+   speed(Speed20, Speed20, 3007),
+   end()
+)
+
+MOVE_PATTERN(AvoidObstacle,
+   speed(Speed20, -Speed30, 308),
+   speed(Speed20, -Speed40, 408),
+   speed(Speed30, Speed30, 2008),
+   end()
+)
 
 // Emergency stop - immediate deceleration for safety
-inline static constexpr movement EmergencyStop[] = {
-   { Speed00, Speed00, 100},
-   { 0, 0, 0 }
-};
+MOVE_PATTERN(EmergencyStop,
+   speed(Speed00, Speed00, 100),
+   halt()
+)
 
 // Gentle stop - gradual deceleration to minimize grass wear
-inline static constexpr movement GentleStop[] = {
-   { Speed60, Speed60, 200},
-   { Speed40, Speed40, 200},
-   { Speed20, Speed20, 200},
-   { Speed00, Speed00, 100},
-   { 0, 0, 0 }
-};
+MOVE_PATTERN(GentleStop,
+   speed(Speed60, Speed60, 200),
+   speed(Speed40, Speed40, 200),
+   speed(Speed20, Speed20, 200),
+   speed(Speed00, Speed00, 100),
+   halt()
+)
 
 // Spot turn left 90° - in-place rotation for orientation correction
-inline static constexpr movement SpotTurnLeft90[] = {
-   { Speed00, Speed00, 200},     // Stop first
-   { -Speed30, Speed30, 800},    // Rotate left ~90° at moderate speed
-   { Speed00, Speed00, 200},     // Stop and settle
-   { 0, 0, 0 }
-};
+MOVE_PATTERN(SpotTurnLeft90,
+   speed(Speed00, Speed00, 200),     // Stop first
+   speed(-Speed30, Speed30, 800),    // Rotate left ~90° at moderate speed
+   speed(Speed00, Speed00, 200),     // Stop and settle
+   end()
+)
 
 // Spot turn right 90° - in-place rotation for orientation correction
-inline static constexpr movement SpotTurnRight90[] = {
-   { Speed00, Speed00, 200},     // Stop first
-   { Speed30, -Speed30, 800},    // Rotate right ~90° at moderate speed
-   { Speed00, Speed00, 200},     // Stop and settle
-   { 0, 0, 0 }
-};
+MOVE_PATTERN(SpotTurnRight90,
+   speed(Speed00, Speed00, 200),     // Stop first
+   speed(Speed30, -Speed30, 800),    // Rotate right ~90° at moderate speed
+   speed(Speed00, Speed00, 200),     // Stop and settle
+   end()
+)
 
 // Spot turn 180° - full reverse orientation
-inline static constexpr movement SpotTurn180[] = {
-   { Speed00, Speed00, 200},     // Stop first
-   { -Speed30, Speed30, 1600},   // Rotate left 180° at moderate speed
-   { Speed00, Speed00, 200},     // Stop and settle
-   { 0, 0, 0 }
-};
+MOVE_PATTERN(SpotTurn180,
+   speed(Speed00, Speed00, 200),     // Stop first
+   speed(-Speed30, Speed30, 1600),   // Rotate left 180° at moderate speed
+   speed(Speed00, Speed00, 200),     // Stop and settle
+   end()
+)
 
 // Reverse and turn - recovery pattern when stuck or blocked
-inline static constexpr movement ReverseAndTurn[] = {
-   { -Speed40, -Speed40, 1000},  // Reverse straight
-   { -Speed30, Speed00, 400},    // Reverse while turning left
-   { Speed00, Speed00, 200},     // Stop
-   { Speed40, Speed40, 600},     // Move forward
-   { 0, 0, 0 }
-};
+MOVE_PATTERN(ReverseAndTurn,
+   speed(-Speed40, -Speed40, 1000),  // Reverse straight
+   speed(-Speed30, Speed00, 400),    // Reverse while turning left
+   speed(Speed00, Speed00, 200),     // Stop
+   speed(Speed40, Speed40, 600),     // Move forward
+   end()
+)
 
 // Gentle arc left - smooth left turn while moving forward
-inline static constexpr movement GentleArcLeft[] = {
-   { Speed50, Speed70, 1000},    // Gentle left arc
-   { Speed60, Speed80, 1000},    // Continue arc
-   { Speed70, Speed90, 1000},    // Complete arc
-   { 0, 0, 0 }
-};
+MOVE_PATTERN(GentleArcLeft,
+   arc(1400, 450, Speed70),          // 45° left on a 1.4m radius
+   end()
+)
 
 // Gentle arc right - smooth right turn while moving forward
-inline static constexpr movement GentleArcRight[] = {
-   { Speed70, Speed50, 1000},    // Gentle right arc
-   { Speed80, Speed60, 1000},    // Continue arc
-   { Speed90, Speed70, 1000},    // Complete arc
-   { 0, 0, 0 }
-};
+MOVE_PATTERN(GentleArcRight,
+   arc(1400, -450, Speed70),         // 45° right on a 1.4m radius
+   end()
+)
 
 // Perimeter search spiral - small spiral pattern to relocate boundary
-inline static constexpr movement PerimeterSearchSpiral[] = {
-   { Speed40, Speed40, 500},     // Forward
-   { Speed30, Speed50, 400},     // Turn right slight
-   { Speed40, Speed40, 700},     // Forward longer
-   { Speed30, Speed50, 400},     // Turn right slight
-   { Speed40, Speed40, 900},     // Forward even longer
-   { Speed30, Speed50, 400},     // Turn right slight
-   { Speed40, Speed40, 1100},    // Forward longest
-   { 0, 0, 0 }
-};
+MOVE_PATTERN(PerimeterSearchSpiral,
+   straight(200, Speed40),           // Forward
+   spiral(500, 1500, 2, Speed40),    // Two widening turns, 0.5m -> 1.5m radius
+   end()
+)
 
 // GPS drift correction - gentle forward movement for position update
-inline static constexpr movement GPSDriftCorrection[] = {
-   { Speed30, Speed30, 2000},    // Slow forward for 2 seconds
-   { Speed00, Speed00, 1000},    // Stop and wait for GPS lock
-   { 0, 0, 0 }
-};
+MOVE_PATTERN(GPSDriftCorrection,
+   speed(Speed30, Speed30, 2000),    // Slow forward for 2 seconds
+   speed(Speed00, Speed00, 1000),    // Stop and wait for GPS lock
+   end()
+)
 
 // Obstacle nudge left - gentle push to avoid obstacle on right
-inline static constexpr movement ObstacleNudgeLeft[] = {
-   { Speed50, Speed70, 300},     // Nudge left
-   { Speed60, Speed60, 500},     // Continue forward
-   { Speed70, Speed50, 300},     // Nudge back right
-   { Speed70, Speed70, 500},     // Resume straight
-   { 0, 0, 0 }
-};
+MOVE_PATTERN(ObstacleNudgeLeft,
+   speed(Speed50, Speed70, 300),     // Nudge left
+   speed(Speed60, Speed60, 500),     // Continue forward
+   speed(Speed70, Speed50, 300),     // Nudge back right
+   speed(Speed70, Speed70, 500),     // Resume straight
+   end()
+)
 
 // Obstacle nudge right - gentle push to avoid obstacle on left
-inline static constexpr movement ObstacleNudgeRight[] = {
-   { Speed70, Speed50, 300},     // Nudge right
-   { Speed60, Speed60, 500},     // Continue forward
-   { Speed50, Speed70, 300},     // Nudge back left
-   { Speed70, Speed70, 500},     // Resume straight
-   { 0, 0, 0 }
-};
-
-// Teardrop turn 180° - smooth arc turn for stripe mowing
+MOVE_PATTERN(ObstacleNudgeRight,
+   speed(Speed70, Speed50, 300),     // Nudge right
+   speed(Speed60, Speed60, 500),     // Continue forward
+   speed(Speed50, Speed70, 300),     // Nudge back left
+   speed(Speed70, Speed70, 500),     // Resume straight
+   end()
+)
+
+// Teardrop turn 180° right - smooth arc turn for stripe mowing
 // This pattern complements the GPS-based ParallelStripeMower arc generation
 // Useful for manual control or when GPS waypoints aren't available
-inline static constexpr movement TeardropTurn180[] = {
-   { Speed60, Speed60, 300},     // Approach at moderate speed
-   { Speed70, Speed90, 600},     // Start gentle right arc
-   { Speed60, Speed90, 600},     // Tighten arc (more differential)
-   { Speed50, Speed90, 600},     // Continue arc
-   { Speed60, Speed90, 600},     // Maintain arc
-   { Speed70, Speed90, 600},     // Widen arc slightly
-   { Speed80, Speed80, 300},     // Straighten out
-   { 0, 0, 0 }
-};
+MOVE_PATTERN(TeardropTurn180,
+   straight(150, Speed60),           // Approach at moderate speed
+   arc(500, 450, Speed60),           // Swing out left
+   arc(500, -2250, Speed60),         // Main right arc, net heading change -180°
+   straight(150, Speed80),           // Straighten out
+   end()
+)
 
 // Teardrop turn 180° left - mirror of right turn
-inline static constexpr movement TeardropTurn180Left[] = {
-   { Speed60, Speed60, 300},     // Approach at moderate speed
-   { Speed90, Speed70, 600},     // Start gentle left arc
-   { Speed90, Speed60, 600},     // Tighten arc (more differential)
-   { Speed90, Speed50, 600},     // Continue arc
-   { Speed90, Speed60, 600},     // Maintain arc
-   { Speed90, Speed70, 600},     // Widen arc slightly
-   { Speed80, Speed80, 300},     // Straighten out
-   { 0, 0, 0 }
-};
+MOVE_PATTERN(TeardropTurn180Left,
+   straight(150, Speed60),           // Approach at moderate speed
+   arc(500, -450, Speed60),          // Swing out right
+   arc(500, 2250, Speed60),          // Main left arc, net heading change +180°
+   straight(150, Speed80),           // Straighten out
+   end()
+)
+
+} // namespace MovePatterns
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+// Host stand-in for the Arduino core, enough for the headers under test.
+// Pins do nothing; the clock only moves when a test advances it.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define PI 3.1415926535897932384626433832795
+#define F_CPU 16000000UL
+#define constrain(a, lo, hi) ((a) < (lo) ? (lo) : ((a) > (hi) ? (hi) : (a)))
+#define _BV(b) (1u << (b))
+
+#define PROGMEM
+#define pgm_read_byte(a) (*(const uint8_t *)(a))
+#define pgm_read_word(a) (*(const uint16_t *)(a))
+#define pgm_read_dword(a) (*(const uint32_t *)(a))
+#define pgm_read_ptr(a) (*(void *const *)(a))
+
+#define noInterrupts()
+#define interrupts()
+
+namespace NativeClock {
+   inline unsigned long us = 0;
+   inline void advanceMs(unsigned long ms) { us += ms * 1000UL; }
+}
+
+inline unsigned long millis() { return NativeClock::us / 1000UL; }
+inline unsigned long micros() { return NativeClock::us; }
+inline void delay(unsigned long ms) { NativeClock::advanceMs(ms); }
+inline void delayMicroseconds(unsigned int us) { NativeClock::us += us; }
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return 0; }
+inline void analogWrite(uint8_t, int) {}
+inline uint8_t digitalPinToInterrupt(uint8_t pin) { return pin; }
+inline void attachInterrupt(uint8_t, void (*)(), int) {}
+inline void detachInterrupt(uint8_t) {}
+
+inline volatile uint8_t nativePort = 0;
+inline uint8_t digitalPinToPort(uint8_t) { return 0; }
+inline volatile uint8_t *portInputRegister(uint8_t) { return &nativePort; }
+inline volatile uint8_t *portOutputRegister(uint8_t) { return &nativePort; }
+inline uint8_t digitalPinToBitMask(uint8_t pin) { return 1 << (pin & 7); }
+
+class Stream {
+public:
+   virtual ~Stream() {}
+   virtual int available() { return 0; }
+   virtual int read() { return -1; }
+   virtual size_t write(uint8_t) { return 1; }
+};
+
+// Debug output is dropped
+class NativeSerial : public Stream {
+public:
+   void begin(long) {}
+   template <class T> void print(T) {}
+   template <class T> void print(T, int) {}
+   template <class T> void println(T) {}
+   template <class T> void println(T, int) {}
+   void println() {}
+};
+
+inline NativeSerial Serial;
+
+#endif
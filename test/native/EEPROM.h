@@ -0,0 +1,29 @@
+#ifndef NATIVE_EEPROM_H
+#define NATIVE_EEPROM_H
+
+#include <stdint.h>
+
+// 1KB like the Uno, erased to 0xFF
+class EEPROMClass {
+public:
+   uint8_t mem[1024];
+   uint32_t writes;
+
+   EEPROMClass() : writes(0) {
+      for (uint16_t i = 0; i < sizeof(mem); i++) mem[i] = 0xFF;
+   }
+
+   uint8_t read(int address) { return mem[address]; }
+   void write(int address, uint8_t value) {
+      mem[address] = value;
+      writes++;
+   }
+   void update(int address, uint8_t value) {
+      if (mem[address] != value) write(address, value);
+   }
+   uint16_t length() { return sizeof(mem); }
+};
+
+inline EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef NATIVE_TASKSCHEDULERDECLARATIONS_H
+#define NATIVE_TASKSCHEDULERDECLARATIONS_H
+
+// Host stand-in for TaskScheduler: tasks never run on their own, a test
+// calls Callback() (or runs the Scheduler, which does nothing) itself.
+
+#include <stdint.h>
+
+#define TASK_FOREVER (-1)
+#define TASK_ONCE 1
+#define TASK_IMMEDIATE 0
+#define TASK_SECOND 1000UL
+#define TASK_MILLISECOND 1UL
+
+class Scheduler {
+public:
+   bool execute() { return true; }
+};
+
+class StatusRequest {
+public:
+   void setWaiting(unsigned int = 1) {}
+   bool signal(int = 0) { return true; }
+   void signalComplete(int = 0) {}
+   bool pending() { return false; }
+   bool completed() { return true; }
+   int getStatus() { return 0; }
+};
+
+class Task {
+private:
+   unsigned long _interval;
+   long _iterations;
+   bool _enabled;
+   unsigned long _runCounter;
+
+public:
+   Task(unsigned long interval = 0, long iterations = 0, Scheduler * = nullptr, bool enable = false)
+      : _interval(interval), _iterations(iterations), _enabled(false), _runCounter(0) {
+      if (enable) this->enable();
+   }
+   virtual ~Task() {}
+
+   virtual bool Callback() { return true; }
+   virtual bool OnEnable() { return true; }
+   virtual void OnDisable() {}
+
+   void enable() {
+      if (_enabled) return;
+      _enabled = true;
+      _runCounter = 0;
+      if (!OnEnable()) _enabled = false;
+   }
+   bool enableIfNot() {
+      bool was = _enabled;
+      enable();
+      return was;
+   }
+   void enableDelayed(unsigned long = 0) { enable(); }
+   void disable() {
+      if (!_enabled) return;
+      _enabled = false;
+      OnDisable();
+   }
+   bool isEnabled() { return _enabled; }
+   void restart() {
+      disable();
+      enable();
+   }
+   void restartDelayed(unsigned long = 0) { restart(); }
+   void setInterval(unsigned long interval) { _interval = interval; }
+   unsigned long getInterval() { return _interval; }
+   void setIterations(long iterations) { _iterations = iterations; }
+   long getIterations() { return _iterations; }
+   unsigned long getRunCounter() { return _runCounter; }
+   void delay(unsigned long = 0) {}
+   void forceNextIteration() {}
+   bool isFirstIteration() { return _runCounter <= 1; }
+   bool isLastIteration() { return _iterations == 0; }
+   void waitFor(StatusRequest *, unsigned long = 0, long = 1) {}
+   StatusRequest *getInternalStatusRequest() { return nullptr; }
+
+   // Test hook: one scheduled run, as the Scheduler would do it
+   bool runOnce() {
+      if (!_enabled) return false;
+      _runCounter++;
+      bool result = Callback();
+      if (_iterations > 0 && --_iterations == 0) disable();
+      return result;
+   }
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef NATIVE_WIRE_H
+#define NATIVE_WIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// No device answers
+class TwoWire {
+public:
+   void begin() {}
+   void setClock(uint32_t) {}
+   void beginTransmission(uint8_t) {}
+   size_t write(uint8_t) { return 1; }
+   uint8_t endTransmission(bool = true) { return 2; }
+   uint8_t requestFrom(uint8_t, uint8_t, uint8_t = 1) { return 0; }
+   int read() { return -1; }
+   int available() { return 0; }
+};
+
+inline TwoWire Wire;
+
+#endif
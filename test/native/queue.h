@@ -0,0 +1,2 @@
+// globals.hpp includes <queue.h>; the file is src/Queue.h (case sensitive hosts)
+#include "../../src/Queue.h"
@@ -0,0 +1,126 @@
+// AllMovements: stop patterns are terminal, chained patterns keep their own
+// priority, a full preempt stack keeps the pattern it interrupts.
+
+#include <unity.h>
+#include "AllMoves.h"
+
+static Scheduler ts;
+static int16_t lastLeft, lastRight;
+
+static void record(movement m) {
+   lastLeft = m.leftSpeed;
+   lastRight = m.rightSpeed;
+}
+
+// Run scheduled passes until the pattern changes to `motion` (or give up)
+static bool runUntil(AllMovements &moves, CurrentMotion motion, uint16_t passes = 200) {
+   for (uint16_t i = 0; i < passes; i++) {
+      if (moves.CurrentPattern() == motion) return true;
+      if (!moves.isEnabled()) return false;
+      NativeClock::advanceMs(moves.getInterval());
+      moves.Callback();
+   }
+   return moves.CurrentPattern() == motion;
+}
+
+void setUp() {
+   lastLeft = lastRight = 0;
+}
+
+void tearDown() {}
+
+void test_emergency_stop_is_terminal() {
+   AllMovements moves(&ts, record);
+   moves.setCurrentPattern(CIRCLE);
+   moves.Callback();
+   NativeClock::advanceMs(100);
+   moves.chainPattern(TURN_LEFT);
+
+   TEST_ASSERT_TRUE(moves.preempt(EMERGENCY_STOP, PRIORITY_EMERGENCY));
+   TEST_ASSERT_EQUAL_INT16(0, lastLeft);
+   TEST_ASSERT_EQUAL_INT16(0, lastRight);
+
+   // Past the stop step: HALT, nothing resumed or chained
+   NativeClock::advanceMs(moves.getInterval());
+   moves.Callback();
+   TEST_ASSERT_FALSE(moves.isEnabled());
+   TEST_ASSERT_EQUAL(EMERGENCY_STOP, moves.CurrentPattern());
+   NativeClock::advanceMs(1000);
+   moves.Callback();                          // Even if called again, it stays halted
+   TEST_ASSERT_FALSE(moves.isEnabled());
+   TEST_ASSERT_EQUAL_INT16(0, lastLeft);
+   TEST_ASSERT_EQUAL_INT16(0, lastRight);
+   TEST_ASSERT_FALSE(moves.preempt(AVOID_OBSTACLE, PRIORITY_OBSTACLE));
+
+   // Only an explicit pattern moves again
+   moves.setCurrentPattern(CONTINUOUS);
+   TEST_ASSERT_TRUE(moves.isEnabled());
+   moves.Callback();
+   TEST_ASSERT_GREATER_THAN(0, lastLeft);
+}
+
+void test_gentle_stop_is_terminal() {
+   AllMovements moves(&ts, record);
+   moves.setCurrentPattern(GENTLE_STOP);
+   moves.chainPattern(CIRCLE);
+   TEST_ASSERT_FALSE(runUntil(moves, CIRCLE));
+   TEST_ASSERT_EQUAL(GENTLE_STOP, moves.CurrentPattern());
+   TEST_ASSERT_FALSE(moves.isEnabled());
+   TEST_ASSERT_EQUAL_INT16(0, lastLeft);
+   TEST_ASSERT_EQUAL_INT16(0, lastRight);
+}
+
+// A pattern preempting a halted one ends back in the halt
+void test_halt_resumes_into_halt() {
+   AllMovements moves(&ts, record);
+   moves.setCurrentPattern(GENTLE_STOP);
+   runUntil(moves, CIRCLE);
+   TEST_ASSERT_TRUE(moves.preempt(AVOID_OBSTACLE, PRIORITY_OBSTACLE));
+   TEST_ASSERT_TRUE(moves.isEnabled());
+   TEST_ASSERT_FALSE(runUntil(moves, CONTINUOUS));
+   TEST_ASSERT_EQUAL(GENTLE_STOP, moves.CurrentPattern());
+   TEST_ASSERT_FALSE(moves.isEnabled());
+   TEST_ASSERT_EQUAL_INT16(0, lastLeft);
+}
+
+void test_chained_pattern_runs_at_its_own_priority() {
+   AllMovements moves(&ts, record);
+   moves.setCurrentPattern(SPOT_TURN_180);
+   moves.chainPattern(TURN_LEFT, PRIORITY_NAVIGATION);
+   moves.chainPattern(SLOW_DOWN);
+
+   TEST_ASSERT_TRUE(runUntil(moves, TURN_LEFT));
+   TEST_ASSERT_EQUAL_UINT8(PRIORITY_NAVIGATION, moves.CurrentPriority());
+   TEST_ASSERT_FALSE(moves.preempt(CIRCLE, PRIORITY_NAVIGATION));
+
+   // Not the priority of the pattern before it
+   TEST_ASSERT_TRUE(runUntil(moves, SLOW_DOWN));
+   TEST_ASSERT_EQUAL_UINT8(PRIORITY_ROUTINE, moves.CurrentPriority());
+   TEST_ASSERT_TRUE(moves.preempt(AVOID_OBSTACLE, PRIORITY_OBSTACLE));
+}
+
+// Third nested preempt: the oldest (lowest priority) frame goes, the
+// pattern running when it came is resumed
+void test_full_preempt_stack_drops_lowest_frame() {
+   AllMovements moves(&ts, record);
+   moves.setCurrentPattern(CIRCLE);
+   moves.Callback();
+   TEST_ASSERT_TRUE(moves.preempt(AVOID_OBSTACLE, PRIORITY_OBSTACLE));
+   TEST_ASSERT_TRUE(moves.preempt(REVERSE_AND_TURN, PRIORITY_BOUNDARY));
+   TEST_ASSERT_TRUE(moves.preempt(SPOT_TURN_180, PRIORITY_EMERGENCY));
+
+   TEST_ASSERT_TRUE(runUntil(moves, REVERSE_AND_TURN));
+   TEST_ASSERT_EQUAL_UINT8(PRIORITY_BOUNDARY, moves.CurrentPriority());
+   TEST_ASSERT_TRUE(runUntil(moves, AVOID_OBSTACLE));
+   TEST_ASSERT_TRUE(runUntil(moves, CONTINUOUS));
+}
+
+int main() {
+   UNITY_BEGIN();
+   RUN_TEST(test_emergency_stop_is_terminal);
+   RUN_TEST(test_gentle_stop_is_terminal);
+   RUN_TEST(test_halt_resumes_into_halt);
+   RUN_TEST(test_chained_pattern_runs_at_its_own_priority);
+   RUN_TEST(test_full_preempt_stack_drops_lowest_frame);
+   return UNITY_END();
+}
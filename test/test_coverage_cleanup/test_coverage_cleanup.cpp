@@ -0,0 +1,153 @@
+// CoverageCleanup on lawns that are not convex: fragments stay on the lawn
+// (off-lawn cells are covered by excludeOutside()) and still close the gaps.
+
+#include <unity.h>
+#include "PerimeterStorage.h"
+#include "CoverageMap.h"
+#include "CoverageCleanup.h"
+
+static const uint16_t CellMM = 100;
+static const uint16_t BladeMM = 250;
+
+static uint32_t words[2048];
+static PerimeterStorage lawn;
+
+// C shape, 10m x 10m, the bay 7m deep and 4m wide opens to the east
+static const Point2D_int cShape[] = {
+   Point2D_int(0, 0), Point2D_int(10000, 0), Point2D_int(10000, 3000), Point2D_int(3000, 3000),
+   Point2D_int(3000, 7000), Point2D_int(10000, 7000), Point2D_int(10000, 10000), Point2D_int(0, 10000)
+};
+
+// North-south stripes kept marginMM off every edge: the border left over is
+// one gap that runs around the bay or the bed
+static void mowStripes(CoverageMap &map, int32_t marginMM) {
+   for (int32_t x = marginMM; x <= 10000 - marginMM; x += BladeMM - 10) {
+      Point2D_int pieces[8];
+      int n = lawn.clipSegment(Point2D_int(x, 0), Point2D_int(x, 10000), pieces, 4, marginMM);
+      for (int i = 0; i < n; i++) {
+         map.markPoint(pieces[2 * i], BladeMM);
+         map.markSwath(pieces[2 * i], pieces[2 * i + 1], BladeMM);
+      }
+   }
+}
+
+// Run the planner to the end, mowing every fragment; returns the fragments,
+// offLawn counts those with a gap row center off the lawn
+static uint16_t cleanup(CoverageMap &map, Point2D_int position, uint16_t &offLawn) {
+   CoverageCleanup planner(&map);
+   planner.begin(position, BladeMM);
+   uint16_t fragments = 0;
+   offLawn = 0;
+   for (uint32_t steps = 0; steps < 100000; steps++) {
+      Point2D_int s, e;
+      if (planner.takeFragment(s, e)) {
+         fragments++;
+         // The ends reach half a cell past the gap rows; the rows themselves must be lawn
+         int32_t dir = e.y > s.y ? 1 : -1;
+         for (int32_t y = s.y + dir * CellMM / 2; (e.y - y) * dir >= CellMM / 2; y += dir * CellMM / 2) {
+            if (!lawn.contains(Point2D_int(s.x, y))) {
+               offLawn++;
+               break;
+            }
+         }
+         map.markPoint(s, BladeMM);
+         map.markSwath(s, e, BladeMM);
+         continue;
+      }
+      if (!planner.step()) break;
+   }
+   TEST_ASSERT_TRUE(planner.isDone());
+   return fragments;
+}
+
+void setUp() {
+   lawn.clear();
+}
+
+void tearDown() {}
+
+void test_fragments_do_not_cross_the_bay() {
+   lawn.loadFromArray(cShape, 8);
+   CoverageRamStore store(words, sizeof(words) / sizeof(words[0]));
+   CoverageMap map(&store);
+   TEST_ASSERT_TRUE(map.begin(lawn, CellMM));
+   map.excludeOutside(lawn);
+   mowStripes(map, 400);
+   uint8_t before = map.coveragePercent(lawn);
+   TEST_ASSERT_LESS_THAN(90, before);
+
+   uint16_t offLawn;
+   uint16_t fragments = cleanup(map, Point2D_int(9000, 1500), offLawn);
+   TEST_ASSERT_GREATER_THAN(0, fragments);
+   TEST_ASSERT_EQUAL_UINT16(0, offLawn);
+   TEST_ASSERT_GREATER_OR_EQUAL(99, map.coveragePercent(lawn));
+}
+
+void test_fragments_go_around_a_bed() {
+   const Point2D_int square[] = {
+      Point2D_int(0, 0), Point2D_int(10000, 0), Point2D_int(10000, 10000), Point2D_int(0, 10000)
+   };
+   const Point2D_int bed[] = {
+      Point2D_int(3000, 4000), Point2D_int(7000, 4000), Point2D_int(7000, 6000), Point2D_int(3000, 6000)
+   };
+   lawn.loadFromArray(square, 4);
+   TEST_ASSERT_TRUE(lawn.addExclusionZone(bed, 4));
+   CoverageRamStore store(words, sizeof(words) / sizeof(words[0]));
+   CoverageMap map(&store);
+   TEST_ASSERT_TRUE(map.begin(lawn, CellMM));
+   map.excludeOutside(lawn);
+   mowStripes(map, 400);
+
+   uint16_t offLawn;
+   uint16_t fragments = cleanup(map, Point2D_int(500, 500), offLawn);
+   TEST_ASSERT_GREATER_THAN(0, fragments);
+   TEST_ASSERT_EQUAL_UINT16(0, offLawn);
+   TEST_ASSERT_GREATER_OR_EQUAL(99, map.coveragePercent(lawn));
+}
+
+// 20 beds on one row: 42 crossings there, all of them paired, so every bed
+// is off the lawn for the map and the clipping
+void test_row_of_twenty_beds() {
+   const Point2D_int strip[] = {
+      Point2D_int(0, 0), Point2D_int(25000, 0), Point2D_int(50000, 0),
+      Point2D_int(50000, 10000), Point2D_int(25000, 10000), Point2D_int(0, 10000)
+   };
+   lawn.loadFromArray(strip, 6);
+   for (int32_t k = 0; k < 20; k++) {
+      int32_t x = 1500 + k * 2400;
+      const Point2D_int bed[] = {
+         Point2D_int(x, 4000), Point2D_int(x + 1000, 4000), Point2D_int(x + 1000, 6000), Point2D_int(x, 6000)
+      };
+      TEST_ASSERT_TRUE(lawn.addExclusionZone(bed, 4));
+   }
+   int32_t xs[MAX_BOUNDARY_CROSSINGS];
+   TEST_ASSERT_EQUAL(42, lawn.getCrossings(5050, xs, MAX_BOUNDARY_CROSSINGS));
+   TEST_ASSERT_EQUAL(-1, lawn.getCrossings(5050, xs, 32));
+
+   CoverageRamStore store(words, sizeof(words) / sizeof(words[0]));
+   CoverageMap map(&store);
+   TEST_ASSERT_TRUE(map.begin(lawn, CellMM));
+   map.excludeOutside(lawn);
+   uint32_t lawnCells = 0;
+   for (uint16_t row = 0; row < map.getRows(); row++) {
+      uint16_t uncovered = 0, inside = 0;
+      for (uint16_t col = 0; col < map.getCols(); col++) {
+         if (!map.isCellCovered(col, row)) uncovered++;
+         if (lawn.contains(map.cellCenter(col, row))) inside++;
+      }
+      TEST_ASSERT_EQUAL_UINT16(inside, uncovered);
+      lawnCells += inside;
+   }
+   TEST_ASSERT_EQUAL_UINT32(lawnCells, map.getInsideCells());
+
+   Point2D_int pieces[2 * 32];
+   TEST_ASSERT_EQUAL(21, lawn.clipSegment(Point2D_int(0, 5000), Point2D_int(50000, 5000), pieces, 32, BladeMM / 2));
+}
+
+int main() {
+   UNITY_BEGIN();
+   RUN_TEST(test_fragments_do_not_cross_the_bay);
+   RUN_TEST(test_fragments_go_around_a_bed);
+   RUN_TEST(test_row_of_twenty_beds);
+   return UNITY_END();
+}
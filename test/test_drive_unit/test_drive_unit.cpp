@@ -0,0 +1,121 @@
+// DriveUnit (runtime Motor*) against L298DriveUnit (by value, static dispatch):
+// same ramps, no heap for the production unit, per-tick cost on the host.
+// pio test -e native -f test_drive_unit -v prints the measured numbers.
+
+#include <unity.h>
+#include <stdio.h>
+#include <new>
+#include <chrono>
+#include "DriveUnit.h"
+#include "LineFollower.h"
+
+static uint32_t heapAllocations = 0;
+
+void *operator new(size_t size) {
+   heapAllocations++;
+   void *p = malloc(size);
+   if (p == nullptr) throw std::bad_alloc();
+   return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static Scheduler ts;
+
+void setUp() {}
+void tearDown() {}
+
+void test_l298_drive_unit_uses_no_heap() {
+   uint32_t before = heapAllocations;
+   L298DriveUnit drive(&ts, WheelUpdateRate, L298Driver(LEFTENABLE, LEFTIN1, LEFTIN2),
+                       L298Driver(RIGHTENABLE, RIGHTIN1, RIGHTIN2));
+   TEST_ASSERT_EQUAL_UINT32(0, heapAllocations - before);
+
+   before = heapAllocations;
+   DriveUnit runtime(&ts, WheelUpdateRate);
+   TEST_ASSERT_EQUAL_UINT32(2, heapAllocations - before);   // Two L298 adapters
+
+   char line[96];
+   snprintf(line, sizeof(line), "sizeof: L298DriveUnit %u B, DriveUnit %u B + 2 heap L298 of %u B",
+            (unsigned)sizeof(L298DriveUnit), (unsigned)sizeof(DriveUnit), (unsigned)sizeof(L298));
+   TEST_MESSAGE(line);
+}
+
+template <class Drive>
+static void ramp(Drive &drive, int16_t *left, int16_t *right, int ticks) {
+   drive.setTargetSpeed(800, -400, 20 * WheelUpdateRate);
+   for (int i = 0; i < ticks; i++) {
+      drive.runOnce();
+      left[i] = drive.getLeftSpeed();
+      right[i] = drive.getRightSpeed();
+   }
+}
+
+void test_both_variants_ramp_alike() {
+   L298DriveUnit drive(&ts, WheelUpdateRate, L298Driver(LEFTENABLE, LEFTIN1, LEFTIN2),
+                       L298Driver(RIGHTENABLE, RIGHTIN1, RIGHTIN2));
+   DriveUnit runtime(&ts, WheelUpdateRate);
+   int16_t l1[30], r1[30], l2[30], r2[30];
+   ramp(drive, l1, r1, 30);
+   ramp(runtime, l2, r2, 30);
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(l2, l1, sizeof(l1));
+   TEST_ASSERT_EQUAL_UINT8_ARRAY(r2, r1, sizeof(r1));
+   TEST_ASSERT_INT_WITHIN(40, 800, l1[29]);
+   TEST_ASSERT_INT_WITHIN(20, -400, r1[29]);
+}
+
+// Every tick changes both speeds, so every tick reaches move()
+template <class Drive>
+static double nanosecondsPerTick(Drive &drive) {
+   const int Rounds = 20000;
+   auto t0 = std::chrono::steady_clock::now();
+   for (int k = 0; k < Rounds; k++) {
+      drive.setTargetSpeed((k & 1) ? 1000 : -1000, (k & 1) ? -1000 : 1000, 50 * WheelUpdateRate);
+      for (int i = 0; i < 50; i++) drive.Callback();
+   }
+   auto t1 = std::chrono::steady_clock::now();
+   return std::chrono::duration<double, std::nano>(t1 - t0).count() / (Rounds * 50.0);
+}
+
+void test_per_tick_cost() {
+   L298DriveUnit drive(&ts, WheelUpdateRate, L298Driver(LEFTENABLE, LEFTIN1, LEFTIN2),
+                       L298Driver(RIGHTENABLE, RIGHTIN1, RIGHTIN2));
+   DriveUnit runtime(&ts, WheelUpdateRate);
+   nanosecondsPerTick(drive);                       // Warm up
+   double staticNs = nanosecondsPerTick(drive);
+   double virtualNs = nanosecondsPerTick(runtime);
+
+   char line[96];
+   snprintf(line, sizeof(line), "per tick (host): L298DriveUnit %.1f ns, DriveUnit %.1f ns", staticNs, virtualNs);
+   TEST_MESSAGE(line);
+   TEST_ASSERT_TRUE(staticNs > 0 && virtualNs > 0);
+}
+
+// The production follower drives the static unit
+void test_line_follower_drives_l298_unit() {
+   L298DriveUnit drive(&ts, WheelUpdateRate, L298Driver(LEFTENABLE, LEFTIN1, LEFTIN2),
+                       L298Driver(RIGHTENABLE, RIGHTIN1, RIGHTIN2));
+   GPSInterface gps;
+   IMUInterface imu;
+   LineFollowerT<L298DriveUnit> follower(&ts, &gps, &imu, &drive);
+   gps.setPositionMM(0, 0);
+   follower.setLineMM(Point2D_int(0, 0), Point2D_int(10000, 0));
+   follower.enable();
+   follower.runOnce();
+   TEST_ASSERT_FALSE(follower.isComplete());
+   TEST_ASSERT_TRUE(drive.isEnabled());
+
+   gps.setPositionMM(9900, 0);
+   follower.runOnce();
+   TEST_ASSERT_TRUE(follower.isComplete());
+}
+
+int main() {
+   UNITY_BEGIN();
+   RUN_TEST(test_l298_drive_unit_uses_no_heap);
+   RUN_TEST(test_both_variants_ramp_alike);
+   RUN_TEST(test_per_tick_cost);
+   RUN_TEST(test_line_follower_drives_l298_unit);
+   return UNITY_END();
+}
@@ -0,0 +1,122 @@
+// GeoProjection against a double precision geodetic -> ECEF -> ENU reference
+
+#include <unity.h>
+#include <math.h>
+#include "GeoProjection.h"
+
+static const double SemiMajor = 6378137000.0;           // WGS84, mm
+static const double E2 = 6.69437999014e-3;
+
+static void toEcef(double latDeg, double lonDeg, double h, double &x, double &y, double &z) {
+   double lat = latDeg * M_PI / 180.0;
+   double lon = lonDeg * M_PI / 180.0;
+   double n = SemiMajor / sqrt(1.0 - E2 * sin(lat) * sin(lat));
+   x = (n + h) * cos(lat) * cos(lon);
+   y = (n + h) * cos(lat) * sin(lon);
+   z = (n * (1.0 - E2) + h) * sin(lat);
+}
+
+// East/north (mm) of a point at the origin's height
+static void referenceEnu(double lat0, double lon0, double h, double lat, double lon, double &e, double &n) {
+   double x0, y0, z0, x, y, z;
+   toEcef(lat0, lon0, h, x0, y0, z0);
+   toEcef(lat, lon, h, x, y, z);
+   double dx = x - x0, dy = y - y0, dz = z - z0;
+   double phi = lat0 * M_PI / 180.0;
+   double lam = lon0 * M_PI / 180.0;
+   e = -sin(lam) * dx + cos(lam) * dy;
+   n = -sin(phi) * cos(lam) * dx - sin(phi) * sin(lam) * dy + cos(phi) * dz;
+}
+
+// Largest error (1/10 mm) over a grid of points within rangeM of the origin
+static int32_t maxError(int32_t lat7, int32_t lon7, int32_t heightMM, int32_t rangeM) {
+   GeoProjection geo;
+   geo.begin(lat7, lon7, heightMM);
+   double lat0 = lat7 * 1e-7, lon0 = lon7 * 1e-7;
+   double mPerDegLat = 111000.0;
+   double mPerDegLon = 111000.0 * cos(lat0 * M_PI / 180.0);
+   double worst = 0;
+   for (int32_t i = -4; i <= 4; i++) {
+      for (int32_t j = -4; j <= 4; j++) {
+         if (i * i + j * j > 16) continue;
+         int32_t dLat7 = (int32_t)(rangeM * i / 4 / mPerDegLat * 1e7);
+         int32_t dLon7 = (int32_t)(rangeM * j / 4 / mPerDegLon * 1e7);
+         double e, n;
+         referenceEnu(lat0, lon0, heightMM, (lat7 + dLat7) * 1e-7, (lon7 + dLon7) * 1e-7, e, n);
+         Point2D_int p = geo.toLocal(lat7 + dLat7, lon7 + dLon7);
+         double err = sqrt((p.x - e) * (p.x - e) + (p.y - n) * (p.y - n));
+         if (err > worst) worst = err;
+      }
+   }
+   return (int32_t)ceil(worst * 10);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_origin_maps_to_zero() {
+   GeoProjection geo;
+   TEST_ASSERT_FALSE(geo.valid());
+   geo.begin(473921234, 85412345, 452000, 56, -12);
+   TEST_ASSERT_TRUE(geo.valid());
+   Point2D_int p = geo.toLocal(473921234, 85412345, 56, -12);
+   TEST_ASSERT_EQUAL_INT32(0, p.x);
+   TEST_ASSERT_EQUAL_INT32(0, p.y);
+}
+
+void test_axes_are_east_and_north() {
+   GeoProjection geo;
+   geo.begin(473921234, 85412345, 452000);
+   Point2D_int east = geo.toLocal(473921234, 85422345);      // +0.001 deg lon, ~75m
+   Point2D_int north = geo.toLocal(473931234, 85412345);     // +0.001 deg lat, ~111m
+   TEST_ASSERT_INT_WITHIN(10, 0, east.y);
+   TEST_ASSERT_INT_WITHIN(75500, 75000, east.x);
+   TEST_ASSERT_INT_WITHIN(10, 0, north.x);
+   TEST_ASSERT_INT_WITHIN(111500, 111000, north.y);
+}
+
+// doc/GPS.md: below 0.8mm within 1km, ~1mm at 3km up to 60 deg, 2mm at 70 deg
+void test_error_within_1km() {
+   const int32_t lats7[] = { 0, 300000000, 473921234, 600000000, -350000000 };
+   for (uint8_t i = 0; i < sizeof(lats7) / sizeof(lats7[0]); i++) {
+      TEST_ASSERT_LESS_OR_EQUAL(8, maxError(lats7[i], 85412345, 452000, 1000));
+   }
+}
+
+void test_error_within_3km() {
+   const int32_t lats7[] = { 0, 300000000, 473921234, 600000000, -600000000 };
+   for (uint8_t i = 0; i < sizeof(lats7) / sizeof(lats7[0]); i++) {
+      TEST_ASSERT_LESS_OR_EQUAL(10, maxError(lats7[i], -1223456789, 20000, 3000));
+   }
+   TEST_ASSERT_LESS_OR_EQUAL(20, maxError(700000000, 200000000, 0, 3000));
+}
+
+void test_high_precision_digits() {
+   GeoProjection geo;
+   geo.begin(473921234, 85412345, 452000);
+   // 1e-9 deg latitude is ~0.11mm: 45 of them ~5mm
+   Point2D_int p = geo.toLocal(473921234, 85412345, 45, 0);
+   TEST_ASSERT_INT_WITHIN(1, 5, p.y);
+   TEST_ASSERT_EQUAL_INT32(0, p.x);
+}
+
+void test_across_antimeridian() {
+   GeoProjection geo;
+   geo.begin(-170000000, 1799990000, 0);                       // 0.001 deg west of 180
+   Point2D_int p = geo.toLocal(-170000000, -1799990000);        // 0.001 deg east of it
+   double e, n;
+   referenceEnu(-17.0, 179.999, 0, -17.0, 180.001, e, n);
+   TEST_ASSERT_INT_WITHIN(1, (int32_t)lround(e), p.x);
+   TEST_ASSERT_INT_WITHIN(1, (int32_t)lround(n), p.y);
+}
+
+int main() {
+   UNITY_BEGIN();
+   RUN_TEST(test_origin_maps_to_zero);
+   RUN_TEST(test_axes_are_east_and_north);
+   RUN_TEST(test_error_within_1km);
+   RUN_TEST(test_error_within_3km);
+   RUN_TEST(test_high_precision_digits);
+   RUN_TEST(test_across_antimeridian);
+   return UNITY_END();
+}
@@ -0,0 +1,240 @@
+// IMUAsync against MockI2CBus: the setup script, gyro calibration, FIFO
+// polls and recovery from NACKs, with a simulated ICM-20948 behind the mock.
+
+#include <unity.h>
+#include "MockI2CBus.h"
+#include "IMUAsync.h"
+
+// ICM-20948 as far as IMUAsync sees it: banked registers, the burst at
+// ACCEL_XOUT_H, a gyro Z FIFO filled at the 1125Hz ODR
+struct SimIcm {
+   uint8_t bank;
+   uint8_t regs[4][128];
+   int16_t gyroZ;
+   uint16_t fifoBytes;
+   uint8_t fifoLowNext;          // Next FIFO_R_W byte is the low half
+   uint16_t fifoResets;
+   uint32_t producedUs;          // Sample clock, 1e6 / 1125 per sample
+
+   bool fifoOn() const {
+      return (regs[0][ICM20948_USER_CTRL] & ICM20948_USER_CTRL_FIFO_EN) &&
+             (regs[0][ICM20948_FIFO_EN_2] & ICM20948_FIFO_EN_GYRO_Z);
+   }
+
+   // Queue the samples due up to now; stream mode keeps the newest
+   void produce(uint32_t nowUs) {
+      while (nowUs - producedUs >= 889) {
+         producedUs += 889;
+         if (!fifoOn()) continue;
+         if (fifoBytes < ICM20948_FIFO_SIZE) fifoBytes += 2;
+      }
+   }
+
+   static bool onRead(uint8_t reg, uint8_t *value, void *context) {
+      SimIcm *s = static_cast<SimIcm*>(context);
+      if (reg == ICM20948_REG_BANK_SEL) {
+         *value = s->bank << 4;
+      } else if (s->bank != 0) {
+         *value = s->regs[s->bank][reg & 0x7F];
+      } else if (reg == ICM20948_GYRO_XOUT_H + 4) {
+         *value = (uint16_t)s->gyroZ >> 8;
+      } else if (reg == ICM20948_GYRO_XOUT_H + 5) {
+         *value = s->gyroZ & 0xFF;
+      } else if (reg == ICM20948_ACCEL_XOUT_H + 4) {
+         *value = 0x40;                           // 1g on Z at +-2g
+      } else if (reg == ICM20948_FIFO_COUNTH) {
+         *value = s->fifoBytes >> 8;
+      } else if (reg == ICM20948_FIFO_COUNTH + 1) {
+         *value = s->fifoBytes & 0xFF;
+      } else if (reg == ICM20948_FIFO_R_W) {
+         *value = s->fifoLowNext ? (s->gyroZ & 0xFF) : (uint16_t)s->gyroZ >> 8;
+         s->fifoLowNext ^= 1;
+         if (s->fifoBytes > 0) s->fifoBytes--;
+      } else {
+         *value = s->regs[0][reg & 0x7F];
+      }
+      return true;
+   }
+
+   static bool onWrite(uint8_t reg, uint8_t value, void *context) {
+      SimIcm *s = static_cast<SimIcm*>(context);
+      if (reg == ICM20948_REG_BANK_SEL) {
+         s->bank = (value >> 4) & 3;
+         return true;
+      }
+      s->regs[s->bank][reg & 0x7F] = value;
+      if (s->bank == 0 && reg == ICM20948_FIFO_RST && value == 0x1F) {
+         s->fifoBytes = 0;
+         s->fifoLowNext = 0;
+         s->fifoResets++;
+      }
+      return true;
+   }
+};
+
+static Scheduler ts;
+static SimIcm sim;
+
+static void attachSim(MockI2CBus &bus, uint8_t address = ICM20948_ADDR) {
+   MockI2CBus::Device *d = bus.addDevice(address, SimIcm::onRead, SimIcm::onWrite, &sim);
+   d->streamReg = ICM20948_FIFO_R_W;
+}
+
+// Run the 1ms tasks for ms milliseconds
+static void run(MockI2CBus &bus, IMUAsync &imu, uint32_t ms) {
+   for (uint32_t i = 0; i < ms; i++) {
+      NativeClock::advanceMs(1);
+      sim.produce(NativeClock::us);
+      bus.Callback();
+      if (imu.isEnabled()) imu.Callback();
+   }
+}
+
+static bool runUntilReady(MockI2CBus &bus, IMUAsync &imu, uint32_t maxMs) {
+   for (uint32_t i = 0; i < maxMs && !imu.ready(); i++) run(bus, imu, 1);
+   return imu.ready();
+}
+
+void setUp() {
+   memset(&sim, 0, sizeof(sim));
+   sim.gyroZ = 40;                                // Bias, stationary
+   sim.producedUs = NativeClock::us;
+}
+
+void tearDown() {}
+
+void test_setup_writes_the_register_script() {
+   MockI2CBus bus(&ts);
+   IMUInterface imu;
+   IMUAsync async(&ts, &bus, &imu);
+   attachSim(bus);
+
+   async.begin(false, true, 10);
+   time_ms_t start = millis();
+   run(bus, async, 150);
+   TEST_ASSERT_EQUAL(IMUAsync::State::Setup, async.getState());    // Waiting out the reset
+
+   TEST_ASSERT_TRUE(runUntilReady(bus, async, 1000));
+   // Power up, reset, wake and axes waits, 10 samples 10ms apart
+   TEST_ASSERT_GREATER_OR_EQUAL(100 + 100 + 10 + 10 + 10 * 10, millis() - start);
+
+   TEST_ASSERT_EQUAL_UINT8(0, sim.bank);
+   TEST_ASSERT_EQUAL_HEX8(0x01, sim.regs[0][ICM20948_PWR_MGMT_1]);
+   TEST_ASSERT_EQUAL_HEX8(ICM20948_USER_CTRL_FIFO_EN, sim.regs[0][ICM20948_USER_CTRL]);
+   TEST_ASSERT_EQUAL_HEX8(ICM20948_FIFO_EN_GYRO_Z, sim.regs[0][ICM20948_FIFO_EN_2]);
+   TEST_ASSERT_EQUAL_HEX8(0x01, sim.regs[2][ICM20948_GYRO_CONFIG_1]);
+   TEST_ASSERT_EQUAL_HEX8(0x01, sim.regs[2][ICM20948_ACCEL_CONFIG]);
+   TEST_ASSERT_EQUAL_HEX8(0x00, sim.regs[3][ICM20948_I2C_SLV0_CTRL]);   // No magnetometer
+   TEST_ASSERT_EQUAL_UINT16(2, sim.fifoResets);                         // Setup and after calibration
+   TEST_ASSERT_TRUE(imu.isInitialized());
+   TEST_ASSERT_TRUE(imu.isFifoEnabled());
+   TEST_ASSERT_EQUAL_UINT16(0, async.getErrors());
+}
+
+void test_calibration_and_fifo_integration() {
+   MockI2CBus bus(&ts);
+   IMUInterface imu;
+   IMUAsync async(&ts, &bus, &imu);
+   attachSim(bus);
+
+   async.begin(false, true, 20);
+   TEST_ASSERT_TRUE(runUntilReady(bus, async, 1000));
+   TEST_ASSERT_EQUAL_INT16(40 * 16, imu.getGyroBiasZQ4());
+
+   // Still: the bias cancels
+   run(bus, async, 500);
+   TEST_ASSERT_EQUAL_INT32(0, imu.getGyroAngle());
+
+   // 10 deg/s for one second, every sample through the FIFO
+   uint32_t samples = imu.getFifoSamples();
+   sim.gyroZ = 40 + 1310;
+   run(bus, async, 1000);
+   sim.gyroZ = 40;
+   run(bus, async, 100);                          // Drain what is left
+   TEST_ASSERT_INT_WITHIN(2, 100, imu.getGyroAngle());
+   TEST_ASSERT_INT_WITHIN(10, 1100 * 1125 / 1000, imu.getFifoSamples() - samples);
+   TEST_ASSERT_EQUAL_UINT16(0, imu.getFifoOverflows());
+}
+
+void test_fifo_overflow_restarts_the_fifo() {
+   MockI2CBus bus(&ts);
+   IMUInterface imu;
+   IMUAsync async(&ts, &bus, &imu);
+   attachSim(bus);
+
+   async.begin(false, true, 10);
+   TEST_ASSERT_TRUE(runUntilReady(bus, async, 1000));
+   uint16_t resets = sim.fifoResets;
+
+   sim.fifoBytes = ICM20948_FIFO_SIZE;            // Missed polls
+   run(bus, async, 40);
+   TEST_ASSERT_EQUAL_UINT16(1, imu.getFifoOverflows());
+   TEST_ASSERT_EQUAL_UINT16(resets + 1, sim.fifoResets);
+   TEST_ASSERT_TRUE(runUntilReady(bus, async, 100));
+
+   uint32_t samples = imu.getFifoSamples();
+   run(bus, async, 200);
+   TEST_ASSERT_GREATER_THAN(200, imu.getFifoSamples() - samples);
+}
+
+void test_nack_repeats_setup_and_calibration_steps() {
+   MockI2CBus bus(&ts);
+   IMUInterface imu;
+   IMUAsync async(&ts, &bus, &imu);
+   attachSim(bus);
+
+   async.begin(false, true, 10);
+   run(bus, async, 99);
+   bus.failNext(2);                               // First two setup writes
+   TEST_ASSERT_TRUE(runUntilReady(bus, async, 1000));
+   TEST_ASSERT_EQUAL_UINT16(2, async.getErrors());
+   TEST_ASSERT_EQUAL_UINT16(2, bus.getErrors());
+   TEST_ASSERT_EQUAL_HEX8(0x01, sim.regs[0][ICM20948_PWR_MGMT_1]);
+   TEST_ASSERT_EQUAL_HEX8(ICM20948_USER_CTRL_FIFO_EN, sim.regs[0][ICM20948_USER_CTRL]);
+   TEST_ASSERT_EQUAL_INT16(40 * 16, imu.getGyroBiasZQ4());
+}
+
+void test_nack_while_running_skips_to_the_next_poll() {
+   MockI2CBus bus(&ts);
+   IMUInterface imu;
+   IMUAsync async(&ts, &bus, &imu);
+   attachSim(bus);
+
+   async.begin(false, true, 10);
+   TEST_ASSERT_TRUE(runUntilReady(bus, async, 1000));
+
+   sim.gyroZ = 40 + 1310;
+   bus.failNext(3);
+   run(bus, async, 1000);
+   sim.gyroZ = 40;
+   run(bus, async, 100);
+   TEST_ASSERT_EQUAL_UINT16(3, async.getErrors());
+   TEST_ASSERT_TRUE(async.ready());
+   // The FIFO kept the samples of the failed polls
+   TEST_ASSERT_INT_WITHIN(2, 100, imu.getGyroAngle());
+}
+
+void test_missing_device_never_leaves_setup() {
+   MockI2CBus bus(&ts);
+   IMUInterface imu;
+   IMUAsync async(&ts, &bus, &imu);
+   attachSim(bus, ICM20948_ADDR_AD0_LOW);         // Wrong address
+
+   async.begin(false, true, 10);
+   run(bus, async, 1000);
+   TEST_ASSERT_EQUAL(IMUAsync::State::Setup, async.getState());
+   TEST_ASSERT_FALSE(imu.isInitialized());
+   // One attempt per 10ms retry, not a busy loop
+   TEST_ASSERT_INT_WITHIN(10, 90, async.getErrors());
+}
+
+int main() {
+   UNITY_BEGIN();
+   RUN_TEST(test_setup_writes_the_register_script);
+   RUN_TEST(test_calibration_and_fifo_integration);
+   RUN_TEST(test_fifo_overflow_restarts_the_fifo);
+   RUN_TEST(test_nack_repeats_setup_and_calibration_steps);
+   RUN_TEST(test_nack_while_running_skips_to_the_next_poll);
+   RUN_TEST(test_missing_device_never_leaves_setup);
+   return UNITY_END();
+}
@@ -0,0 +1,66 @@
+// LineFollower steers in the heading convention of its sources:
+// 0 = east, counter-clockwise positive, like the IMU, odometry and PoseEKF.
+
+#include <unity.h>
+#include "LineFollower.h"
+
+// Records the last command instead of driving wheels
+struct RecordingDrive {
+   int left;
+   int right;
+   int calls;
+   void setTargetSpeed(int leftSpeed, int rightSpeed, int) {
+      left = leftSpeed;
+      right = rightSpeed;
+      calls++;
+   }
+};
+
+static Scheduler ts;
+
+// One control step on the line from (0,0) to end, at (0,0) with the given heading
+static RecordingDrive steer(Point2D_int end, angle_t heading) {
+   RecordingDrive drive = { 0, 0, 0 };
+   GPSInterface gps;
+   IMUInterface imu;
+   imu.attach(false, false);
+   imu.setHeading(heading);
+   LineFollowerT<RecordingDrive> follower(&ts, &gps, &imu, &drive);
+   gps.setPositionMM(0, 0);
+   follower.setLineMM(Point2D_int(0, 0), end);
+   follower.enable();
+   follower.runOnce();
+   return drive;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_on_course_drives_straight() {
+   const Point2D_int ends[] = { Point2D_int(10000, 0), Point2D_int(0, 10000),
+                                Point2D_int(-10000, 0), Point2D_int(0, -10000) };
+   for (uint8_t i = 0; i < 4; i++) {
+      RecordingDrive d = steer(ends[i], (angle_t)(i * 900));
+      TEST_ASSERT_EQUAL_INT(1, d.calls);
+      TEST_ASSERT_GREATER_THAN(0, d.left);
+      TEST_ASSERT_INT_WITHIN(2, d.left, d.right);
+   }
+}
+
+void test_line_to_the_left_turns_left() {
+   RecordingDrive d = steer(Point2D_int(0, 10000), 0);       // Facing east, line goes north
+   TEST_ASSERT_GREATER_THAN(d.left, d.right);
+}
+
+void test_line_to_the_right_turns_right() {
+   RecordingDrive d = steer(Point2D_int(10000, 0), 900);     // Facing north, line goes east
+   TEST_ASSERT_GREATER_THAN(d.right, d.left);
+}
+
+int main() {
+   UNITY_BEGIN();
+   RUN_TEST(test_on_course_drives_straight);
+   RUN_TEST(test_line_to_the_left_turns_left);
+   RUN_TEST(test_line_to_the_right_turns_right);
+   return UNITY_END();
+}
@@ -0,0 +1,157 @@
+// PoseEKF bench simulation (doc/POSE_EKF.md): 20 minutes of 20m stripes with
+// 180 deg turns at 0.5m/s, 2% wheel slip, a 0.3 deg/s gyro bias and GPS at
+// 5Hz. The filter is fed increments as its Task would compute them.
+
+#include <unity.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "PoseEKF.h"
+
+// Gaussian noise, same sequence on every host (xorshift + Box-Muller)
+struct Noise {
+   uint32_t s;
+   explicit Noise(uint32_t seed) : s(seed) {}
+   double uniform() {
+      s ^= s << 13;
+      s ^= s >> 17;
+      s ^= s << 5;
+      return (s + 1.0) / 4294967297.0;
+   }
+   double gauss() { return sqrt(-2.0 * log(uniform())) * cos(2.0 * M_PI * uniform()); }
+};
+
+struct BenchResult {
+   double ekfRms;            // mm, after the first minute
+   double gpsRms;            // mm
+   double headingRms;        // deg
+   double maxOutageError;    // mm, worst while GPS was out
+   double errorAfterOutage;  // mm, 5s after GPS came back
+   int32_t bias;             // urad/s
+};
+
+static const double BiasDegPerS = 0.3;
+static const double TrueBias = BiasDegPerS * M_PI / 180 * 1e6;
+
+static Scheduler ts;
+
+static BenchResult bench(double gpsSigma, double outageFrom = -1, double outageTo = -1) {
+   WheelEncoder left(2), right(3);
+   Odometry odo(&ts, &left, &right, 40, 200);
+   IMUInterface imu;
+   GPSInterface gps;
+   PoseEKF ekf(&ts, &odo, &imu, &gps);
+   ekf.setGpsLatencyMs(0);
+   ekf.setPose(0, 0, 30, 100, 50);
+   Noise noise(1);
+
+   const double dt = 0.02, v = 0.5, slip = 0.02;
+   const double turn = M_PI / 3.15;                  // 180 deg in 3.15s
+   double x = 0, y = 0, th = 0, gyro = 0;
+   int32_t lastGyro = 0;
+   double se = 0, sg = 0, sh = 0;
+   uint32_t count = 0, fixes = 0;
+   BenchResult r = { 0, 0, 0, 0, 0, 0 };
+
+   for (uint32_t k = 1; k <= 60000; k++) {
+      double t = k * dt;
+      // 40s stripe, half turn, 40s stripe, half turn the other way
+      double cycle = fmod(t, 86.3);
+      int leg = (int)(t / 86.3);
+      double w = 0;
+      if (cycle >= 40 && cycle < 43.15) w = (leg % 2 ? -1 : 1) * turn;
+      if (cycle >= 83.15) w = (leg % 2 ? 1 : -1) * turn;
+
+      double ds = v * dt;
+      double mid = th + w * dt / 2;
+      x += ds * cos(mid);
+      y += ds * sin(mid);
+      th += w * dt;
+
+      // Odometry overreads by the slip; the gyro angle is in tenths, like getGyroAngle()
+      double measured = ds * (1 + slip) + 0.0005 * noise.gauss();
+      gyro += w * dt + BiasDegPerS * M_PI / 180 * dt;
+      int32_t g = (int32_t)floor(gyro * 1800 / M_PI);
+      ekf.predict(k * 20, (int32_t)lround(measured * 1e6), (g - lastGyro) * 174533 / 100, 20);
+      lastGyro = g;
+
+      bool out = t >= outageFrom && t < outageTo;
+      if (k % 10 == 0 && !out) {
+         double gx = x * 1000 + gpsSigma * noise.gauss();
+         double gy = y * 1000 + gpsSigma * noise.gauss();
+         ekf.correctPosition((distance_t)lround(gx), (distance_t)lround(gy),
+                             (int64_t)(gpsSigma * gpsSigma * 1e6));
+         if (t > 60) {
+            sg += (gx - x * 1000) * (gx - x * 1000) + (gy - y * 1000) * (gy - y * 1000);
+            fixes++;
+         }
+      }
+
+      PoseEstimate p = ekf.getPose();
+      double ex = p.position.x - x * 1000, ey = p.position.y - y * 1000;
+      double e = sqrt(ex * ex + ey * ey);
+      double he = p.heading / 10.0 - fmod(th * 180 / M_PI + 3600, 360);
+      while (he > 180) he -= 360;
+      while (he < -180) he += 360;
+      if (t > 60) {
+         se += e * e;
+         sh += he * he;
+         count++;
+      }
+      if (out && e > r.maxOutageError) r.maxOutageError = e;
+      if (outageTo > 0 && fabs(t - (outageTo + 5)) < dt / 2) r.errorAfterOutage = e;
+   }
+   r.ekfRms = sqrt(se / count);
+   r.gpsRms = sqrt(sg / fixes);
+   r.headingRms = sqrt(sh / count);
+   r.bias = ekf.getGyroBias();
+   return r;
+}
+
+static void report(const char *name, const BenchResult &r) {
+   char line[128];
+   snprintf(line, sizeof(line), "%s: GPS %.0fmm, EKF %.1fmm rms, heading %.2f deg rms, bias %ld urad/s",
+            name, r.gpsRms, r.ekfRms, r.headingRms, (long)r.bias);
+   TEST_MESSAGE(line);
+}
+
+void setUp() {}
+void tearDown() {}
+
+// doc: GPS 29mm rms -> EKF 12mm, heading 0.14 deg, bias 5093 of 5236 urad/s
+void test_rtk_noise_twenty_minutes() {
+   BenchResult r = bench(20);
+   report("20mm GPS", r);
+   TEST_ASSERT_LESS_THAN(16, (int)r.ekfRms);
+   TEST_ASSERT_LESS_THAN((int)(r.gpsRms / 2), (int)r.ekfRms);
+   TEST_ASSERT_LESS_THAN(20, (int)(r.headingRms * 100));
+   TEST_ASSERT_INT_WITHIN((int)(TrueBias * 0.05), (int)TrueBias, r.bias);
+}
+
+// doc: GPS 432mm rms -> EKF 87mm, heading 0.40 deg
+void test_float_noise_twenty_minutes() {
+   BenchResult r = bench(300);
+   report("300mm GPS", r);
+   TEST_ASSERT_LESS_THAN(110, (int)r.ekfRms);
+   TEST_ASSERT_LESS_THAN((int)(r.gpsRms / 4), (int)r.ekfRms);
+   TEST_ASSERT_LESS_THAN(60, (int)(r.headingRms * 100));
+   TEST_ASSERT_INT_WITHIN((int)(TrueBias * 0.10), (int)TrueBias, r.bias);
+}
+
+// doc: a 30s outage drifts at most 34cm, the first fixes pull it back
+void test_gps_outage() {
+   BenchResult r = bench(20, 600, 630);
+   char line[96];
+   snprintf(line, sizeof(line), "30s outage: worst %.0fmm, %.0fmm 5s after", r.maxOutageError, r.errorAfterOutage);
+   TEST_MESSAGE(line);
+   TEST_ASSERT_LESS_THAN(450, (int)r.maxOutageError);
+   TEST_ASSERT_LESS_THAN(50, (int)r.errorAfterOutage);
+}
+
+int main() {
+   UNITY_BEGIN();
+   RUN_TEST(test_rtk_noise_twenty_minutes);
+   RUN_TEST(test_float_noise_twenty_minutes);
+   RUN_TEST(test_gps_outage);
+   return UNITY_END();
+}
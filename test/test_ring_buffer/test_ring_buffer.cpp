@@ -0,0 +1,127 @@
+// RingBuffer overrun handling: an Overwrite ring left unread for any number
+// of pushes (the 8 bit indices lap) returns the newest Size items and counts
+// the rest as dropped.
+
+#include <unity.h>
+#include "RingBuffer.h"
+
+typedef RingBuffer<uint16_t, 4> Ring;
+
+static void pushSequence(Ring &ring, uint16_t first, uint16_t count) {
+   for (uint16_t i = 0; i < count; i++) ring.push((uint16_t)(first + i));
+}
+
+// The newest 4 of 0 .. pushed - 1 come back in order, the rest were dropped
+static void assertNewest(Ring &ring, uint16_t pushed) {
+   uint16_t latest = 0;
+   TEST_ASSERT_TRUE(ring.dataAvailable());
+   TEST_ASSERT_EQUAL_UINT16(4, ring.count());
+   TEST_ASSERT_TRUE(ring.peekLatest(latest));
+   TEST_ASSERT_EQUAL_UINT16(pushed - 1, latest);
+   for (uint16_t i = 0; i < 4; i++) {
+      uint16_t item = 0;
+      TEST_ASSERT_TRUE(ring.pull(item));
+      TEST_ASSERT_EQUAL_UINT16(pushed - 4 + i, item);
+   }
+   uint16_t item;
+   TEST_ASSERT_FALSE(ring.pull(item));
+   TEST_ASSERT_FALSE(ring.dataAvailable());
+   TEST_ASSERT_EQUAL_UINT16(pushed - 4, ring.takeDropped());
+   TEST_ASSERT_EQUAL_UINT16(0, ring.takeDropped());
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_exactly_a_lap_of_pushes() {
+   Ring ring;
+   pushSequence(ring, 0, 256);
+   assertNewest(ring, 256);
+}
+
+void test_a_lap_and_one() {
+   Ring ring;
+   pushSequence(ring, 0, 257);
+   assertNewest(ring, 257);
+}
+
+void test_many_laps() {
+   Ring ring;
+   pushSequence(ring, 0, 1000);
+   assertNewest(ring, 1000);
+}
+
+void test_pushN_over_laps() {
+   Ring ring;
+   uint16_t items[7];
+   uint16_t pushed = 0;
+   while (pushed < 1000) {
+      for (uint16_t i = 0; i < 7; i++) items[i] = (uint16_t)(pushed + i);
+      ring.pushN(items, 7);
+      pushed += 7;
+   }
+   assertNewest(ring, pushed);
+}
+
+// Consumer reads some, then falls behind by several laps, then catches up
+void test_overrun_after_reading() {
+   Ring ring;
+   pushSequence(ring, 0, 3);
+   uint16_t item;
+   TEST_ASSERT_TRUE(ring.pull(item));
+   TEST_ASSERT_EQUAL_UINT16(0, item);
+   pushSequence(ring, 3, 600);          // 2 unread + 600 pushed, 4 kept
+   for (uint16_t i = 0; i < 4; i++) {
+      TEST_ASSERT_TRUE(ring.pull(item));
+      TEST_ASSERT_EQUAL_UINT16(599 + i, item);
+   }
+   TEST_ASSERT_EQUAL_UINT16(598, ring.takeDropped());
+
+   // Back to normal: nothing lost while the consumer keeps up
+   for (uint16_t i = 0; i < 300; i++) {
+      ring.push(i);
+      TEST_ASSERT_TRUE(ring.pull(item));
+      TEST_ASSERT_EQUAL_UINT16(i, item);
+   }
+   TEST_ASSERT_EQUAL_UINT16(0, ring.takeDropped());
+}
+
+void test_clear_after_overrun() {
+   Ring ring;
+   pushSequence(ring, 0, 700);
+   ring.clear();
+   uint16_t item;
+   TEST_ASSERT_FALSE(ring.dataAvailable());
+   TEST_ASSERT_FALSE(ring.peekLatest(item));
+   ring.push(42);
+   TEST_ASSERT_TRUE(ring.pull(item));
+   TEST_ASSERT_EQUAL_UINT16(42, item);
+   TEST_ASSERT_EQUAL_UINT16(696, ring.takeDropped());
+}
+
+// Reject mode is unchanged: a full ring refuses the newest item
+void test_reject_when_full() {
+   RingBuffer<uint16_t, 4, false> ring;
+   for (uint16_t i = 0; i < 4; i++) TEST_ASSERT_TRUE(ring.push(i));
+   TEST_ASSERT_FALSE(ring.push(4));
+   TEST_ASSERT_EQUAL_UINT16(4, ring.count());
+   for (uint16_t n = 0; n < 600; n++) {
+      uint16_t item;
+      TEST_ASSERT_TRUE(ring.pull(item));
+      TEST_ASSERT_TRUE(ring.push(item));
+   }
+   TEST_ASSERT_EQUAL_UINT16(0, ring.takeDropped());
+}
+
+int main() {
+   UNITY_BEGIN();
+   RUN_TEST(test_exactly_a_lap_of_pushes);
+   RUN_TEST(test_a_lap_and_one);
+   RUN_TEST(test_many_laps);
+   RUN_TEST(test_pushN_over_laps);
+   RUN_TEST(test_overrun_after_reading);
+   RUN_TEST(test_clear_after_overrun);
+   RUN_TEST(test_reject_when_full);
+   return UNITY_END();
+}
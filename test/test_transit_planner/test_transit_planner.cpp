@@ -0,0 +1,190 @@
+// TransitPlanner on a large lawn (doc/TRANSIT_PLANNER.md): 100m x 80m, a
+// hedge with one gap and six beds, 500mm cells in a 32KB workspace. Paths
+// keep the clearance, step() gives the same path as findPath() in bounded
+// pieces, and findPath() is timed.
+
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include "TransitPlanner.h"
+
+static const uint16_t CellMM = 500;
+static const uint16_t ClearanceMM = 300;
+static const int Queries = 100;
+
+static uint16_t workspace[16384];
+static PerimeterStorage lawn;
+
+// Same queries on every host
+struct Random {
+   uint32_t s;
+   explicit Random(uint32_t seed) : s(seed) {}
+   int32_t below(int32_t n) {
+      s ^= s << 13;
+      s ^= s >> 17;
+      s ^= s << 5;
+      return (int32_t)(s % (uint32_t)n);
+   }
+};
+
+static void addBed(int32_t cx, int32_t cy, int32_t r) {
+   Point2D_int bed[8];
+   for (int i = 0; i < 8; i++) {
+      double a = i * M_PI / 4;
+      bed[i] = Point2D_int(cx + (int32_t)lround(r * cos(a)), cy + (int32_t)lround(r * sin(a)));
+   }
+   TEST_ASSERT_TRUE(lawn.addExclusionZone(bed, 8));
+}
+
+// Segments of at most 25m (16 bit offsets)
+static void buildLawn() {
+   const Point2D_int outer[] = {
+      Point2D_int(0, 0), Point2D_int(25000, 0), Point2D_int(50000, 0), Point2D_int(75000, 0),
+      Point2D_int(100000, 0), Point2D_int(100000, 20000), Point2D_int(100000, 40000),
+      Point2D_int(100000, 60000), Point2D_int(100000, 80000), Point2D_int(75000, 80000),
+      Point2D_int(50000, 80000), Point2D_int(25000, 80000), Point2D_int(0, 80000),
+      Point2D_int(0, 60000), Point2D_int(0, 40000), Point2D_int(0, 20000)
+   };
+   // From the south edge to 5m short of the north edge
+   const Point2D_int hedge[] = {
+      Point2D_int(48000, -1000), Point2D_int(52000, -1000), Point2D_int(52000, 20000),
+      Point2D_int(52000, 45000), Point2D_int(52000, 75000), Point2D_int(48000, 75000),
+      Point2D_int(48000, 50000), Point2D_int(48000, 25000)
+   };
+   lawn.clear();
+   lawn.loadFromArray(outer, 16);
+   TEST_ASSERT_TRUE(lawn.addExclusionZone(hedge, 8));
+   addBed(15000, 20000, 3000);
+   addBed(30000, 60000, 4000);
+   addBed(25000, 35000, 2000);
+   addBed(70000, 15000, 3500);
+   addBed(80000, 55000, 4500);
+   addBed(65000, 40000, 1500);
+}
+
+static Point2D_int randomPoint(Random &random) {
+   return Point2D_int(1000 + random.below(98000), 1000 + random.below(78000));
+}
+
+// Legs between corners (not the exact start and goal) keep the clearance
+static void assertLegsClear(TransitPlanner &planner) {
+   uint8_t n = planner.getPathCount();
+   for (uint8_t i = 1; i + 2 < n; i++) {
+      Point2D_int a = planner.getPathPoint(i);
+      Point2D_int b = planner.getPathPoint(i + 1);
+      int32_t samples = (int32_t)(hypot(b.x - a.x, b.y - a.y) / 50) + 1;
+      for (int32_t k = 0; k <= samples; k++) {
+         Point2D_int p(a.x + (b.x - a.x) * k / samples, a.y + (b.y - a.y) * k / samples);
+         TEST_ASSERT_TRUE(lawn.contains(p));
+         TEST_ASSERT_GREATER_OR_EQUAL(ClearanceMM, lawn.distanceToBoundary(p));
+      }
+   }
+}
+
+void setUp() {
+   buildLawn();
+}
+
+void tearDown() {}
+
+void test_grid_fits_the_workspace() {
+   TransitPlanner planner(workspace, sizeof(workspace));
+   TEST_ASSERT_TRUE(planner.begin(lawn, CellMM, ClearanceMM));
+   TEST_ASSERT_EQUAL_UINT16(201, planner.getCols());
+   TEST_ASSERT_EQUAL_UINT16(161, planner.getRows());
+   TEST_ASSERT_GREATER_OR_EQUAL(512, planner.getMaxNodes());
+}
+
+// Dock on the west edge to the far east side: through the hedge gap
+void test_path_goes_through_the_gap() {
+   TransitPlanner planner(workspace, sizeof(workspace));
+   TEST_ASSERT_TRUE(planner.begin(lawn, CellMM, ClearanceMM));
+   TEST_ASSERT_EQUAL(TransitPlanner::FOUND, planner.findPath(Point2D_int(0, 40000), Point2D_int(99000, 41000)));
+   bool north = false;
+   for (uint8_t i = 0; i < planner.getPathCount(); i++) {
+      if (planner.getPathPoint(i).y > 75000) north = true;
+   }
+   TEST_ASSERT_TRUE(north);
+   TEST_ASSERT_LESS_OR_EQUAL(TransitPlanner::MaxPathPoints + 2, planner.getPathCount());
+   assertLegsClear(planner);
+}
+
+void test_find_path_timing() {
+   TransitPlanner planner(workspace, sizeof(workspace));
+   TEST_ASSERT_TRUE(planner.begin(lawn, CellMM, ClearanceMM));
+   Random random(7);
+   double total = 0, worst = 0;
+   uint32_t expanded = 0;
+   int found = 0;
+   for (int k = 0; k < Queries; k++) {
+      Point2D_int from = randomPoint(random);
+      Point2D_int to = randomPoint(random);
+      auto t0 = std::chrono::steady_clock::now();
+      TransitPlanner::Status status = planner.findPath(from, to);
+      auto t1 = std::chrono::steady_clock::now();
+      double us = std::chrono::duration<double, std::micro>(t1 - t0).count();
+      total += us;
+      if (us > worst) worst = us;
+      if (planner.getExpanded() > expanded) expanded = planner.getExpanded();
+      if (status != TransitPlanner::FOUND) continue;
+      found++;
+      assertLegsClear(planner);
+   }
+
+   char line[96];
+   snprintf(line, sizeof(line), "findPath (host): %d found of %d, mean %.0f us, max %.0f us, %lu expanded max",
+            found, Queries, total / Queries, worst, (unsigned long)expanded);
+   TEST_MESSAGE(line);
+   TEST_ASSERT_EQUAL(Queries, found);
+}
+
+// Smallest budget: the search and the string pulling both take many steps,
+// and the result is findPath()'s
+void test_steps_are_bounded() {
+   TransitPlanner planner(workspace, sizeof(workspace));
+   TEST_ASSERT_TRUE(planner.begin(lawn, CellMM, ClearanceMM));
+   Point2D_int from(0, 40000), to(99000, 41000);
+   TEST_ASSERT_EQUAL(TransitPlanner::FOUND, planner.findPath(from, to));
+   Point2D_int path[TransitPlanner::MaxPathPoints + 2];
+   uint8_t count = planner.getPathCount();
+   for (uint8_t i = 0; i < count; i++) path[i] = planner.getPathPoint(i);
+
+   planner.setStepBudget(1);
+   TEST_ASSERT_EQUAL(TransitPlanner::SEARCHING, planner.plan(from, to));
+   uint32_t steps = 0;
+   double worst = 0;
+   TransitPlanner::Status status;
+   do {
+      auto t0 = std::chrono::steady_clock::now();
+      status = planner.step();
+      auto t1 = std::chrono::steady_clock::now();
+      double us = std::chrono::duration<double, std::micro>(t1 - t0).count();
+      if (us > worst) worst = us;
+      steps++;
+   } while (status == TransitPlanner::SEARCHING);
+
+   TEST_ASSERT_EQUAL(TransitPlanner::FOUND, status);
+   // One expansion per step, then the pulling: 8 cells of line of sight per
+   // step, so a path of ~100 cells takes more than a few
+   TEST_ASSERT_GREATER_THAN(planner.getExpanded() + 10, steps);
+   TEST_ASSERT_EQUAL_UINT8(count, planner.getPathCount());
+   for (uint8_t i = 0; i < count; i++) {
+      TEST_ASSERT_EQUAL_INT32(path[i].x, planner.getPathPoint(i).x);
+      TEST_ASSERT_EQUAL_INT32(path[i].y, planner.getPathPoint(i).y);
+   }
+
+   char line[96];
+   snprintf(line, sizeof(line), "step() budget 1 (host): %lu steps for %lu expanded, max %.1f us",
+            (unsigned long)steps, (unsigned long)planner.getExpanded(), worst);
+   TEST_MESSAGE(line);
+}
+
+int main() {
+   UNITY_BEGIN();
+   RUN_TEST(test_grid_fits_the_workspace);
+   RUN_TEST(test_path_goes_through_the_gap);
+   RUN_TEST(test_find_path_timing);
+   RUN_TEST(test_steps_are_bounded);
+   return UNITY_END();
+}